@@ -152,6 +152,45 @@ typedef enum {
 void Axp192_Init();
 /* @[declare_axp192_init] */
 
+/**
+ * @brief AXP192 register cache statistics.
+ */
+/* @[declare_axp192_cache_stats_t] */
+typedef struct {
+    uint32_t bus_reads;         /**< @brief Register reads sent over I2C. */
+    uint32_t reads_cached;      /**< @brief Control register reads served from the cache. */
+    uint32_t bus_writes;        /**< @brief Register writes sent over I2C. */
+    uint32_t writes_skipped;    /**< @brief Writes skipped because the register already held the value. */
+} axp192_cache_stats_t;
+/* @[declare_axp192_cache_stats_t] */
+
+/**
+ * @brief Forgets the cached AXP192 control registers.
+ * 
+ * With CONFIG_AXP192_REG_CACHE, the control registers that only the
+ * firmware changes (output enables, voltages, charge and GPIO setup) are
+ * kept in a write-through cache. Read-modify-write updates then need no bus
+ * read, and writes of an unchanged value are skipped. Status, IRQ and ADC
+ * registers are always read live.
+ * 
+ * Call it if the AXP192 may have been reset or changed behind the
+ * driver, the next access of each register then reads it again.
+ */
+/* @[declare_axp192_invalidateregcache] */
+void Axp192_InvalidateRegCache();
+/* @[declare_axp192_invalidateregcache] */
+
+/**
+ * @brief Copies the AXP192 register cache statistics.
+ * 
+ * All counters stay 0 without CONFIG_AXP192_REG_CACHE.
+ * 
+ * @param[out] stats The statistics.
+ */
+/* @[declare_axp192_getregcachestats] */
+void Axp192_GetRegCacheStats(axp192_cache_stats_t *stats);
+/* @[declare_axp192_getregcachestats] */
+
 /**
  * @brief Extends the DC voltage range of the Low-Dropout
  * regulator (LDO) on the AXP192.
@@ -0,0 +1,187 @@
+/**
+ * @file i2c_trace.h
+ * @brief Per-device transaction statistics and a trace of the I2C buses.
+ *
+ * Enabled with CONFIG_I2C_TRACE. i2c_device.c reports every transaction
+ * into this module, which keeps for each device (port and address):
+ *  - read and write transaction counts and the bytes moved,
+ *  - error and timeout counts,
+ *  - a histogram of the time a transaction waited for the bus, from being
+ *    queued until its command link started,
+ *  - a histogram of the transfer time on the wire,
+ * and a record of the last CONFIG_I2C_TRACE_HISTORY transactions of all
+ * devices. Batched transactions share the transfer time of their command
+ * link in proportion to their bytes on the wire.
+ *
+ * Drivers that run their own command links after i2c_apply_bus(), like the
+ * ATECC608 HAL, only report the time they waited for the bus.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "driver/i2c.h"
+#include "latency_histogram.h"
+
+/**
+ * @brief Most devices with their own statistics, further devices are not traced.
+ */
+#define I2C_TRACE_MAX_DEVICES       12
+
+/**
+ * @brief Number of histogram buckets, see latency_histogram.h.
+ */
+#define I2C_TRACE_BUCKETS           LATENCY_HISTOGRAM_BUCKETS
+#define I2C_TRACE_BUCKET_BASE_US    LATENCY_HISTOGRAM_BASE_US
+
+/**
+ * @brief Histogram of durations.
+ */
+/* @[declare_i2c_trace_histogram_t] */
+typedef latency_histogram_t i2c_trace_histogram_t;
+/* @[declare_i2c_trace_histogram_t] */
+
+/**
+ * @brief Statistics of one device.
+ */
+/* @[declare_i2c_trace_stats_t] */
+typedef struct {
+    i2c_port_t port;                /**< I2C port of the device. */
+    uint8_t addr;                   /**< 7 bit address of the device. */
+    uint32_t reads;                 /**< Read transactions. */
+    uint32_t writes;                /**< Write transactions. */
+    uint64_t bytes_read;            /**< Data bytes read, without addresses. */
+    uint64_t bytes_written;         /**< Data bytes written, without addresses. */
+    uint32_t errors;                /**< Failed transactions other than timeouts. */
+    uint32_t timeouts;              /**< Transactions that timed out. */
+    i2c_trace_histogram_t wait;     /**< Time waited for the bus, queueing included. */
+    i2c_trace_histogram_t transfer; /**< Time on the wire. */
+} i2c_trace_stats_t;
+/* @[declare_i2c_trace_stats_t] */
+
+/**
+ * @brief One recorded transaction.
+ */
+/* @[declare_i2c_trace_record_t] */
+typedef struct {
+    uint32_t start_us;          /**< esp_timer_get_time() when the command link started, lower 32 bits. */
+    uint32_t wait_us;           /**< Time waited for the bus. */
+    uint32_t transfer_us;       /**< Time on the wire. */
+    uint32_t reg_addr;          /**< Register address, or I2C_NO_REG. */
+    esp_err_t err;              /**< Result of the transaction. */
+    uint16_t length;            /**< Data bytes. */
+    uint8_t port;               /**< I2C port. */
+    uint8_t addr;               /**< 7 bit device address. */
+    bool write;                 /**< Write or read. */
+    uint8_t batch;              /**< Transactions in the command link. */
+} i2c_trace_record_t;
+/* @[declare_i2c_trace_record_t] */
+
+/**
+ * @brief Registers a device for statistics.
+ *
+ * Called by i2c_malloc_device(). Devices with the same port and address
+ * share their statistics.
+ *
+ * @return The index of the device statistics, -1 if the table is full.
+ */
+/* @[declare_i2c_trace_add_device] */
+int8_t i2c_trace_add_device(i2c_port_t port, uint8_t addr);
+/* @[declare_i2c_trace_add_device] */
+
+/**
+ * @brief Records a completed transaction.
+ *
+ * Called by i2c_device.c after each command link, once per transaction.
+ */
+/* @[declare_i2c_trace_transaction] */
+void i2c_trace_transaction(int8_t device, const i2c_trace_record_t *record);
+/* @[declare_i2c_trace_transaction] */
+
+/**
+ * @brief Records the time a device waited in i2c_apply_bus().
+ */
+/* @[declare_i2c_trace_bus_wait] */
+void i2c_trace_bus_wait(int8_t device, uint32_t wait_us);
+/* @[declare_i2c_trace_bus_wait] */
+
+/**
+ * @brief Copies the statistics of one device.
+ *
+ * **Example:**
+ *
+ * Log how long touch reads wait for the bus at worst.
+ * @code{c}
+ *  i2c_trace_stats_t touch;
+ *  if (i2c_trace_get_device_stats(I2C_NUM_1, 0x38, &touch) == ESP_OK) {
+ *      ESP_LOGI(TAG, "touch waited up to %u us in %u reads", touch.wait.max_us, touch.reads);
+ *  }
+ * @endcode
+ *
+ * @param[in] port I2C port of the device.
+ * @param[in] addr 7 bit address of the device.
+ * @param[out] stats The statistics.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : stats is NULL
+ *  - ESP_ERR_NOT_FOUND     : The device is not traced
+ */
+/* @[declare_i2c_trace_get_device_stats] */
+esp_err_t i2c_trace_get_device_stats(i2c_port_t port, uint8_t addr, i2c_trace_stats_t *stats);
+/* @[declare_i2c_trace_get_device_stats] */
+
+/**
+ * @brief Copies the statistics of all traced devices.
+ *
+ * @param[out] stats Array of at least max_devices entries.
+ * @param[in] max_devices Size of the array.
+ *
+ * @return The number of devices copied.
+ */
+/* @[declare_i2c_trace_get_stats] */
+size_t i2c_trace_get_stats(i2c_trace_stats_t *stats, size_t max_devices);
+/* @[declare_i2c_trace_get_stats] */
+
+/**
+ * @brief Copies the most recent transactions, newest first.
+ *
+ * @param[out] records Array of at least max_records entries.
+ * @param[in] max_records Size of the array.
+ *
+ * @return The number of records copied.
+ */
+/* @[declare_i2c_trace_get_recent] */
+size_t i2c_trace_get_recent(i2c_trace_record_t *records, size_t max_records);
+/* @[declare_i2c_trace_get_recent] */
+
+/**
+ * @brief Clears the statistics and the recorded transactions, the devices stay registered.
+ */
+/* @[declare_i2c_trace_reset] */
+void i2c_trace_reset(void);
+/* @[declare_i2c_trace_reset] */
+
+/**
+ * @brief Prints the statistics of every device and the recent transactions to the console.
+ */
+/* @[declare_i2c_trace_dump] */
+void i2c_trace_dump(void);
+/* @[declare_i2c_trace_dump] */
+
+/**
+ * @brief Registers the `i2c_trace` console command.
+ *
+ * Available with CONFIG_I2C_TRACE_CONSOLE. `i2c_trace` prints the
+ * statistics, `i2c_trace reset` clears them. Call it after
+ * esp_console_init() or esp_console_new_repl_uart().
+ *
+ * @return The result of esp_console_cmd_register().
+ */
+/* @[declare_i2c_trace_register_console_command] */
+esp_err_t i2c_trace_register_console_command(void);
+/* @[declare_i2c_trace_register_console_command] */
@@ -0,0 +1,291 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_idf_version.h"
+#include "esp_timer.h"
+#include "driver/i2s.h"
+#include "driver/gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "i2s_manager.h"
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+#include "esp_rom_gpio.h"
+#define I2S_MANAGER_ROUTE(pin, signal) esp_rom_gpio_connect_out_signal(pin, signal, false, false)
+#else
+#include "esp32/rom/gpio.h"
+#define I2S_MANAGER_ROUTE(pin, signal) gpio_matrix_out(pin, signal, false, false)
+#endif
+
+#ifndef CONFIG_I2S_MANAGER_TASK_PRIORITY
+#define CONFIG_I2S_MANAGER_TASK_PRIORITY 7
+#endif
+
+typedef struct {
+    bool open;
+    i2s_port_t port;
+    uint32_t ws_signal;
+    i2s_pin_config_t pins;
+    /* How long the DMA buffers take to play */
+    int64_t drain_us;
+} i2s_manager_side_t;
+
+static i2s_manager_side_t sides[2] = {
+    [I2S_MANAGER_RX] = { .port = I2S_MANAGER_RX_PORT, .ws_signal = I2S0O_WS_OUT_IDX },
+    [I2S_MANAGER_TX] = { .port = I2S_MANAGER_TX_PORT, .ws_signal = I2S1O_WS_OUT_IDX },
+};
+static i2s_manager_dir_t owner = I2S_MANAGER_NONE;
+static bool tx_writing;
+static i2s_manager_stats_t manager_stats = { .owner = I2S_MANAGER_NONE };
+
+/* Guards the state above and the switches */
+static SemaphoreHandle_t manager_mutex;
+/* Held by the speaker writer between I2SManager_AcquireTx() and I2SManager_ReleaseTx() */
+static SemaphoreHandle_t tx_mutex;
+
+static volatile bool duplex_running;
+static uint16_t duplex_rx_ms, duplex_tx_ms;
+static SemaphoreHandle_t duplex_done;
+
+static esp_err_t I2SManager_CreateLocks(void) {
+    if (manager_mutex == NULL) {
+        manager_mutex = xSemaphoreCreateMutex();
+        tx_mutex = xSemaphoreCreateMutex();
+        duplex_done = xSemaphoreCreateBinary();
+    }
+    return manager_mutex && tx_mutex && duplex_done ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/* Called with manager_mutex taken */
+static void I2SManager_Switch(i2s_manager_dir_t dir) {
+    if (dir == owner) {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    if (owner != I2S_MANAGER_NONE) {
+        i2s_stop(sides[owner].port);
+    }
+    if (dir != I2S_MANAGER_NONE) {
+        I2S_MANAGER_ROUTE(I2S_MANAGER_SHARED_PIN, sides[dir].ws_signal);
+        i2s_start(sides[dir].port);
+    }
+    owner = dir;
+    uint32_t elapsed = esp_timer_get_time() - start;
+
+    manager_stats.owner = dir;
+    manager_stats.switches++;
+    manager_stats.switch_us_last = elapsed;
+    manager_stats.switch_us_total += elapsed;
+    if (elapsed > manager_stats.switch_us_max) {
+        manager_stats.switch_us_max = elapsed;
+    }
+}
+
+static bool I2SManager_PinShared(int pin, i2s_manager_dir_t other) {
+    const i2s_pin_config_t *pins = &sides[other].pins;
+    return sides[other].open && (pin == pins->bck_io_num || pin == pins->ws_io_num ||
+                                 pin == pins->data_out_num || pin == pins->data_in_num);
+}
+
+esp_err_t I2SManager_Open(i2s_manager_dir_t dir, const i2s_config_t *config, const i2s_pin_config_t *pins) {
+    if ((dir != I2S_MANAGER_RX && dir != I2S_MANAGER_TX) || config == NULL || pins == NULL ||
+        config->sample_rate <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (I2SManager_CreateLocks() != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    i2s_manager_side_t *side = &sides[dir];
+    if (side->open) {
+        xSemaphoreGive(manager_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = i2s_driver_install(side->port, config, 0, NULL);
+    if (err != ESP_OK) {
+        xSemaphoreGive(manager_mutex);
+        return err;
+    }
+    i2s_set_pin(side->port, pins);
+    i2s_set_clk(side->port, config->sample_rate, config->bits_per_sample, I2S_CHANNEL_MONO);
+    /* Not clocked until it has the shared pin */
+    i2s_stop(side->port);
+    side->pins = *pins;
+    side->drain_us = (int64_t) config->dma_buf_count * config->dma_buf_len * 1000000 / config->sample_rate;
+    side->open = true;
+
+    /* The pins were just routed to this side, the owner gets the shared one back unless this side takes it */
+    i2s_manager_dir_t want = owner;
+    if (owner == I2S_MANAGER_NONE || (dir == I2S_MANAGER_RX && !tx_writing && !duplex_running)) {
+        want = dir;
+    }
+    if (want == owner) {
+        I2S_MANAGER_ROUTE(I2S_MANAGER_SHARED_PIN, sides[owner].ws_signal);
+    } else {
+        I2SManager_Switch(want);
+    }
+    xSemaphoreGive(manager_mutex);
+    return ESP_OK;
+}
+
+esp_err_t I2SManager_Close(i2s_manager_dir_t dir) {
+    if (dir != I2S_MANAGER_RX && dir != I2S_MANAGER_TX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (manager_mutex == NULL || !sides[dir].open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (duplex_running) {
+        I2SManager_StopDuplex();
+    }
+
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    i2s_manager_side_t *side = &sides[dir];
+    i2s_manager_dir_t other = dir == I2S_MANAGER_RX ? I2S_MANAGER_TX : I2S_MANAGER_RX;
+    if (owner == dir) {
+        I2SManager_Switch(sides[other].open ? other : I2S_MANAGER_NONE);
+    }
+    i2s_driver_uninstall(side->port);
+    side->open = false;
+
+    const int pins[] = { side->pins.bck_io_num, side->pins.ws_io_num, side->pins.data_out_num,
+                         side->pins.data_in_num };
+    for (int i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        if (pins[i] >= 0 && !I2SManager_PinShared(pins[i], other)) {
+            gpio_reset_pin(pins[i]);
+        }
+    }
+    xSemaphoreGive(manager_mutex);
+    return ESP_OK;
+}
+
+esp_err_t I2SManager_AcquireTx(TickType_t wait) {
+    if (manager_mutex == NULL || !sides[I2S_MANAGER_TX].open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(tx_mutex, wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    tx_writing = true;
+    if (!duplex_running) {
+        I2SManager_Switch(I2S_MANAGER_TX);
+    }
+    xSemaphoreGive(manager_mutex);
+    return ESP_OK;
+}
+
+static void I2SManager_EndTx(bool drained) {
+    bool hand_back = !duplex_running && sides[I2S_MANAGER_RX].open && owner == I2S_MANAGER_TX;
+    int64_t drain_us = 0;
+
+    if (hand_back && !drained) {
+        /* The last write returned once its samples were in the DMA buffers, which play for at most drain_us */
+        int64_t start = esp_timer_get_time();
+        const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+        vTaskDelay((sides[I2S_MANAGER_TX].drain_us + tick_us - 1) / tick_us + 1);
+        drain_us = esp_timer_get_time() - start;
+    }
+
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    tx_writing = false;
+    if (hand_back && !duplex_running && sides[I2S_MANAGER_RX].open) {
+        I2SManager_Switch(I2S_MANAGER_RX);
+    }
+    if (drain_us > manager_stats.drain_us_max) {
+        manager_stats.drain_us_max = drain_us;
+    }
+    xSemaphoreGive(manager_mutex);
+    xSemaphoreGive(tx_mutex);
+}
+
+void I2SManager_ReleaseTx(void) {
+    I2SManager_EndTx(false);
+}
+
+void I2SManager_ReleaseTxDrained(void) {
+    I2SManager_EndTx(true);
+}
+
+static void I2SManager_DuplexTask(void *arg) {
+    TickType_t rx_ticks = pdMS_TO_TICKS(duplex_rx_ms) ? pdMS_TO_TICKS(duplex_rx_ms) : 1;
+    TickType_t tx_ticks = pdMS_TO_TICKS(duplex_tx_ms) ? pdMS_TO_TICKS(duplex_tx_ms) : 1;
+    TickType_t wake = xTaskGetTickCount();
+
+    while (duplex_running) {
+        xSemaphoreTake(manager_mutex, portMAX_DELAY);
+        I2SManager_Switch(I2S_MANAGER_RX);
+        xSemaphoreGive(manager_mutex);
+        vTaskDelayUntil(&wake, rx_ticks);
+        if (!duplex_running) {
+            break;
+        }
+
+        xSemaphoreTake(manager_mutex, portMAX_DELAY);
+        I2SManager_Switch(I2S_MANAGER_TX);
+        xSemaphoreGive(manager_mutex);
+        vTaskDelayUntil(&wake, tx_ticks);
+    }
+
+    xSemaphoreGive(duplex_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t I2SManager_StartDuplex(uint16_t rx_ms, uint16_t tx_ms) {
+    if (rx_ms < 1 || rx_ms > 1000 || tx_ms < 1 || tx_ms > 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (manager_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    if (duplex_running || !sides[I2S_MANAGER_RX].open || !sides[I2S_MANAGER_TX].open) {
+        xSemaphoreGive(manager_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    duplex_rx_ms = rx_ms;
+    duplex_tx_ms = tx_ms;
+    duplex_running = true;
+    if (xTaskCreatePinnedToCore(I2SManager_DuplexTask, "I2SDuplexTask", 2 * 1024, NULL,
+                                CONFIG_I2S_MANAGER_TASK_PRIORITY, NULL, 0) != pdPASS) {
+        duplex_running = false;
+        xSemaphoreGive(manager_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+    manager_stats.duplex = true;
+    xSemaphoreGive(manager_mutex);
+    return ESP_OK;
+}
+
+esp_err_t I2SManager_StopDuplex(void) {
+    if (manager_mutex == NULL || !duplex_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* The task sees the flag at the end of its current slot */
+    duplex_running = false;
+    xSemaphoreTake(duplex_done, portMAX_DELAY);
+
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    manager_stats.duplex = false;
+    if (!tx_writing && sides[I2S_MANAGER_RX].open) {
+        I2SManager_Switch(I2S_MANAGER_RX);
+    } else if (sides[I2S_MANAGER_TX].open) {
+        I2SManager_Switch(I2S_MANAGER_TX);
+    }
+    xSemaphoreGive(manager_mutex);
+    return ESP_OK;
+}
+
+void I2SManager_GetStats(i2s_manager_stats_t *stats) {
+    if (manager_mutex == NULL) {
+        *stats = manager_stats;
+        return;
+    }
+    xSemaphoreTake(manager_mutex, portMAX_DELAY);
+    *stats = manager_stats;
+    xSemaphoreGive(manager_mutex);
+}
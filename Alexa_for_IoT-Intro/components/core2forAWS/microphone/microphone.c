@@ -1,16 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_idf_version.h"
+#include "esp_timer.h"
 #include "driver/i2s.h"
-#include "driver/gpio.h"
+#include "i2s_manager.h"
 #include "microphone.h"
 
 #define I2S_LRCK_PIN 0
 #define I2S_DATA_IN_PIN 34
 
-void Microphone_Init() {
+#ifndef CONFIG_MIC_CAPTURE_SAMPLE_RATE
+#define CONFIG_MIC_CAPTURE_SAMPLE_RATE 16000
+#endif
+
+#ifndef CONFIG_MIC_CAPTURE_DMA_BUF_COUNT
+#define CONFIG_MIC_CAPTURE_DMA_BUF_COUNT 4
+#endif
+
+#ifndef CONFIG_MIC_CAPTURE_DMA_BUF_LEN
+#define CONFIG_MIC_CAPTURE_DMA_BUF_LEN 256
+#endif
+
+#ifndef CONFIG_MIC_CAPTURE_FRAME_SAMPLES
+#define CONFIG_MIC_CAPTURE_FRAME_SAMPLES 512
+#endif
+
+#ifndef CONFIG_MIC_CAPTURE_POOL_FRAMES
+#define CONFIG_MIC_CAPTURE_POOL_FRAMES 4
+#endif
+
+#ifndef CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS
+#define CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS 4
+#endif
+
+#ifndef CONFIG_MIC_CAPTURE_TASK_PRIORITY
+#define CONFIG_MIC_CAPTURE_TASK_PRIORITY 6
+#endif
+
+struct mic_subscriber {
+    QueueHandle_t queue;
+};
+
+static mic_capture_config_t capture_config;
+static mic_frame_t *frames;
+/* The frame a capture finding the pool empty goes to, to keep up with the DMA */
+static mic_frame_t discard_frame;
+static int16_t *frame_samples;
+static QueueHandle_t free_frames;
+static struct mic_subscriber subscribers[CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS];
+static SemaphoreHandle_t subscribers_mutex;
+static SemaphoreHandle_t capture_done;
+static TaskHandle_t capture_task_handle;
+static volatile bool capturing;
+static mic_capture_stats_t capture_stats;
+/* References the consumers hold, received or still queued, the capture cannot stop under them */
+static uint32_t frames_out;
+static portMUX_TYPE frame_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t Microphone_InstallI2S(uint32_t rate, int dma_buf_count, int dma_buf_len) {
     i2s_config_t i2s_config = {
         .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_PDM),
-        .sample_rate = 44100,
+        .sample_rate = rate,
         .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
         .channel_format = I2S_CHANNEL_FMT_ALL_RIGHT,
 #if ESP_IDF_VERSION > ESP_IDF_VERSION_VAL(4, 1, 0)
@@ -19,8 +73,8 @@ void Microphone_Init() {
 		.communication_format = I2S_COMM_FORMAT_I2S,
 #endif
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 2,
-        .dma_buf_len = 128,
+        .dma_buf_count = dma_buf_count,
+        .dma_buf_len = dma_buf_len,
     };
 
     i2s_pin_config_t pin_config;
@@ -28,14 +82,331 @@ void Microphone_Init() {
     pin_config.ws_io_num = I2S_LRCK_PIN;
     pin_config.data_out_num = I2S_PIN_NO_CHANGE;
     pin_config.data_in_num = I2S_DATA_IN_PIN;
-    
-    i2s_driver_install(MIC_I2S_NUMBER, &i2s_config, 0, NULL);
-    i2s_set_pin(MIC_I2S_NUMBER, &pin_config);
-    i2s_set_clk(MIC_I2S_NUMBER, 44100, I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_MONO);
+
+    return I2SManager_Open(I2S_MANAGER_RX, &i2s_config, &pin_config);
+}
+
+void Microphone_Init() {
+    Microphone_InstallI2S(44100, 2, 128);
 }
 
 void Microphone_Deinit() {
-    i2s_driver_uninstall(MIC_I2S_NUMBER);
-    gpio_reset_pin(GPIO_NUM_0);
-    gpio_reset_pin(GPIO_NUM_34);
-}
\ No newline at end of file
+    I2SManager_Close(I2S_MANAGER_RX);
+}
+
+static void Microphone_FreePool(void) {
+    if (free_frames != NULL) {
+        vQueueDelete(free_frames);
+        free_frames = NULL;
+    }
+    free(frames);
+    free(frame_samples);
+    frames = NULL;
+    frame_samples = NULL;
+}
+
+/* Returns the frame to the pool when its last reference is dropped */
+static void Microphone_DropRef(mic_frame_t *frame) {
+    portENTER_CRITICAL(&frame_mux);
+    bool last = --frame->refs == 0;
+    portEXIT_CRITICAL(&frame_mux);
+    if (last) {
+        xQueueSend(free_frames, &frame, 0);
+    }
+}
+
+static void Microphone_Publish(mic_frame_t *frame) {
+    bool published = false;
+    uint32_t queue_full = 0;
+
+    /* The capture holds a reference of its own until every consumer has the frame */
+    frame->refs = 1;
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].queue == NULL) {
+            continue;
+        }
+        portENTER_CRITICAL(&frame_mux);
+        frame->refs++;
+        frames_out++;
+        portEXIT_CRITICAL(&frame_mux);
+        if (xQueueSend(subscribers[i].queue, &frame, 0) == pdTRUE) {
+            published = true;
+        } else {
+            portENTER_CRITICAL(&frame_mux);
+            frame->refs--;
+            frames_out--;
+            portEXIT_CRITICAL(&frame_mux);
+            queue_full++;
+        }
+    }
+    xSemaphoreGive(subscribers_mutex);
+
+    portENTER_CRITICAL(&frame_mux);
+    capture_stats.published += published;
+    capture_stats.queue_full += queue_full;
+    portEXIT_CRITICAL(&frame_mux);
+    Microphone_DropRef(frame);
+}
+
+static void Microphone_CaptureTask(void *arg) {
+    const size_t frame_bytes = capture_config.frame_samples * sizeof(int16_t);
+    const int64_t frame_us = (int64_t) capture_config.frame_samples * 1000000 / capture_config.sample_rate;
+    const int64_t dma_us = (int64_t) capture_config.dma_buf_count * capture_config.dma_buf_len * 1000000 /
+                           capture_config.sample_rate;
+    const TickType_t read_wait = pdMS_TO_TICKS(2 * frame_us / 1000) + 2;
+    int64_t next_us = 0;
+    uint32_t sequence = 0;
+    bool lost = false;
+    bool resync = false;
+    i2s_manager_stats_t pin_stats;
+    I2SManager_GetStats(&pin_stats);
+    uint32_t switches = pin_stats.switches;
+
+    while (capturing) {
+        mic_frame_t *frame;
+        if (xQueueReceive(free_frames, &frame, 0) != pdTRUE) {
+            frame = &discard_frame;
+        }
+
+        size_t bytes_read = 0;
+        int64_t before = esp_timer_get_time();
+        esp_err_t err = i2s_read(MIC_I2S_NUMBER, (void *) frame->samples, frame_bytes, &bytes_read, read_wait);
+        int64_t after = esp_timer_get_time();
+        if (err != ESP_OK || bytes_read < frame_bytes) {
+            /* Whatever was read of the frame is gone */
+            if (frame != &discard_frame) {
+                xQueueSend(free_frames, &frame, 0);
+            }
+            lost = true;
+            resync = true;
+            continue;
+        }
+
+        /* The speaker had the shared pin during the read, the samples stopped for a while */
+        I2SManager_GetStats(&pin_stats);
+        if (pin_stats.switches != switches) {
+            switches = pin_stats.switches;
+            lost = true;
+            resync = true;
+        }
+
+        int64_t time_us;
+        uint32_t lost_samples = 0;
+        if (sequence == 0 || resync) {
+            /* Nothing to follow, the frame ended at most when the read returned */
+            time_us = after - frame_us;
+            resync = false;
+        } else if (after - before >= frame_us / 2) {
+            /* The read waited for the last samples, so the frame started at most frame_us before
+             * it returned. Scheduling only makes that later: follow earlier bounds at once and
+             * later ones slowly, which keeps the clock of the samples but not the jitter. */
+            int64_t bound_us = after - frame_us;
+            time_us = bound_us < next_us ? bound_us : next_us + (bound_us - next_us) / 16;
+        } else {
+            /* Samples were waiting, more than the DMA buffers hold means the oldest were dropped */
+            time_us = next_us;
+            int64_t backlog_us = after - (next_us + frame_us);
+            if (backlog_us > dma_us) {
+                lost_samples = (backlog_us - dma_us) * capture_config.sample_rate / 1000000;
+                time_us = after - dma_us - frame_us;
+            }
+        }
+        next_us = time_us + frame_us;
+
+        portENTER_CRITICAL(&frame_mux);
+        capture_stats.frames++;
+        if (lost_samples) {
+            capture_stats.dma_overruns++;
+            capture_stats.dma_lost_samples += lost_samples;
+            capture_stats.last_overrun_us = after;
+        }
+        if (frame == &discard_frame) {
+            capture_stats.pool_empty++;
+        }
+        portEXIT_CRITICAL(&frame_mux);
+
+        if (frame == &discard_frame) {
+            lost = true;
+        } else {
+            frame->sequence = sequence;
+            frame->time_us = time_us;
+            frame->discontinuity = lost || lost_samples;
+            lost = false;
+            Microphone_Publish(frame);
+        }
+        sequence++;
+    }
+
+    xSemaphoreGive(capture_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t Microphone_StartCapture(const mic_capture_config_t *config) {
+    mic_capture_config_t settings = { 0 };
+    if (config != NULL) {
+        settings = *config;
+    }
+    settings.sample_rate = settings.sample_rate ? settings.sample_rate : CONFIG_MIC_CAPTURE_SAMPLE_RATE;
+    settings.dma_buf_count = settings.dma_buf_count ? settings.dma_buf_count : CONFIG_MIC_CAPTURE_DMA_BUF_COUNT;
+    settings.dma_buf_len = settings.dma_buf_len ? settings.dma_buf_len : CONFIG_MIC_CAPTURE_DMA_BUF_LEN;
+    settings.frame_samples = settings.frame_samples ? settings.frame_samples : CONFIG_MIC_CAPTURE_FRAME_SAMPLES;
+    settings.pool_frames = settings.pool_frames ? settings.pool_frames : CONFIG_MIC_CAPTURE_POOL_FRAMES;
+    config = &settings;
+
+    if (config->sample_rate < 1000 || config->sample_rate > 96000 || config->dma_buf_count < 2 ||
+        config->dma_buf_count > 128 || config->dma_buf_len < 8 || config->dma_buf_len > 1024 ||
+        config->frame_samples < 16 || config->pool_frames < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (capturing) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (subscribers_mutex == NULL) {
+        subscribers_mutex = xSemaphoreCreateMutex();
+        capture_done = xSemaphoreCreateBinary();
+        if (subscribers_mutex == NULL || capture_done == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    capture_config = *config;
+    frames = calloc(config->pool_frames, sizeof(mic_frame_t));
+    /* One more frame of samples for discard_frame */
+    frame_samples = malloc((config->pool_frames + 1) * config->frame_samples * sizeof(int16_t));
+    free_frames = xQueueCreate(config->pool_frames, sizeof(mic_frame_t *));
+    if (frames == NULL || frame_samples == NULL || free_frames == NULL) {
+        Microphone_FreePool();
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i <= config->pool_frames; i++) {
+        mic_frame_t *frame = i < config->pool_frames ? &frames[i] : &discard_frame;
+        frame->samples = &frame_samples[i * config->frame_samples];
+        frame->count = config->frame_samples;
+        if (frame != &discard_frame) {
+            xQueueSend(free_frames, &frame, 0);
+        }
+    }
+
+    if (Microphone_InstallI2S(config->sample_rate, config->dma_buf_count, config->dma_buf_len) != ESP_OK) {
+        Microphone_FreePool();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&frame_mux);
+    memset(&capture_stats, 0, sizeof(capture_stats));
+    portEXIT_CRITICAL(&frame_mux);
+    capturing = true;
+    if (xTaskCreatePinnedToCore(Microphone_CaptureTask, "MicCaptureTask", 3 * 1024, NULL,
+                                CONFIG_MIC_CAPTURE_TASK_PRIORITY, &capture_task_handle, 0) != pdPASS) {
+        capturing = false;
+        Microphone_Deinit();
+        Microphone_FreePool();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Microphone_StopCapture(void) {
+    if (!capturing) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].queue != NULL) {
+            xSemaphoreGive(subscribers_mutex);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    /* Without subscribers nothing adds references, a frame still held would be freed under its consumer */
+    portENTER_CRITICAL(&frame_mux);
+    uint32_t held = frames_out;
+    portEXIT_CRITICAL(&frame_mux);
+    xSemaphoreGive(subscribers_mutex);
+    if (held) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* The task sees the flag after its current read */
+    capturing = false;
+    xSemaphoreTake(capture_done, portMAX_DELAY);
+    capture_task_handle = NULL;
+    Microphone_Deinit();
+    Microphone_FreePool();
+    return ESP_OK;
+}
+
+esp_err_t Microphone_Subscribe(uint8_t depth, mic_subscriber_t *subscriber) {
+    if (depth == 0 || subscriber == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!capturing) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].queue == NULL) {
+            subscribers[i].queue = xQueueCreate(depth, sizeof(mic_frame_t *));
+            if (subscribers[i].queue != NULL) {
+                *subscriber = &subscribers[i];
+                err = ESP_OK;
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(subscribers_mutex);
+    return err;
+}
+
+esp_err_t Microphone_Unsubscribe(mic_subscriber_t subscriber) {
+    if (subscriber < &subscribers[0] || subscriber >= &subscribers[CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS] ||
+        subscribers_mutex == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(subscribers_mutex, portMAX_DELAY);
+    if (subscriber->queue == NULL) {
+        xSemaphoreGive(subscribers_mutex);
+        return ESP_ERR_INVALID_ARG;
+    }
+    mic_frame_t *frame;
+    while (xQueueReceive(subscriber->queue, &frame, 0) == pdTRUE) {
+        Microphone_ReleaseFrame(frame);
+    }
+    vQueueDelete(subscriber->queue);
+    subscriber->queue = NULL;
+    xSemaphoreGive(subscribers_mutex);
+    return ESP_OK;
+}
+
+esp_err_t Microphone_ReceiveFrame(mic_subscriber_t subscriber, const mic_frame_t **frame, TickType_t wait) {
+    if (subscriber == NULL || subscriber->queue == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mic_frame_t *received;
+    if (xQueueReceive(subscriber->queue, &received, wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *frame = received;
+    return ESP_OK;
+}
+
+void Microphone_ReleaseFrame(const mic_frame_t *frame) {
+    if (frame == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&frame_mux);
+    frames_out--;
+    portEXIT_CRITICAL(&frame_mux);
+    Microphone_DropRef((mic_frame_t *) frame);
+}
+
+void Microphone_GetCaptureStats(mic_capture_stats_t *stats) {
+    portENTER_CRITICAL(&frame_mux);
+    *stats = capture_stats;
+    portEXIT_CRITICAL(&frame_mux);
+    stats->free_frames = free_frames != NULL ? uxQueueMessagesWaiting(free_frames) : 0;
+}
@@ -1,13 +1,62 @@
+#include <string.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "core2foraws_speaker.h"
 #include "driver/i2s.h"
 #include "esp_idf_version.h"
+#include "esp_timer.h"
+#include "i2s_manager.h"
 
 #define I2S_BCK_PIN 12
 #define I2S_LRCK_PIN 0
 #define I2S_DATA_PIN 2
-#define I2S_DATA_IN_PIN 34
-#define SPEAKER_I2S_NUMBER I2S_NUM_0
+#define SPEAKER_I2S_NUMBER I2S_MANAGER_TX_PORT
+
+#ifndef CONFIG_SPEAKER_STREAM_SAMPLE_RATE
+#define CONFIG_SPEAKER_STREAM_SAMPLE_RATE 44100
+#endif
+
+#ifndef CONFIG_SPEAKER_STREAM_DMA_BUF_COUNT
+#define CONFIG_SPEAKER_STREAM_DMA_BUF_COUNT 8
+#endif
+
+#ifndef CONFIG_SPEAKER_STREAM_DMA_BUF_LEN
+#define CONFIG_SPEAKER_STREAM_DMA_BUF_LEN 128
+#endif
+
+#ifndef CONFIG_SPEAKER_STREAM_QUEUE_LEN
+#define CONFIG_SPEAKER_STREAM_QUEUE_LEN 8
+#endif
+
+#ifndef CONFIG_SPEAKER_STREAM_TASK_PRIORITY
+#define CONFIG_SPEAKER_STREAM_TASK_PRIORITY 8
+#endif
+
+typedef struct {
+    speaker_block_t block;
+    int64_t submit_us;
+    /* Blocks submitted before a flush are discarded */
+    uint32_t generation;
+    bool stop;
+} speaker_stream_item_t;
+
+static speaker_stream_config_t stream_config;
+static speaker_block_cb_t stream_done;
+static QueueHandle_t stream_queue;
+static SemaphoreHandle_t stream_idle;
+static SemaphoreHandle_t stream_stopped;
+/* Held by the task while it writes a chunk, so a flush cannot clear the DMA buffers under a write */
+static SemaphoreHandle_t stream_write_lock;
+static volatile bool streaming;
+static volatile uint32_t stream_generation;
+/* Blocks submitted and not done with, and whether the task has the pin, under stream_mux */
+static uint32_t stream_pending;
+static bool stream_holding;
+static bool stream_draining;
+static speaker_stream_stats_t stream_stats;
+static portMUX_TYPE stream_mux = portMUX_INITIALIZER_UNLOCKED;
 
 esp_err_t Speaker_Init() {
     esp_err_t err = ESP_OK;
@@ -29,15 +78,13 @@ esp_err_t Speaker_Init() {
     i2s_config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
     i2s_config.use_apll = false;
     i2s_config.tx_desc_auto_clear = true;
-    err += i2s_driver_install(SPEAKER_I2S_NUMBER, &i2s_config, 0, NULL);
 
     i2s_pin_config_t tx_pin_config;
     tx_pin_config.bck_io_num = I2S_BCK_PIN;
     tx_pin_config.ws_io_num = I2S_LRCK_PIN;
     tx_pin_config.data_out_num = I2S_DATA_PIN;
-    tx_pin_config.data_in_num = I2S_DATA_IN_PIN;
-    err += i2s_set_pin(SPEAKER_I2S_NUMBER, &tx_pin_config);
-    err += i2s_set_clk(SPEAKER_I2S_NUMBER, 44100, I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_MONO);
+    tx_pin_config.data_in_num = I2S_PIN_NO_CHANGE;
+    err = I2SManager_Open(I2S_MANAGER_TX, &i2s_config, &tx_pin_config);
 
     if(err != ESP_OK){
         err = ESP_FAIL;
@@ -47,18 +94,318 @@ esp_err_t Speaker_Init() {
 
 esp_err_t Speaker_WriteBuff(uint8_t* buff, uint32_t len, uint32_t timeout) {
     size_t bytes_written = 0;
-    return i2s_write(SPEAKER_I2S_NUMBER, buff, len, &bytes_written, portMAX_DELAY);
+    esp_err_t err = I2SManager_AcquireTx(timeout);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = i2s_write(SPEAKER_I2S_NUMBER, buff, len, &bytes_written, timeout);
+    I2SManager_ReleaseTx();
+    if (err == ESP_OK && bytes_written < len) {
+        err = ESP_ERR_TIMEOUT;
+    }
+    return err;
 }
 
 esp_err_t Speaker_Deinit() {
-    esp_err_t err = ESP_OK;
-    err += i2s_driver_uninstall(SPEAKER_I2S_NUMBER);
-    err += gpio_reset_pin(I2S_LRCK_PIN);
-    err += gpio_reset_pin(I2S_DATA_PIN);
-    err += gpio_reset_pin(I2S_BCK_PIN);
-    err += gpio_reset_pin(I2S_DATA_IN_PIN);
-    if(err != ESP_OK){
-        err = ESP_FAIL;
+    return I2SManager_Close(I2S_MANAGER_TX) == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+/* Wakes Speaker_Drain() once nothing is left to play */
+static void Speaker_StreamCheckIdle(void) {
+    portENTER_CRITICAL(&stream_mux);
+    bool idle = stream_pending == 0 && !stream_holding;
+    if (idle) {
+        stream_draining = false;
     }
-    return err;
-}
\ No newline at end of file
+    portEXIT_CRITICAL(&stream_mux);
+    if (idle) {
+        xSemaphoreGive(stream_idle);
+    }
+}
+
+static void Speaker_StreamDone(const speaker_stream_item_t *item, bool played) {
+    if (stream_done != NULL) {
+        stream_done(&item->block, played);
+    }
+    portENTER_CRITICAL(&stream_mux);
+    stream_pending--;
+    if (!played) {
+        stream_stats.flushed++;
+    }
+    portEXIT_CRITICAL(&stream_mux);
+    Speaker_StreamCheckIdle();
+}
+
+static void Speaker_StreamTask(void *arg) {
+    const size_t chunk_samples = stream_config.dma_buf_len;
+    /* How long the DMA buffers play after the last write */
+    const int64_t ring_us = (int64_t) stream_config.dma_buf_count * stream_config.dma_buf_len * 1000000 /
+                            stream_config.sample_rate;
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    speaker_stream_item_t item;
+    int64_t dry_us = 0;
+    bool in_sound = false;
+    uint32_t write_generation = 0;
+
+    for (;;) {
+        TickType_t wait = portMAX_DELAY;
+        if (stream_holding) {
+            int64_t left_us = dry_us - esp_timer_get_time();
+            wait = left_us > 0 ? (left_us + tick_us - 1) / tick_us : 0;
+        }
+
+        if (xQueueReceive(stream_queue, &item, wait) != pdTRUE) {
+            /* The DMA buffers played out with nothing to follow */
+            portENTER_CRITICAL(&stream_mux);
+            if (in_sound && !stream_draining && write_generation == stream_generation) {
+                stream_stats.underruns++;
+                stream_stats.last_underrun_us = dry_us;
+            }
+            portEXIT_CRITICAL(&stream_mux);
+            in_sound = false;
+            I2SManager_ReleaseTxDrained();
+            portENTER_CRITICAL(&stream_mux);
+            stream_holding = false;
+            portEXIT_CRITICAL(&stream_mux);
+            Speaker_StreamCheckIdle();
+            continue;
+        }
+        if (item.stop) {
+            break;
+        }
+        if (item.generation != stream_generation) {
+            Speaker_StreamDone(&item, false);
+            continue;
+        }
+
+        if (!stream_holding) {
+            I2SManager_AcquireTx(portMAX_DELAY);
+            portENTER_CRITICAL(&stream_mux);
+            stream_holding = true;
+            portEXIT_CRITICAL(&stream_mux);
+        }
+        if (esp_timer_get_time() > dry_us) {
+            in_sound = false;
+        }
+
+        /* A DMA buffer at a time, so a flush stops the block quickly */
+        bool played = true;
+        write_generation = item.generation;
+        for (size_t done = 0; done < item.block.count; done += chunk_samples) {
+            xSemaphoreTake(stream_write_lock, portMAX_DELAY);
+            if (item.generation != stream_generation) {
+                xSemaphoreGive(stream_write_lock);
+                played = false;
+                break;
+            }
+            size_t count = item.block.count - done < chunk_samples ? item.block.count - done : chunk_samples;
+            size_t bytes_written;
+            i2s_write(SPEAKER_I2S_NUMBER, &item.block.samples[done], count * sizeof(int16_t), &bytes_written,
+                      portMAX_DELAY);
+            xSemaphoreGive(stream_write_lock);
+            if (done == 0 && !in_sound) {
+                uint32_t latency = esp_timer_get_time() - item.submit_us;
+                portENTER_CRITICAL(&stream_mux);
+                stream_stats.start_latency_us_last = latency;
+                if (latency > stream_stats.start_latency_us_max) {
+                    stream_stats.start_latency_us_max = latency;
+                }
+                portEXIT_CRITICAL(&stream_mux);
+            }
+            in_sound = true;
+        }
+        dry_us = esp_timer_get_time() + ring_us;
+        in_sound = played && !item.block.last;
+
+        if (played) {
+            portENTER_CRITICAL(&stream_mux);
+            stream_stats.blocks++;
+            stream_stats.samples += item.block.count;
+            portEXIT_CRITICAL(&stream_mux);
+        }
+        Speaker_StreamDone(&item, played);
+    }
+
+    if (stream_holding) {
+        I2SManager_ReleaseTx();
+        portENTER_CRITICAL(&stream_mux);
+        stream_holding = false;
+        portEXIT_CRITICAL(&stream_mux);
+    }
+    xSemaphoreGive(stream_stopped);
+    vTaskDelete(NULL);
+}
+
+esp_err_t Speaker_StartStream(const speaker_stream_config_t *config, speaker_block_cb_t done) {
+    speaker_stream_config_t settings = { 0 };
+    if (config != NULL) {
+        settings = *config;
+    }
+    settings.sample_rate = settings.sample_rate ? settings.sample_rate : CONFIG_SPEAKER_STREAM_SAMPLE_RATE;
+    settings.dma_buf_count = settings.dma_buf_count ? settings.dma_buf_count : CONFIG_SPEAKER_STREAM_DMA_BUF_COUNT;
+    settings.dma_buf_len = settings.dma_buf_len ? settings.dma_buf_len : CONFIG_SPEAKER_STREAM_DMA_BUF_LEN;
+    settings.queue_len = settings.queue_len ? settings.queue_len : CONFIG_SPEAKER_STREAM_QUEUE_LEN;
+
+    if (settings.sample_rate < 1000 || settings.sample_rate > 96000 || settings.dma_buf_count < 2 ||
+        settings.dma_buf_count > 128 || settings.dma_buf_len < 8 || settings.dma_buf_len > 1024) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (stream_idle == NULL) {
+        stream_idle = xSemaphoreCreateBinary();
+        stream_stopped = xSemaphoreCreateBinary();
+        stream_write_lock = xSemaphoreCreateMutex();
+        if (stream_idle == NULL || stream_stopped == NULL || stream_write_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    stream_queue = xQueueCreate(settings.queue_len, sizeof(speaker_stream_item_t));
+    if (stream_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    i2s_config_t i2s_config = {
+        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
+        .sample_rate = settings.sample_rate,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
+#if ESP_IDF_VERSION > ESP_IDF_VERSION_VAL(4, 1, 0)
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+#else
+        .communication_format = I2S_COMM_FORMAT_I2S,
+#endif
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = settings.dma_buf_count,
+        .dma_buf_len = settings.dma_buf_len,
+        .use_apll = false,
+        .tx_desc_auto_clear = true,
+    };
+    i2s_pin_config_t tx_pin_config = {
+        .bck_io_num = I2S_BCK_PIN,
+        .ws_io_num = I2S_LRCK_PIN,
+        .data_out_num = I2S_DATA_PIN,
+        .data_in_num = I2S_PIN_NO_CHANGE,
+    };
+    esp_err_t err = I2SManager_Open(I2S_MANAGER_TX, &i2s_config, &tx_pin_config);
+    if (err != ESP_OK) {
+        vQueueDelete(stream_queue);
+        stream_queue = NULL;
+        return err == ESP_ERR_NO_MEM ? ESP_ERR_NO_MEM : ESP_ERR_INVALID_STATE;
+    }
+
+    stream_config = settings;
+    stream_done = done;
+    portENTER_CRITICAL(&stream_mux);
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    stream_pending = 0;
+    stream_holding = false;
+    stream_draining = false;
+    portEXIT_CRITICAL(&stream_mux);
+    xSemaphoreTake(stream_idle, 0);
+    streaming = true;
+    if (xTaskCreatePinnedToCore(Speaker_StreamTask, "SpeakerStreamTask", 3 * 1024, NULL,
+                                CONFIG_SPEAKER_STREAM_TASK_PRIORITY, NULL, 1) != pdPASS) {
+        streaming = false;
+        I2SManager_Close(I2S_MANAGER_TX);
+        vQueueDelete(stream_queue);
+        stream_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Speaker_StopStream(void) {
+    if (!streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    Speaker_Flush();
+    streaming = false;
+    speaker_stream_item_t stop = { .stop = true };
+    xQueueSend(stream_queue, &stop, portMAX_DELAY);
+    xSemaphoreTake(stream_stopped, portMAX_DELAY);
+
+    /* Blocks behind the stop were never played */
+    speaker_stream_item_t item;
+    while (xQueueReceive(stream_queue, &item, 0) == pdTRUE) {
+        if (!item.stop) {
+            Speaker_StreamDone(&item, false);
+        }
+    }
+    vQueueDelete(stream_queue);
+    stream_queue = NULL;
+    I2SManager_Close(I2S_MANAGER_TX);
+    return ESP_OK;
+}
+
+esp_err_t Speaker_Submit(const speaker_block_t *block, TickType_t wait) {
+    if (block == NULL || block->samples == NULL || block->count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    speaker_stream_item_t item = {
+        .block = *block,
+        .submit_us = esp_timer_get_time(),
+        .generation = stream_generation,
+    };
+    portENTER_CRITICAL(&stream_mux);
+    stream_pending++;
+    portEXIT_CRITICAL(&stream_mux);
+    if (xQueueSend(stream_queue, &item, wait) != pdTRUE) {
+        portENTER_CRITICAL(&stream_mux);
+        stream_pending--;
+        stream_stats.queue_full++;
+        portEXIT_CRITICAL(&stream_mux);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Speaker_Drain(TickType_t wait) {
+    if (!streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        portENTER_CRITICAL(&stream_mux);
+        bool idle = stream_pending == 0 && !stream_holding;
+        stream_draining = !idle;
+        portEXIT_CRITICAL(&stream_mux);
+        if (idle) {
+            return ESP_OK;
+        }
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (wait != portMAX_DELAY && waited >= wait) {
+            return ESP_ERR_TIMEOUT;
+        }
+        xSemaphoreTake(stream_idle, wait == portMAX_DELAY ? portMAX_DELAY : wait - waited);
+    }
+}
+
+esp_err_t Speaker_Flush(void) {
+    if (!streaming) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&stream_mux);
+    stream_generation++;
+    portEXIT_CRITICAL(&stream_mux);
+    /* Waits out a chunk being written, the task sees the new generation before writing another */
+    xSemaphoreTake(stream_write_lock, portMAX_DELAY);
+    i2s_zero_dma_buffer(SPEAKER_I2S_NUMBER);
+    xSemaphoreGive(stream_write_lock);
+    return ESP_OK;
+}
+
+void Speaker_GetStreamStats(speaker_stream_stats_t *stats) {
+    portENTER_CRITICAL(&stream_mux);
+    *stats = stream_stats;
+    portEXIT_CRITICAL(&stream_mux);
+    QueueHandle_t queue = stream_queue;
+    stats->queued = queue != NULL ? uxQueueMessagesWaiting(queue) : 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * RMT transmitter of the simulated board.
+ *
+ * rmt_write_sample() calls the translator like the driver: first for the whole
+ * channel memory, then for half of it at a time as the interrupt refills it.
+ * The items are decoded into bits by their high time like an SK6812 does, a
+ * 0 being about 300 ns and a 1 about 600 ns high. An item starting low ends the
+ * frame like the reset pulse of the chain.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "driver/rmt.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+/* RMT clock of 80 MHz */
+#define SIM_RMT_SRC_CLK_HZ  80000000ULL
+/* Longer high times are a 1 */
+#define SIM_RMT_BIT1_MIN_NS 450
+
+typedef struct {
+    rmt_config_t config;
+    bool installed;
+    sample_to_rmt_t translator;
+    uint8_t *frame;
+    size_t frame_len;
+    size_t frame_capacity;
+    uint32_t frames;
+} sim_rmt_channel_t;
+
+static pthread_mutex_t rmt_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_rmt_channel_t channels[RMT_CHANNEL_MAX];
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param) {
+    if (rmt_param == NULL || rmt_param->channel >= RMT_CHANNEL_MAX || rmt_param->mem_block_num == 0 ||
+        rmt_param->clk_div == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&rmt_lock);
+    channels[rmt_param->channel].config = *rmt_param;
+    pthread_mutex_unlock(&rmt_lock);
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags) {
+    (void) rx_buf_size;
+    (void) intr_alloc_flags;
+    if (channel >= RMT_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&rmt_lock);
+    esp_err_t err = channels[channel].installed ? ESP_ERR_INVALID_STATE : ESP_OK;
+    channels[channel].installed = true;
+    pthread_mutex_unlock(&rmt_lock);
+    return err;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel) {
+    if (channel >= RMT_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&rmt_lock);
+    channels[channel].installed = false;
+    channels[channel].translator = NULL;
+    pthread_mutex_unlock(&rmt_lock);
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn) {
+    if (channel >= RMT_CHANNEL_MAX || fn == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&rmt_lock);
+    esp_err_t err = channels[channel].installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK) {
+        channels[channel].translator = fn;
+    }
+    pthread_mutex_unlock(&rmt_lock);
+    return err;
+}
+
+static void sim_rmt_push_bit(sim_rmt_channel_t *ch, size_t bit_index, int bit) {
+    size_t byte = bit_index / 8;
+    if (byte >= ch->frame_capacity) {
+        size_t capacity = ch->frame_capacity ? ch->frame_capacity * 2 : 64;
+        ch->frame = realloc(ch->frame, capacity);
+        assert(ch->frame != NULL);
+        memset(ch->frame + ch->frame_capacity, 0, capacity - ch->frame_capacity);
+        ch->frame_capacity = capacity;
+    }
+    if (bit) {
+        ch->frame[byte] |= 0x80 >> (bit_index % 8);
+    }
+}
+
+/* Decodes items into the frame, returns false once the frame ended */
+static bool sim_rmt_decode(sim_rmt_channel_t *ch, const rmt_item32_t *items, size_t count, size_t *bits,
+                           uint64_t *ticks) {
+    for (size_t i = 0; i < count; i++) {
+        *ticks += items[i].duration0 + items[i].duration1;
+        if (items[i].level0 == 0 || items[i].duration0 == 0) {
+            return false;
+        }
+        uint64_t high_ns = (uint64_t) items[i].duration0 * ch->config.clk_div * 1000000000ULL / SIM_RMT_SRC_CLK_HZ;
+        sim_rmt_push_bit(ch, (*bits)++, high_ns >= SIM_RMT_BIT1_MIN_NS);
+    }
+    return true;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done) {
+    (void) wait_tx_done;
+    if (channel >= RMT_CHANNEL_MAX || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&rmt_lock);
+    sim_rmt_channel_t *ch = &channels[channel];
+    if (!ch->installed || ch->translator == NULL) {
+        pthread_mutex_unlock(&rmt_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t mem_items = RMT_MEM_ITEM_NUM * ch->config.mem_block_num;
+    rmt_item32_t *items = calloc(mem_items, sizeof(rmt_item32_t));
+    assert(items != NULL);
+    if (ch->frame) {
+        memset(ch->frame, 0, ch->frame_capacity);
+    }
+
+    size_t bits = 0;
+    uint64_t ticks = 0;
+    size_t wanted = mem_items;
+    bool running = true;
+    while (src_size && running) {
+        size_t translated = 0;
+        size_t item_num = 0;
+        ch->translator(src, items, src_size, wanted, &translated, &item_num);
+        if (translated == 0 && item_num == 0) {
+            break;
+        }
+        running = sim_rmt_decode(ch, items, item_num, &bits, &ticks);
+        src += translated;
+        src_size -= translated < src_size ? translated : src_size;
+        wanted = mem_items / 2;
+    }
+    free(items);
+
+    ch->frame_len = (bits + 7) / 8;
+    ch->frames++;
+    uint64_t wire_ns = ticks * ch->config.clk_div * 1000000000ULL / SIM_RMT_SRC_CLK_HZ;
+    pthread_mutex_unlock(&rmt_lock);
+
+    if (wait_tx_done) {
+        sim_wire_wait(wire_ns);
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done) {
+    if (channel >= RMT_CHANNEL_MAX || rmt_item == NULL || item_num <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&rmt_lock);
+    sim_rmt_channel_t *ch = &channels[channel];
+    if (ch->frame) {
+        memset(ch->frame, 0, ch->frame_capacity);
+    }
+    size_t bits = 0;
+    uint64_t ticks = 0;
+    sim_rmt_decode(ch, rmt_item, item_num, &bits, &ticks);
+    ch->frame_len = (bits + 7) / 8;
+    ch->frames++;
+    uint64_t wire_ns = ticks * ch->config.clk_div * 1000000000ULL / SIM_RMT_SRC_CLK_HZ;
+    pthread_mutex_unlock(&rmt_lock);
+
+    if (wait_tx_done) {
+        sim_wire_wait(wire_ns);
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time) {
+    (void) channel;
+    (void) wait_time;
+    return ESP_OK;
+}
+
+size_t sim_rmt_get_frame(rmt_channel_t channel, uint8_t *bytes, size_t max) {
+    pthread_mutex_lock(&rmt_lock);
+    sim_rmt_channel_t *ch = &channels[channel];
+    size_t length = ch->frame_len;
+    memcpy(bytes, ch->frame, length < max ? length : max);
+    pthread_mutex_unlock(&rmt_lock);
+    return length;
+}
+
+uint32_t sim_rmt_frames(rmt_channel_t channel) {
+    pthread_mutex_lock(&rmt_lock);
+    uint32_t frames = channels[channel].frames;
+    pthread_mutex_unlock(&rmt_lock);
+    return frames;
+}
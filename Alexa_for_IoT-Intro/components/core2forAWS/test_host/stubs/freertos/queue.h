@@ -0,0 +1,29 @@
+/* Host stand-in for the FreeRTOS queues */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_queue *QueueHandle_t;
+typedef QueueHandle_t xQueueHandle;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#define xQueueSend(queue, item, wait)   xQueueSendToBack(queue, item, wait)
+
+/* Nothing blocks in an ISR, so the ISR variants are the calls with no wait */
+#define xQueueSendFromISR(queue, item, woken)           ((void) (woken), xQueueSendToBack(queue, item, 0))
+#define xQueueSendToBackFromISR(queue, item, woken)     xQueueSendFromISR(queue, item, woken)
+#define xQueueSendToFrontFromISR(queue, item, woken)    ((void) (woken), xQueueSendToFront(queue, item, 0))
+#define xQueueOverwriteFromISR(queue, item, woken)      ((void) (woken), xQueueOverwrite(queue, item))
+#define xQueueReceiveFromISR(queue, item, woken)        ((void) (woken), xQueueReceive(queue, item, 0))
+#define uxQueueMessagesWaitingFromISR(queue)            uxQueueMessagesWaiting(queue)
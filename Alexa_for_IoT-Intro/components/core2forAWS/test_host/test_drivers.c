@@ -0,0 +1,1019 @@
+/*
+ * Host test of the core2forAWS drivers against the device models of sim/.
+ *
+ * The drivers are brought up the way Core2ForAWS_Init() does and checked
+ * through their public functions: register values reach the AXP192 and are
+ * cached, IMU readings follow the synthetic motion, the RTC keeps time, touch
+ * reports turn into samples and gestures, the SK6812 frame carries the pixel
+ * bytes and the speaker and microphone move samples at the I2S rate, also
+ * both at once through the I2S manager, the speaker stream plays queued
+ * blocks without gaps, the activity detector hears
+ * a voice over a quiet room and the I2C scheduler batches the transactions of
+ * one device only. Exits with 1 on any failure.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "i2c_device.h"
+#include "i2c_trace.h"
+#include "axp192.h"
+#include "mpu6886.h"
+#include "mpu6886_fusion.h"
+#include "nvs.h"
+#include "bm8563.h"
+#include "ft6336u.h"
+#include "sk6812.h"
+#include "core2foraws_speaker.h"
+#include "microphone.h"
+#include "microphone_vad.h"
+#include "i2s_manager.h"
+#include "soc/gpio_sig_map.h"
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            errors++;                                                       \
+        }                                                                   \
+    } while (0)
+
+/* The power setup of Core2ForAWS_PMU_Init(3300, 0, 0, 2700) */
+static void pmu_init(void)
+{
+    Axp192_Init();
+    Axp192_SetLDO23Volt(3300, 0);
+    Axp192_SetDCDC3Volt(2700);
+    Axp192_SetVoffVolt(3000);
+    Axp192_SetChargeCurrent(CHARGE_Current_100mA);
+    Axp192_SetChargeVoltage(CHARGE_VOLT_4200mV);
+    Axp192_EnableCharge(1);
+    Axp192_EnableLDODCExt((1 << AXP192_LDO2_EN_BIT) | (1 << AXP192_DC3_EN_BIT) | (1 << AXP192_DC1_EN_BIT));
+    Axp192_SetGPIO4Mode(1);
+    Axp192_SetAdc1Enable(0xfe);
+}
+
+static int test_axp192(void)
+{
+    int errors = 0;
+
+    CHECK(sim_axp192.regs[AXP192_LDO23_VOLT_REG] == 0xf0);
+    CHECK(sim_axp192.regs[AXP192_DC3_VOLT_REG] == (2700 - 700) / 25);
+    CHECK(sim_axp192.regs[AXP192_LDO23_DC123_EXT_CTL_REG] == 0x07);
+    CHECK(fabsf(Axp192_GetBatVolt() - 4.0997f) < 0.001f);
+
+    sim_axp192_set_adc(AXP192_BAT_ADC_VOLTAGE_REG, 3400, 12);
+    CHECK(fabsf(Axp192_GetBatVolt() - 3.74f) < 0.001f);
+
+    /* Setting a control register to the value it holds costs no transaction */
+    axp192_cache_stats_t before, after;
+    Axp192_GetRegCacheStats(&before);
+    uint32_t writes = sim_axp192.writes;
+    Axp192_EnableLDO2(1);
+    Axp192_SetDCDC3Volt(2700);
+    Axp192_GetRegCacheStats(&after);
+    CHECK(after.writes_skipped == before.writes_skipped + 2);
+    CHECK(sim_axp192.writes == writes);
+
+    /* A failed write is not cached, so the next one goes to the bus again */
+    sim_i2c_fail_next(&sim_axp192, 1);
+    Axp192_SetDCDC3Volt(3000);
+    CHECK(sim_axp192.regs[AXP192_DC3_VOLT_REG] == (2700 - 700) / 25);
+    Axp192_SetDCDC3Volt(3000);
+    CHECK(sim_axp192.regs[AXP192_DC3_VOLT_REG] == (3000 - 700) / 25);
+
+    printf("axp192:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+/* Gravity in device coordinates for the orientation w, x, y, z */
+static void expected_gravity(const float q[4], float g[3])
+{
+    g[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+    g[1] = 2 * (q[2] * q[3] + q[0] * q[1]);
+    g[2] = 1 - 2 * (q[1] * q[1] + q[2] * q[2]);
+}
+
+static int test_mpu6886(void)
+{
+    int errors = 0;
+
+    CHECK(MPU6886_Init() == 0);
+
+    sim_imu_motion_t motion = { .rate_dps = { 0, 0, 90 } };
+    sim_mpu6886_set_motion(&motion);
+    float ax, ay, az, gx, gy, gz, t;
+    MPU6886_GetAccelData(&ax, &ay, &az);
+    MPU6886_GetGyroData(&gx, &gy, &gz);
+    MPU6886_GetTempData(&t);
+    CHECK(fabsf(ax) < 0.01f && fabsf(ay) < 0.01f && fabsf(az - 1.0f) < 0.01f);
+    CHECK(fabsf(gx) < 0.1f && fabsf(gy) < 0.1f && fabsf(gz - 90.0f) < 0.1f);
+    CHECK(fabsf(t - 30.0f) < 0.01f);
+
+    /* Tumbling about X and Y, the accelerometer follows the orientation */
+    motion = (sim_imu_motion_t) { .rate_dps = { 120, -60, 0 } };
+    sim_mpu6886_set_motion(&motion);
+    for (int i = 0; i < 10; i++) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        float q[4], g[3];
+        sim_mpu6886_get_orientation(esp_timer_get_time(), q);
+        expected_gravity(q, g);
+        MPU6886_GetAccelData(&ax, &ay, &az);
+        CHECK(fabsf(ax - g[0]) < 0.02f && fabsf(ay - g[1]) < 0.02f && fabsf(az - g[2]) < 0.02f);
+    }
+
+    /* The bias shows in the gyroscope, the noise stays within its bounds */
+    motion = (sim_imu_motion_t) { .gyro_bias_dps = { 1.5f, -2.0f, 0.5f }, .noise = 0.2f };
+    sim_mpu6886_set_motion(&motion);
+    MPU6886_GetGyroData(&gx, &gy, &gz);
+    CHECK(fabsf(gx - 1.5f) < 0.3f && fabsf(gy + 2.0f) < 0.3f && fabsf(gz - 0.5f) < 0.3f);
+
+    printf("mpu6886: %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static volatile uint32_t imu_callbacks;
+
+static void imu_callback(void)
+{
+    imu_callbacks++;
+}
+
+static int test_mpu6886_stream(void)
+{
+    int errors = 0;
+    mpu6886_sample_t sample;
+    mpu6886_stream_stats_t stats;
+
+    CHECK(MPU6886_StartStream(2) == ESP_ERR_INVALID_ARG);
+    CHECK(MPU6886_StopStream() == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_AddSampleCallback(imu_callback) == ESP_OK);
+    sim_imu_motion_t motion = { .rate_dps = { 0, 0, 90 } };
+    sim_mpu6886_set_motion(&motion);
+    CHECK(MPU6886_StartStream(500) == ESP_OK);
+    CHECK(MPU6886_StartStream(500) == ESP_ERR_INVALID_STATE);
+
+    /* Two readers see the same samples, evenly spaced at the rate */
+    uint32_t cursor_a = 0, cursor_b = 0;
+    uint32_t count_a = 0, count_b = 0, reads_before = sim_mpu6886.reads;
+    int64_t first_us = 0, last_us = 0;
+    for (int i = 0; i < 6; i++) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        while (MPU6886_ReadSample(&cursor_a, &sample)) {
+            CHECK(fabsf(sample.accel[2] - 1.0f) < 0.01f && fabsf(sample.gyro[2] - 90.0f) < 0.1f);
+            CHECK(fabsf(sample.temp - 30.0f) < 0.01f);
+            if (count_a) {
+                CHECK(sample.time_us - last_us == 2000);
+            } else {
+                first_us = sample.time_us;
+            }
+            last_us = sample.time_us;
+            count_a++;
+        }
+        while (MPU6886_ReadSample(&cursor_b, &sample)) {
+            count_b++;
+        }
+    }
+    CHECK(count_a > 100 && count_b == count_a);
+    MPU6886_GetStreamStats(&stats);
+    CHECK(stats.rate_hz == 500 && stats.overflows == 0 && stats.errors == 0);
+    /* Nothing was lost between the first and the last sample read */
+    CHECK(stats.samples >= count_a && count_a == (last_us - first_us) / 2000 + 1);
+    /* A count and a burst read per FIFO_BATCH_MS instead of two reads per sample */
+    CHECK(sim_mpu6886.reads - reads_before < count_a / 4);
+    CHECK(imu_callbacks > 0 && imu_callbacks <= stats.bursts);
+
+    /* A failed count read only delays the samples */
+    sim_i2c_fail_next(&sim_mpu6886, 1);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    while (MPU6886_ReadSample(&cursor_a, &sample)) {
+        CHECK(sample.time_us - last_us == 2000);
+        last_us = sample.time_us;
+    }
+    MPU6886_GetStreamStats(&stats);
+    CHECK(stats.errors == 1 && stats.overflows == 0);
+
+    /* Rates that do not divide 1 kHz are rounded up */
+    CHECK(MPU6886_StopStream() == ESP_OK);
+    CHECK(MPU6886_StopStream() == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_StartStream(300) == ESP_OK);
+    MPU6886_GetStreamStats(&stats);
+    CHECK(stats.rate_hz == 333);
+    CHECK(MPU6886_StopStream() == ESP_OK);
+
+    /* The single-shot reads keep working */
+    float gx, gy, gz;
+    MPU6886_GetGyroData(&gx, &gy, &gz);
+    CHECK(fabsf(gz - 90.0f) < 0.1f);
+
+    printf("stream:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_mpu6886_fusion(void)
+{
+    int errors = 0;
+    float bias[3], loaded[3];
+
+    sim_nvs_erase_all();
+    CHECK(MPU6886_LoadGyroBias(loaded) == ESP_ERR_NVS_NOT_FOUND);
+    CHECK(MPU6886_CalibrateGyroBias(50, bias) == ESP_ERR_INVALID_ARG);
+
+    /* Turning is not lying still, nothing is saved */
+    sim_imu_motion_t motion = { .rate_dps = { 0, 30, 0 } };
+    sim_mpu6886_set_motion(&motion);
+    CHECK(MPU6886_CalibrateGyroBias(200, bias) == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_LoadGyroBias(loaded) == ESP_ERR_NVS_NOT_FOUND);
+
+    motion = (sim_imu_motion_t) { .gyro_bias_dps = { -1.0f, 0.5f, 2.0f }, .noise = 0.02f };
+    sim_mpu6886_set_motion(&motion);
+    CHECK(MPU6886_CalibrateGyroBias(200, bias) == ESP_OK);
+    CHECK(fabsf(bias[0] + 1.0f) < 0.05f && fabsf(bias[1] - 0.5f) < 0.05f && fabsf(bias[2] - 2.0f) < 0.05f);
+    CHECK(MPU6886_LoadGyroBias(loaded) == ESP_OK && memcmp(bias, loaded, sizeof(bias)) == 0);
+
+    /* A filter picks the bias up, and a level device at rest is level without acceleration */
+    mpu6886_fusion_t fusion;
+    mpu6886_attitude_t attitude;
+    MPU6886_FusionInit(&fusion);
+    CHECK(memcmp(fusion.gyro_bias, bias, sizeof(bias)) == 0);
+    mpu6886_sample_t sample = { .accel = { 0, 0, 1 }, .gyro = { bias[0], bias[1], bias[2] }, .temp = 25 };
+    for (int i = 0; i < 100; i++) {
+        sample.time_us += 2000;
+        MPU6886_FusionUpdate(&fusion, &sample);
+    }
+    MPU6886_FusionGetAttitude(&fusion, &attitude);
+    CHECK(fabsf(attitude.roll) < 0.01f && fabsf(attitude.pitch) < 0.01f && fabsf(attitude.yaw) < 0.01f);
+    CHECK(fabsf(attitude.linear_accel[2]) < 0.001f && fabsf(attitude.linear_accel_world[2]) < 0.001f);
+    CHECK(fusion.updates == 99);
+
+    /* The first sample sets the tilt, 30 degrees of roll */
+    MPU6886_FusionInit(&fusion);
+    sample = (mpu6886_sample_t) { .accel = { 0, 0.5f, 0.8660254f }, .gyro = { bias[0], bias[1], bias[2] } };
+    MPU6886_FusionUpdate(&fusion, &sample);
+    MPU6886_FusionGetAttitude(&fusion, &attitude);
+    CHECK(fabsf(attitude.roll - 30.0f) < 0.01f && fabsf(attitude.pitch) < 0.01f);
+    CHECK(fabsf(attitude.gravity[1] - 0.5f) < 0.001f && fabsf(attitude.linear_accel_world[1]) < 0.001f);
+
+    printf("fusion:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_mpu6886_motion(void)
+{
+    int errors = 0;
+
+    CHECK(MPU6886_WaitForMotion(0) == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_DisableMotionDetect() == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_EnableMotionDetect(0, 50) == ESP_ERR_INVALID_ARG);
+    CHECK(MPU6886_EnableMotionDetect(1024, 50) == ESP_ERR_INVALID_ARG);
+    CHECK(MPU6886_EnableMotionDetect(40, 1000) == ESP_ERR_INVALID_ARG);
+
+    sim_imu_motion_t motion = { 0 };
+    sim_mpu6886_set_motion(&motion);
+    CHECK(MPU6886_EnableMotionDetect(42, 50) == ESP_OK);
+    CHECK(MPU6886_EnableMotionDetect(42, 50) == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_StartStream(500) == ESP_ERR_INVALID_STATE);
+    /* Gyroscope in standby, accelerometer cycling at 50 Hz with the threshold rounded to 44 mG */
+    CHECK(sim_mpu6886.regs[MPU6886_PWR_MGMT_1] == 0x21 && sim_mpu6886.regs[MPU6886_PWR_MGMT_2] == 0x07);
+    CHECK(sim_mpu6886.regs[MPU6886_SMPLRT_DIV] == 19 && sim_mpu6886.regs[MPU6886_ACCEL_INTEL_CTRL] == 0xc0);
+    CHECK(sim_mpu6886.regs[MPU6886_ACCEL_WOM_X_THR] == 11 && sim_mpu6886.regs[MPU6886_ACCEL_WOM_Z_THR] == 11);
+
+    /* Lying still */
+    CHECK(MPU6886_WaitForMotion(0) == ESP_ERR_TIMEOUT);
+    CHECK(MPU6886_WaitForMotion(pdMS_TO_TICKS(200)) == ESP_ERR_TIMEOUT);
+
+    /* A shake is seen within a sample and a poll, and the accelerometer keeps reading */
+    motion.shake_g = 0.3f;
+    motion.shake_hz = 2.0f;
+    int64_t start = esp_timer_get_time();
+    sim_mpu6886_set_motion(&motion);
+    CHECK(MPU6886_WaitForMotion(pdMS_TO_TICKS(1000)) == ESP_OK);
+    int64_t latency = esp_timer_get_time() - start;
+    /* A 20 ms sample, the default 20 ms poll and some scheduling */
+    CHECK(latency < 50000);
+    float ax, ay, az;
+    MPU6886_GetAccelData(&ax, &ay, &az);
+    CHECK(fabsf(az - 1.0f) < 0.31f);
+
+    /* Still again, once the motion of the stop was latched and read */
+    motion.shake_g = 0.0f;
+    sim_mpu6886_set_motion(&motion);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    MPU6886_WaitForMotion(0);
+    CHECK(MPU6886_WaitForMotion(pdMS_TO_TICKS(100)) == ESP_ERR_TIMEOUT);
+
+    /* Back to the init configuration, the stream can start again */
+    CHECK(MPU6886_DisableMotionDetect() == ESP_OK);
+    CHECK(MPU6886_WaitForMotion(0) == ESP_ERR_INVALID_STATE);
+    CHECK(sim_mpu6886.regs[MPU6886_PWR_MGMT_1] == 0x01 && sim_mpu6886.regs[MPU6886_PWR_MGMT_2] == 0x00);
+    CHECK(sim_mpu6886.regs[MPU6886_SMPLRT_DIV] == 0x05 && sim_mpu6886.regs[MPU6886_ACCEL_INTEL_CTRL] == 0x00);
+    CHECK(sim_mpu6886.regs[MPU6886_INT_ENABLE] == 0x01);
+    CHECK(MPU6886_StartStream(500) == ESP_OK);
+    CHECK(MPU6886_EnableMotionDetect(40, 50) == ESP_ERR_INVALID_STATE);
+    CHECK(MPU6886_StopStream() == ESP_OK);
+
+    printf("motion:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_bm8563(void)
+{
+    int errors = 0;
+
+    BM8563_Init();
+    rtc_date_t date = { .year = 2021, .month = 12, .day = 31, .hour = 23, .minute = 59, .second = 58 };
+    BM8563_SetTime(&date);
+
+    rtc_date_t now;
+    BM8563_GetTime(&now);
+    CHECK(now.year == 2021 && now.month == 12 && now.day == 31 && now.hour == 23 && now.minute == 59);
+    CHECK(now.second == 58 || now.second == 59);
+
+    vTaskDelay(pdMS_TO_TICKS(2100));
+    BM8563_GetTime(&now);
+    CHECK(now.year == 2022 && now.month == 1 && now.day == 1 && now.hour == 0 && now.minute == 0);
+    CHECK(now.second <= 1);
+
+    printf("bm8563:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static volatile uint32_t touch_callbacks;
+
+static void touch_callback(void)
+{
+    touch_callbacks++;
+}
+
+static int test_ft6336u(void)
+{
+    int errors = 0;
+
+    FT6336U_Init();
+    FT6336U_AddTouchCallback(touch_callback);
+
+    sim_touch_point_t point = { .x = 100, .y = 120, .id = 0 };
+    sim_ft6336u_report(1, &point);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    ft6336u_touch_t touch;
+    FT6336U_GetPoints(&touch);
+    CHECK(touch.count == 1 && touch.points[0].x == 100 && touch.points[0].y == 120);
+    CHECK(touch_callbacks == 1);
+
+    sim_ft6336u_report(0, NULL);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    FT6336U_GetPoints(&touch);
+    CHECK(touch.count == 0 && touch.points[0].x == 100);
+
+    /* A quick drag to the right and a release is a swipe */
+    ft6336u_gesture_t gesture;
+    while (FT6336U_GetGesture(&gesture, 0)) {
+    }
+    uint32_t cursor = 0;
+    while (FT6336U_ReadTouch(&cursor, &touch)) {
+    }
+    for (int i = 0; i <= 10; i++) {
+        point = (sim_touch_point_t) { .x = 50 + 20 * i, .y = 160, .id = 1 };
+        sim_ft6336u_report(1, &point);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    sim_ft6336u_report(0, NULL);
+    CHECK(FT6336U_GetGesture(&gesture, pdMS_TO_TICKS(200)));
+    CHECK(gesture.type == FT6336U_GESTURE_SWIPE_RIGHT && gesture.x == 50 && gesture.dx == 200 && gesture.vx > 0);
+
+    /* Every report reached the ring, in order */
+    uint32_t samples = 0;
+    uint16_t last_x = 0;
+    while (FT6336U_ReadTouch(&cursor, &touch)) {
+        if (touch.count) {
+            CHECK(touch.points[0].x > last_x);
+            last_x = touch.points[0].x;
+        }
+        samples++;
+    }
+    CHECK(samples == 12);
+
+    /* The callbacks are replaced while the task dispatches, and a removed one is not called afterwards */
+    for (int i = 0; i < 200; i++) {
+        point = (sim_touch_point_t) { .x = 10 + i, .y = 40, .id = 2 };
+        sim_ft6336u_report(1, &point);
+        FT6336U_SetTouchCallback(i % 2 ? touch_callback : NULL);
+        CHECK(FT6336U_AddTouchCallback(touch_callback) == ESP_OK);
+    }
+    sim_ft6336u_report(0, NULL);
+    FT6336U_SetTouchCallback(NULL);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    uint32_t calls = touch_callbacks;
+    sim_ft6336u_report(1, &point);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    CHECK(touch_callbacks == calls);
+    sim_ft6336u_report(0, NULL);
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    printf("ft6336u: %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_sk6812(void)
+{
+    int errors = 0;
+
+    pixel_settings_t px = {
+        .pixel_count = 10,
+        .brightness = 255,
+        .color_order = "GRBW",
+        .nbits = 24,
+        .timings = { .t0h = 350, .t0l = 800, .t1h = 600, .t1l = 700, .reset = 80000 },
+    };
+    /* np_show() hands one byte past the pixels to the translator, which sends the reset pulse instead */
+    px.pixels = calloc(px.pixel_count * 3 + 1, 1);
+    CHECK(neopixel_init(GPIO_NUM_25, RMT_CHANNEL_0) == ESP_OK);
+
+    for (uint16_t i = 0; i < px.pixel_count; i++) {
+        np_set_pixel_color(&px, i, (0x102030 * (i + 1)) << 8);
+    }
+    np_show(&px, RMT_CHANNEL_0);
+
+    uint8_t frame[64];
+    CHECK(sim_rmt_get_frame(RMT_CHANNEL_0, frame, sizeof(frame)) == px.pixel_count * 3);
+    CHECK(memcmp(frame, px.pixels, px.pixel_count * 3) == 0);
+
+    px.brightness = 20;
+    np_show(&px, RMT_CHANNEL_0);
+    sim_rmt_get_frame(RMT_CHANNEL_0, frame, sizeof(frame));
+    for (int i = 0; i < px.pixel_count * 3; i++) {
+        CHECK(frame[i] == (uint8_t) (20 / 255.0 * px.pixels[i]));
+    }
+    CHECK(sim_rmt_frames(RMT_CHANNEL_0) == 2);
+
+    neopixel_deinit(RMT_CHANNEL_0);
+    free(px.pixels);
+    printf("sk6812:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static uint64_t speaker_bytes;
+
+static void speaker_sink(i2s_port_t port, const void *data, size_t size, void *ctx)
+{
+    speaker_bytes += size;
+}
+
+static int test_speaker_mic(void)
+{
+    int errors = 0;
+
+    /* 100 ms of 44.1 kHz mono 16 bit samples take about that long to play */
+    static int16_t samples[4410];
+    sim_i2s_set_sink(I2S_MANAGER_TX_PORT, speaker_sink, NULL);
+    CHECK(Speaker_Init() == ESP_OK);
+    int64_t start = esp_timer_get_time();
+    CHECK(Speaker_WriteBuff((uint8_t *) samples, sizeof(samples), portMAX_DELAY) == ESP_OK);
+    int64_t elapsed = esp_timer_get_time() - start;
+    CHECK(speaker_bytes == sizeof(samples));
+    /* All but the two DMA buffers must have played */
+    CHECK(elapsed >= 90000);
+    /* The timeout gives up on the rest */
+    speaker_bytes = 0;
+    start = esp_timer_get_time();
+    CHECK(Speaker_WriteBuff((uint8_t *) samples, sizeof(samples), pdMS_TO_TICKS(20)) == ESP_ERR_TIMEOUT);
+    elapsed = esp_timer_get_time() - start;
+    CHECK(speaker_bytes > 0 && speaker_bytes < sizeof(samples));
+    CHECK(elapsed < 40000);
+    CHECK(Speaker_Deinit() == ESP_OK);
+
+    sim_i2s_tone_t tone = { .freq_hz = 1000, .amplitude = 8000 };
+    sim_i2s_set_source(I2S_NUM_0, sim_i2s_tone_source, &tone);
+    Microphone_Init();
+    int16_t mic[1024];
+    size_t bytes_read;
+    CHECK(i2s_read(MIC_I2S_NUMBER, mic, sizeof(mic), &bytes_read, portMAX_DELAY) == ESP_OK);
+    CHECK(bytes_read == sizeof(mic));
+    int16_t peak = 0;
+    int crossings = 0;
+    for (int i = 0; i < 1024; i++) {
+        peak = abs(mic[i]) > peak ? abs(mic[i]) : peak;
+        crossings += i && (mic[i - 1] < 0) != (mic[i] < 0);
+    }
+    /* 1024 samples at 44.1 kHz hold 23 periods of the tone */
+    CHECK(peak > 7950 && peak <= 8000);
+    CHECK(crossings >= 45 && crossings <= 48);
+    Microphone_Deinit();
+
+    printf("i2s:     %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_mic_capture(void)
+{
+    int errors = 0;
+    mic_subscriber_t meter, recorder;
+    const mic_frame_t *frame, *same;
+    mic_capture_stats_t stats;
+
+    sim_i2s_tone_t tone = { .freq_hz = 1000, .amplitude = 8000 };
+    sim_i2s_set_source(I2S_NUM_0, sim_i2s_tone_source, &tone);
+
+    mic_capture_config_t config = { .sample_rate = 16000, .frame_samples = 256, .pool_frames = 4 };
+    CHECK(Microphone_Subscribe(2, &meter) == ESP_ERR_INVALID_STATE);
+    CHECK(Microphone_StartCapture(&(mic_capture_config_t) { .dma_buf_count = 1 }) == ESP_ERR_INVALID_ARG);
+    CHECK(Microphone_StartCapture(&config) == ESP_OK);
+    CHECK(Microphone_StartCapture(&config) == ESP_ERR_INVALID_STATE);
+    CHECK(Microphone_Subscribe(0, &meter) == ESP_ERR_INVALID_ARG);
+    CHECK(Microphone_Subscribe(4, &meter) == ESP_OK);
+    CHECK(Microphone_Subscribe(2, &recorder) == ESP_OK);
+
+    /* Both consumers get the same samples */
+    CHECK(Microphone_ReceiveFrame(meter, &frame, pdMS_TO_TICKS(100)) == ESP_OK);
+    CHECK(Microphone_ReceiveFrame(recorder, &same, pdMS_TO_TICKS(100)) == ESP_OK);
+    CHECK(frame == same);
+    CHECK(frame->count == 256);
+    int16_t peak = 0;
+    for (int i = 0; i < frame->count; i++) {
+        peak = abs(frame->samples[i]) > peak ? abs(frame->samples[i]) : peak;
+    }
+    CHECK(peak > 7900 && peak <= 8000);
+    Microphone_ReleaseFrame(frame);
+    Microphone_ReleaseFrame(same);
+
+    /* Frames of 16 ms follow each other */
+    int64_t last_us = 0;
+    uint32_t last_sequence = 0;
+    for (int i = 0; i < 10; i++) {
+        CHECK(Microphone_ReceiveFrame(meter, &frame, pdMS_TO_TICKS(100)) == ESP_OK);
+        CHECK(Microphone_ReceiveFrame(recorder, &same, pdMS_TO_TICKS(100)) == ESP_OK);
+        if (i) {
+            CHECK(frame->sequence == last_sequence + 1);
+            CHECK(llabs(frame->time_us - last_us - 16000) < 1000);
+            CHECK(!frame->discontinuity);
+        }
+        last_us = frame->time_us;
+        last_sequence = frame->sequence;
+        Microphone_ReleaseFrame(frame);
+        Microphone_ReleaseFrame(same);
+    }
+
+    /* A stalled recorder misses frames, the meter does not */
+    int64_t start = esp_timer_get_time();
+    uint32_t received = 0;
+    while (esp_timer_get_time() - start < 200000) {
+        if (Microphone_ReceiveFrame(meter, &frame, pdMS_TO_TICKS(100)) == ESP_OK) {
+            CHECK(received == 0 || !frame->discontinuity);
+            received++;
+            Microphone_ReleaseFrame(frame);
+        }
+    }
+    CHECK(received >= 11);
+    Microphone_GetCaptureStats(&stats);
+    CHECK(stats.queue_full >= 8);
+
+    /* With both stalled the pool runs dry, and the next frame tells of the gap */
+    vTaskDelay(pdMS_TO_TICKS(200));
+    Microphone_GetCaptureStats(&stats);
+    CHECK(stats.pool_empty >= 8);
+    CHECK(stats.free_frames == 0);
+    bool gap = false;
+    for (int i = 0; i < 4 && Microphone_ReceiveFrame(meter, &frame, pdMS_TO_TICKS(100)) == ESP_OK; i++) {
+        gap = gap || frame->discontinuity;
+        Microphone_ReleaseFrame(frame);
+        if (i == 0) {
+            /* Frees the frames the recorder holds */
+            CHECK(Microphone_Unsubscribe(recorder) == ESP_OK);
+        }
+    }
+    CHECK(gap);
+    CHECK(Microphone_Unsubscribe(recorder) == ESP_ERR_INVALID_ARG);
+
+    CHECK(Microphone_StopCapture() == ESP_ERR_INVALID_STATE);
+    /* A frame still held keeps the pool, and the capture, alive after the last unsubscribe */
+    CHECK(Microphone_ReceiveFrame(meter, &frame, pdMS_TO_TICKS(100)) == ESP_OK);
+    CHECK(Microphone_Unsubscribe(meter) == ESP_OK);
+    CHECK(Microphone_StopCapture() == ESP_ERR_INVALID_STATE);
+    Microphone_ReleaseFrame(frame);
+    Microphone_GetCaptureStats(&stats);
+    CHECK(stats.free_frames >= 3);
+    CHECK(stats.dma_overruns == 0);
+    CHECK(stats.frames >= stats.published + stats.pool_empty);
+    CHECK(Microphone_StopCapture() == ESP_OK);
+    CHECK(Microphone_StopCapture() == ESP_ERR_INVALID_STATE);
+    sim_i2s_set_source(I2S_NUM_0, NULL, NULL);
+
+    printf("mic:     %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+/* Feeds 16 ms frames of a 1 kHz tone plus uniform noise, and an offset, to a detector. Returns the
+ * time of the first event of the given kind in the run, or -1. */
+static int64_t vad_feed(mic_vad_t *vad, int64_t *time_us, int duration_ms, int tone, int noise, int offset,
+                        mic_vad_event_t wanted, int *events)
+{
+    static int16_t samples[256];
+    mic_frame_t frame = { .samples = samples, .count = 256 };
+    int64_t found = -1;
+
+    for (int t = 0; t < duration_ms; t += 16) {
+        for (int i = 0; i < 256; i++) {
+            double v = offset + tone * sin(2 * M_PI * 1000 * i / 16000.0) + noise * (2.0 * rand() / RAND_MAX - 1);
+            samples[i] = (int16_t) v;
+        }
+        frame.time_us = *time_us;
+        mic_vad_event_t event = Microphone_VadProcess(vad, &frame);
+        if (event != MIC_VAD_NONE) {
+            (*events)++;
+        }
+        if (event == wanted && found < 0) {
+            found = *time_us;
+        }
+        *time_us += 16000;
+    }
+    return found;
+}
+
+static int test_mic_vad(void)
+{
+    int errors = 0;
+    mic_vad_t vad;
+    int64_t now = 0;
+    int events = 0;
+
+    srand(1);
+    Microphone_VadInit(&vad, 16000);
+    CHECK(vad.threshold_q8 == 9 * 85 && vad.onset_us == 40000 && vad.hangover_us == 500000);
+
+    /* A quiet room with a DC offset */
+    CHECK(vad_feed(&vad, &now, 1000, 0, 30, 500, MIC_VAD_START, &events) < 0);
+    CHECK(events == 0);
+    CHECK(!vad.active);
+    CHECK(vad.dc > 480 && vad.dc < 520);
+
+    /* A click shorter than the onset */
+    CHECK(vad_feed(&vad, &now, 16, 3000, 30, 500, MIC_VAD_START, &events) < 0);
+    CHECK(vad_feed(&vad, &now, 500, 0, 30, 500, MIC_VAD_START, &events) < 0);
+    CHECK(events == 0);
+
+    /* A voice starts after the onset and stops after the hangover */
+    int64_t voice_us = now;
+    int64_t start_us = vad_feed(&vad, &now, 800, 3000, 30, 500, MIC_VAD_START, &events);
+    CHECK(start_us >= voice_us + 32000 && start_us <= voice_us + 48000);
+    CHECK(vad.active);
+    CHECK(vad.zcr_permille > 100 && vad.zcr_permille < 150);
+    int64_t silence_us = now;
+    int64_t stop_us = vad_feed(&vad, &now, 1000, 0, 30, 500, MIC_VAD_STOP, &events);
+    CHECK(stop_us >= silence_us + 480000 && stop_us <= silence_us + 512000);
+    CHECK(events == 2);
+    CHECK(vad.starts == 1);
+
+    /* Pauses shorter than the hangover are bridged */
+    events = 0;
+    for (int i = 0; i < 5; i++) {
+        vad_feed(&vad, &now, 200, 3000, 30, 500, MIC_VAD_NONE, &events);
+        vad_feed(&vad, &now, 200, 0, 30, 500, MIC_VAD_NONE, &events);
+    }
+    CHECK(events == 1 && vad.active);
+    vad_feed(&vad, &now, 1000, 0, 30, 500, MIC_VAD_NONE, &events);
+    CHECK(events == 2 && !vad.active);
+
+    /* Loud hiss crosses zero too often */
+    events = 0;
+    CHECK(vad_feed(&vad, &now, 500, 0, 3000, 500, MIC_VAD_START, &events) < 0);
+    CHECK(vad.zcr_permille > 400);
+    CHECK(events == 0);
+
+    CHECK(vad.frames > 300);
+    CHECK(vad.cycles_max > 0);
+
+    /* On the frames of the capture */
+    mic_subscriber_t sub;
+    const mic_frame_t *frame;
+    sim_i2s_tone_t tone = { .freq_hz = 1000, .amplitude = 8000 };
+    sim_i2s_set_source(I2S_MANAGER_RX_PORT, sim_i2s_tone_source, &tone);
+    CHECK(Microphone_StartCapture(&(mic_capture_config_t) { .sample_rate = 16000, .frame_samples = 256 }) == ESP_OK);
+    CHECK(Microphone_Subscribe(4, &sub) == ESP_OK);
+    Microphone_VadInit(&vad, 16000);
+    /* The noise floor starts at the tone, so it only counts once quieter frames set it */
+    vad.noise_q8 = 0;
+    vad.started = true;
+    for (int i = 0; i < 10 && !vad.active; i++) {
+        if (Microphone_ReceiveFrame(sub, &frame, pdMS_TO_TICKS(100)) == ESP_OK) {
+            Microphone_VadProcess(&vad, frame);
+            Microphone_ReleaseFrame(frame);
+        }
+    }
+    CHECK(vad.active);
+    CHECK(Microphone_Unsubscribe(sub) == ESP_OK);
+    CHECK(Microphone_StopCapture() == ESP_OK);
+    sim_i2s_set_source(I2S_MANAGER_RX_PORT, NULL, NULL);
+
+    printf("vad:     %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_i2s_manager(void)
+{
+    int errors = 0;
+    mic_subscriber_t sub;
+    const mic_frame_t *frame;
+    i2s_manager_stats_t stats;
+
+    sim_i2s_tone_t tone = { .freq_hz = 1000, .amplitude = 8000 };
+    sim_i2s_set_source(I2S_MANAGER_RX_PORT, sim_i2s_tone_source, &tone);
+    sim_i2s_set_sink(I2S_MANAGER_TX_PORT, speaker_sink, NULL);
+
+    CHECK(Microphone_StartCapture(&(mic_capture_config_t) { .sample_rate = 16000, .frame_samples = 256 }) == ESP_OK);
+    CHECK(Microphone_Subscribe(16, &sub) == ESP_OK);
+    CHECK(Speaker_Init() == ESP_OK);
+    /* The microphone keeps the shared pin */
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S0O_WS_OUT_IDX);
+    I2SManager_GetStats(&stats);
+    CHECK(stats.owner == I2S_MANAGER_RX);
+    uint32_t switches = stats.switches;
+    while (Microphone_ReceiveFrame(sub, &frame, 0) == ESP_OK) {
+        Microphone_ReleaseFrame(frame);
+    }
+
+    /* A 50 ms beep takes the pin and gives it back once played */
+    static int16_t beep[2205];
+    speaker_bytes = 0;
+    CHECK(Speaker_WriteBuff((uint8_t *) beep, sizeof(beep), portMAX_DELAY) == ESP_OK);
+    CHECK(speaker_bytes == sizeof(beep));
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S0O_WS_OUT_IDX);
+    I2SManager_GetStats(&stats);
+    CHECK(stats.owner == I2S_MANAGER_RX);
+    CHECK(stats.switches == switches + 2);
+    CHECK(stats.switch_us_max < 1000);
+    /* Two DMA buffers of 128 samples at 44.1 kHz */
+    CHECK(stats.drain_us_max >= 5800);
+
+    /* The capture went on and tells of the gap */
+    bool gap = false;
+    int received = 0;
+    while (received < 10 && Microphone_ReceiveFrame(sub, &frame, pdMS_TO_TICKS(100)) == ESP_OK) {
+        gap = gap || frame->discontinuity;
+        received++;
+        Microphone_ReleaseFrame(frame);
+    }
+    CHECK(received == 10);
+    CHECK(gap);
+
+    /* In duplex the speaker plays in a third of the time, and the microphone hears in the rest */
+    CHECK(I2SManager_StartDuplex(0, 10) == ESP_ERR_INVALID_ARG);
+    CHECK(I2SManager_StartDuplex(20, 10) == ESP_OK);
+    CHECK(I2SManager_StartDuplex(20, 10) == ESP_ERR_INVALID_STATE);
+    speaker_bytes = 0;
+    int64_t start = esp_timer_get_time();
+    CHECK(Speaker_WriteBuff((uint8_t *) beep, sizeof(beep), portMAX_DELAY) == ESP_OK);
+    int64_t elapsed = esp_timer_get_time() - start;
+    CHECK(speaker_bytes == sizeof(beep));
+    CHECK(elapsed >= 80000);
+    received = 0;
+    while (Microphone_ReceiveFrame(sub, &frame, 0) == ESP_OK) {
+        received++;
+        Microphone_ReleaseFrame(frame);
+    }
+    CHECK(received >= 3);
+    I2SManager_GetStats(&stats);
+    CHECK(stats.duplex);
+    CHECK(stats.switches >= switches + 8);
+    CHECK(I2SManager_StopDuplex() == ESP_OK);
+    CHECK(I2SManager_StopDuplex() == ESP_ERR_INVALID_STATE);
+    I2SManager_GetStats(&stats);
+    CHECK(!stats.duplex);
+    CHECK(stats.owner == I2S_MANAGER_RX);
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S0O_WS_OUT_IDX);
+
+    /* The last one open keeps the pin */
+    CHECK(Microphone_Unsubscribe(sub) == ESP_OK);
+    CHECK(Microphone_StopCapture() == ESP_OK);
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S1O_WS_OUT_IDX);
+    CHECK(I2SManager_StartDuplex(20, 10) == ESP_ERR_INVALID_STATE);
+    CHECK(Speaker_Deinit() == ESP_OK);
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == SIG_GPIO_OUT_IDX);
+    sim_i2s_set_source(I2S_MANAGER_RX_PORT, NULL, NULL);
+    sim_i2s_set_sink(I2S_MANAGER_TX_PORT, NULL, NULL);
+
+    printf("duplex:  %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int stream_played, stream_flushed, stream_refills;
+static int16_t stream_samples[22050];
+
+/* Submits the next block of a sound as the last one is done with, from the stream task */
+static void stream_block_done(const speaker_block_t *block, bool played)
+{
+    if (!played) {
+        stream_flushed++;
+        return;
+    }
+    stream_played++;
+    if (block->ctx != NULL && --stream_refills >= 0) {
+        speaker_block_t next = { .samples = stream_samples, .count = 512, .last = stream_refills == 0,
+                                 .ctx = stream_refills ? block->ctx : NULL };
+        Speaker_Submit(&next, 0);
+    }
+}
+
+static int test_speaker_stream(void)
+{
+    int errors = 0;
+    speaker_stream_stats_t stats;
+    sim_i2s_stats_t sim_stats;
+
+    sim_i2s_set_sink(I2S_MANAGER_TX_PORT, speaker_sink, NULL);
+    speaker_block_t beep = { .samples = stream_samples, .count = 2205, .last = true };
+    CHECK(Speaker_Submit(&beep, 0) == ESP_ERR_INVALID_STATE);
+    CHECK(Speaker_StartStream(&(speaker_stream_config_t) { .dma_buf_count = 1 }, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(Speaker_StartStream(&(speaker_stream_config_t) { .queue_len = 2 }, stream_block_done) == ESP_OK);
+    CHECK(Speaker_StartStream(NULL, NULL) == ESP_ERR_INVALID_STATE);
+    CHECK(Speaker_Init() == ESP_FAIL);
+
+    /* An alert starts at once and the submit does not wait for it */
+    speaker_bytes = 0;
+    int64_t start = esp_timer_get_time();
+    CHECK(Speaker_Submit(&beep, 0) == ESP_OK);
+    CHECK(esp_timer_get_time() - start < 2000);
+    CHECK(Speaker_Drain(portMAX_DELAY) == ESP_OK);
+    int64_t elapsed = esp_timer_get_time() - start;
+    CHECK(elapsed >= 50000 && elapsed < 90000);
+    CHECK(speaker_bytes == beep.count * sizeof(int16_t));
+    CHECK(stream_played == 1);
+    Speaker_GetStreamStats(&stats);
+    CHECK(stats.blocks == 1 && stats.samples == beep.count);
+    CHECK(stats.start_latency_us_max < 5000);
+    CHECK(stats.underruns == 0);
+
+    /* Refills from the callback keep the DMA fed */
+    stream_played = 0;
+    stream_refills = 20;
+    speaker_block_t first = { .samples = stream_samples, .count = 512, .ctx = &stream_refills };
+    CHECK(Speaker_Submit(&first, 0) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(5));
+    sim_i2s_get_stats(I2S_MANAGER_TX_PORT, &sim_stats);
+    uint32_t sim_underruns = sim_stats.tx_underruns;
+    CHECK(Speaker_Drain(pdMS_TO_TICKS(1000)) == ESP_OK);
+    CHECK(stream_played == 21);
+    Speaker_GetStreamStats(&stats);
+    CHECK(stats.underruns == 0);
+    sim_i2s_get_stats(I2S_MANAGER_TX_PORT, &sim_stats);
+    CHECK(sim_stats.tx_underruns == sim_underruns);
+
+    /* A late block in the middle of a sound is an underrun, draining after one is not */
+    speaker_block_t part = { .samples = stream_samples, .count = 512 };
+    CHECK(Speaker_Submit(&part, 0) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    int64_t late_us = esp_timer_get_time();
+    CHECK(Speaker_Submit(&part, 0) == ESP_OK);
+    CHECK(Speaker_Drain(portMAX_DELAY) == ESP_OK);
+    Speaker_GetStreamStats(&stats);
+    CHECK(stats.underruns == 1);
+    CHECK(stats.last_underrun_us > start && stats.last_underrun_us < late_us);
+
+    /* A flush silences the sound at once */
+    stream_played = 0;
+    speaker_block_t clip = { .samples = stream_samples, .count = 22050, .last = true };
+    CHECK(Speaker_Submit(&clip, 0) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    CHECK(Speaker_Submit(&clip, 0) == ESP_OK);
+    CHECK(Speaker_Submit(&clip, 0) == ESP_OK);
+    CHECK(Speaker_Submit(&clip, 0) == ESP_ERR_TIMEOUT);
+    start = esp_timer_get_time();
+    CHECK(Speaker_Flush() == ESP_OK);
+    /* Nothing of the flushed sound reaches the DMA buffers after the flush */
+    uint64_t flushed_bytes = speaker_bytes;
+    CHECK(Speaker_Drain(pdMS_TO_TICKS(1000)) == ESP_OK);
+    CHECK(esp_timer_get_time() - start < 60000);
+    CHECK(speaker_bytes == flushed_bytes);
+    CHECK(stream_played == 0 && stream_flushed == 3);
+    Speaker_GetStreamStats(&stats);
+    CHECK(stats.flushed == 3 && stats.queue_full == 1 && stats.queued == 0);
+    CHECK(stats.underruns == 1);
+
+    /* With the microphone capturing, the stream takes the pin for a sound and gives it back */
+    CHECK(Microphone_StartCapture(&(mic_capture_config_t) { .sample_rate = 16000, .frame_samples = 256 }) == ESP_OK);
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S0O_WS_OUT_IDX);
+    speaker_bytes = 0;
+    start = esp_timer_get_time();
+    CHECK(Speaker_Submit(&beep, 0) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S1O_WS_OUT_IDX);
+    CHECK(Speaker_Drain(portMAX_DELAY) == ESP_OK);
+    /* Once the 50 ms sound and the 23 ms of DMA buffers played, without waiting for them a second time */
+    CHECK(esp_timer_get_time() - start < 50000 + 23000);
+    CHECK(speaker_bytes == beep.count * sizeof(int16_t));
+    CHECK(sim_gpio_signal(I2S_MANAGER_SHARED_PIN) == I2S0O_WS_OUT_IDX);
+    CHECK(Microphone_StopCapture() == ESP_OK);
+
+    CHECK(Speaker_StopStream() == ESP_OK);
+    CHECK(Speaker_StopStream() == ESP_ERR_INVALID_STATE);
+    CHECK(Speaker_Drain(0) == ESP_ERR_INVALID_STATE);
+    sim_i2s_set_sink(I2S_MANAGER_TX_PORT, NULL, NULL);
+
+    printf("speaker: %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static int test_trace(void)
+{
+    int errors = 0;
+
+    /* The trace saw the same transactions as the bus */
+    i2c_trace_stats_t stats;
+    CHECK(i2c_trace_get_device_stats(I2C_NUM_1, 0x68, &stats) == ESP_OK);
+    /* The stream test failed one read, which the model never saw */
+    CHECK(stats.reads == sim_mpu6886.reads + 1);
+    CHECK(stats.errors == 1);
+    CHECK(i2c_trace_get_device_stats(I2C_NUM_1, 0x34, &stats) == ESP_OK);
+    CHECK(stats.errors == 1);
+
+    printf("trace:   %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+static void batch_done(i2c_trans_t *trans)
+{
+    xSemaphoreGive((SemaphoreHandle_t) trans->user);
+}
+
+static int test_i2c_batch(void)
+{
+    int errors = 0;
+    I2CDevice_t pmu = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, 0x34);
+    I2CDevice_t imu = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, 0x68);
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(5, 0);
+    uint8_t data[5][2];
+    i2c_trans_t trans[5];
+    for (int i = 0; i < 5; i++) {
+        trans[i] = (i2c_trans_t) {
+            .device = (i == 1 || i == 2) ? pmu : imu,
+            .reg_addr = 0x00,
+            .data = data[i],
+            .length = sizeof(data[i]),
+            .priority = I2C_PRIORITY_NORMAL,
+            .callback = batch_done,
+            .user = done,
+        };
+    }
+
+    /* Holding the bus, the first transaction keeps the scheduler waiting while the others queue up */
+    CHECK(i2c_take_port(I2C_NUM_1, portMAX_DELAY) == pdTRUE);
+    CHECK(i2c_queue_trans(&trans[0], portMAX_DELAY) == ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    for (int i = 1; i < 5; i++) {
+        CHECK(i2c_queue_trans(&trans[i], portMAX_DELAY) == ESP_OK);
+    }
+    sim_i2c_fail_next(&sim_axp192, 1);
+    sim_i2c_reset_stats();
+    i2c_free_port(I2C_NUM_1);
+    for (int i = 0; i < 5; i++) {
+        CHECK(xSemaphoreTake(done, pdMS_TO_TICKS(1000)) == pdTRUE);
+    }
+
+    /* The transactions of each device share a link, and the NACK of one device fails only its own */
+    sim_i2c_stats_t stats;
+    sim_i2c_get_stats(I2C_NUM_1, &stats);
+    CHECK(stats.links == 3);
+    CHECK(trans[0].err == ESP_OK);
+    CHECK(trans[1].err != ESP_OK && trans[2].err != ESP_OK);
+    CHECK(trans[3].err == ESP_OK && trans[4].err == ESP_OK);
+
+    vSemaphoreDelete(done);
+    i2c_free_device(pmu);
+    i2c_free_device(imu);
+
+    printf("batch:   %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    sim_board_init();
+    pmu_init();
+
+    errors += test_axp192();
+    errors += test_mpu6886();
+    errors += test_mpu6886_stream();
+    errors += test_mpu6886_fusion();
+    errors += test_mpu6886_motion();
+    errors += test_bm8563();
+    errors += test_ft6336u();
+    errors += test_sk6812();
+    errors += test_speaker_mic();
+    errors += test_mic_capture();
+    errors += test_mic_vad();
+    errors += test_i2s_manager();
+    errors += test_speaker_stream();
+    errors += test_trace();
+    errors += test_i2c_batch();
+
+    if (errors) printf("FAILED\n");
+    return errors ? 1 : 0;
+}
@@ -20,7 +20,11 @@ extern "C" {
 /*********************
  *      DEFINES
  *********************/
-#define DISP_BUF_SIZE  (LV_HOR_RES_MAX * 32)
+#ifndef CONFIG_LV_DISP_BUF_LINES
+#define CONFIG_LV_DISP_BUF_LINES 32
+#endif
+
+#define DISP_BUF_SIZE  (LV_HOR_RES_MAX * CONFIG_LV_DISP_BUF_LINES)
 
 /**********************
  *      TYPEDEFS
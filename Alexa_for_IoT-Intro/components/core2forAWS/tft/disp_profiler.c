@@ -0,0 +1,319 @@
+/**
+ * @file disp_profiler.c
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LV_DISP_PROFILER
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#if CONFIG_LV_DISP_PROFILER_CONSOLE
+#include "esp_console.h"
+#endif
+
+#include "disp_profiler.h"
+
+#define TAG "DispProfiler"
+
+#ifndef CONFIG_LV_DISP_PROFILER_WINDOW
+#define CONFIG_LV_DISP_PROFILER_WINDOW 100
+#endif
+
+#ifndef CONFIG_LV_DISP_PROFILER_HISTORY
+#define CONFIG_LV_DISP_PROFILER_HISTORY 16
+#endif
+
+#ifndef CONFIG_LV_DISP_PROFILER_FRAME_BUDGET_MS
+#define CONFIG_LV_DISP_PROFILER_FRAME_BUDGET_MS 33
+#endif
+
+static const char *metric_names[DISP_PROFILER_METRIC_MAX] = {
+    "frame", "area render", "flush wait", "flush", "lock wait", "lock hold"
+};
+
+/* Guards everything below against concurrent readers; only the gui task writes */
+static portMUX_TYPE profiler_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static disp_profiler_stats_t window_cur;
+static disp_profiler_stats_t window_last;
+static bool window_last_valid;
+static int64_t window_start_us;
+
+static disp_profiler_frame_t history[CONFIG_LV_DISP_PROFILER_HISTORY];
+static size_t history_head;
+static size_t history_count;
+
+/* Frame being refreshed, only touched by the gui task */
+static disp_profiler_frame_t frame;
+static int64_t frame_start_us;
+static int64_t area_start_us;
+static uint32_t area_wait_us;
+static int64_t wait_start_us;
+static uint32_t pending_spi_bytes;
+static bool frame_unlocked;
+
+/* Flush timing, the end is stamped by the SPI post transaction interrupt */
+static int64_t flush_start_us;
+static volatile int64_t flush_done_us;
+static volatile bool flush_done;
+
+static void metric_add(disp_profiler_metric_t metric, uint32_t us) {
+    portENTER_CRITICAL(&profiler_mux);
+    LatencyHistogram_Add(&window_cur.metrics[metric], us);
+    portEXIT_CRITICAL(&profiler_mux);
+}
+
+/* Must be called within profiler_mux */
+static void window_roll(int64_t now) {
+    if (window_cur.frames < CONFIG_LV_DISP_PROFILER_WINDOW) {
+        return;
+    }
+    window_cur.window_us = (uint32_t) (now - window_start_us);
+    window_last = window_cur;
+    window_last_valid = true;
+    memset(&window_cur, 0, sizeof(window_cur));
+    window_start_us = now;
+}
+
+/* Folds in a flush completed since the last call */
+static void flush_collect(void) {
+    if (!flush_done) {
+        return;
+    }
+    flush_done = false;
+    if (flush_start_us != 0 && flush_done_us > flush_start_us) {
+        metric_add(DISP_PROFILER_FLUSH, (uint32_t) (flush_done_us - flush_start_us));
+    }
+    flush_start_us = 0;
+}
+
+void DispProfiler_FrameBegin(void) {
+    flush_collect();
+    memset(&frame, 0, sizeof(frame));
+    frame_start_us = esp_timer_get_time();
+    frame.start_us = (uint32_t) frame_start_us;
+}
+
+void DispProfiler_FrameEnd(uint32_t pixels) {
+    int64_t now = esp_timer_get_time();
+
+    frame.frame_us = (uint32_t) (now - frame_start_us);
+    frame.render_us = frame.frame_us - frame.flush_wait_us;
+    frame.pixels = pixels;
+    frame.spi_bytes = pending_spi_bytes;
+    pending_spi_bytes = 0;
+
+    bool over_budget = frame.frame_us > CONFIG_LV_DISP_PROFILER_FRAME_BUDGET_MS * 1000;
+
+    portENTER_CRITICAL(&profiler_mux);
+    if (window_start_us == 0) {
+        window_start_us = frame_start_us;
+    }
+    LatencyHistogram_Add(&window_cur.metrics[DISP_PROFILER_FRAME], frame.frame_us);
+    window_cur.frames++;
+    window_cur.areas += frame.areas;
+    window_cur.pixels += pixels;
+    window_cur.spi_bytes += frame.spi_bytes;
+    if (over_budget) {
+        window_cur.over_budget++;
+    }
+    history_head = (history_head + 1) % CONFIG_LV_DISP_PROFILER_HISTORY;
+    history[history_head] = frame;
+    if (history_count < CONFIG_LV_DISP_PROFILER_HISTORY) {
+        history_count++;
+    }
+    window_roll(now);
+    portEXIT_CRITICAL(&profiler_mux);
+
+    /* The lock hold time is known once lv_task_handler() returns */
+    frame_unlocked = true;
+
+#if CONFIG_LV_DISP_PROFILER_LOG_OVER_BUDGET
+    if (over_budget) {
+        ESP_LOGW(TAG, "Frame took %u us (render %u us, flush wait %u us, slowest area %u us), %u areas, %u px, %u SPI bytes",
+                 frame.frame_us, frame.render_us, frame.flush_wait_us, frame.max_area_us,
+                 frame.areas, frame.pixels, frame.spi_bytes);
+    }
+#endif
+}
+
+void DispProfiler_AreaBegin(void) {
+    area_wait_us = 0;
+    area_start_us = esp_timer_get_time();
+}
+
+void DispProfiler_AreaEnd(void) {
+    uint32_t render_us = (uint32_t) (esp_timer_get_time() - area_start_us) - area_wait_us;
+
+    frame.areas++;
+    if (render_us > frame.max_area_us) {
+        frame.max_area_us = render_us;
+    }
+    metric_add(DISP_PROFILER_AREA_RENDER, render_us);
+}
+
+void DispProfiler_FlushWaitBegin(void) {
+    wait_start_us = esp_timer_get_time();
+}
+
+void DispProfiler_FlushWaitEnd(void) {
+    uint32_t wait_us = (uint32_t) (esp_timer_get_time() - wait_start_us);
+
+    area_wait_us += wait_us;
+    frame.flush_wait_us += wait_us;
+    metric_add(DISP_PROFILER_FLUSH_WAIT, wait_us);
+}
+
+void DispProfiler_FlushStart(void) {
+    flush_collect();
+    flush_start_us = esp_timer_get_time();
+}
+
+void IRAM_ATTR DispProfiler_FlushDoneFromISR(void) {
+    flush_done_us = esp_timer_get_time();
+    flush_done = true;
+}
+
+void DispProfiler_AddSpiBytes(size_t bytes) {
+    pending_spi_bytes += bytes;
+}
+
+void DispProfiler_GuiLock(uint32_t wait_us, uint32_t hold_us) {
+    flush_collect();
+
+    portENTER_CRITICAL(&profiler_mux);
+    LatencyHistogram_Add(&window_cur.metrics[DISP_PROFILER_GUI_LOCK_WAIT], wait_us);
+    LatencyHistogram_Add(&window_cur.metrics[DISP_PROFILER_GUI_LOCK_HOLD], hold_us);
+    if (frame_unlocked && history_count > 0) {
+        history[history_head].lock_hold_us = hold_us;
+    }
+    portEXIT_CRITICAL(&profiler_mux);
+
+    frame_unlocked = false;
+}
+
+esp_err_t DispProfiler_GetStats(disp_profiler_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&profiler_mux);
+    if (window_last_valid) {
+        *stats = window_last;
+    } else {
+        *stats = window_cur;
+        stats->window_us = window_start_us ? (uint32_t) (esp_timer_get_time() - window_start_us) : 0;
+    }
+    portEXIT_CRITICAL(&profiler_mux);
+
+    return ESP_OK;
+}
+
+size_t DispProfiler_GetRecentFrames(disp_profiler_frame_t *frames, size_t max_frames) {
+    size_t copied = 0;
+
+    if (frames == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&profiler_mux);
+    size_t index = history_head;
+    while (copied < max_frames && copied < history_count) {
+        frames[copied++] = history[index];
+        index = (index + CONFIG_LV_DISP_PROFILER_HISTORY - 1) % CONFIG_LV_DISP_PROFILER_HISTORY;
+    }
+    portEXIT_CRITICAL(&profiler_mux);
+
+    return copied;
+}
+
+void DispProfiler_Reset(void) {
+    portENTER_CRITICAL(&profiler_mux);
+    memset(&window_cur, 0, sizeof(window_cur));
+    memset(&window_last, 0, sizeof(window_last));
+    window_last_valid = false;
+    window_start_us = 0;
+    history_head = 0;
+    history_count = 0;
+    portEXIT_CRITICAL(&profiler_mux);
+}
+
+void DispProfiler_Dump(void) {
+    /* Too large for the stack of the console task */
+    static disp_profiler_stats_t stats;
+    static disp_profiler_frame_t frames[CONFIG_LV_DISP_PROFILER_HISTORY];
+
+    DispProfiler_GetStats(&stats);
+    size_t frame_count = DispProfiler_GetRecentFrames(frames, CONFIG_LV_DISP_PROFILER_HISTORY);
+
+    printf("Display profiler: %u frames in %u ms, %u areas, %llu px, %llu SPI bytes, %u over %u ms budget\n",
+           stats.frames, stats.window_us / 1000, stats.areas, stats.pixels, stats.spi_bytes,
+           stats.over_budget, CONFIG_LV_DISP_PROFILER_FRAME_BUDGET_MS);
+
+    printf("%-12s %7s %9s %9s %9s %9s %9s\n", "metric (us)", "count", "avg", "min", "p50<", "p90<", "max");
+    for (int i = 0; i < DISP_PROFILER_METRIC_MAX; i++) {
+        const disp_profiler_histogram_t *hist = &stats.metrics[i];
+        uint32_t avg = hist->count ? (uint32_t) (hist->total_us / hist->count) : 0;
+        printf("%-12s %7u %9u %9u %9u %9u %9u\n", metric_names[i], hist->count, avg, hist->min_us,
+               LatencyHistogram_Percentile(hist, 50), LatencyHistogram_Percentile(hist, 90), hist->max_us);
+    }
+
+    printf("Frame time histogram:\n");
+    const disp_profiler_histogram_t *hist = &stats.metrics[DISP_PROFILER_FRAME];
+    for (int i = 0; i < DISP_PROFILER_BUCKETS; i++) {
+        if (hist->buckets[i] == 0) {
+            continue;
+        }
+        if (i < DISP_PROFILER_BUCKETS - 1) {
+            printf("  < %7u us: %u\n", DISP_PROFILER_BUCKET_BASE_US << i, hist->buckets[i]);
+        } else {
+            printf("  >=%7u us: %u\n", DISP_PROFILER_BUCKET_BASE_US << (i - 1), hist->buckets[i]);
+        }
+    }
+
+    printf("Recent frames (newest first):\n");
+    printf("%10s %8s %8s %8s %8s %5s %7s %7s %8s\n",
+           "start ms", "frame", "render", "wait", "max area", "areas", "px", "SPI B", "lock");
+    for (size_t i = 0; i < frame_count; i++) {
+        const disp_profiler_frame_t *f = &frames[i];
+        printf("%10u %8u %8u %8u %8u %5u %7u %7u %8u%s\n",
+               f->start_us / 1000, f->frame_us, f->render_us, f->flush_wait_us, f->max_area_us,
+               f->areas, f->pixels, f->spi_bytes, f->lock_hold_us,
+               f->frame_us > CONFIG_LV_DISP_PROFILER_FRAME_BUDGET_MS * 1000 ? " !" : "");
+    }
+}
+
+#if CONFIG_LV_DISP_PROFILER_CONSOLE
+static int disp_prof_cmd(int argc, char **argv) {
+    if (argc > 1) {
+        if (strcmp(argv[1], "reset") == 0) {
+            DispProfiler_Reset();
+            return 0;
+        }
+        printf("Unknown argument: %s\n", argv[1]);
+        return 1;
+    }
+    DispProfiler_Dump();
+    return 0;
+}
+
+esp_err_t DispProfiler_RegisterConsoleCommand(void) {
+    const esp_console_cmd_t cmd = {
+        .command = "disp_prof",
+        .help = "Print the display profiler statistics, 'disp_prof reset' clears them",
+        .hint = "[reset]",
+        .func = &disp_prof_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+#endif
+
+#endif /* CONFIG_LV_DISP_PROFILER */
@@ -35,6 +35,68 @@ extern "C" {
 #endif
 #endif
 
+/*******************
+ * POOL ALLOCATOR
+ *******************/
+
+#if defined (CONFIG_LV_MEM_POOL) && !defined (CONFIG_LV_MEM_CUSTOM)
+#define CONFIG_LV_MEM_CUSTOM                    1
+#define CONFIG_LV_MEM_CUSTOM_INCLUDE            "lvgl_pool.h"
+#define CONFIG_LV_MEM_CUSTOM_ALLOC              LvglPool_Alloc
+#define CONFIG_LV_MEM_CUSTOM_FREE               LvglPool_Free
+#define LV_MEM_CUSTOM_MONITOR                   LvglPool_Monitor
+#endif
+
+/*******************
+ * FAST MEMORY
+ *******************/
+
+#if defined (CONFIG_LV_ATTRIBUTE_FAST_MEM_USE_IRAM) && !defined (CONFIG_LV_ATTRIBUTE_FAST_MEM)
+#define CONFIG_LV_ATTRIBUTE_FAST_MEM            IRAM_ATTR
+#endif
+
+#if defined (CONFIG_LV_BLEND_RGB565_IRAM) && !defined (LV_ATTRIBUTE_BLEND_RGB565)
+#define LV_ATTRIBUTE_BLEND_RGB565               IRAM_ATTR
+#endif
+
+/*******************
+ * EVENT-DRIVEN GUI TASK
+ *******************/
+
+#if defined (CONFIG_LV_GUI_TASK_EVENT_DRIVEN)
+/* The gui task may sleep for long periods, so the tick can't rely on a periodic timer */
+#ifndef CONFIG_LV_TICK_CUSTOM
+#define CONFIG_LV_TICK_CUSTOM                   1
+#define CONFIG_LV_TICK_CUSTOM_INCLUDE           "esp_timer.h"
+#define CONFIG_LV_TICK_CUSTOM_SYS_TIME_EXPR     (esp_timer_get_time() / 1000)
+#endif
+
+/* Wakes the gui task when an lv_task is created or switched on, e.g. by an invalidation */
+#ifndef LV_TASK_HANDLER_NOTIFY
+void Core2ForAWS_Display_Notify(void);
+#define LV_TASK_HANDLER_NOTIFY()                Core2ForAWS_Display_Notify()
+#endif
+#endif
+
+/*******************
+ * DISPLAY PROFILER
+ *******************/
+
+#if defined (CONFIG_LV_DISP_PROFILER) && !defined (LV_REFR_PROFILE_FRAME_BEGIN)
+void DispProfiler_FrameBegin(void);
+void DispProfiler_FrameEnd(uint32_t pixels);
+void DispProfiler_AreaBegin(void);
+void DispProfiler_AreaEnd(void);
+void DispProfiler_FlushWaitBegin(void);
+void DispProfiler_FlushWaitEnd(void);
+#define LV_REFR_PROFILE_FRAME_BEGIN()           DispProfiler_FrameBegin()
+#define LV_REFR_PROFILE_FRAME_END(px)           DispProfiler_FrameEnd(px)
+#define LV_REFR_PROFILE_AREA_BEGIN()            DispProfiler_AreaBegin()
+#define LV_REFR_PROFILE_AREA_END()              DispProfiler_AreaEnd()
+#define LV_REFR_PROFILE_FLUSH_WAIT_BEGIN()      DispProfiler_FlushWaitBegin()
+#define LV_REFR_PROFILE_FLUSH_WAIT_END()        DispProfiler_FlushWaitEnd()
+#endif
+
 /*******************
  * LV COLOR TRANSP
  *******************/
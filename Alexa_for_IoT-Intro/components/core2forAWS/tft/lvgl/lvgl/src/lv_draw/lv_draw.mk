@@ -1,5 +1,6 @@
 CSRCS += lv_draw_mask.c
 CSRCS += lv_draw_blend.c
+CSRCS += lv_draw_blend_rgb565.c
 CSRCS += lv_draw_rect.c
 CSRCS += lv_draw_label.c
 CSRCS += lv_draw_line.c
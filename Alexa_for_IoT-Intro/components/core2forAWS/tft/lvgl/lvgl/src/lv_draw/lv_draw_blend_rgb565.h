@@ -0,0 +1,91 @@
+/**
+ * @file lv_draw_blend_rgb565.h
+ * Software blending kernels specialized for 16 bit (optionally byte swapped) RGB565 buffers
+ */
+
+#ifndef LV_DRAW_BLEND_RGB565_H
+#define LV_DRAW_BLEND_RGB565_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../lv_misc/lv_color.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/*The kernels only handle plain RGB565 destinations*/
+#if LV_USE_BLEND_RGB565 && LV_COLOR_DEPTH == 16 && LV_COLOR_SCREEN_TRANSP == 0
+#define LV_DRAW_BLEND_RGB565    1
+#else
+#define LV_DRAW_BLEND_RGB565    0
+#endif
+
+/*Placement of the kernels. Defaults to the general fast memory attribute*/
+#ifndef LV_ATTRIBUTE_BLEND_RGB565
+#define LV_ATTRIBUTE_BLEND_RGB565   LV_ATTRIBUTE_FAST_MEM
+#endif
+
+#if LV_DRAW_BLEND_RGB565
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/*
+ * All kernels produce exactly the same pixels as the generic `lv_color_mix()` loops of `lv_draw_blend.c`.
+ * `dest_stride`, `src_stride` are in pixels.
+ */
+
+//! @cond Doxygen_Suppress
+/**
+ * Fill a `w` x `h` area with a color using an overall opacity
+ * @param dest first pixel to fill
+ * @param dest_stride width of the destination buffer
+ * @param w width of the area
+ * @param h height of the area
+ * @param color fill color
+ * @param opa opacity of the color (should be < LV_OPA_MAX)
+ */
+LV_ATTRIBUTE_BLEND_RGB565 void _lv_blend_rgb565_fill_opa(lv_color_t * dest, int32_t dest_stride, int32_t w, int32_t h,
+                                                         lv_color_t color, lv_opa_t opa);
+
+/**
+ * Copy a `w` x `h` area of an image
+ * @param dest first pixel to write
+ * @param dest_stride width of the destination buffer
+ * @param src first pixel to read
+ * @param src_stride width of the source buffer
+ * @param w width of the area
+ * @param h height of the area
+ */
+LV_ATTRIBUTE_BLEND_RGB565 void _lv_blend_rgb565_map_copy(lv_color_t * dest, int32_t dest_stride,
+                                                         const lv_color_t * src, int32_t src_stride, int32_t w, int32_t h);
+
+/**
+ * Blend a `w` x `h` area of an image using an overall opacity
+ * @param dest first pixel to write
+ * @param dest_stride width of the destination buffer
+ * @param src first pixel to read
+ * @param src_stride width of the source buffer
+ * @param w width of the area
+ * @param h height of the area
+ * @param opa opacity of the image (should be < LV_OPA_MAX)
+ */
+LV_ATTRIBUTE_BLEND_RGB565 void _lv_blend_rgb565_map_opa(lv_color_t * dest, int32_t dest_stride,
+                                                        const lv_color_t * src, int32_t src_stride, int32_t w, int32_t h,
+                                                        lv_opa_t opa);
+//! @endcond
+
+#endif /*LV_DRAW_BLEND_RGB565*/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_DRAW_BLEND_RGB565_H*/
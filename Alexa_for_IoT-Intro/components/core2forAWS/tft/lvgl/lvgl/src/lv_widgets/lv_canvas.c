@@ -7,6 +7,7 @@
  *      INCLUDES
  *********************/
 #include <stdlib.h>
+#include <string.h>
 #include "lv_canvas.h"
 #include "../lv_misc/lv_debug.h"
 #include "../lv_misc/lv_math.h"
@@ -30,6 +31,7 @@
  **********************/
 static lv_res_t lv_canvas_signal(lv_obj_t * canvas, lv_signal_t sign, void * param);
 static void set_set_px_cb(lv_disp_drv_t * disp_drv, lv_img_cf_t cf);
+static void write_col_palette(lv_img_dsc_t * dsc, lv_coord_t x, const uint8_t * idx, const lv_color_t * palette);
 
 static void set_px_true_color_alpha(lv_disp_drv_t * disp_drv, uint8_t * buf, lv_coord_t buf_w, lv_coord_t x,
                                     lv_coord_t y,
@@ -258,6 +260,76 @@ void lv_canvas_copy_buf(lv_obj_t * canvas, const void * to_copy, lv_coord_t x, l
     }
 }
 
+/**
+ * Write a whole column of the canvas from palette indices, e.g. a spectrum of a spectrogram.
+ * Only the column is invalidated (the whole canvas if it is zoomed, rotated or offset).
+ * @param canvas pointer to a canvas object
+ * @param x the column to write
+ * @param idx palette index of every pixel of the column, top to bottom (canvas height entries)
+ * @param palette the colors to look the indices up in
+ */
+void lv_canvas_set_col_palette(lv_obj_t * canvas, lv_coord_t x, const uint8_t * idx, const lv_color_t * palette)
+{
+    LV_ASSERT_OBJ(canvas, LV_OBJX_NAME);
+    LV_ASSERT_NULL(idx);
+    LV_ASSERT_NULL(palette);
+
+    lv_canvas_ext_t * ext = lv_obj_get_ext_attr(canvas);
+    if(x < 0 || x >= (lv_coord_t)ext->dsc.header.w) {
+        LV_LOG_WARN("lv_canvas_set_col_palette: x out of the canvas");
+        return;
+    }
+
+    write_col_palette(&ext->dsc, x, idx, palette);
+
+    if(lv_img_get_zoom(canvas) != LV_IMG_ZOOM_NONE || lv_img_get_angle(canvas) != 0 ||
+       lv_img_get_offset_x(canvas) != 0 || lv_img_get_offset_y(canvas) != 0) {
+        lv_obj_invalidate(canvas);
+        return;
+    }
+
+    lv_area_t col;
+    col.x1 = canvas->coords.x1 + x;
+    col.x2 = col.x1;
+    col.y1 = canvas->coords.y1;
+    col.y2 = canvas->coords.y1 + ext->dsc.header.h - 1;
+    lv_obj_invalidate_area(canvas, &col);
+}
+
+/**
+ * Scroll the canvas content left by one column and write the new rightmost column from
+ * palette indices, e.g. to show a spectrogram as a waterfall.
+ * The canvas is invalidated once.
+ * @param canvas pointer to a canvas object
+ * @param idx palette index of every pixel of the new column, top to bottom (canvas height entries)
+ * @param palette the colors to look the indices up in
+ */
+void lv_canvas_scroll_col_palette(lv_obj_t * canvas, const uint8_t * idx, const lv_color_t * palette)
+{
+    LV_ASSERT_OBJ(canvas, LV_OBJX_NAME);
+    LV_ASSERT_NULL(idx);
+    LV_ASSERT_NULL(palette);
+
+    lv_canvas_ext_t * ext = lv_obj_get_ext_attr(canvas);
+    lv_img_dsc_t * dsc = &ext->dsc;
+    uint32_t px_size = lv_img_cf_get_px_size(dsc->header.cf) >> 3;
+    if(px_size == 0) {
+        LV_LOG_WARN("lv_canvas_scroll_col_palette: not supported for color formats below 8 bit");
+        return;
+    }
+
+    uint32_t stride = dsc->header.w * px_size;
+    uint8_t * row = (uint8_t *)dsc->data;
+    lv_coord_t y;
+    for(y = 0; y < (lv_coord_t)dsc->header.h; y++) {
+        memmove(row, row + px_size, stride - px_size);
+        row += stride;
+    }
+
+    write_col_palette(dsc, dsc->header.w - 1, idx, palette);
+    lv_obj_invalidate(canvas);
+}
+
 /**
  * Transform and image and store the result on a canvas.
  * @param canvas pointer to a canvas object to store the result of the transformation.
@@ -1113,6 +1185,29 @@ static lv_res_t lv_canvas_signal(lv_obj_t * canvas, lv_signal_t sign, void * par
     return res;
 }
 
+static void write_col_palette(lv_img_dsc_t * dsc, lv_coord_t x, const uint8_t * idx, const lv_color_t * palette)
+{
+    lv_coord_t h = dsc->header.h;
+    lv_coord_t y;
+
+    if(dsc->header.cf != LV_IMG_CF_TRUE_COLOR && dsc->header.cf != LV_IMG_CF_TRUE_COLOR_ALPHA) {
+        for(y = 0; y < h; y++) {
+            lv_img_buf_set_px_color(dsc, x, y, palette[idx[y]]);
+        }
+        return;
+    }
+
+    /*Write straight into the buffer, a column is one pixel per row*/
+    uint32_t px_size = lv_img_cf_get_px_size(dsc->header.cf) >> 3;
+    uint32_t stride = dsc->header.w * px_size;
+    uint8_t * px = (uint8_t *)dsc->data + x * px_size;
+    for(y = 0; y < h; y++) {
+        _lv_memcpy_small(px, &palette[idx[y]], sizeof(lv_color_t));
+        if(dsc->header.cf == LV_IMG_CF_TRUE_COLOR_ALPHA) px[LV_IMG_PX_SIZE_ALPHA_BYTE - 1] = LV_OPA_COVER;
+        px += stride;
+    }
+}
+
 static void set_set_px_cb(lv_disp_drv_t * disp_drv, lv_img_cf_t cf)
 {
     switch(cf) {
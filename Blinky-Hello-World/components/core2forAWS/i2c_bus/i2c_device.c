@@ -1,5 +1,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 
 #include "driver/i2c.h"
 #include "esp_log.h"
@@ -7,6 +9,11 @@
 
 #include "i2c_device.h"
 
+#if CONFIG_I2C_TRACE
+#include "esp_timer.h"
+#include "i2c_trace.h"
+#endif
+
 #define TAG "I2C-DEVICE"
 
 #ifdef CONFIG_I2C_DEVICE_DEBUG_INFO
@@ -29,6 +36,18 @@
 
 #define I2C_TIMEOUT_MS (100)
 
+#ifndef CONFIG_I2C_SCHEDULER_QUEUE_LEN
+#define CONFIG_I2C_SCHEDULER_QUEUE_LEN 16
+#endif
+
+#ifndef CONFIG_I2C_SCHEDULER_BATCH_MAX
+#define CONFIG_I2C_SCHEDULER_BATCH_MAX 8
+#endif
+
+#ifndef CONFIG_I2C_SCHEDULER_TASK_PRIORITY
+#define CONFIG_I2C_SCHEDULER_TASK_PRIORITY 10
+#endif
+
 typedef struct _i2c_port_obj_t {
     i2c_port_t port;
     gpio_num_t scl;
@@ -39,11 +58,26 @@ typedef struct _i2c_port_obj_t {
 typedef struct _i2c_device_t {
     i2c_port_obj_t* i2c_port;
     uint8_t addr;
+    i2c_priority_t priority;
+#if CONFIG_I2C_TRACE
+    int8_t trace;
+#endif
 } i2c_device_t;
 
 static SemaphoreHandle_t i2c_mutex[I2C_NUM_MAX];
 static i2c_port_obj_t *i2c_port_used[2] = { NULL, NULL };
 
+#if CONFIG_I2C_SCHEDULER
+typedef struct _i2c_scheduler_t {
+    QueueHandle_t queue[I2C_PRIORITY_MAX];
+    SemaphoreHandle_t pending;
+    TaskHandle_t task;
+} i2c_scheduler_t;
+
+static i2c_scheduler_t i2c_scheduler[I2C_NUM_MAX];
+static void i2c_scheduler_start(i2c_port_t i2c_num);
+#endif
+
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr) {
     if (i2c_num > I2C_NUM_MAX) {
         i2c_num = I2C_NUM_MAX;
@@ -74,6 +108,13 @@ I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl
 
     device->i2c_port = new_device_port;
     device->addr = device_addr;
+    device->priority = I2C_PRIORITY_NORMAL;
+#if CONFIG_I2C_TRACE
+    device->trace = i2c_trace_add_device(i2c_num, device_addr);
+#endif
+#if CONFIG_I2C_SCHEDULER
+    i2c_scheduler_start(i2c_num);
+#endif
     log_i("New device malloc, scl: %d, sda: %d, freq: %d HZ",
         device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
 
@@ -104,13 +145,8 @@ BaseType_t i2c_free_port(i2c_port_t i2c_num) {
     return xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
 }
 
-esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
-    if (i2c_device == NULL) {
-        return ESP_FAIL;
-    }
-
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
+/* Installs the bus configuration of the device, called with the port mutex taken */
+static esp_err_t i2c_configure_bus(i2c_device_t* device) {
     i2c_port_obj_t* used_port = i2c_port_used[device->i2c_port->port];
     
     if (used_port == device->i2c_port) {
@@ -151,96 +187,292 @@ esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
     return ESP_OK;
 }
 
-esp_err_t i2c_free_bus(I2CDevice_t i2c_device) {
+esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
     if (i2c_device == NULL) {
-        return ESP_ERR_INVALID_ARG;
+        return ESP_FAIL;
     }
+
     i2c_device_t* device = (i2c_device_t *)i2c_device;
-    return (xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]) == pdTRUE) ? ESP_OK : ESP_FAIL;
+#if CONFIG_I2C_TRACE
+    int64_t start_us = esp_timer_get_time();
+    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
+    i2c_trace_bus_wait(device->trace, (uint32_t) (esp_timer_get_time() - start_us));
+#else
+    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
+#endif
+    return i2c_configure_bus(device);
 }
 
-esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+esp_err_t i2c_free_bus(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
-
     i2c_device_t* device = (i2c_device_t *)i2c_device;
+    return (xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]) == pdTRUE) ? ESP_OK : ESP_FAIL;
+}
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+/* Adds the START to STOP sequence of a transaction to a command link */
+static void i2c_cmd_add_trans(i2c_cmd_handle_t cmd, const i2c_trans_t *trans) {
+    i2c_device_t* device = (i2c_device_t *)trans->device;
 
-    if(!(reg_addr & I2C_NO_REG)){
+    if (trans->write) {
         i2c_master_start(cmd);
         i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-        i2c_master_write_byte(cmd, reg_addr, 1);
+        if(!(trans->reg_addr & I2C_NO_REG)){
+            i2c_master_write_byte(cmd, trans->reg_addr, 1);
+        }
+        if (trans->length > 0) {
+            i2c_master_write(cmd, trans->data, trans->length, 1);
+        }
+        i2c_master_stop(cmd);
+        return;
+    }
+
+    if(!(trans->reg_addr & I2C_NO_REG)){
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
+        i2c_master_write_byte(cmd, trans->reg_addr, 1);
     }
- 
+
     i2c_master_start(cmd);
     i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(cmd, data, length - 1, I2C_MASTER_ACK);
+    if (trans->length > 1) {
+        i2c_master_read(cmd, trans->data, trans->length - 1, I2C_MASTER_ACK);
     }
-    if (length > 0) {
-        i2c_master_read_byte(cmd, &data[length-1], I2C_MASTER_NACK);
+    if (trans->length > 0) {
+        i2c_master_read_byte(cmd, &trans->data[trans->length - 1], I2C_MASTER_NACK);
     }
     i2c_master_stop(cmd);
-    i2c_apply_bus(i2c_device);
-    
+}
+
+#define DEVICE_ADDR(trans) (((i2c_device_t *)(trans)->device)->addr)
+
+#if CONFIG_I2C_TRACE
+/* Bytes of a transaction on the wire, addresses included */
+static uint32_t i2c_trans_wire_bytes(const i2c_trans_t *trans) {
+    uint32_t reg_bytes = (trans->reg_addr & I2C_NO_REG) ? 0 : 1;
+    if (trans->write) {
+        return 1 + reg_bytes + trans->length;
+    }
+    return 2 * reg_bytes + 1 + trans->length;
+}
+#endif
+
+/* Sends the transactions in one command link, they must share the bus configuration */
+static void i2c_execute(i2c_trans_t **batch, uint8_t count) {
+    i2c_device_t* device = (i2c_device_t *)batch[0]->device;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    for (uint8_t i = 0; i < count; i++) {
+        i2c_cmd_add_trans(cmd, batch[i]);
+    }
+
     esp_err_t err = ESP_FAIL;
 
-    err = i2c_master_cmd_begin(device->i2c_port->port, cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
+    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
+#if CONFIG_I2C_TRACE
+    int64_t start_us = esp_timer_get_time();
+#endif
+    i2c_configure_bus(device);
+    err = i2c_master_cmd_begin(device->i2c_port->port, cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS * count));
+#if CONFIG_I2C_TRACE
+    uint32_t transfer_us = (uint32_t) (esp_timer_get_time() - start_us);
+#endif
+    i2c_free_bus(device);
     i2c_cmd_link_delete(cmd);
 
-    if (err != ESP_OK) {
-        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
-    } else {
-        log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
-        log_reg(data, length);
+#if CONFIG_I2C_TRACE
+    /* Transactions share the time of the link in proportion to their bytes on the wire */
+    uint32_t wire_bytes = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        wire_bytes += i2c_trans_wire_bytes(batch[i]);
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        i2c_trace_record_t record = {
+            .start_us = (uint32_t) start_us,
+            .wait_us = (uint32_t) (start_us - batch[i]->queued_us),
+            .transfer_us = (uint32_t) ((uint64_t) transfer_us * i2c_trans_wire_bytes(batch[i]) / wire_bytes),
+            .reg_addr = batch[i]->reg_addr,
+            .err = err,
+            .length = batch[i]->length,
+            .port = device->i2c_port->port,
+            .addr = DEVICE_ADDR(batch[i]),
+            .write = batch[i]->write,
+            .batch = count,
+        };
+        i2c_trace_transaction(((i2c_device_t *)batch[i]->device)->trace, &record);
     }
+#endif
 
-    return err;
+    for (uint8_t i = 0; i < count; i++) {
+        i2c_trans_t *trans = batch[i];
+        trans->err = err;
+        if (err != ESP_OK) {
+            if (trans->write) {
+                log_e("I2C Write Error, addr: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", DEVICE_ADDR(trans), trans->reg_addr, trans->length, err);
+            } else {
+                log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", DEVICE_ADDR(trans), trans->reg_addr, trans->length, err);
+            }
+        } else {
+            if (trans->write) {
+                log_i("I2C Write Success, addr: 0x%02x, reg: 0x%02x, length: %d", DEVICE_ADDR(trans), trans->reg_addr, trans->length);
+            } else {
+                log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", DEVICE_ADDR(trans), trans->reg_addr, trans->length);
+            }
+            log_reg(trans->data, trans->length);
+        }
+    }
 }
 
-esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+#if CONFIG_I2C_SCHEDULER
+/* Register transactions of one device can share a command link, a NACK then only fails that device */
+static bool i2c_trans_batchable(const i2c_trans_t *first, const i2c_trans_t *next) {
+    return !(next->reg_addr & I2C_NO_REG) && next->device == first->device;
+}
+
+static void i2c_scheduler_task(void *arg) {
+    i2c_scheduler_t *scheduler = (i2c_scheduler_t *)arg;
+    i2c_trans_t *batch[CONFIG_I2C_SCHEDULER_BATCH_MAX];
+    i2c_trans_t *next;
+
+    for (;;) {
+        /* Given once for every queued transaction */
+        xSemaphoreTake(scheduler->pending, portMAX_DELAY);
+
+        /* A transaction batched before its count was given leaves a count without one */
+        uint8_t priority = 0;
+        while (priority < I2C_PRIORITY_MAX && xQueueReceive(scheduler->queue[priority], &batch[0], 0) != pdTRUE) {
+            priority++;
+        }
+        if (priority == I2C_PRIORITY_MAX) {
+            continue;
+        }
+
+        /* Only this task receives, so a peeked transaction is still there to take */
+        uint8_t count = 1;
+        while (!(batch[0]->reg_addr & I2C_NO_REG) && count < CONFIG_I2C_SCHEDULER_BATCH_MAX &&
+               xQueuePeek(scheduler->queue[priority], &next, 0) == pdTRUE && i2c_trans_batchable(batch[0], next)) {
+            xQueueReceive(scheduler->queue[priority], &batch[count++], 0);
+            xSemaphoreTake(scheduler->pending, 0);
+        }
+
+        i2c_execute(batch, count);
+
+        for (uint8_t i = 0; i < count; i++) {
+            if (batch[i]->callback) {
+                batch[i]->callback(batch[i]);
+            }
+        }
+    }
+}
+
+static void i2c_scheduler_start(i2c_port_t i2c_num) {
+    i2c_scheduler_t *scheduler = &i2c_scheduler[i2c_num];
+    if (scheduler->task != NULL) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < I2C_PRIORITY_MAX; i++) {
+        scheduler->queue[i] = xQueueCreate(CONFIG_I2C_SCHEDULER_QUEUE_LEN, sizeof(i2c_trans_t *));
+    }
+    scheduler->pending = xSemaphoreCreateCounting(I2C_PRIORITY_MAX * CONFIG_I2C_SCHEDULER_QUEUE_LEN, 0);
+    xTaskCreatePinnedToCore(i2c_scheduler_task, i2c_num == I2C_NUM_0 ? "I2C0Sched" : "I2C1Sched", 3 * 1024,
+                            scheduler, CONFIG_I2C_SCHEDULER_TASK_PRIORITY, &scheduler->task, tskNO_AFFINITY);
+}
+
+static void i2c_blocking_done(i2c_trans_t *trans) {
+    xSemaphoreGive((SemaphoreHandle_t)trans->user);
+}
+#endif
+
+esp_err_t i2c_queue_trans(i2c_trans_t *trans, TickType_t wait) {
+    if (trans == NULL || trans->device == NULL || (trans->length > 0 && trans->data == NULL) ||
+        trans->priority >= I2C_PRIORITY_MAX) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
+#if CONFIG_I2C_TRACE
+    trans->queued_us = esp_timer_get_time();
+#endif
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    
-    if(!(reg_addr & I2C_NO_REG)){
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-        i2c_master_write_byte(cmd, reg_addr, 1);
+#if CONFIG_I2C_SCHEDULER
+    i2c_scheduler_t *scheduler = &i2c_scheduler[((i2c_device_t *)trans->device)->i2c_port->port];
+    if (xQueueSend(scheduler->queue[trans->priority], &trans, wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
     }
+    xSemaphoreGive(scheduler->pending);
+#else
+    i2c_execute(&trans, 1);
+    if (trans->callback) {
+        trans->callback(trans);
+    }
+#endif
+    return ESP_OK;
+}
 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(cmd, data, length - 1, I2C_MASTER_ACK);
+/* Queues a transaction with the priority of the device and waits for it */
+static esp_err_t i2c_transfer(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length, bool write) {
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_trans_t trans = {
+        .device = i2c_device,
+        .reg_addr = reg_addr,
+        .data = data,
+        .length = length,
+        .write = write,
+        .priority = device->priority,
+    };
+    i2c_trans_t *batch = &trans;
+
+#if CONFIG_I2C_SCHEDULER
+    i2c_port_t port = device->i2c_port->port;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    /* The scheduler task and a task holding the port with i2c_take_port() would wait for themselves */
+    if (self != i2c_scheduler[port].task && xSemaphoreGetMutexHolder(i2c_mutex[port]) != self) {
+        StaticSemaphore_t done_buffer;
+        SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&done_buffer);
+        trans.callback = i2c_blocking_done;
+        trans.user = done;
+
+        esp_err_t err = i2c_queue_trans(&trans, portMAX_DELAY);
+        if (err == ESP_OK) {
+            xSemaphoreTake(done, portMAX_DELAY);
+            err = trans.err;
+        }
+        vSemaphoreDelete(done);
+        return err;
     }
-    if (length > 0) {
-        i2c_master_read_byte(cmd, &data[length-1], I2C_MASTER_NACK);
+#endif
+
+#if CONFIG_I2C_TRACE
+    trans.queued_us = esp_timer_get_time();
+#endif
+    i2c_execute(&batch, 1);
+    return trans.err;
+}
+
+esp_err_t i2c_device_set_priority(I2CDevice_t i2c_device, i2c_priority_t priority) {
+    if (i2c_device == NULL || priority >= I2C_PRIORITY_MAX) {
+        return ESP_ERR_INVALID_ARG;
     }
-    i2c_master_stop(cmd);
-    i2c_apply_bus(i2c_device);
+    ((i2c_device_t *)i2c_device)->priority = priority;
+    return ESP_OK;
+}
 
-    esp_err_t err = ESP_FAIL;
-    
-    err = i2c_master_cmd_begin(device->i2c_port->port, cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
-    i2c_cmd_link_delete(cmd);
+esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    if (err != ESP_OK) {
-        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
-    } else {
-        log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
-        log_reg(data, length);
+    return i2c_transfer(i2c_device, reg_addr, data, length, false);
+}
+
+esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    return err;
+    return i2c_transfer(i2c_device, reg_addr, data, length, false);
 }
 
 esp_err_t i2c_read_byte(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t* data) {
@@ -286,35 +518,7 @@ esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *da
         return ESP_FAIL;
     }
 
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    if(!(reg_addr & I2C_NO_REG)){
-        i2c_master_write_byte(write_cmd, reg_addr, 1);
-    }
-    if (length > 0) {
-        i2c_master_write(write_cmd, data, length, 1);
-    }
-    i2c_master_stop(write_cmd);
-
-    esp_err_t err = ESP_FAIL;
-
-    i2c_apply_bus(i2c_device);
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
-
-    i2c_cmd_link_delete(write_cmd);
-
-    if (err != ESP_OK) {
-        log_e("I2C Write Error, addr: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
-    } else {
-        log_i("I2C Write Success, addr: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
-        log_reg(data, length);
-    }
-
-    return err;
+    return i2c_transfer(i2c_device, reg_addr, data, length, true);
 }
 
 esp_err_t i2c_write_byte(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t data) {
@@ -7,12 +7,19 @@
 
 #include "stdint.h"
 
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
 #define MPU6886_ADDRESS           0x68 
 #define MPU6886_WHOAMI            0x75
 #define MPU6886_ACCEL_INTEL_CTRL  0x69
+#define MPU6886_ACCEL_WOM_X_THR   0x20
+#define MPU6886_ACCEL_WOM_Y_THR   0x21
+#define MPU6886_ACCEL_WOM_Z_THR   0x22
 #define MPU6886_SMPLRT_DIV        0x19
 #define MPU6886_INT_PIN_CFG       0x37
 #define MPU6886_INT_ENABLE        0x38
+#define MPU6886_INT_STATUS        0x3A
 #define MPU6886_ACCEL_XOUT_H      0x3B
 #define MPU6886_ACCEL_XOUT_L      0x3C
 #define MPU6886_ACCEL_YOUT_H      0x3D
@@ -38,6 +45,11 @@
 #define MPU6886_ACCEL_CONFIG      0x1C
 #define MPU6886_ACCEL_CONFIG2     0x1D
 #define MPU6886_FIFO_EN           0x23
+#define MPU6886_FIFO_WM_TH1       0x60
+#define MPU6886_FIFO_WM_TH2       0x61
+#define MPU6886_FIFO_COUNTH       0x72
+#define MPU6886_FIFO_COUNTL       0x73
+#define MPU6886_FIFO_R_W          0x74
 
 /**
  * @brief List of possible accelerometer scalars in Gs.
@@ -63,6 +75,43 @@ typedef enum {
 } gyro_scale_t;
 /* @[declare_mpu6886_gyro_scale_t] */
 
+/**
+ * @brief A timestamped sample of the FIFO stream.
+ */
+/* @[declare_mpu6886_sample_t] */
+typedef struct {
+    int64_t time_us;    /**< @brief When the sample was taken, from esp_timer_get_time(). */
+    float accel[3];     /**< @brief Acceleration in X, Y and Z in G's. */
+    float gyro[3];      /**< @brief Angular rate around X, Y and Z in degrees per second. */
+    float temp;         /**< @brief Temperature in degrees Celsius. */
+} mpu6886_sample_t;
+/* @[declare_mpu6886_sample_t] */
+
+/**
+ * @brief Statistics of the FIFO stream since it was started.
+ */
+/* @[declare_mpu6886_stream_stats_t] */
+typedef struct {
+    uint16_t rate_hz;       /**< @brief The output data rate, the requested one rounded to what the divider allows. */
+    uint32_t samples;       /**< @brief Samples stored in the ring buffer. */
+    uint32_t bursts;        /**< @brief FIFO burst reads. */
+    uint32_t overflows;     /**< @brief Times the FIFO filled up before it was read, each losing its contents. */
+    uint32_t errors;        /**< @brief Failed I2C transfers. */
+} mpu6886_stream_stats_t;
+/* @[declare_mpu6886_stream_stats_t] */
+
+/**
+ * @brief Function called by the MPU6886 task after each burst read.
+ */
+/* @[declare_mpu6886_sample_callback_t] */
+typedef void (*MPU6886_SampleCallback_t)(void);
+/* @[declare_mpu6886_sample_callback_t] */
+
+/**
+ * @brief Most sample callbacks that can be registered at once.
+ */
+#define MPU6886_MAX_SAMPLE_CALLBACKS 4
+
 /**
  * @brief Initializes the MPU6886 over I2C.
  * 
@@ -210,3 +259,179 @@ void MPU6886_GetGyroData(float *roll, float *yaw, float *pitch);
 /* @[declare_mpu6886_gettempdata] */
 void MPU6886_GetTempData(float *t);
 /* @[declare_mpu6886_gettempdata] */
+
+/**
+ * @brief Starts streaming samples through the on-chip FIFO.
+ *
+ * The MPU6886 samples the accelerometer, the gyroscope and the temperature
+ * at the output data rate into its 1 KB FIFO. A FreeRTOS task with the task
+ * name `MPU6886Task` empties it in one burst read every
+ * CONFIG_MPU6886_FIFO_BATCH_MS, or when the FIFO watermark interrupt fires
+ * on CONFIG_MPU6886_INT_PIN, instead of two register reads per sample.
+ * The samples are timestamped and stored in a ring of
+ * CONFIG_MPU6886_SAMPLE_RING_LEN samples read with MPU6886_ReadSample().
+ *
+ * The single-shot functions keep working while streaming.
+ *
+ * **Example:**
+ *
+ * Stream at 500 Hz.
+ * @code{c}
+ *  MPU6886_StartStream(500);
+ * @endcode
+ *
+ * @param[in] rate_hz The output data rate, from 4 to 1000 Hz. The sensor
+ * divides 1 kHz by an integer, so rates that do not divide it are rounded up.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : The rate is out of range
+ *  - ESP_ERR_INVALID_STATE : MPU6886_Init() failed or was not called, or the stream is already running
+ *  - ESP_ERR_NO_MEM        : The task could not be created
+ *  - ESP_FAIL              : The sensor could not be configured
+ */
+/* @[declare_mpu6886_startstream] */
+esp_err_t MPU6886_StartStream(uint16_t rate_hz);
+/* @[declare_mpu6886_startstream] */
+
+/**
+ * @brief Stops the FIFO stream.
+ *
+ * The samples stored so far stay readable.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The stream is not running
+ */
+/* @[declare_mpu6886_stopstream] */
+esp_err_t MPU6886_StopStream(void);
+/* @[declare_mpu6886_stopstream] */
+
+/**
+ * @brief Reads the next sample of a reader.
+ *
+ * Each reader keeps its own cursor, starting at 0, so several consumers see
+ * every sample. A reader that falls more than CONFIG_MPU6886_SAMPLE_RING_LEN
+ * samples behind skips to the oldest sample still stored.
+ *
+ * **Example:**
+ *
+ * Print every sample.
+ * @code{c}
+ *  static uint32_t cursor = 0;
+ *  mpu6886_sample_t sample;
+ *
+ *  while (MPU6886_ReadSample(&cursor, &sample)) {
+ *      printf("%lld us: Z %.3f G, %.1f dps\n", sample.time_us, sample.accel[2], sample.gyro[2]);
+ *  }
+ * @endcode
+ *
+ * @param[in,out] cursor The reader cursor, advanced past the returned sample.
+ * @param[out] sample The sample.
+ *
+ * @return The number of samples that were waiting for this reader,
+ * including the returned one, or 0 if there was none.
+ */
+/* @[declare_mpu6886_readsample] */
+uint32_t MPU6886_ReadSample(uint32_t *cursor, mpu6886_sample_t *sample);
+/* @[declare_mpu6886_readsample] */
+
+/**
+ * @brief Registers a function to be called after each burst of samples is stored.
+ *
+ * The callback runs in the `MPU6886Task` FreeRTOS task and must not block,
+ * it is meant to wake the consumers, e.g. with a task notification.
+ *
+ * @param[in] callback The function to call.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : callback is NULL
+ *  - ESP_ERR_NO_MEM        : MPU6886_MAX_SAMPLE_CALLBACKS are already registered
+ */
+/* @[declare_mpu6886_addsamplecallback] */
+esp_err_t MPU6886_AddSampleCallback(MPU6886_SampleCallback_t callback);
+/* @[declare_mpu6886_addsamplecallback] */
+
+/**
+ * @brief Retrieves the statistics of the FIFO stream.
+ *
+ * @param[out] stats The statistics.
+ */
+/* @[declare_mpu6886_getstreamstats] */
+void MPU6886_GetStreamStats(mpu6886_stream_stats_t *stats);
+/* @[declare_mpu6886_getstreamstats] */
+
+/**
+ * @brief Arms the wake-on-motion comparator of the MPU6886.
+ *
+ * The gyroscope is put in standby and the accelerometer in its low power
+ * mode, waking up only to take a sample at the given rate. Each sample is
+ * compared with the previous one, and a change larger than the threshold on
+ * any axis latches a motion interrupt, seen by MPU6886_WaitForMotion().
+ *
+ * With CONFIG_MPU6886_INT_PIN set, the INT line is armed as a level
+ * interrupt and as a GPIO wakeup source, so an application running
+ * automatic light sleep can stay asleep until the device moves. Otherwise
+ * the interrupt status is polled every CONFIG_MPU6886_WOM_POLL_MS.
+ *
+ * The accelerometer readings stay available at the low power rate, the
+ * gyroscope readings do not. The FIFO stream cannot run at the same time.
+ *
+ * **Example:**
+ *
+ * Pause while the device lies still.
+ * @code{c}
+ *  MPU6886_EnableMotionDetect(40, 20);
+ *  MPU6886_WaitForMotion(portMAX_DELAY);
+ *  MPU6886_DisableMotionDetect();
+ * @endcode
+ *
+ * @param[in] threshold_mg The change in acceleration that counts as motion,
+ * from 4 to 1020 mG, rounded to a multiple of 4 mG.
+ * @param[in] rate_hz The low power sample rate, from 4 to 500 Hz. The sensor
+ * divides 1 kHz by an integer, so rates that do not divide it are rounded up.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : The threshold or the rate is out of range
+ *  - ESP_ERR_INVALID_STATE : MPU6886_Init() failed or was not called, the detection is already armed or the stream is running
+ *  - ESP_ERR_NO_MEM        : The interrupt could not be set up
+ *  - ESP_FAIL              : The sensor could not be configured
+ */
+/* @[declare_mpu6886_enablemotiondetect] */
+esp_err_t MPU6886_EnableMotionDetect(uint16_t threshold_mg, uint16_t rate_hz);
+/* @[declare_mpu6886_enablemotiondetect] */
+
+/**
+ * @brief Disarms the wake-on-motion comparator.
+ *
+ * The sensor is returned to the configuration of MPU6886_Init(). The
+ * gyroscope takes a few tens of milliseconds to settle after its standby.
+ * A task waiting in MPU6886_WaitForMotion() returns ESP_ERR_INVALID_STATE.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The detection is not armed
+ *  - ESP_FAIL              : The sensor could not be configured
+ */
+/* @[declare_mpu6886_disablemotiondetect] */
+esp_err_t MPU6886_DisableMotionDetect(void);
+/* @[declare_mpu6886_disablemotiondetect] */
+
+/**
+ * @brief Waits until the wake-on-motion comparator detects motion.
+ *
+ * Motion latched since the previous call returns at once, so a wait of 0
+ * checks without blocking. Only one task should wait at a time.
+ *
+ * @param[in] wait The most ticks to wait, portMAX_DELAY to wait forever.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : The device moved
+ *  - ESP_ERR_TIMEOUT       : No motion before the wait ran out
+ *  - ESP_ERR_INVALID_STATE : The detection is not armed
+ */
+/* @[declare_mpu6886_waitformotion] */
+esp_err_t MPU6886_WaitForMotion(TickType_t wait);
+/* @[declare_mpu6886_waitformotion] */
@@ -0,0 +1,172 @@
+/*
+ * Host benchmark of the display flush path of the core2forAWS component.
+ *
+ * LVGL renders into two 32 line buffers like Core2ForAWS_Display_Init() sets
+ * up, and every area goes through disp_driver_flush(), ili9341.c and the
+ * queued transactions of disp_spi.c into the ILI9342C model. A copy of every
+ * rendered area is kept as the reference, and after each frame the panel
+ * memory must match it. Two busy screens are animated, a gauge whose needle
+ * moves like a clock hand and a column chart like the spectrum bars, first
+ * with the bytes taking their time on the 40 MHz bus and then without, which
+ * leaves the cost of rendering and of the driver. Exits with 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "axp192.h"
+#include "disp_spi.h"
+#include "disp_driver.h"
+
+#define FRAMES      100
+
+static lv_color_t buf1[DISP_BUF_SIZE];
+static lv_color_t buf2[DISP_BUF_SIZE];
+static lv_disp_buf_t disp_buf;
+static lv_color_t reference[SIM_LCD_HEIGHT][SIM_LCD_WIDTH];
+
+static void flush_cb(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    const lv_color_t * src = color_p;
+    for(lv_coord_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&reference[y][area->x1], src, lv_area_get_width(area) * sizeof(lv_color_t));
+        src += lv_area_get_width(area);
+    }
+    disp_driver_flush(drv, area, color_p);
+}
+
+/* Renders a frame and waits until its last area has been sent */
+static void refresh(void)
+{
+    lv_refr_now(NULL);
+    while(disp_buf.flushing) {
+        vTaskDelay(0);
+    }
+}
+
+static lv_obj_t * gauge;
+static lv_obj_t * chart;
+static lv_chart_series_t * series;
+
+static void gauge_step(int frame)
+{
+    lv_gauge_set_value(gauge, 0, frame % 60);
+}
+
+static void chart_step(int frame)
+{
+    (void) frame;
+    for(int i = 0; i < 32; i++) {
+        /*Bars move a little from frame to frame like a spectrum*/
+        lv_coord_t v = series->points[i] + rand() % 21 - 10;
+        series->points[i] = LV_MATH_MAX(0, LV_MATH_MIN(100, v));
+    }
+    lv_chart_refresh(chart);
+}
+
+static int run(const char * name, void (*step)(int frame), bool wire_time)
+{
+    sim_spi_stats_t stats;
+    int errors = 0;
+
+    sim_set_wire_time(wire_time);
+    sim_spi_reset_stats();
+    int64_t start = esp_timer_get_time();
+    for(int f = 0; f < FRAMES; f++) {
+        step(f);
+        refresh();
+        if(!errors && memcmp(sim_ili9342c_framebuffer(), reference, sizeof(reference))) {
+            printf("%s: frame %d differs from the rendered screen\n", name, f);
+            errors++;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    sim_spi_get_stats(&stats);
+    sim_set_wire_time(true);
+
+    printf("%-6s %-5s %6d %10.2f %10.1f %10.1f %10.2f\n", name, wire_time ? "wire" : "cpu", FRAMES,
+           elapsed / 1000.0 / FRAMES, (double) stats.transactions / FRAMES, stats.bytes / 1024.0 / FRAMES,
+           stats.wire_ns / 1e6 / FRAMES);
+    return errors;
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    sim_board_init();
+
+    /* The display part of Core2ForAWS_Init() */
+    Axp192_Init();
+    Axp192_SetGPIO4Mode(1);
+    spi_mutex = xSemaphoreCreateMutex();
+    spi_bus_config_t bus_cfg = {
+        .mosi_io_num = 23,
+        .miso_io_num = 38,
+        .sclk_io_num = 18,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = 320 * 32 * 3,
+    };
+    spi_bus_initialize(HSPI_HOST, &bus_cfg, 1);
+
+    lv_init();
+    disp_spi_add_device(HSPI_HOST);
+    disp_driver_init();
+
+    lv_disp_buf_init(&disp_buf, buf1, buf2, DISP_BUF_SIZE);
+    lv_disp_drv_t disp_drv;
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.flush_cb = flush_cb;
+    disp_drv.buffer = &disp_buf;
+    lv_disp_drv_register(&disp_drv);
+
+    sim_ili9342c_state_t state;
+    sim_ili9342c_get_state(&state);
+    if(state.resets != 1 || state.sleeping || !state.display_on || !state.inverted || state.madctl != 0x08 ||
+       state.colmod != 0x55) {
+        printf("the panel was not set up like ili9341_init() does\n");
+        errors++;
+    }
+
+    printf("%-6s %-5s %6s %10s %10s %10s %10s\n", "screen", "time", "frames", "ms/frame", "trans/f", "KiB/f",
+           "wire ms/f");
+
+    gauge = lv_gauge_create(lv_scr_act(), NULL);
+    lv_obj_set_size(gauge, 200, 200);
+    lv_obj_align(gauge, NULL, LV_ALIGN_CENTER, 0, 0);
+    refresh();
+    if(memcmp(sim_ili9342c_framebuffer(), reference, sizeof(reference))) {
+        printf("first frame differs from the rendered screen\n");
+        errors++;
+    }
+    errors += run("gauge", gauge_step, true);
+    errors += run("gauge", gauge_step, false);
+    lv_obj_del(gauge);
+
+    chart = lv_chart_create(lv_scr_act(), NULL);
+    lv_obj_set_size(chart, 300, 200);
+    lv_obj_align(chart, NULL, LV_ALIGN_CENTER, 0, 0);
+    lv_chart_set_type(chart, LV_CHART_TYPE_COLUMN);
+    lv_chart_set_point_count(chart, 32);
+    series = lv_chart_add_series(chart, LV_COLOR_RED);
+    lv_chart_init_points(chart, series, 50);
+    errors += run("chart", chart_step, true);
+    errors += run("chart", chart_step, false);
+
+    sim_ili9342c_get_state(&state);
+    if(state.overruns) {
+        printf("%u pixels were written past their window\n", state.overruns);
+        errors++;
+    }
+
+    if(errors) printf("FAILED\n");
+    return errors ? 1 : 0;
+}
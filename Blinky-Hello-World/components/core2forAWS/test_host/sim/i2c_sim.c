@@ -0,0 +1,312 @@
+/*
+ * Legacy I2C master driver of the simulated board.
+ *
+ * Command links are recorded as the driver would queue them and run by
+ * i2c_master_cmd_begin() against the device models attached to the port. A
+ * link stops at the first address nobody acknowledges and fails with ESP_FAIL,
+ * like the hardware does on a NACK.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "driver/i2c.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+typedef enum {
+    SIM_I2C_START,
+    SIM_I2C_WRITE,
+    SIM_I2C_READ,
+    SIM_I2C_STOP,
+} sim_i2c_op_type_t;
+
+typedef struct {
+    sim_i2c_op_type_t type;
+    uint8_t byte;               /* Single bytes are copied, like i2c_master_write_byte() does */
+    const uint8_t *data;
+    uint8_t *dest;
+    size_t length;
+} sim_i2c_op_t;
+
+typedef struct {
+    sim_i2c_op_t *ops;
+    size_t count;
+    size_t capacity;
+} sim_i2c_link_t;
+
+typedef struct {
+    bool configured;
+    bool installed;
+    uint32_t clk_speed;
+    sim_i2c_stats_t stats;
+} sim_i2c_port_t;
+
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_i2c_port_t ports[I2C_NUM_MAX];
+static sim_i2c_device_t *devices;
+
+void sim_i2c_lock(void) {
+    pthread_mutex_lock(&bus_lock);
+}
+
+void sim_i2c_unlock(void) {
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void sim_i2c_attach(sim_i2c_device_t *dev) {
+    sim_i2c_lock();
+    dev->next = devices;
+    devices = dev;
+    sim_i2c_unlock();
+}
+
+void sim_i2c_fail_next(sim_i2c_device_t *dev, uint32_t count) {
+    sim_i2c_lock();
+    dev->nack_next = count;
+    sim_i2c_unlock();
+}
+
+void sim_i2c_get_stats(i2c_port_t port, sim_i2c_stats_t *stats) {
+    sim_i2c_lock();
+    *stats = ports[port].stats;
+    sim_i2c_unlock();
+}
+
+void sim_i2c_reset_stats(void) {
+    sim_i2c_lock();
+    for (int i = 0; i < I2C_NUM_MAX; i++) {
+        memset(&ports[i].stats, 0, sizeof(ports[i].stats));
+    }
+    for (sim_i2c_device_t *dev = devices; dev; dev = dev->next) {
+        dev->reads = 0;
+        dev->writes = 0;
+        dev->bytes_read = 0;
+        dev->bytes_written = 0;
+    }
+    sim_i2c_unlock();
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || i2c_conf == NULL || i2c_conf->mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_lock();
+    ports[i2c_num].configured = true;
+    ports[i2c_num].clk_speed = i2c_conf->master.clk_speed;
+    sim_i2c_unlock();
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len,
+                             int intr_alloc_flags) {
+    (void) slv_rx_buf_len;
+    (void) slv_tx_buf_len;
+    (void) intr_alloc_flags;
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_lock();
+    esp_err_t err = ports[i2c_num].installed ? ESP_FAIL : ESP_OK;
+    ports[i2c_num].installed = true;
+    ports[i2c_num].stats.installs++;
+    sim_i2c_unlock();
+    return err;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_lock();
+    esp_err_t err = ports[i2c_num].installed ? ESP_OK : ESP_FAIL;
+    ports[i2c_num].installed = false;
+    sim_i2c_unlock();
+    return err;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void) {
+    return calloc(1, sizeof(sim_i2c_link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle) {
+    sim_i2c_link_t *link = cmd_handle;
+    if (link) {
+        free(link->ops);
+        free(link);
+    }
+}
+
+static esp_err_t sim_i2c_add(i2c_cmd_handle_t cmd_handle, const sim_i2c_op_t *op) {
+    sim_i2c_link_t *link = cmd_handle;
+    if (link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (link->count == link->capacity) {
+        size_t capacity = link->capacity ? link->capacity * 2 : 16;
+        sim_i2c_op_t *ops = realloc(link->ops, capacity * sizeof(*ops));
+        if (ops == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        link->ops = ops;
+        link->capacity = capacity;
+    }
+    link->ops[link->count++] = *op;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle) {
+    sim_i2c_op_t op = { .type = SIM_I2C_START };
+    return sim_i2c_add(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en) {
+    (void) ack_en;
+    sim_i2c_op_t op = { .type = SIM_I2C_WRITE, .byte = data, .length = 1 };
+    return sim_i2c_add(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en) {
+    (void) ack_en;
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_op_t op = { .type = SIM_I2C_WRITE, .data = data, .length = data_len };
+    return sim_i2c_add(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack) {
+    (void) ack;
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_op_t op = { .type = SIM_I2C_READ, .dest = data, .length = 1 };
+    return sim_i2c_add(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack) {
+    (void) ack;
+    if (data == NULL || data_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_i2c_op_t op = { .type = SIM_I2C_READ, .dest = data, .length = data_len };
+    return sim_i2c_add(cmd_handle, &op);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle) {
+    sim_i2c_op_t op = { .type = SIM_I2C_STOP };
+    return sim_i2c_add(cmd_handle, &op);
+}
+
+static sim_i2c_device_t *sim_i2c_find(i2c_port_t port, uint8_t addr) {
+    for (sim_i2c_device_t *dev = devices; dev; dev = dev->next) {
+        if (dev->port == port && dev->addr == addr) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait) {
+    (void) ticks_to_wait;
+    sim_i2c_link_t *link = cmd_handle;
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sim_i2c_lock();
+    sim_i2c_port_t *port = &ports[i2c_num];
+    if (!port->installed || !port->configured) {
+        sim_i2c_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_OK;
+    sim_i2c_device_t *dev = NULL;
+    bool expect_addr = false;
+    bool reading = false;
+    bool set_pointer = false;
+    /* START and STOP take about a bit each, every byte takes nine with its acknowledge */
+    uint64_t bits = 0;
+
+    port->stats.links++;
+    for (size_t i = 0; i < link->count && err == ESP_OK; i++) {
+        const sim_i2c_op_t *op = &link->ops[i];
+        switch (op->type) {
+            case SIM_I2C_START:
+                port->stats.starts++;
+                expect_addr = true;
+                bits++;
+                break;
+
+            case SIM_I2C_WRITE:
+                for (size_t n = 0; n < op->length && err == ESP_OK; n++) {
+                    uint8_t byte = op->data ? op->data[n] : op->byte;
+                    bits += 9;
+                    port->stats.bytes++;
+                    if (expect_addr) {
+                        expect_addr = false;
+                        dev = sim_i2c_find(i2c_num, byte >> 1);
+                        if (dev && dev->nack_next) {
+                            dev->nack_next--;
+                            dev = NULL;
+                        }
+                        if (dev == NULL) {
+                            port->stats.nacks++;
+                            err = ESP_FAIL;
+                            break;
+                        }
+                        reading = byte & I2C_MASTER_READ;
+                        set_pointer = !reading;
+                        if (reading) {
+                            dev->reads++;
+                        } else {
+                            dev->writes++;
+                        }
+                    } else if (dev == NULL || reading) {
+                        err = ESP_FAIL;
+                    } else if (set_pointer) {
+                        dev->pointer = byte;
+                        set_pointer = false;
+                    } else {
+                        uint8_t reg = dev->pointer++;
+                        dev->regs[reg] = byte;
+                        dev->bytes_written++;
+                        if (dev->on_write) {
+                            dev->on_write(dev, reg, byte);
+                        }
+                    }
+                }
+                break;
+
+            case SIM_I2C_READ:
+                if (dev == NULL || !reading) {
+                    err = ESP_FAIL;
+                    break;
+                }
+                for (size_t n = 0; n < op->length; n++) {
+                    uint8_t reg = dev->pointer++;
+                    if (dev->on_read) {
+                        dev->on_read(dev, reg);
+                    }
+                    op->dest[n] = dev->regs[reg];
+                }
+                dev->bytes_read += op->length;
+                port->stats.bytes += op->length;
+                bits += 9 * op->length;
+                break;
+
+            case SIM_I2C_STOP:
+                bits++;
+                dev = NULL;
+                break;
+        }
+    }
+
+    uint64_t wire_ns = port->clk_speed ? bits * 1000000000ULL / port->clk_speed : 0;
+    port->stats.wire_ns += wire_ns;
+    sim_i2c_unlock();
+
+    sim_wire_wait(wire_ns);
+    return err;
+}
@@ -0,0 +1,376 @@
+/*
+ * I2S driver of the simulated board.
+ *
+ * The DMA buffers are modelled by their timing only. Written samples play out
+ * at the sample rate, so i2s_write() blocks while the buffers hold more than
+ * dma_buf_count * dma_buf_len frames, and a write finding them drained counts
+ * an underrun. Received samples arrive at the sample rate from the moment the
+ * driver is installed, so i2s_read() blocks until enough have arrived, and
+ * frames not read before the buffers fill up are dropped. A stopped port
+ * pauses: nothing plays out of the transmit buffers, which writes can still
+ * fill up, and nothing arrives to be read. With sim_set_wire_time() off
+ * nothing waits and the stream is not timed.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2s.h"
+#include "esp32/rom/gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "esp_timer.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+typedef struct {
+    bool installed;
+    bool started;
+    i2s_config_t config;
+    uint32_t rate;
+    uint32_t frame_bytes;
+    /* Transmit: when the samples written so far have played */
+    int64_t tx_end_us;
+    bool tx_active;
+    /* While stopped: what was left to play */
+    int64_t tx_left_us;
+    /* Receive: when sampling started and how many frames were taken since */
+    int64_t rx_start_us;
+    uint64_t rx_frames;
+    int64_t rx_stop_us;
+    sim_i2s_sink_t sink;
+    void *sink_ctx;
+    sim_i2s_source_t source;
+    void *source_ctx;
+    sim_i2s_stats_t stats;
+} sim_i2s_port_t;
+
+static pthread_mutex_t i2s_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_i2s_port_t ports[I2S_NUM_MAX];
+
+static bool sim_i2s_valid(i2s_port_t i2s_num) {
+    return i2s_num >= I2S_NUM_0 && i2s_num < I2S_NUM_MAX;
+}
+
+static void sim_i2s_sleep_us(int64_t us) {
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static uint32_t sim_i2s_channels(i2s_channel_fmt_t format) {
+    return format == I2S_CHANNEL_FMT_RIGHT_LEFT ? 2 : 1;
+}
+
+/* Duration of the DMA buffers */
+static int64_t sim_i2s_buffer_us(const sim_i2s_port_t *port) {
+    return (int64_t) port->config.dma_buf_count * port->config.dma_buf_len * 1000000 / port->rate;
+}
+
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t *i2s_config, int queue_size, void *i2s_queue) {
+    (void) queue_size;
+    (void) i2s_queue;
+    if (!sim_i2s_valid(i2s_num) || i2s_config == NULL || i2s_config->sample_rate <= 0 ||
+        i2s_config->dma_buf_count < 2 || i2s_config->dma_buf_len < 8) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&i2s_lock);
+    sim_i2s_port_t *port = &ports[i2s_num];
+    esp_err_t err = ESP_OK;
+    if (port->installed) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        port->installed = true;
+        port->started = true;
+        port->config = *i2s_config;
+        port->rate = i2s_config->sample_rate;
+        port->frame_bytes = i2s_config->bits_per_sample / 8 * sim_i2s_channels(i2s_config->channel_format);
+        port->tx_end_us = esp_timer_get_time();
+        port->tx_active = false;
+        port->tx_left_us = 0;
+        port->rx_start_us = esp_timer_get_time();
+        port->rx_frames = 0;
+    }
+    pthread_mutex_unlock(&i2s_lock);
+    return err;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t i2s_num) {
+    if (!sim_i2s_valid(i2s_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&i2s_lock);
+    esp_err_t err = ports[i2s_num].installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    ports[i2s_num].installed = false;
+    ports[i2s_num].started = false;
+    pthread_mutex_unlock(&i2s_lock);
+    return err;
+}
+
+esp_err_t i2s_set_pin(i2s_port_t i2s_num, const i2s_pin_config_t *pin) {
+    if (!sim_i2s_valid(i2s_num) || pin == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!ports[i2s_num].installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (pin->bck_io_num >= 0) {
+        gpio_matrix_out(pin->bck_io_num, i2s_num == I2S_NUM_0 ? I2S0O_BCK_OUT_IDX : I2S1O_BCK_OUT_IDX, false, false);
+    }
+    if (pin->ws_io_num >= 0) {
+        gpio_matrix_out(pin->ws_io_num, i2s_num == I2S_NUM_0 ? I2S0O_WS_OUT_IDX : I2S1O_WS_OUT_IDX, false, false);
+    }
+    if (pin->data_out_num >= 0) {
+        gpio_matrix_out(pin->data_out_num, i2s_num == I2S_NUM_0 ? I2S0O_DATA_OUT23_IDX : I2S1O_DATA_OUT23_IDX,
+                        false, false);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_set_clk(i2s_port_t i2s_num, uint32_t rate, i2s_bits_per_sample_t bits, i2s_channel_t ch) {
+    if (!sim_i2s_valid(i2s_num) || rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&i2s_lock);
+    sim_i2s_port_t *port = &ports[i2s_num];
+    esp_err_t err = port->installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK) {
+        port->rate = rate;
+        port->config.bits_per_sample = bits;
+        port->frame_bytes = bits / 8 * ch;
+        port->tx_end_us = esp_timer_get_time();
+        port->tx_active = false;
+        port->rx_start_us = esp_timer_get_time();
+        port->rx_frames = 0;
+    }
+    pthread_mutex_unlock(&i2s_lock);
+    return err;
+}
+
+esp_err_t i2s_set_sample_rates(i2s_port_t i2s_num, uint32_t rate) {
+    if (!sim_i2s_valid(i2s_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return i2s_set_clk(i2s_num, rate, ports[i2s_num].config.bits_per_sample,
+                       (i2s_channel_t) sim_i2s_channels(ports[i2s_num].config.channel_format));
+}
+
+esp_err_t i2s_start(i2s_port_t i2s_num) {
+    if (!sim_i2s_valid(i2s_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&i2s_lock);
+    sim_i2s_port_t *port = &ports[i2s_num];
+    if (!port->started) {
+        /* The samples in the buffers play out from now on, and the stopped time brought none */
+        int64_t now = esp_timer_get_time();
+        port->started = true;
+        port->tx_end_us = now + port->tx_left_us;
+        port->rx_start_us += now - port->rx_stop_us;
+    }
+    pthread_mutex_unlock(&i2s_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_stop(i2s_port_t i2s_num) {
+    if (!sim_i2s_valid(i2s_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&i2s_lock);
+    sim_i2s_port_t *port = &ports[i2s_num];
+    if (port->started) {
+        int64_t now = esp_timer_get_time();
+        port->started = false;
+        port->tx_left_us = port->tx_end_us > now ? port->tx_end_us - now : 0;
+        port->rx_stop_us = now;
+    }
+    pthread_mutex_unlock(&i2s_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_zero_dma_buffer(i2s_port_t i2s_num) {
+    if (!sim_i2s_valid(i2s_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&i2s_lock);
+    ports[i2s_num].tx_end_us = esp_timer_get_time();
+    ports[i2s_num].tx_active = false;
+    ports[i2s_num].tx_left_us = 0;
+    pthread_mutex_unlock(&i2s_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_write(i2s_port_t i2s_num, const void *src, size_t size, size_t *bytes_written, TickType_t ticks_to_wait) {
+    if (!sim_i2s_valid(i2s_num) || src == NULL || bytes_written == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *bytes_written = 0;
+
+    pthread_mutex_lock(&i2s_lock);
+    sim_i2s_port_t *port = &ports[i2s_num];
+    if (!port->installed || !(port->config.mode & I2S_MODE_TX)) {
+        pthread_mutex_unlock(&i2s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint8_t *data = src;
+    size_t chunk_max = (size_t) port->config.dma_buf_len * port->frame_bytes;
+    int64_t give_up_us = ticks_to_wait == portMAX_DELAY ? INT64_MAX :
+                         esp_timer_get_time() + (int64_t) ticks_to_wait * portTICK_PERIOD_MS * 1000;
+
+    while (size) {
+        size_t chunk = size < chunk_max ? size : chunk_max;
+        int64_t chunk_us = (int64_t) (chunk / port->frame_bytes) * 1000000 / port->rate;
+
+        if (sim_wire_time() && !port->started) {
+            /* Paused, the buffers only fill up */
+            while (!port->started && port->tx_left_us + chunk_us > sim_i2s_buffer_us(port) &&
+                   esp_timer_get_time() < give_up_us) {
+                pthread_mutex_unlock(&i2s_lock);
+                sim_i2s_sleep_us(1000);
+                pthread_mutex_lock(&i2s_lock);
+            }
+            if (!port->started) {
+                if (port->tx_left_us + chunk_us > sim_i2s_buffer_us(port)) {
+                    break;
+                }
+                port->tx_left_us += chunk_us;
+                port->tx_active = true;
+            }
+        }
+        if (sim_wire_time() && port->started) {
+            int64_t now = esp_timer_get_time();
+            if (port->tx_end_us < now) {
+                if (port->tx_active && port->started) {
+                    port->stats.tx_underruns++;
+                }
+                port->tx_end_us = now;
+            }
+            /* A DMA buffer frees up as the oldest one finishes playing */
+            int64_t free_at = port->tx_end_us + chunk_us - sim_i2s_buffer_us(port);
+            if (free_at > now) {
+                if (free_at > give_up_us) {
+                    break;
+                }
+                pthread_mutex_unlock(&i2s_lock);
+                sim_i2s_sleep_us(free_at - now);
+                pthread_mutex_lock(&i2s_lock);
+            }
+            port->tx_end_us += chunk_us;
+            port->tx_active = true;
+        }
+
+        if (port->sink) {
+            port->sink(i2s_num, data, chunk, port->sink_ctx);
+        }
+        port->stats.bytes_written += chunk;
+        *bytes_written += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    pthread_mutex_unlock(&i2s_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_read(i2s_port_t i2s_num, void *dest, size_t size, size_t *bytes_read, TickType_t ticks_to_wait) {
+    if (!sim_i2s_valid(i2s_num) || dest == NULL || bytes_read == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *bytes_read = 0;
+
+    pthread_mutex_lock(&i2s_lock);
+    sim_i2s_port_t *port = &ports[i2s_num];
+    if (!port->installed || !(port->config.mode & I2S_MODE_RX)) {
+        pthread_mutex_unlock(&i2s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint64_t frames = size / port->frame_bytes;
+    if (sim_wire_time()) {
+        int64_t give_up_us = ticks_to_wait == portMAX_DELAY ? INT64_MAX :
+                             esp_timer_get_time() + (int64_t) ticks_to_wait * portTICK_PERIOD_MS * 1000;
+        /* Nothing arrives while stopped */
+        while (!port->started) {
+            if (esp_timer_get_time() >= give_up_us) {
+                pthread_mutex_unlock(&i2s_lock);
+                return ESP_ERR_TIMEOUT;
+            }
+            pthread_mutex_unlock(&i2s_lock);
+            sim_i2s_sleep_us(1000);
+            pthread_mutex_lock(&i2s_lock);
+        }
+        int64_t now = esp_timer_get_time();
+        uint64_t arrived = (uint64_t) (now - port->rx_start_us) * port->rate / 1000000;
+        uint64_t capacity = (uint64_t) port->config.dma_buf_count * port->config.dma_buf_len;
+        if (arrived > port->rx_frames + capacity) {
+            port->stats.rx_overruns++;
+            port->rx_frames = arrived - capacity;
+        }
+        int64_t ready_us = port->rx_start_us + (int64_t) ((port->rx_frames + frames) * 1000000 / port->rate);
+        if (ready_us > now) {
+            int64_t wait_us = ready_us - now;
+            if (ready_us > give_up_us) {
+                pthread_mutex_unlock(&i2s_lock);
+                return ESP_ERR_TIMEOUT;
+            }
+            pthread_mutex_unlock(&i2s_lock);
+            sim_i2s_sleep_us(wait_us);
+            pthread_mutex_lock(&i2s_lock);
+        }
+    }
+    port->rx_frames += frames;
+
+    if (port->source) {
+        port->source(i2s_num, dest, size, port->source_ctx);
+    } else {
+        memset(dest, 0, size);
+    }
+    port->stats.bytes_read += size;
+    *bytes_read = size;
+    pthread_mutex_unlock(&i2s_lock);
+    return ESP_OK;
+}
+
+void sim_i2s_set_sink(i2s_port_t port, sim_i2s_sink_t sink, void *ctx) {
+    pthread_mutex_lock(&i2s_lock);
+    ports[port].sink = sink;
+    ports[port].sink_ctx = ctx;
+    pthread_mutex_unlock(&i2s_lock);
+}
+
+void sim_i2s_set_source(i2s_port_t port, sim_i2s_source_t source, void *ctx) {
+    pthread_mutex_lock(&i2s_lock);
+    ports[port].source = source;
+    ports[port].source_ctx = ctx;
+    pthread_mutex_unlock(&i2s_lock);
+}
+
+void sim_i2s_get_stats(i2s_port_t port, sim_i2s_stats_t *stats) {
+    pthread_mutex_lock(&i2s_lock);
+    *stats = ports[port].stats;
+    pthread_mutex_unlock(&i2s_lock);
+}
+
+void sim_i2s_tone_source(i2s_port_t port, void *data, size_t size, void *ctx) {
+    sim_i2s_tone_t *tone = ctx;
+    int16_t *samples = data;
+    /* Called with the I2S lock taken */
+    double step = 2 * M_PI * tone->freq_hz / ports[port].rate;
+    uint32_t channels = ports[port].frame_bytes / sizeof(int16_t);
+
+    for (size_t i = 0; i + channels <= size / sizeof(int16_t); i += channels) {
+        int16_t value = (int16_t) lrint(tone->amplitude * sin(tone->phase));
+        for (uint32_t c = 0; c < channels; c++) {
+            samples[i + c] = value;
+        }
+        tone->phase += step;
+        if (tone->phase > 2 * M_PI) {
+            tone->phase -= 2 * M_PI;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * BM8563 real time clock model.
+ *
+ * The time registers count with the host clock from the time last written.
+ * A burst read latches them when it starts, like the chip does.
+ */
+
+#define _GNU_SOURCE
+#include <time.h>
+
+#include "esp_timer.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define BM8563_SECONDS_REG      0x02
+#define BM8563_YEARS_REG        0x08
+
+sim_i2c_device_t sim_bm8563 = {
+    .name = "BM8563",
+    .port = I2C_NUM_1,
+    .addr = 0x51,
+};
+
+static time_t base_time;
+static int64_t base_us;
+static int last_read = -1;
+
+static uint8_t sim_bm8563_bcd(int value) {
+    return ((value / 10) << 4) | (value % 10);
+}
+
+static int sim_bm8563_bin(uint8_t bcd) {
+    return (bcd >> 4) * 10 + (bcd & 0x0f);
+}
+
+static void sim_bm8563_latch(void) {
+    time_t now = base_time + (esp_timer_get_time() - base_us) / 1000000;
+    struct tm tm;
+    gmtime_r(&now, &tm);
+
+    uint8_t *regs = sim_bm8563.regs;
+    regs[0x02] = sim_bm8563_bcd(tm.tm_sec);
+    regs[0x03] = sim_bm8563_bcd(tm.tm_min);
+    regs[0x04] = sim_bm8563_bcd(tm.tm_hour);
+    regs[0x05] = sim_bm8563_bcd(tm.tm_mday);
+    regs[0x06] = tm.tm_wday;
+    regs[0x07] = sim_bm8563_bcd(tm.tm_mon + 1) | (tm.tm_year < 100 ? 0x80 : 0x00);
+    regs[0x08] = sim_bm8563_bcd(tm.tm_year % 100);
+}
+
+static void sim_bm8563_read(sim_i2c_device_t *dev, uint8_t reg) {
+    (void) dev;
+    if (reg >= BM8563_SECONDS_REG && reg <= BM8563_YEARS_REG &&
+        (reg == BM8563_SECONDS_REG || reg != last_read + 1)) {
+        sim_bm8563_latch();
+    }
+    last_read = reg;
+}
+
+static void sim_bm8563_write(sim_i2c_device_t *dev, uint8_t reg, uint8_t value) {
+    (void) value;
+    last_read = -1;
+    if (reg < BM8563_SECONDS_REG || reg > BM8563_YEARS_REG) {
+        return;
+    }
+    /* Every byte of a burst restarts the clock, the last one sets it */
+    const uint8_t *regs = dev->regs;
+    struct tm tm = {
+        .tm_sec = sim_bm8563_bin(regs[0x02] & 0x7f),
+        .tm_min = sim_bm8563_bin(regs[0x03] & 0x7f),
+        .tm_hour = sim_bm8563_bin(regs[0x04] & 0x3f),
+        .tm_mday = sim_bm8563_bin(regs[0x05] & 0x3f),
+        .tm_mon = sim_bm8563_bin(regs[0x07] & 0x1f) - 1,
+        .tm_year = sim_bm8563_bin(regs[0x08]) + (regs[0x07] & 0x80 ? 0 : 100),
+    };
+    base_time = timegm(&tm);
+    base_us = esp_timer_get_time();
+}
+
+void sim_bm8563_init(void) {
+    base_time = time(NULL);
+    base_us = esp_timer_get_time();
+    sim_bm8563.on_read = sim_bm8563_read;
+    sim_bm8563.on_write = sim_bm8563_write;
+    sim_bm8563_latch();
+    sim_i2c_attach(&sim_bm8563);
+}
@@ -0,0 +1,44 @@
+/*
+ * FT6336U touch controller model.
+ *
+ * A report sets TD_STATUS and the point registers, then pulses the interrupt
+ * line like the controller does in trigger mode.
+ */
+
+#include "sim.h"
+#include "sim_internal.h"
+
+#define FT6336U_INTR_PIN        GPIO_NUM_39
+#define FT6336U_REG_TD_STATUS   0x02
+#define FT6336U_REG_P1_XH       0x03
+#define FT6336U_POINT_REGS      6
+#define FT6336U_EVENT_CONTACT   2
+
+sim_i2c_device_t sim_ft6336u = {
+    .name = "FT6336U",
+    .port = I2C_NUM_1,
+    .addr = 0x38,
+};
+
+void sim_ft6336u_report(uint8_t count, const sim_touch_point_t *points) {
+    sim_i2c_lock();
+    uint8_t *regs = sim_ft6336u.regs;
+    regs[FT6336U_REG_TD_STATUS] = count;
+    for (uint8_t i = 0; i < count && i < 2; i++) {
+        uint8_t *p = &regs[FT6336U_REG_P1_XH + i * FT6336U_POINT_REGS];
+        p[0] = (FT6336U_EVENT_CONTACT << 6) | ((points[i].x >> 8) & 0x0f);
+        p[1] = points[i].x & 0xff;
+        p[2] = (points[i].id << 4) | ((points[i].y >> 8) & 0x0f);
+        p[3] = points[i].y & 0xff;
+    }
+    sim_i2c_unlock();
+
+    sim_gpio_drive(FT6336U_INTR_PIN, 0);
+    sim_gpio_drive(FT6336U_INTR_PIN, 1);
+}
+
+void sim_ft6336u_init(void) {
+    sim_ft6336u.regs[0xa3] = 0x64;      /* Chip ID */
+    sim_ft6336u.regs[0xa8] = 0x11;      /* Vendor ID */
+    sim_i2c_attach(&sim_ft6336u);
+}
@@ -0,0 +1,299 @@
+/**
+ * @file sim.h
+ * @brief A simulated Core2 for AWS for host builds of the core2forAWS drivers.
+ *
+ * The ESP-IDF drivers the component uses (GPIO, legacy I2C master, SPI master,
+ * RMT and I2S) are replaced by the stubs/ headers and the sim/ sources, and
+ * FreeRTOS runs on POSIX threads. The component sources are compiled unchanged
+ * against them. The peripherals end in register level models of the devices on
+ * the board:
+ *  - I2C: a register file per device with an auto-incrementing register
+ *    pointer, and hooks to refresh live registers before they are read and to
+ *    act on writes. The AXP192, MPU6886, BM8563 and FT6336U are modelled.
+ *  - SPI: the ILI9342C decodes commands, window addresses and memory writes
+ *    into a framebuffer, with D/C taken from the GPIO the driver sets.
+ *  - RMT: the items written are decoded back into the bytes an SK6812 chain latches.
+ *  - I2S: writes go to a sink and reads come from a source, paced by the sample clock.
+ *  - NVS: blobs are kept in memory for the life of the program.
+ *
+ * Transfers take the time they would on the wire unless that is turned off
+ * with sim_set_wire_time(), so the timing of the drivers stays realistic while
+ * their CPU cost can still be measured on its own.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+#include "driver/rmt.h"
+#include "driver/i2s.h"
+
+/**
+ * @brief Attaches the device models to their buses and pins as on the Core2 for AWS.
+ *
+ * I2C port 1: AXP192 (0x34), BM8563 (0x51), MPU6886 (0x68), FT6336U (0x38,
+ * interrupt on GPIO 39). SPI: ILI9342C (CS GPIO 5, D/C GPIO 15, reset on AXP192 GPIO 4).
+ */
+void sim_board_init(void);
+
+/**
+ * @brief Makes transfers wait for the time they take on the wire, on by default.
+ */
+void sim_set_wire_time(bool enable);
+bool sim_wire_time(void);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* GPIO */
+
+/**
+ * @brief Drives an input pin from outside, running the ISR handler on a matching edge.
+ *
+ * The calling thread stands in for the interrupt.
+ */
+void sim_gpio_drive(gpio_num_t pin, int level);
+
+/**
+ * @brief The level the firmware set on an output pin.
+ */
+int sim_gpio_output(gpio_num_t pin);
+
+/**
+ * @brief The peripheral signal routed to an output pin, SIG_GPIO_OUT_IDX for the GPIO itself.
+ */
+uint32_t sim_gpio_signal(gpio_num_t pin);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* I2C */
+
+typedef struct sim_i2c_device sim_i2c_device_t;
+
+/**
+ * @brief An I2C device model.
+ *
+ * The first byte written after the address sets the register pointer, further
+ * bytes are written to the registers and reads return them, both moving the
+ * pointer on. The hooks are called with the bus lock taken.
+ */
+struct sim_i2c_device {
+    const char *name;
+    i2c_port_t port;
+    uint8_t addr;
+    uint8_t regs[256];
+    uint8_t pointer;
+    /** Called before a register is read, to update a live value. */
+    void (*on_read)(sim_i2c_device_t *dev, uint8_t reg);
+    /** Called after a register was written. */
+    void (*on_write)(sim_i2c_device_t *dev, uint8_t reg, uint8_t value);
+    void *ctx;
+
+    /* Kept by the bus */
+    uint32_t nack_next;         /**< The next transactions addressing the device are not acknowledged. */
+    uint32_t reads;             /**< Read transactions. */
+    uint32_t writes;            /**< Write transactions, register pointer updates included. */
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    sim_i2c_device_t *next;
+};
+
+/**
+ * @brief Bus statistics of one port.
+ */
+typedef struct {
+    uint32_t links;             /**< i2c_master_cmd_begin() calls. */
+    uint32_t starts;            /**< START and repeated START conditions. */
+    uint32_t nacks;             /**< Addresses nobody acknowledged. */
+    uint32_t installs;          /**< i2c_driver_install() calls, bus reconfigurations. */
+    uint64_t bytes;             /**< Bytes on the wire, addresses included. */
+    uint64_t wire_ns;           /**< Time on the wire at the configured clock. */
+} sim_i2c_stats_t;
+
+void sim_i2c_attach(sim_i2c_device_t *dev);
+
+/**
+ * @brief Fails the next transactions addressing the device with a NACK.
+ */
+void sim_i2c_fail_next(sim_i2c_device_t *dev, uint32_t count);
+
+void sim_i2c_get_stats(i2c_port_t port, sim_i2c_stats_t *stats);
+void sim_i2c_reset_stats(void);
+
+/**
+ * @brief Takes the bus lock, to change the registers of a model between transactions.
+ */
+void sim_i2c_lock(void);
+void sim_i2c_unlock(void);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* SPI */
+
+/**
+ * @brief Receives the bytes of the transactions sent to a device, with the level of its D/C line.
+ */
+typedef void (*sim_spi_sink_t)(const uint8_t *data, size_t length, void *ctx);
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t queued;            /**< Transactions through spi_device_queue_trans(). */
+    uint64_t bytes;
+    uint64_t wire_ns;
+} sim_spi_stats_t;
+
+void sim_spi_attach(int cs_pin, sim_spi_sink_t sink, void *ctx);
+void sim_spi_get_stats(sim_spi_stats_t *stats);
+void sim_spi_reset_stats(void);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* RMT */
+
+/**
+ * @brief Copies the bytes decoded from the last rmt_write_sample() on the channel.
+ *
+ * @return The number of bytes of the frame, which may be more than max.
+ */
+size_t sim_rmt_get_frame(rmt_channel_t channel, uint8_t *bytes, size_t max);
+
+/**
+ * @brief Number of frames written to the channel.
+ */
+uint32_t sim_rmt_frames(rmt_channel_t channel);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* I2S */
+
+typedef void (*sim_i2s_sink_t)(i2s_port_t port, const void *data, size_t size, void *ctx);
+typedef void (*sim_i2s_source_t)(i2s_port_t port, void *data, size_t size, void *ctx);
+
+typedef struct {
+    uint64_t bytes_written;
+    uint64_t bytes_read;
+    uint32_t tx_underruns;      /**< The DMA ran out of samples to send while started. */
+    uint32_t rx_overruns;       /**< Received samples were dropped because nobody read them in time. */
+} sim_i2s_stats_t;
+
+/**
+ * @brief A sine source for sim_i2s_set_source(), 16 bit samples on every channel.
+ */
+typedef struct {
+    float freq_hz;
+    int16_t amplitude;
+    /* Kept by the source */
+    double phase;
+} sim_i2s_tone_t;
+
+void sim_i2s_tone_source(i2s_port_t port, void *data, size_t size, void *ctx);
+
+/**
+ * @brief Sets where written samples go, nowhere by default.
+ */
+void sim_i2s_set_sink(i2s_port_t port, sim_i2s_sink_t sink, void *ctx);
+
+/**
+ * @brief Sets where read samples come from, silence by default.
+ */
+void sim_i2s_set_source(i2s_port_t port, sim_i2s_source_t source, void *ctx);
+
+void sim_i2s_get_stats(i2s_port_t port, sim_i2s_stats_t *stats);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* AXP192 */
+
+extern sim_i2c_device_t sim_axp192;
+
+/**
+ * @brief Sets a 12 or 13 bit ADC result, reg is the register of the high bits.
+ */
+void sim_axp192_set_adc(uint8_t reg, uint16_t value, uint8_t bits);
+
+/**
+ * @brief Called when GPIO 4 of the AXP192 changes, the reset line of the LCD on the Core2.
+ */
+void sim_axp192_on_gpio4(void (*callback)(int level));
+
+/* ---------------------------------------------------------------------------------------------- */
+/* MPU6886 */
+
+extern sim_i2c_device_t sim_mpu6886;
+
+/**
+ * @brief Motion of the synthetic IMU source.
+ *
+ * The device starts level with gravity along +Z and turns at a constant rate,
+ * the accelerometer sees gravity in the turning frame plus a shake along Z.
+ */
+typedef struct {
+    float rate_dps[3];          /**< Angular rate around X, Y and Z. */
+    float gyro_bias_dps[3];     /**< Added to the gyroscope readings. */
+    float shake_g;              /**< Amplitude of a sine acceleration along Z. */
+    float shake_hz;
+    float noise;                /**< Uniform noise on every axis, in g and dps. */
+} sim_imu_motion_t;
+
+/**
+ * @brief Starts the synthetic source with the motion, time zero being now.
+ */
+void sim_mpu6886_set_motion(const sim_imu_motion_t *motion);
+
+/**
+ * @brief The orientation of the synthetic source at a time from esp_timer_get_time(),
+ * as the quaternion w, x, y, z rotating device coordinates into the world.
+ */
+void sim_mpu6886_get_orientation(int64_t time_us, float q[4]);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* BM8563 */
+
+extern sim_i2c_device_t sim_bm8563;
+
+/* ---------------------------------------------------------------------------------------------- */
+/* FT6336U */
+
+extern sim_i2c_device_t sim_ft6336u;
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint8_t id;
+} sim_touch_point_t;
+
+/**
+ * @brief Reports touch points and pulses the interrupt line, no points is a release.
+ */
+void sim_ft6336u_report(uint8_t count, const sim_touch_point_t *points);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* ILI9342C */
+
+#define SIM_LCD_WIDTH   320
+#define SIM_LCD_HEIGHT  240
+
+typedef struct {
+    uint32_t resets;            /**< Hardware resets through the AXP192. */
+    uint32_t commands;
+    uint32_t windows;           /**< Memory writes started. */
+    uint64_t pixels;            /**< Pixels written. */
+    uint32_t overruns;          /**< Pixels past the end of the window, dropped. */
+    bool sleeping;
+    bool display_on;
+    bool inverted;
+    uint8_t madctl;
+    uint8_t colmod;
+} sim_ili9342c_state_t;
+
+/**
+ * @brief The panel memory, SIM_LCD_HEIGHT rows of SIM_LCD_WIDTH RGB565 pixels
+ * in the byte order they were sent.
+ */
+const uint8_t *sim_ili9342c_framebuffer(void);
+void sim_ili9342c_get_state(sim_ili9342c_state_t *state);
+
+/* ---------------------------------------------------------------------------------------------- */
+/* NVS */
+
+/**
+ * @brief Erases every stored key, like a freshly erased flash.
+ */
+void sim_nvs_erase_all(void);
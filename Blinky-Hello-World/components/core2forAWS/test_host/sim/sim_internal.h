@@ -0,0 +1,18 @@
+/* Shared between the sim/ sources, not for the tests */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Sleeps for the time a transfer takes on the wire, when sim_set_wire_time() is on */
+void sim_wire_wait(uint64_t ns);
+
+/* SPI sink of the ILI9342C model, and its hardware reset */
+void sim_ili9342c_receive(const uint8_t *data, size_t length, void *ctx);
+void sim_ili9342c_reset(int level);
+
+void sim_axp192_init(void);
+void sim_mpu6886_init(void);
+void sim_bm8563_init(void);
+void sim_ft6336u_init(void);
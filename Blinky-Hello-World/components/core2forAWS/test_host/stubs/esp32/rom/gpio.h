@@ -0,0 +1,9 @@
+/* Host stand-in for the GPIO matrix functions of the ESP32 ROM, implemented in sim/gpio_sim.c */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Routes the peripheral output signal_idx (see soc/gpio_sig_map.h) to the pin */
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, bool out_inv, bool oen_inv);
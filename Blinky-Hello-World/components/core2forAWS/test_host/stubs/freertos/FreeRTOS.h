@@ -0,0 +1,46 @@
+/* Host stand-in for FreeRTOS, implemented on POSIX threads in sim/freertos_sim.c.
+ * A tick is one millisecond. Task priorities and core affinity are ignored, and
+ * critical sections take one process wide lock like disabling interrupts on both cores. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "esp_err.h"
+#include "esp_attr.h"
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef int portMUX_TYPE;
+
+#define configTICK_RATE_HZ              1000
+#define portTICK_PERIOD_MS              (1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS                portTICK_PERIOD_MS
+#define portMAX_DELAY                   ((TickType_t) 0xffffffffUL)
+#define pdMS_TO_TICKS(ms)               ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          pdTRUE
+#define pdFAIL                          pdFALSE
+#define errQUEUE_EMPTY                  0
+#define errQUEUE_FULL                   0
+
+#define configASSERT(x)                 assert(x)
+
+void sim_enter_critical(void);
+void sim_exit_critical(void);
+void sim_yield(void);
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void) (mux), sim_enter_critical())
+#define portEXIT_CRITICAL(mux)          ((void) (mux), sim_exit_critical())
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portYIELD()                     sim_yield()
+#define portYIELD_FROM_ISR()            sim_yield()
@@ -246,6 +246,10 @@ lv_task_t * lv_task_create(lv_task_cb_t task_xcb, uint32_t period, lv_task_prio_
 
     task_created = true;
 
+#ifdef LV_TASK_HANDLER_NOTIFY
+    if(prio != LV_TASK_PRIO_OFF) LV_TASK_HANDLER_NOTIFY();
+#endif
+
     return new_task;
 }
 
@@ -298,6 +302,10 @@ void lv_task_set_prio(lv_task_t * task, lv_task_prio_t prio)
     task_list_changed = true;
 
     task->prio = prio;
+
+#ifdef LV_TASK_HANDLER_NOTIFY
+    if(prio != LV_TASK_PRIO_OFF) LV_TASK_HANDLER_NOTIFY();
+#endif
 }
 
 /**
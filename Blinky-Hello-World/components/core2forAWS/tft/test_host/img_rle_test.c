@@ -0,0 +1,203 @@
+/*
+ * Host test for the run-length encoded image decoder (img_rle.c).
+ *
+ * The Getting-Started images are opened once as the original C arrays
+ * with LVGL's built-in decoder and once as encoded by tools/img_rle.py.
+ * Whole decoded images and lines read at arbitrary offsets must match
+ * the built-in decoder byte for byte. Indexed images are compared with
+ * the LV_IMG_CF_TRUE_COLOR_ALPHA lines the built-in decoder expands them to.
+ * Images the encoding would make larger are left unencoded, and must come out
+ * no larger than the original.
+ *
+ * Encoded images closed and opened again must come back from the decoder's
+ * cache without being decoded again.
+ *
+ * Then the first draw, which decodes the image, a cold draw (open, read
+ * every line, close), as without lv_img_cache, and a warm draw (read every
+ * line of an open image), as with lv_img_cache, are timed. On the host the original arrays are plain RAM, so this does not
+ * show the flash cache misses they cost on the device. Exits with 1 on any
+ * mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lvgl/lvgl.h"
+#include "img_rle.h"
+
+#define ITERATIONS  200
+
+#define IMAGES(X) X(house_on) X(house_off) X(fan_spinning) X(fan_off) X(thermometer)
+
+#define DECLARE(name) extern const lv_img_dsc_t name; extern const lv_img_dsc_t orig_##name;
+IMAGES(DECLARE)
+
+typedef struct {
+    const char * name;
+    const lv_img_dsc_t * orig;
+    const lv_img_dsc_t * rle;
+} image_t;
+
+#define ENTRY(name) { #name, &orig_##name, &name },
+static const image_t images[] = { IMAGES(ENTRY) };
+
+static uint8_t line_ref[LV_HOR_RES_MAX * 4];
+static uint8_t line_rle[LV_HOR_RES_MAX * 4];
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void read_line(lv_img_decoder_dsc_t * dsc, lv_coord_t x, lv_coord_t y, lv_coord_t len, uint8_t * buf)
+{
+    uint8_t px_size = lv_img_cf_get_px_size(dsc->header.cf) >> 3;
+    if(dsc->img_data) memcpy(buf, dsc->img_data + (y * dsc->header.w + x) * px_size, len * px_size);
+    else lv_img_decoder_read_line(dsc, x, y, len, buf);
+}
+
+static int check(const image_t * img)
+{
+    lv_img_decoder_dsc_t ref, rle;
+    lv_img_decoder_open(&ref, img->orig, LV_COLOR_BLACK);
+    lv_img_decoder_open(&rle, img->rle, LV_COLOR_BLACK);
+
+    int errors = 0;
+    bool encoded = img->rle->header.cf == LV_IMG_CF_USER_ENCODED_0;
+    bool indexed = ref.header.cf >= LV_IMG_CF_INDEXED_1BIT && ref.header.cf <= LV_IMG_CF_INDEXED_8BIT;
+    if(img->rle->data_size > img->orig->data_size) {
+        printf("%s: encoded larger than the original\n", img->name);
+        errors++;
+    }
+    if((indexed && encoded ? LV_IMG_CF_TRUE_COLOR_ALPHA : ref.header.cf) != rle.header.cf ||
+       ref.header.w != rle.header.w || ref.header.h != rle.header.h) {
+        printf("%s: header mismatch\n", img->name);
+        errors++;
+    }
+
+    uint8_t px_size = lv_img_cf_get_px_size(indexed ? LV_IMG_CF_TRUE_COLOR_ALPHA : rle.header.cf) >> 3;
+    lv_coord_t w = ref.header.w;
+    for(lv_coord_t y = 0; y < ref.header.h && !errors; y++) {
+        /*The whole line, then a few partial ones starting inside the packets*/
+        for(int i = 0; i < 8; i++) {
+            lv_coord_t x = i ? rand() % w : 0;
+            lv_coord_t len = i ? 1 + rand() % (w - x) : w;
+            read_line(&ref, x, y, len, line_ref);
+            if(rle.img_data) read_line(&rle, x, y, len, line_rle);
+            else lv_img_decoder_read_line(&rle, x, y, len, line_rle);
+            if(memcmp(line_ref, line_rle, len * px_size)) {
+                printf("%s: line %d x %d len %d differs\n", img->name, y, x, len);
+                errors++;
+                break;
+            }
+            /*Also the line by line path when the open decoded the whole image*/
+            if(rle.img_data) {
+                lv_img_decoder_read_line(&rle, x, y, len, line_rle);
+                if(memcmp(line_ref, line_rle, len * px_size)) {
+                    printf("%s: read_line %d x %d len %d differs\n", img->name, y, x, len);
+                    errors++;
+                    break;
+                }
+            }
+        }
+    }
+
+    lv_img_decoder_close(&ref);
+    lv_img_decoder_close(&rle);
+    return errors;
+}
+
+static double time_warm_draw(const lv_img_dsc_t * src)
+{
+    lv_img_decoder_dsc_t dsc;
+    lv_img_decoder_open(&dsc, src, LV_COLOR_BLACK);
+
+    double start = now_us();
+    for(int i = 0; i < ITERATIONS; i++) {
+        for(lv_coord_t y = 0; y < dsc.header.h; y++) {
+            read_line(&dsc, 0, y, dsc.header.w, line_ref);
+        }
+    }
+    double us = (now_us() - start) / ITERATIONS;
+
+    lv_img_decoder_close(&dsc);
+    return us;
+}
+
+static int check_cache(const image_t * img)
+{
+    lv_img_decoder_dsc_t a, b;
+    int errors = 0;
+
+    lv_img_decoder_open(&a, img->rle, LV_COLOR_BLACK);
+    lv_img_decoder_open(&b, img->rle, LV_COLOR_BLACK);
+    const uint8_t * pixels = a.img_data;
+    if(b.img_data != pixels) {
+        printf("%s: opened twice, decoded twice\n", img->name);
+        errors++;
+    }
+    lv_img_decoder_close(&a);
+    lv_img_decoder_close(&b);
+
+    lv_img_decoder_open(&a, img->rle, LV_COLOR_BLACK);
+    if(a.img_data != pixels) {
+        printf("%s: decoded again after closing\n", img->name);
+        errors++;
+    }
+    lv_img_decoder_close(&a);
+    return errors;
+}
+
+static double time_first_draw(const lv_img_dsc_t * src)
+{
+    double start = now_us();
+    lv_img_decoder_dsc_t dsc;
+    lv_img_decoder_open(&dsc, src, LV_COLOR_BLACK);
+    for(lv_coord_t y = 0; y < dsc.header.h; y++) {
+        read_line(&dsc, 0, y, dsc.header.w, line_ref);
+    }
+    lv_img_decoder_close(&dsc);
+    return now_us() - start;
+}
+
+static double time_cold_draw(const lv_img_dsc_t * src)
+{
+    double start = now_us();
+    for(int i = 0; i < ITERATIONS; i++) {
+        lv_img_decoder_dsc_t dsc;
+        lv_img_decoder_open(&dsc, src, LV_COLOR_BLACK);
+        for(lv_coord_t y = 0; y < dsc.header.h; y++) {
+            read_line(&dsc, 0, y, dsc.header.w, line_ref);
+        }
+        lv_img_decoder_close(&dsc);
+    }
+    return (now_us() - start) / ITERATIONS;
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    _lv_mem_init();
+    _lv_img_decoder_init();
+    ImgRle_Init();
+
+    printf("%-14s %8s %8s %14s %14s %14s %14s %14s\n", "image", "flash B", "rle B", "first rle",
+           "cold built-in", "cold rle", "warm built-in", "warm rle");
+    for(size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+        const image_t * img = &images[i];
+        double first = time_first_draw(img->rle);
+        errors += check(img);
+        if(img->rle->header.cf == LV_IMG_CF_USER_ENCODED_0) errors += check_cache(img);
+        printf("%-14s %8u %8u %11.1f us %11.1f us %11.1f us %11.1f us %11.1f us\n", img->name,
+               img->orig->data_size, img->rle->data_size, first, time_cold_draw(img->orig),
+               time_cold_draw(img->rle), time_warm_draw(img->orig), time_warm_draw(img->rle));
+    }
+
+    if(errors) printf("FAILED\n");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Host test for the LVGL pool allocator (lvgl_pool.c).
+ *
+ * First random sized blocks are allocated and freed directly, every block
+ * is filled with a pattern which must still be intact when it is freed.
+ * Then LVGL, built with LV_MEM_CUSTOM routed to the pool, rebuilds a screen
+ * with a tab view and lists over and over as the Factory-Firmware does when
+ * switching pages. After each rebuild is deleted the arena must be back to
+ * where it started. Exits with 1 on any error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl_pool.h"
+
+#define BLOCKS      2000
+#define ROUNDS      100000
+#define REBUILDS    200
+
+static lv_color_t buf[LV_HOR_RES_MAX * 20];
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void flush_cb(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    (void) area;
+    (void) color_p;
+    lv_disp_flush_ready(drv);
+}
+
+static int random_blocks(void)
+{
+    static uint8_t * ptr[BLOCKS];
+    static uint16_t size[BLOCKS];
+    int errors = 0;
+
+    double start = now_us();
+    for(int r = 0; r < ROUNDS; r++) {
+        int i = rand() % BLOCKS;
+        if(ptr[i]) {
+            for(int j = 0; j < size[i]; j++) {
+                if(ptr[i][j] != (uint8_t) i) {
+                    errors++;
+                    break;
+                }
+            }
+            LvglPool_Free(ptr[i]);
+            ptr[i] = NULL;
+        } else {
+            /*Mostly small blocks as LVGL allocates them, some larger ones*/
+            size[i] = rand() % 8 ? 1 + rand() % LVGL_POOL_MAX_BLOCK : 1 + rand() % 2048;
+            ptr[i] = LvglPool_Alloc(size[i]);
+            if(ptr[i] == NULL) errors++;
+            else memset(ptr[i], (uint8_t) i, size[i]);
+        }
+    }
+    double elapsed = now_us() - start;
+
+    for(int i = 0; i < BLOCKS; i++) LvglPool_Free(ptr[i]);
+
+    lvgl_pool_stats_t stats;
+    LvglPool_GetStats(&stats);
+    if(stats.internal_used || stats.overflow_used || stats.overflow_count) {
+        printf("random blocks: %u B internal, %u B in %u overflow allocations left over\n",
+               stats.internal_used, stats.overflow_used, stats.overflow_count);
+        errors++;
+    }
+    printf("random blocks: %d alloc/free in %.0f us, %.3f us each\n", ROUNDS, elapsed, elapsed / ROUNDS);
+    return errors;
+}
+
+static void build_screen(lv_obj_t * scr)
+{
+    lv_obj_t * tabview = lv_tabview_create(scr, NULL);
+    for(int t = 0; t < 4; t++) {
+        char name[16];
+        snprintf(name, sizeof(name), "Page %d", t);
+        lv_obj_t * tab = lv_tabview_add_tab(tabview, name);
+        lv_obj_t * list = lv_list_create(tab, NULL);
+        for(int i = 0; i < 12; i++) {
+            snprintf(name, sizeof(name), "Item %d", i);
+            lv_list_add_btn(list, LV_SYMBOL_WIFI, name);
+        }
+        lv_obj_t * label = lv_label_create(tab, NULL);
+        lv_label_set_text_fmt(label, "Tab %d with a label long enough to be wrapped", t);
+    }
+}
+
+static int rebuild_screens(void)
+{
+    int errors = 0;
+    lv_obj_t * scr = lv_scr_act();
+    lv_refr_now(NULL);
+
+    lvgl_pool_stats_t base;
+    LvglPool_GetStats(&base);
+
+    double start = now_us();
+    for(int r = 0; r < REBUILDS; r++) {
+        build_screen(scr);
+        lv_refr_now(NULL);
+        lv_obj_clean(scr);
+        lv_refr_now(NULL);
+
+        lvgl_pool_stats_t stats;
+        LvglPool_GetStats(&stats);
+        if(stats.internal_used != base.internal_used || stats.overflow_used != base.overflow_used) {
+            printf("rebuild %d: %u B internal, %u B overflow, expected %u B and %u B\n", r,
+                   stats.internal_used, stats.overflow_used, base.internal_used, base.overflow_used);
+            errors++;
+            break;
+        }
+    }
+    double elapsed = now_us() - start;
+
+    lvgl_pool_stats_t stats;
+    LvglPool_GetStats(&stats);
+    if(stats.failed != base.failed || stats.arena_full != base.arena_full) {
+        printf("rebuilds: %u failed allocations, %u overflowed a full arena\n", stats.failed - base.failed,
+               stats.arena_full - base.arena_full);
+        errors++;
+    }
+
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    printf("rebuilds: %d in %.0f us, lv_mem_monitor %u%% used, %u%% fragmented\n", REBUILDS, elapsed,
+           mon.used_pct, mon.frag_pct);
+    return errors;
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    errors += random_blocks();
+
+    lv_init();
+    lv_disp_buf_t disp_buf;
+    lv_disp_buf_init(&disp_buf, buf, NULL, LV_HOR_RES_MAX * 20);
+    lv_disp_drv_t disp_drv;
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.flush_cb = flush_cb;
+    disp_drv.buffer = &disp_buf;
+    lv_disp_drv_register(&disp_drv);
+
+    errors += rebuild_screens();
+
+    LvglPool_Dump();
+
+    if(errors) printf("FAILED\n");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * Host benchmark for the LVGL blending code.
+ *
+ * Every scene is rendered with the generic loops (ref_lv_blend_*) and with
+ * the RGB565 kernels (_lv_blend_*) into a 320 x 32 line draw buffer, the
+ * same shape the Core2 for AWS display driver uses. The results must be
+ * identical, then each version is timed. Exits with 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lv_draw/lv_draw_blend.h"
+#include "lv_hal/lv_hal_disp.h"
+
+#define BUF_W           320
+#define BUF_H           32
+#define IMG_W           100
+#define IMG_H           BUF_H
+#define ITERATIONS      2000
+#define MASK_FRAMES     16      /*Different masks per frame, so branch predictors can't learn them*/
+
+void ref_lv_blend_fill(const lv_area_t * clip_area, const lv_area_t * fill_area, lv_color_t color,
+                       lv_opa_t * mask, lv_draw_mask_res_t mask_res, lv_opa_t opa, lv_blend_mode_t mode);
+void ref_lv_blend_map(const lv_area_t * clip_area, const lv_area_t * map_area, const lv_color_t * map_buf,
+                      lv_opa_t * mask, lv_draw_mask_res_t mask_res, lv_opa_t opa, lv_blend_mode_t mode);
+
+typedef struct {
+    void (*fill)(const lv_area_t *, const lv_area_t *, lv_color_t, lv_opa_t *, lv_draw_mask_res_t, lv_opa_t,
+                 lv_blend_mode_t);
+    void (*map)(const lv_area_t *, const lv_area_t *, const lv_color_t *, lv_opa_t *, lv_draw_mask_res_t, lv_opa_t,
+                lv_blend_mode_t);
+} blend_impl_t;
+
+static const blend_impl_t ref_impl = { ref_lv_blend_fill, ref_lv_blend_map };
+static const blend_impl_t rgb565_impl = { _lv_blend_fill, _lv_blend_map };
+
+static lv_disp_t disp;
+static lv_disp_buf_t disp_buf;
+static lv_color_t draw_buf[BUF_W * BUF_H];
+static lv_color_t start_buf[BUF_W * BUF_H];
+static lv_color_t ref_result[BUF_W * BUF_H];
+static lv_color_t img[IMG_W * IMG_H];
+static lv_opa_t aa_masks[MASK_FRAMES][BUF_H][BUF_W];
+static lv_opa_t glyph_masks[MASK_FRAMES][BUF_H][BUF_W];
+static int frame;
+
+#define aa_mask     aa_masks[frame % MASK_FRAMES]
+#define glyph_mask  glyph_masks[frame % MASK_FRAMES]
+
+/* Stubs for the display the blending functions draw to */
+lv_disp_t * _lv_refr_get_disp_refreshing(void)
+{
+    return &disp;
+}
+
+lv_disp_buf_t * lv_disp_get_buf(lv_disp_t * d)
+{
+    return d->driver.buffer;
+}
+
+static void area_set(lv_area_t * a, lv_coord_t x1, lv_coord_t y1, lv_coord_t x2, lv_coord_t y2)
+{
+    a->x1 = x1;
+    a->y1 = y1;
+    a->x2 = x2;
+    a->y2 = y2;
+}
+
+/* Rectangles */
+
+static void scene_rect_opa(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    area_set(&a, 10, 0, 300, BUF_H - 1);
+    impl->fill(&clip, &a, LV_COLOR_MAKE(0x20, 0x80, 0xE0), NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_50, LV_BLEND_MODE_NORMAL);
+    area_set(&a, 41, 4, 200, 20);
+    impl->fill(&clip, &a, LV_COLOR_MAKE(0xFF, 0x40, 0x10), NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_30, LV_BLEND_MODE_NORMAL);
+}
+
+/* Rounded rectangle edges: one masked line at a time, as lv_draw_rect() does */
+static void scene_rect_rounded(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    for(lv_coord_t y = 0; y < BUF_H; y++) {
+        area_set(&a, 3, y, BUF_W - 4, y);
+        impl->fill(&clip, &a, LV_COLOR_MAKE(0x30, 0xC0, 0x60), aa_mask[y], LV_DRAW_MASK_RES_CHANGED, LV_OPA_COVER,
+                   LV_BLEND_MODE_NORMAL);
+    }
+}
+
+/* Text: glyph masks with full and partial coverage */
+static void scene_text(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    for(lv_coord_t y = 0; y < BUF_H; y++) {
+        area_set(&a, 1, y, BUF_W - 2, y);
+        impl->fill(&clip, &a, LV_COLOR_WHITE, glyph_mask[y], LV_DRAW_MASK_RES_CHANGED, LV_OPA_COVER, LV_BLEND_MODE_NORMAL);
+    }
+}
+
+static void scene_text_opa(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    for(lv_coord_t y = 0; y < BUF_H; y++) {
+        area_set(&a, 1, y, BUF_W - 2, y);
+        impl->fill(&clip, &a, LV_COLOR_YELLOW, glyph_mask[y], LV_DRAW_MASK_RES_CHANGED, LV_OPA_70, LV_BLEND_MODE_NORMAL);
+    }
+}
+
+/* Gradients: one fill per line with a changing color */
+static void scene_gradient(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    for(lv_coord_t y = 0; y < BUF_H; y++) {
+        area_set(&a, 0, y, BUF_W - 1, y);
+        lv_color_t c = LV_COLOR_MAKE(y * 8, 0x40, (0xFF - y * 8));
+        impl->fill(&clip, &a, c, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_COVER, LV_BLEND_MODE_NORMAL);
+    }
+}
+
+static void scene_gradient_opa(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    for(lv_coord_t y = 0; y < BUF_H; y++) {
+        area_set(&a, 0, y, BUF_W - 1, y);
+        lv_color_t c = LV_COLOR_MAKE(y * 8, 0x40, (0xFF - y * 8));
+        impl->fill(&clip, &a, c, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_60, LV_BLEND_MODE_NORMAL);
+    }
+}
+
+/* Images: aligned and odd positions */
+
+static void scene_img_copy(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    area_set(&a, 0, 0, IMG_W - 1, IMG_H - 1);
+    impl->map(&clip, &a, img, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_COVER, LV_BLEND_MODE_NORMAL);
+    area_set(&a, 101, 0, 101 + IMG_W - 1, IMG_H - 1);
+    impl->map(&clip, &a, img, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_COVER, LV_BLEND_MODE_NORMAL);
+    /*Clipped on the left so the source starts on an odd pixel too*/
+    area_set(&clip, 205, 0, BUF_W - 1, BUF_H - 1);
+    area_set(&a, 200, 0, 200 + IMG_W - 1, IMG_H - 1);
+    impl->map(&clip, &a, img, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_COVER, LV_BLEND_MODE_NORMAL);
+}
+
+static void scene_img_opa(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    area_set(&clip, 0, 0, BUF_W - 1, BUF_H - 1);
+    area_set(&a, 0, 0, IMG_W - 1, IMG_H - 1);
+    impl->map(&clip, &a, img, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_40, LV_BLEND_MODE_NORMAL);
+    area_set(&a, 103, 0, 103 + IMG_W - 1, IMG_H - 1);
+    impl->map(&clip, &a, img, NULL, LV_DRAW_MASK_RES_FULL_COVER, LV_OPA_80, LV_BLEND_MODE_NORMAL);
+}
+
+static void scene_img_mask(const blend_impl_t * impl)
+{
+    lv_area_t clip, a;
+    for(lv_coord_t y = 0; y < IMG_H; y++) {
+        area_set(&clip, 0, y, BUF_W - 1, y);
+        area_set(&a, 7, 0, 7 + IMG_W - 1, IMG_H - 1);
+        impl->map(&clip, &a, img, aa_mask[y], LV_DRAW_MASK_RES_CHANGED, LV_OPA_COVER, LV_BLEND_MODE_NORMAL);
+        area_set(&a, 150, 0, 150 + IMG_W - 1, IMG_H - 1);
+        impl->map(&clip, &a, img, aa_mask[y], LV_DRAW_MASK_RES_CHANGED, LV_OPA_60, LV_BLEND_MODE_NORMAL);
+    }
+}
+
+typedef struct {
+    const char * name;
+    void (*render)(const blend_impl_t * impl);
+} scene_t;
+
+static const scene_t scenes[] = {
+    { "rect_opa", scene_rect_opa },
+    { "rect_rounded", scene_rect_rounded },
+    { "text", scene_text },
+    { "text_opa", scene_text_opa },
+    { "gradient", scene_gradient },
+    { "gradient_opa", scene_gradient_opa },
+    { "img_copy", scene_img_copy },
+    { "img_opa", scene_img_opa },
+    { "img_mask", scene_img_mask },
+};
+
+static void init_data(void)
+{
+    srand(1);
+
+    /*A background with a few flat regions, like a real screen*/
+    for(int i = 0; i < BUF_W * BUF_H; i++) {
+        start_buf[i] = (i % BUF_W) < BUF_W / 2 ? LV_COLOR_MAKE(0x10, 0x10, 0x30) : LV_COLOR_MAKE(rand(), rand(), rand());
+    }
+    for(int i = 0; i < IMG_W * IMG_H; i++) {
+        img[i] = LV_COLOR_MAKE(rand(), rand(), rand());
+    }
+
+    for(frame = 0; frame < MASK_FRAMES; frame++) {
+        for(int y = 0; y < BUF_H; y++) {
+            for(int x = 0; x < BUF_W; x++) {
+                /*Covered in the middle, anti-aliased edges*/
+                int edge = x < 16 ? x : (BUF_W - 1 - x < 16 ? BUF_W - 1 - x : 16);
+                aa_mask[y][x] = edge >= 16 ? LV_OPA_COVER : (lv_opa_t)(edge * 16 + rand() % 16);
+
+                /*Glyph strokes: mostly transparent or covered, some partial values*/
+                int r = rand() % 8;
+                glyph_mask[y][x] = r < 4 ? LV_OPA_TRANSP : (r < 6 ? LV_OPA_COVER : (lv_opa_t)rand());
+            }
+        }
+    }
+    frame = 0;
+
+    disp_buf.buf_act = draw_buf;
+    area_set(&disp_buf.area, 0, 0, BUF_W - 1, BUF_H - 1);
+    disp.driver.buffer = &disp_buf;
+    disp.driver.antialiasing = 1;
+}
+
+static double time_scene(const scene_t * scene, const blend_impl_t * impl)
+{
+    struct timespec start, end;
+
+    memcpy(draw_buf, start_buf, sizeof(draw_buf));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(frame = 0; frame < ITERATIONS; frame++) {
+        scene->render(impl);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    frame = 0;
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    return ns / ITERATIONS / 1000.0;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    init_data();
+
+    printf("%-14s %10s %10s %8s\n", "scene", "generic us", "rgb565 us", "speedup");
+    for(size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+        const scene_t * scene = &scenes[i];
+
+        memcpy(draw_buf, start_buf, sizeof(draw_buf));
+        scene->render(&ref_impl);
+        memcpy(ref_result, draw_buf, sizeof(draw_buf));
+
+        memcpy(draw_buf, start_buf, sizeof(draw_buf));
+        scene->render(&rgb565_impl);
+        if(memcmp(ref_result, draw_buf, sizeof(draw_buf)) != 0) {
+            printf("%-14s MISMATCH\n", scene->name);
+            failed = 1;
+            continue;
+        }
+
+        double ref_us = time_scene(scene, &ref_impl);
+        double rgb565_us = time_scene(scene, &rgb565_impl);
+        printf("%-14s %10.2f %10.2f %7.2fx\n", scene->name, ref_us, rgb565_us, ref_us / rgb565_us);
+    }
+
+    return failed;
+}
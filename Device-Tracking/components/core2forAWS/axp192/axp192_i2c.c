@@ -1,12 +1,78 @@
 #include "stdint.h"
+#include "stdbool.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "i2c_device.h"
 #include "esp_err.h"
+#include "axp192.h"
 
 #define AXP192_ADDR (0x34)
 
 static I2CDevice_t axp192_device;
+static SemaphoreHandle_t axp192_lock;
+
+#if CONFIG_AXP192_REG_CACHE
+static uint8_t reg_cache[256];
+static uint32_t reg_cache_valid[256 / 32];
+static axp192_cache_stats_t cache_stats;
+
+/* Control registers only the firmware changes, everything else (power and
+ * charge status, IRQ status, ADC results, coulomb counter, GPIO input
+ * levels) is read live */
+static bool Axp192_RegCacheable(uint8_t reg_addr) {
+    switch (reg_addr) {
+        case 0x10:  /* EXTEN and DC-DC2 control */
+        case AXP192_LDO23_DC123_EXT_CTL_REG:
+        case AXP192_DC2_VOLT_REG:
+        case 0x25:  /* DC-DC2 ramp */
+        case AXP192_DC1_VOLT_REG:
+        case AXP192_DC3_VOLT_REG:
+        case AXP192_LDO23_VOLT_REG:
+        case AXP192_VBUS_IPSOUT_CTL_REG:
+        case AXP192_VOFF_VOLT_REG:
+        case AXP192_POWEROFF_REG:
+        case AXP192_CHG_CTL1_REG:
+        case AXP192_CHG_CTL2_REG:
+        case AXP192_SPARE_CHG_CTL_REG:
+        case AXP192_PEK_CTL_REG:
+        case 0x80:  /* DC-DC mode */
+        case AXP192_ADC1_ENABLE_REG:
+        case 0x83:  /* ADC enable 2 */
+        case 0x84:  /* ADC sample rate */
+        case AXP192_GPIO0_CTL_REG:
+        case AXP192_GPIO0_VOLT_REG:
+        case AXP192_GPIO1_CTL_REG:
+        case AXP192_GPIO2_CTL_REG:
+        case AXP192_GPIO34_CTL_REG:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool Axp192_RegCached(uint8_t reg_addr, uint8_t *value) {
+    if (reg_cache_valid[reg_addr / 32] & (1UL << (reg_addr % 32))) {
+        *value = reg_cache[reg_addr];
+        return true;
+    }
+    return false;
+}
+
+static void Axp192_RegCacheSet(uint8_t reg_addr, uint8_t value) {
+    if (Axp192_RegCacheable(reg_addr)) {
+        reg_cache[reg_addr] = value;
+        reg_cache_valid[reg_addr / 32] |= 1UL << (reg_addr % 32);
+    }
+}
+
+static void Axp192_RegCacheDrop(uint8_t reg_addr) {
+    reg_cache_valid[reg_addr / 32] &= ~(1UL << (reg_addr % 32));
+}
+#endif
 
 void Axp192_I2CInit() {
+    axp192_lock = xSemaphoreCreateMutex();
     axp192_device = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, AXP192_ADDR);
 }
 
@@ -18,8 +84,48 @@ bool Axp192_ReadBytes(uint8_t reg_addr, uint8_t *data, uint16_t length) {
     return i2c_read_bytes(axp192_device, reg_addr, data, length) == ESP_OK;
 }
 
-void Axp192_Write8Bit(uint8_t reg_addr, uint8_t value) {
+/* Writes a register through the cache, called with axp192_lock taken */
+static void Axp192_WriteReg(uint8_t reg_addr, uint8_t value) {
+#if CONFIG_AXP192_REG_CACHE
+    uint8_t cached;
+    if (Axp192_RegCached(reg_addr, &cached) && cached == value) {
+        cache_stats.writes_skipped++;
+        return;
+    }
+    if (Axp192_WriteBytes(reg_addr, &value, 1)) {
+        Axp192_RegCacheSet(reg_addr, value);
+    } else {
+        /* The register may or may not have been written */
+        Axp192_RegCacheDrop(reg_addr);
+    }
+    cache_stats.bus_writes++;
+#else
     Axp192_WriteBytes(reg_addr, &value, 1);
+#endif
+}
+
+/* Reads a register, from the cache if it is a control register, called with axp192_lock taken */
+static bool Axp192_ReadReg(uint8_t reg_addr, uint8_t *value) {
+#if CONFIG_AXP192_REG_CACHE
+    if (Axp192_RegCached(reg_addr, value)) {
+        cache_stats.reads_cached++;
+        return true;
+    }
+    cache_stats.bus_reads++;
+    if (Axp192_ReadBytes(reg_addr, value, 1) == false) {
+        return false;
+    }
+    Axp192_RegCacheSet(reg_addr, *value);
+    return true;
+#else
+    return Axp192_ReadBytes(reg_addr, value, 1);
+#endif
+}
+
+void Axp192_Write8Bit(uint8_t reg_addr, uint8_t value) {
+    xSemaphoreTake(axp192_lock, portMAX_DELAY);
+    Axp192_WriteReg(reg_addr, value);
+    xSemaphoreGive(axp192_lock);
 }
 
 void Axp192_WriteBits(uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t bit_length) {
@@ -27,8 +133,11 @@ void Axp192_WriteBits(uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t b
         return ;
     }
 
+    /* The lock makes the read-modify-write atomic against other tasks */
+    xSemaphoreTake(axp192_lock, portMAX_DELAY);
     uint8_t value = 0x00;
-    if (Axp192_ReadBytes(reg_addr, &value, 1) == false) {
+    if (Axp192_ReadReg(reg_addr, &value) == false) {
+        xSemaphoreGive(axp192_lock);
         return ;
     }
 
@@ -36,15 +145,38 @@ void Axp192_WriteBits(uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t b
     data &= (1 << bit_length) - 1;
     value |= data << bit_pos;
 
-    Axp192_WriteBytes(reg_addr, &value, 1);
+    Axp192_WriteReg(reg_addr, value);
+    xSemaphoreGive(axp192_lock);
 }
 
 uint8_t Axp192_Read8Bit(uint8_t reg_addr) {
     uint8_t value = 0x00;
-    Axp192_ReadBytes(reg_addr, &value, 1);
+    xSemaphoreTake(axp192_lock, portMAX_DELAY);
+    Axp192_ReadReg(reg_addr, &value);
+    xSemaphoreGive(axp192_lock);
     return value;
 }
 
+void Axp192_InvalidateRegCache() {
+#if CONFIG_AXP192_REG_CACHE
+    xSemaphoreTake(axp192_lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < sizeof(reg_cache_valid) / sizeof(reg_cache_valid[0]); i++) {
+        reg_cache_valid[i] = 0;
+    }
+    xSemaphoreGive(axp192_lock);
+#endif
+}
+
+void Axp192_GetRegCacheStats(axp192_cache_stats_t *stats) {
+#if CONFIG_AXP192_REG_CACHE
+    xSemaphoreTake(axp192_lock, portMAX_DELAY);
+    *stats = cache_stats;
+    xSemaphoreGive(axp192_lock);
+#else
+    *stats = (axp192_cache_stats_t) { 0 };
+#endif
+}
+
 uint16_t Axp192_Read12Bit(uint8_t reg_addr) {
     uint8_t buf[2];
     if (Axp192_ReadBytes(reg_addr, buf, 2)) {
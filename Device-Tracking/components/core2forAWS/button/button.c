@@ -1,18 +1,62 @@
+#include <stdlib.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "esp_log.h"
 
 #include "ft6336u.h"
 #include "button.h"
 
+#define TAG "BUTTON"
+
+/* Buttons are bucketed in cells of the touch area, the panel reaches below the 240 px display */
+#define BUTTON_GRID_CELL_PX 40
+#define BUTTON_GRID_COLS    (320 / BUTTON_GRID_CELL_PX)
+#define BUTTON_GRID_ROWS    (320 / BUTTON_GRID_CELL_PX)
+
+typedef struct {
+    Button_t** buttons;
+    uint16_t count;
+} button_cell_t;
+
 Button_t* button_ahead = NULL;
 static SemaphoreHandle_t button_lock = NULL;
+static TaskHandle_t button_task_handle = NULL;
+static button_cell_t button_grid[BUTTON_GRID_ROWS][BUTTON_GRID_COLS];
 static void Button_UpdateTask(void *arg);
 
+static void Button_TouchCallback(void) {
+    xTaskNotifyGive(button_task_handle);
+}
+
 void Button_Init() {
     button_lock = xSemaphoreCreateMutex();
-    xTaskCreatePinnedToCore(Button_UpdateTask, "Button", 2 * 1024, NULL, 1, NULL, 0);
+    xTaskCreatePinnedToCore(Button_UpdateTask, "Button", 2 * 1024, NULL, 1, &button_task_handle, 0);
+    FT6336U_AddTouchCallback(Button_TouchCallback);
+}
+
+static uint8_t Button_GridIndex(uint32_t px, uint8_t cells) {
+    uint32_t index = px / BUTTON_GRID_CELL_PX;
+    return index < cells ? index : cells - 1;
+}
+
+/* Adds the button to every cell its touch area overlaps */
+static void Button_GridInsert(Button_t* button) {
+    for (uint8_t row = Button_GridIndex(button->y, BUTTON_GRID_ROWS); row <= Button_GridIndex(button->y + button->h, BUTTON_GRID_ROWS); row++) {
+        for (uint8_t col = Button_GridIndex(button->x, BUTTON_GRID_COLS); col <= Button_GridIndex(button->x + button->w, BUTTON_GRID_COLS); col++) {
+            button_cell_t* cell = &button_grid[row][col];
+            Button_t** buttons = (Button_t **)realloc(cell->buttons, (cell->count + 1) * sizeof(Button_t *));
+            if (buttons == NULL) {
+                ESP_LOGE(TAG, "No memory to index the button at %u, %u", button->x, button->y);
+                continue;
+            }
+            buttons[cell->count] = button;
+            cell->buttons = buttons;
+            cell->count++;
+        }
+    }
 }
 
 Button_t* Button_Attach(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
@@ -22,6 +66,7 @@ Button_t* Button_Attach(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
     button->y = y;
     button->w = w;
     button->h = h;
+    button->value = 0;
     button->last_value = 0;
     button->last_press_time = 0;
     button->long_press_time = 0;
@@ -36,6 +81,7 @@ Button_t* Button_Attach(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
         }
         button_last->next = button;
     }
+    Button_GridInsert(button);
     xSemaphoreGive(button_lock);
     return button;
 }
@@ -79,9 +125,8 @@ uint8_t Button_IsRelease(Button_t* button) {
     return result;
 }
 
-void Button_Update(Button_t* button, uint8_t press, uint16_t x, uint16_t y) {
+static void Button_Update(Button_t* button, uint8_t press, uint16_t x, uint16_t y, uint32_t now_ticks) {
     uint8_t value = press & !((x < button->x) || (x > (button->x + button->w)) || (y < button->y) || (y > (button->y + button->h)));
-    uint32_t now_ticks = xTaskGetTickCount();
     if (value != button->last_value) {
         if (value == 1) {
             button->state |= PRESS;
@@ -99,20 +144,37 @@ void Button_Update(Button_t* button, uint8_t press, uint16_t x, uint16_t y) {
     button->value = value;
 }
 
+static void Button_UpdateCell(const button_cell_t* cell, uint8_t press, uint16_t x, uint16_t y, uint32_t now_ticks) {
+    for (uint16_t i = 0; i < cell->count; i++) {
+        Button_Update(cell->buttons[i], press, x, y, now_ticks);
+    }
+}
+
 static void Button_UpdateTask(void *arg) {
-    Button_t* button;
-    uint16_t x, y;
-    bool press;
+    uint32_t cursor = 0;
+    ft6336u_touch_t touch;
+    /* Only buttons of the previously touched cell can be pressed and need to be released */
+    const button_cell_t* last_cell = NULL;
 
     for (;;) {
-        FT6336U_GetTouch(&x, &y, &press);
+        /* The touch callback wakes the task for new samples, it does not run while the panel is idle */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
         xSemaphoreTake(button_lock, portMAX_DELAY);
-        button = button_ahead;
-        while (button != NULL) {
-            Button_Update(button, press, x, y);
-            button = button->next;
+        /* Every buffered sample is applied, so a tap shorter than a touch read still presses and releases */
+        while (FT6336U_ReadTouch(&cursor, &touch)) {
+            uint8_t press = touch.count > 0;
+            uint16_t x = touch.points[0].x;
+            uint16_t y = touch.points[0].y;
+            uint32_t now_ticks = pdMS_TO_TICKS(touch.time_us / 1000);
+            const button_cell_t* cell = &button_grid[Button_GridIndex(y, BUTTON_GRID_ROWS)][Button_GridIndex(x, BUTTON_GRID_COLS)];
+
+            if (last_cell != NULL && last_cell != cell) {
+                Button_UpdateCell(last_cell, press, x, y, now_ticks);
+            }
+            Button_UpdateCell(cell, press, x, y, now_ticks);
+            last_cell = cell;
         }
         xSemaphoreGive(button_lock);
-        vTaskDelay(pdMS_TO_TICKS(20));
     }
-}
\ No newline at end of file
+}
@@ -43,6 +43,11 @@ typedef struct _Button_t  {
 /**
  * @brief Initializes the virtual buttons using the FT6336U touch controller.
  * 
+ * The button task is woken by the touch controller for each new touch
+ * sample and sleeps while the screen is not touched. Buttons are indexed in
+ * a grid of 40 px cells, so a touch sample is only tested against the
+ * buttons of the cell it lands in and of the cell touched before.
+ * 
  * @note The Core2ForAWS_Init() calls this function
  * when the hardware feature is enabled.
  */
@@ -5,6 +5,7 @@
 
 #pragma once
 #include "axp192.h"
+#include "i2c_trace.h"
 #include "freertos/FreeRTOS.h"
 
 #if CONFIG_SOFTWARE_ILI9342C_SUPPORT || CONFIG_SOFTWARE_SDCARD_SUPPORT
@@ -12,6 +13,11 @@
 #include "lvgl/lvgl.h"
 #include "disp_driver.h"
 #include "disp_spi.h"
+#include "ui_update.h"
+#include "disp_profiler.h"
+#include "img_rle.h"
+#include "lvgl_pool.h"
+#include "disp_diff.h"
 
 /**
  * @brief FreeRTOS semaphore to be used when performing any
@@ -24,6 +30,10 @@
  * The FreeRTOS task, guiTask(), will write to the ILI9342C display
  * controller to update the display.
  *
+ * Tasks that only change a label text, a bar or arc value, a color or
+ * the visibility of a widget can use the UIUpdate_* functions from
+ * ui_update.h instead, which never wait for this semaphore.
+ *
  * **Example:**
  *
  * Create a LVGL label widget, set the text of the label to "Hello World!", and
@@ -71,6 +81,7 @@ extern SemaphoreHandle_t xGuiSemaphore;
 
 #if CONFIG_SOFTWARE_MPU6886_SUPPORT
 #include "mpu6886.h"
+#include "mpu6886_fusion.h"
 #endif
 
 #if CONFIG_SOFTWARE_RTC_SUPPORT
@@ -88,6 +99,7 @@ extern SemaphoreHandle_t xGuiSemaphore;
 
 #if CONFIG_SOFTWARE_MIC_SUPPORT
 #include "microphone.h"
+#include "microphone_vad.h"
 #endif
 
 #if CONFIG_SOFTWARE_SPEAKER_SUPPORT
@@ -358,10 +370,9 @@ void Core2ForAWS_Button_Init(void);
 /**
  * @brief Enables or disables the NS4168 speaker amplifier.
  *
- * @note The speaker cannot be enabled at the same time
- * as the microphone since they both share a common pin (GPIO0).
- * Attempting to enable and use both at the same time will
- * cause the device to hard fault.
+ * @note The speaker shares a common pin (GPIO0) with the microphone,
+ * Speaker_WriteBuff() takes it from the microphone for the time of the
+ * write. See i2s_manager.h.
  *
  * @param[in] state Desired state of the speaker.
  * 1 to enable, 0 to disable.
@@ -468,6 +479,46 @@ void Core2ForAWS_Display_Init(void);
 /* @[declare_core2foraws_display_setbrightness] */
 void Core2ForAWS_Display_SetBrightness(uint8_t brightness);
 /* @[declare_core2foraws_display_setbrightness] */
+
+/**
+ * @brief Wakes the `gui` task so it runs the LVGL task handler.
+ *
+ * Only has an effect when the event-driven GUI task is enabled in
+ * menuconfig (CONFIG_LV_GUI_TASK_EVENT_DRIVEN). In that mode the
+ * `gui` task sleeps until the next LVGL task is due. Invalidating an
+ * object, creating an LVGL task and touching the screen already wake
+ * it up, so this is only needed for work LVGL can't see, like changes
+ * to a canvas buffer made without invalidating the canvas.
+ */
+/* @[declare_core2foraws_display_notify] */
+void Core2ForAWS_Display_Notify(void);
+/* @[declare_core2foraws_display_notify] */
+
+/**
+ * @brief Runs a function in the `gui` task on its next iteration.
+ *
+ * Takes the @ref xGuiSemaphore, schedules the function with
+ * [lv_async_call](https://docs.lvgl.io/7.11/overview/task.html#asynchronous-calls)
+ * and wakes the `gui` task. The function itself is called with the
+ * semaphore held, so it may use any LVGL API.
+ *
+ * **Example:**
+ *
+ * Hide a spinner from a network task.
+ * @code{c}
+ *  static void hide_spinner(void *spinner) {
+ *      lv_obj_set_hidden(spinner, true);
+ *  }
+ *
+ *  Core2ForAWS_Display_AsyncCall(hide_spinner, spinner);
+ * @endcode
+ *
+ * @param[in] async_xcb The function to call.
+ * @param[in] user_data The parameter passed to the function.
+ */
+/* @[declare_core2foraws_display_asynccall] */
+void Core2ForAWS_Display_AsyncCall(lv_async_cb_t async_xcb, void *user_data);
+/* @[declare_core2foraws_display_asynccall] */
 #endif
 
 /**
@@ -0,0 +1,224 @@
+#include "sdkconfig.h"
+
+#if CONFIG_I2C_TRACE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_I2C_TRACE_CONSOLE
+#include "esp_console.h"
+#endif
+
+#include "i2c_device.h"
+#include "i2c_trace.h"
+
+#ifndef CONFIG_I2C_TRACE_HISTORY
+#define CONFIG_I2C_TRACE_HISTORY 32
+#endif
+
+/* Guards everything below, transactions are reported from the scheduler and the calling tasks */
+static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static i2c_trace_stats_t devices[I2C_TRACE_MAX_DEVICES];
+static uint8_t device_count;
+
+static i2c_trace_record_t history[CONFIG_I2C_TRACE_HISTORY];
+static size_t history_head;
+static size_t history_count;
+
+int8_t i2c_trace_add_device(i2c_port_t port, uint8_t addr) {
+    int8_t index = -1;
+
+    portENTER_CRITICAL(&trace_mux);
+    for (uint8_t i = 0; i < device_count; i++) {
+        if (devices[i].port == port && devices[i].addr == addr) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0 && device_count < I2C_TRACE_MAX_DEVICES) {
+        index = device_count++;
+        memset(&devices[index], 0, sizeof(devices[index]));
+        devices[index].port = port;
+        devices[index].addr = addr;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+
+    return index;
+}
+
+void i2c_trace_transaction(int8_t device, const i2c_trace_record_t *record) {
+    portENTER_CRITICAL(&trace_mux);
+    if (device >= 0) {
+        i2c_trace_stats_t *stats = &devices[device];
+        if (record->write) {
+            stats->writes++;
+            stats->bytes_written += record->length;
+        } else {
+            stats->reads++;
+            stats->bytes_read += record->length;
+        }
+        if (record->err == ESP_ERR_TIMEOUT) {
+            stats->timeouts++;
+        } else if (record->err != ESP_OK) {
+            stats->errors++;
+        }
+        LatencyHistogram_Add(&stats->wait, record->wait_us);
+        LatencyHistogram_Add(&stats->transfer, record->transfer_us);
+    }
+
+    history_head = (history_head + 1) % CONFIG_I2C_TRACE_HISTORY;
+    history[history_head] = *record;
+    if (history_count < CONFIG_I2C_TRACE_HISTORY) {
+        history_count++;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+void i2c_trace_bus_wait(int8_t device, uint32_t wait_us) {
+    if (device < 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&trace_mux);
+    LatencyHistogram_Add(&devices[device].wait, wait_us);
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+esp_err_t i2c_trace_get_device_stats(i2c_port_t port, uint8_t addr, i2c_trace_stats_t *stats) {
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&trace_mux);
+    for (uint8_t i = 0; i < device_count; i++) {
+        if (devices[i].port == port && devices[i].addr == addr) {
+            *stats = devices[i];
+            err = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&trace_mux);
+
+    return err;
+}
+
+size_t i2c_trace_get_stats(i2c_trace_stats_t *stats, size_t max_devices) {
+    size_t copied = 0;
+
+    if (stats == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&trace_mux);
+    while (copied < max_devices && copied < device_count) {
+        stats[copied] = devices[copied];
+        copied++;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+
+    return copied;
+}
+
+size_t i2c_trace_get_recent(i2c_trace_record_t *records, size_t max_records) {
+    size_t copied = 0;
+
+    if (records == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&trace_mux);
+    size_t index = history_head;
+    while (copied < max_records && copied < history_count) {
+        records[copied++] = history[index];
+        index = (index + CONFIG_I2C_TRACE_HISTORY - 1) % CONFIG_I2C_TRACE_HISTORY;
+    }
+    portEXIT_CRITICAL(&trace_mux);
+
+    return copied;
+}
+
+void i2c_trace_reset(void) {
+    portENTER_CRITICAL(&trace_mux);
+    for (uint8_t i = 0; i < device_count; i++) {
+        i2c_port_t port = devices[i].port;
+        uint8_t addr = devices[i].addr;
+        memset(&devices[i], 0, sizeof(devices[i]));
+        devices[i].port = port;
+        devices[i].addr = addr;
+    }
+    history_head = 0;
+    history_count = 0;
+    portEXIT_CRITICAL(&trace_mux);
+}
+
+static void histogram_print(const char *name, const i2c_trace_histogram_t *hist) {
+    uint32_t avg = hist->count ? (uint32_t) (hist->total_us / hist->count) : 0;
+    printf("  %-9s %7u %9u %9u %9u %9u %9u\n", name, hist->count, avg, hist->min_us,
+           LatencyHistogram_Percentile(hist, 50), LatencyHistogram_Percentile(hist, 90), hist->max_us);
+}
+
+void i2c_trace_dump(void) {
+    /* Too large for the stack of the console task */
+    static i2c_trace_stats_t stats[I2C_TRACE_MAX_DEVICES];
+    static i2c_trace_record_t records[CONFIG_I2C_TRACE_HISTORY];
+
+    size_t count = i2c_trace_get_stats(stats, I2C_TRACE_MAX_DEVICES);
+    size_t record_count = i2c_trace_get_recent(records, CONFIG_I2C_TRACE_HISTORY);
+
+    for (size_t i = 0; i < count; i++) {
+        const i2c_trace_stats_t *s = &stats[i];
+        printf("I2C%d 0x%02x: %u reads (%llu B), %u writes (%llu B), %u errors, %u timeouts\n",
+               s->port, s->addr, s->reads, (unsigned long long) s->bytes_read, s->writes,
+               (unsigned long long) s->bytes_written, s->errors, s->timeouts);
+        printf("  %-9s %7s %9s %9s %9s %9s %9s\n", "(us)", "count", "avg", "min", "p50<", "p90<", "max");
+        histogram_print("wait", &s->wait);
+        histogram_print("transfer", &s->transfer);
+    }
+
+    printf("Recent transactions (newest first):\n");
+    printf("%10s %4s %4s %4s %2s %5s %6s %8s %8s %6s\n",
+           "start ms", "port", "addr", "reg", "rw", "bytes", "batch", "wait", "transfer", "err");
+    for (size_t i = 0; i < record_count; i++) {
+        const i2c_trace_record_t *r = &records[i];
+        printf("%10u %4u 0x%02x ", r->start_us / 1000, r->port, r->addr);
+        if (r->reg_addr & I2C_NO_REG) {
+            printf("%4s ", "-");
+        } else {
+            printf("0x%02x ", r->reg_addr);
+        }
+        printf("%2s %5u %6u %8u %8u %#6x\n", r->write ? "W" : "R", r->length, r->batch,
+               r->wait_us, r->transfer_us, r->err);
+    }
+}
+
+#if CONFIG_I2C_TRACE_CONSOLE
+static int i2c_trace_cmd(int argc, char **argv) {
+    if (argc > 1) {
+        if (strcmp(argv[1], "reset") == 0) {
+            i2c_trace_reset();
+            return 0;
+        }
+        printf("Unknown argument: %s\n", argv[1]);
+        return 1;
+    }
+    i2c_trace_dump();
+    return 0;
+}
+
+esp_err_t i2c_trace_register_console_command(void) {
+    const esp_console_cmd_t cmd = {
+        .command = "i2c_trace",
+        .help = "Print the I2C device statistics and recent transactions, 'i2c_trace reset' clears them",
+        .hint = "[reset]",
+        .func = &i2c_trace_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
+#endif
+
+#endif /* CONFIG_I2C_TRACE */
@@ -0,0 +1,242 @@
+/*
+ * GPIO matrix of the simulated board.
+ *
+ * Outputs keep the level the firmware set. Inputs are driven by the device
+ * models, and an edge matching the interrupt type of the pin runs its ISR
+ * handler on the thread of the model. Peripheral outputs routed to a pin
+ * are only recorded.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "esp32/rom/gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "sim.h"
+
+typedef struct {
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    int output;
+    int input;
+    gpio_isr_t isr;
+    void *isr_arg;
+    bool routed;
+    uint32_t signal;
+} sim_pin_t;
+
+static sim_pin_t pins[GPIO_NUM_MAX];
+static bool isr_service;
+static pthread_mutex_t gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool sim_gpio_valid(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            pthread_mutex_lock(&gpio_lock);
+            pins[i].mode = config->mode;
+            pins[i].intr_type = config->intr_type;
+            pins[i].intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+            /* Pulled up inputs read high until a device drives them */
+            if (config->pull_up_en) {
+                pins[i].input = 1;
+            }
+            pthread_mutex_unlock(&gpio_lock);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    pins[gpio_num].mode = GPIO_MODE_DISABLE;
+    pins[gpio_num].intr_type = GPIO_INTR_DISABLE;
+    pins[gpio_num].intr_enabled = false;
+    pins[gpio_num].routed = false;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num) {
+    (void) gpio_num;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pull == GPIO_PULLUP_ONLY) {
+        pins[gpio_num].input = 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&pins[gpio_num].output, level ? 1 : 0, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return 0;
+    }
+    if (pins[gpio_num].mode & GPIO_MODE_INPUT) {
+        return __atomic_load_n(&pins[gpio_num].input, __ATOMIC_ACQUIRE);
+    }
+    return __atomic_load_n(&pins[gpio_num].output, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    pins[gpio_num].intr_type = intr_type;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    pins[gpio_num].intr_enabled = true;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    pins[gpio_num].intr_enabled = false;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    (void) intr_alloc_flags;
+    pthread_mutex_lock(&gpio_lock);
+    esp_err_t err = isr_service ? ESP_ERR_INVALID_STATE : ESP_OK;
+    isr_service = true;
+    pthread_mutex_unlock(&gpio_lock);
+    return err;
+}
+
+void gpio_uninstall_isr_service(void) {
+    pthread_mutex_lock(&gpio_lock);
+    isr_service = false;
+    pthread_mutex_unlock(&gpio_lock);
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    esp_err_t err = isr_service ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK) {
+        pins[gpio_num].isr = isr_handler;
+        pins[gpio_num].isr_arg = args;
+    }
+    pthread_mutex_unlock(&gpio_lock);
+    return err;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    if (!sim_gpio_valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    pins[gpio_num].isr = NULL;
+    pins[gpio_num].isr_arg = NULL;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+void sim_gpio_drive(gpio_num_t pin, int level) {
+    if (!sim_gpio_valid(pin)) {
+        return;
+    }
+    level = level ? 1 : 0;
+
+    pthread_mutex_lock(&gpio_lock);
+    int previous = pins[pin].input;
+    pins[pin].input = level;
+
+    bool fire = false;
+    switch (pins[pin].intr_type) {
+        case GPIO_INTR_POSEDGE:
+            fire = !previous && level;
+            break;
+        case GPIO_INTR_NEGEDGE:
+            fire = previous && !level;
+            break;
+        case GPIO_INTR_ANYEDGE:
+            fire = previous != level;
+            break;
+        case GPIO_INTR_LOW_LEVEL:
+            fire = !level;
+            break;
+        case GPIO_INTR_HIGH_LEVEL:
+            fire = level;
+            break;
+        default:
+            break;
+    }
+    gpio_isr_t isr = (fire && pins[pin].intr_enabled && isr_service) ? pins[pin].isr : NULL;
+    void *arg = pins[pin].isr_arg;
+    pthread_mutex_unlock(&gpio_lock);
+
+    if (isr) {
+        isr(arg);
+    }
+}
+
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, bool out_inv, bool oen_inv) {
+    if (!sim_gpio_valid((gpio_num_t) gpio)) {
+        return;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    pins[gpio].routed = signal_idx != SIG_GPIO_OUT_IDX;
+    pins[gpio].signal = signal_idx;
+    pthread_mutex_unlock(&gpio_lock);
+}
+
+uint32_t sim_gpio_signal(gpio_num_t pin) {
+    if (!sim_gpio_valid(pin)) {
+        return SIG_GPIO_OUT_IDX;
+    }
+    pthread_mutex_lock(&gpio_lock);
+    uint32_t signal = pins[pin].routed ? pins[pin].signal : SIG_GPIO_OUT_IDX;
+    pthread_mutex_unlock(&gpio_lock);
+    return signal;
+}
+
+int sim_gpio_output(gpio_num_t pin) {
+    if (!sim_gpio_valid(pin)) {
+        return 0;
+    }
+    return __atomic_load_n(&pins[pin].output, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,189 @@
+/*
+ * ILI9342C LCD controller model.
+ *
+ * Bytes sent with D/C low are commands, the following ones their parameters.
+ * Memory writes fill the column and page window row by row into a 320x240
+ * RGB565 framebuffer kept in the byte order of the wire. MADCTL is recorded but
+ * not applied, the Core2 runs the panel in its native landscape order.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "sim.h"
+#include "sim_internal.h"
+
+#define ILI9342C_DC_PIN     GPIO_NUM_15
+
+#define ILI_SWRESET     0x01
+#define ILI_SLPIN       0x10
+#define ILI_SLPOUT      0x11
+#define ILI_INVOFF      0x20
+#define ILI_INVON       0x21
+#define ILI_DISPOFF     0x28
+#define ILI_DISPON      0x29
+#define ILI_CASET       0x2a
+#define ILI_PASET       0x2b
+#define ILI_RAMWR       0x2c
+#define ILI_MADCTL      0x36
+#define ILI_COLMOD      0x3a
+
+static pthread_mutex_t lcd_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t framebuffer[SIM_LCD_HEIGHT * SIM_LCD_WIDTH * 2];
+static sim_ili9342c_state_t state;
+
+static uint8_t command;
+static uint8_t params[4];
+static uint32_t param_count;
+static uint16_t window[4];          /* x1, x2, y1, y2 */
+static uint16_t cursor_x, cursor_y;
+static bool window_full;
+static int pixel_byte = -1;         /* First byte of a pixel split across transactions */
+static int reset_level = 1;
+
+static void sim_ili9342c_power_on(void) {
+    state.sleeping = true;
+    state.display_on = false;
+    state.inverted = false;
+    state.madctl = 0;
+    state.colmod = 0x66;
+    window[0] = 0;
+    window[1] = SIM_LCD_WIDTH - 1;
+    window[2] = 0;
+    window[3] = SIM_LCD_HEIGHT - 1;
+    command = 0;
+    param_count = 0;
+}
+
+static void sim_ili9342c_pixel(uint8_t high, uint8_t low) {
+    if (window_full) {
+        state.overruns++;
+        return;
+    }
+    if (cursor_x < SIM_LCD_WIDTH && cursor_y < SIM_LCD_HEIGHT) {
+        uint8_t *p = &framebuffer[(cursor_y * SIM_LCD_WIDTH + cursor_x) * 2];
+        p[0] = high;
+        p[1] = low;
+    }
+    state.pixels++;
+
+    if (cursor_x < window[1]) {
+        cursor_x++;
+    } else {
+        cursor_x = window[0];
+        if (cursor_y < window[3]) {
+            cursor_y++;
+        } else {
+            window_full = true;
+        }
+    }
+}
+
+static void sim_ili9342c_command(uint8_t cmd) {
+    command = cmd;
+    param_count = 0;
+    state.commands++;
+
+    switch (cmd) {
+        case ILI_SWRESET:
+            sim_ili9342c_power_on();
+            break;
+        case ILI_SLPIN:
+            state.sleeping = true;
+            break;
+        case ILI_SLPOUT:
+            state.sleeping = false;
+            break;
+        case ILI_INVOFF:
+            state.inverted = false;
+            break;
+        case ILI_INVON:
+            state.inverted = true;
+            break;
+        case ILI_DISPOFF:
+            state.display_on = false;
+            break;
+        case ILI_DISPON:
+            state.display_on = true;
+            break;
+        case ILI_RAMWR:
+            state.windows++;
+            cursor_x = window[0];
+            cursor_y = window[2];
+            window_full = false;
+            pixel_byte = -1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_ili9342c_param(uint8_t value) {
+    switch (command) {
+        case ILI_CASET:
+        case ILI_PASET:
+            if (param_count < 4) {
+                params[param_count] = value;
+            }
+            if (param_count == 3) {
+                uint16_t *range = command == ILI_CASET ? &window[0] : &window[2];
+                range[0] = (params[0] << 8) | params[1];
+                range[1] = (params[2] << 8) | params[3];
+            }
+            break;
+        case ILI_RAMWR:
+            if (pixel_byte < 0) {
+                pixel_byte = value;
+            } else {
+                sim_ili9342c_pixel(pixel_byte, value);
+                pixel_byte = -1;
+            }
+            break;
+        case ILI_MADCTL:
+            state.madctl = value;
+            break;
+        case ILI_COLMOD:
+            state.colmod = value;
+            break;
+        default:
+            break;
+    }
+    param_count++;
+}
+
+void sim_ili9342c_receive(const uint8_t *data, size_t length, void *ctx) {
+    (void) ctx;
+    bool is_data = sim_gpio_output(ILI9342C_DC_PIN);
+
+    pthread_mutex_lock(&lcd_lock);
+    if (reset_level) {
+        for (size_t i = 0; i < length; i++) {
+            if (is_data) {
+                sim_ili9342c_param(data[i]);
+            } else {
+                sim_ili9342c_command(data[i]);
+            }
+        }
+    }
+    pthread_mutex_unlock(&lcd_lock);
+}
+
+void sim_ili9342c_reset(int level) {
+    pthread_mutex_lock(&lcd_lock);
+    if (reset_level && !level) {
+        state.resets++;
+        sim_ili9342c_power_on();
+    }
+    reset_level = level;
+    pthread_mutex_unlock(&lcd_lock);
+}
+
+const uint8_t *sim_ili9342c_framebuffer(void) {
+    return framebuffer;
+}
+
+void sim_ili9342c_get_state(sim_ili9342c_state_t *out) {
+    pthread_mutex_lock(&lcd_lock);
+    *out = state;
+    pthread_mutex_unlock(&lcd_lock);
+}
@@ -0,0 +1,8 @@
+/* Host stand-in for the ESP-IDF system header */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_attr.h"
@@ -0,0 +1,17 @@
+/* Host stand-in for the ESP32 memory map, all host memory is internal and DMA capable */
+
+#pragma once
+
+#include <stdbool.h>
+
+static inline bool esp_ptr_dma_capable(const void *p)
+{
+    (void) p;
+    return true;
+}
+
+static inline bool esp_ptr_external_ram(const void *p)
+{
+    (void) p;
+    return false;
+}
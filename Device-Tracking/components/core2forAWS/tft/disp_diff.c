@@ -0,0 +1,255 @@
+/**
+ * @file disp_diff.c
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LV_DISP_SCANLINE_DIFF
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "disp_diff.h"
+#include "disp_profiler.h"
+#include "ili9341.h"
+
+#if LV_COLOR_DEPTH != 16
+#error "The scanline diff expects RGB565 pixels"
+#endif
+
+#ifndef CONFIG_LV_DISP_DIFF_WINDOW_COST
+#define CONFIG_LV_DISP_DIFF_WINDOW_COST 64
+#endif
+
+#define TAG "DISP_DIFF"
+
+/* Unchanged pixels that are cheaper to send than opening another window */
+#define GAP_PX      (CONFIG_LV_DISP_DIFF_WINDOW_COST / sizeof(lv_color_t))
+
+/* Changed spans kept per row, further spans are merged into the nearest one */
+#define ROW_SPANS   4
+
+typedef struct {
+    int16_t x1;
+    int16_t x2;
+} span_t;
+
+static lv_color_t *shadow;
+static bool send_all = true;
+
+static span_t spans[LV_VER_RES_MAX][ROW_SPANS];
+static uint8_t span_count[LV_VER_RES_MAX];
+static lv_coord_t dirty_y1 = LV_VER_RES_MAX;
+static lv_coord_t dirty_y2 = -1;
+
+static lv_area_t windows[DISP_DIFF_MAX_WINDOWS];
+static uint32_t frame_px_rendered;
+
+static disp_diff_stats_t stats;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t DispDiff_Init(void) {
+    shadow = heap_caps_calloc(LV_HOR_RES_MAX * LV_VER_RES_MAX, sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (shadow == NULL) {
+        ESP_LOGW(TAG, "No PSRAM for the shadow framebuffer, flushing whole areas");
+        return ESP_ERR_NO_MEM;
+    }
+    send_all = true;
+    return ESP_OK;
+}
+
+void DispDiff_Invalidate(void) {
+    send_all = true;
+}
+
+static void span_add(lv_coord_t y, lv_coord_t x1, lv_coord_t x2) {
+    span_t *row = spans[y];
+    uint8_t n = span_count[y];
+
+    /* Nearest span of the row, the gap is negative when they overlap */
+    int8_t nearest = -1;
+    int32_t nearest_gap = INT32_MAX;
+    for (uint8_t i = 0; i < n; i++) {
+        int32_t gap = LV_MATH_MAX(row[i].x1, x1) - LV_MATH_MIN(row[i].x2, x2) - 1;
+        if (gap < nearest_gap) {
+            nearest = i;
+            nearest_gap = gap;
+        }
+    }
+
+    if (nearest >= 0 && (nearest_gap <= (int32_t) GAP_PX || n == ROW_SPANS)) {
+        row[nearest].x1 = LV_MATH_MIN(row[nearest].x1, x1);
+        row[nearest].x2 = LV_MATH_MAX(row[nearest].x2, x2);
+    } else {
+        row[n].x1 = x1;
+        row[n].x2 = x2;
+        span_count[y] = n + 1;
+    }
+
+    if (y < dirty_y1) {
+        dirty_y1 = y;
+    }
+    if (y > dirty_y2) {
+        dirty_y2 = y;
+    }
+}
+
+/* Records the runs of changed pixels of a row, a run ends after more than
+ * GAP_PX unchanged pixels, and updates the shadow row */
+static void diff_row(lv_coord_t y, lv_coord_t x1, const lv_color_t *src, lv_color_t *dst, lv_coord_t w) {
+    if (memcmp(src, dst, w * sizeof(lv_color_t)) == 0) {
+        return;
+    }
+
+    lv_coord_t i = 0;
+    while (i < w) {
+        if (src[i].full == dst[i].full) {
+            i++;
+            continue;
+        }
+
+        lv_coord_t start = i;
+        lv_coord_t end = i;
+        lv_coord_t same = 0;
+        for (i++; i < w; i++) {
+            if (src[i].full != dst[i].full) {
+                end = i;
+                same = 0;
+            } else if (++same > (lv_coord_t) GAP_PX) {
+                break;
+            }
+        }
+        span_add(y, x1 + start, x1 + end);
+    }
+
+    memcpy(dst, src, w * sizeof(lv_color_t));
+}
+
+/* Adds a row span to the window that grows the least by unchanged pixels,
+ * or opens a new window if every existing one would waste more than a window costs */
+static uint16_t window_add(uint16_t count, lv_coord_t y, const span_t *span) {
+    int32_t span_px = span->x2 - span->x1 + 1;
+
+    int32_t best = -1;
+    int32_t best_waste = INT32_MAX;
+    for (uint16_t i = 0; i < count; i++) {
+        const lv_area_t *w = &windows[i];
+        lv_area_t u = {
+            .x1 = LV_MATH_MIN(w->x1, span->x1),
+            .y1 = w->y1,
+            .x2 = LV_MATH_MAX(w->x2, span->x2),
+            .y2 = y,
+        };
+        int32_t waste = (int32_t) lv_area_get_size(&u) - (int32_t) lv_area_get_size(w) - span_px;
+        if (waste < best_waste) {
+            best = i;
+            best_waste = waste;
+        }
+    }
+
+    if (best >= 0 && (best_waste <= (int32_t) GAP_PX || count == DISP_DIFF_MAX_WINDOWS)) {
+        lv_area_t *w = &windows[best];
+        w->x1 = LV_MATH_MIN(w->x1, span->x1);
+        w->x2 = LV_MATH_MAX(w->x2, span->x2);
+        w->y2 = y;
+        return count;
+    }
+
+    windows[count].x1 = span->x1;
+    windows[count].y1 = y;
+    windows[count].x2 = span->x2;
+    windows[count].y2 = y;
+    return count + 1;
+}
+
+/* Merges the spans of the frame into windows and queues them from the shadow framebuffer */
+static void frame_end(lv_disp_drv_t * drv) {
+    uint16_t count = 0;
+    for (lv_coord_t y = dirty_y1; y <= dirty_y2; y++) {
+        for (uint8_t i = 0; i < span_count[y]; i++) {
+            count = window_add(count, y, &spans[y][i]);
+        }
+        span_count[y] = 0;
+    }
+    dirty_y1 = LV_VER_RES_MAX;
+    dirty_y2 = -1;
+    send_all = false;
+
+    uint32_t px_sent = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        px_sent += lv_area_get_size(&windows[i]);
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.frames++;
+    stats.frames_unchanged += count == 0;
+    stats.px_rendered += frame_px_rendered;
+    stats.px_sent += px_sent;
+    stats.windows += count;
+    stats.last_px_rendered = frame_px_rendered;
+    stats.last_px_sent = px_sent;
+    stats.last_windows = count;
+    portEXIT_CRITICAL(&stats_mux);
+    frame_px_rendered = 0;
+
+    if (count == 0) {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+#if CONFIG_LV_DISP_PROFILER
+    DispProfiler_FlushStart();
+#endif
+
+    /* The shadow framebuffer is only written again in the next flush, which
+     * LVGL holds back until the last window signals lv_disp_flush_ready() */
+    for (uint16_t i = 0; i < count; i++) {
+        const lv_area_t *w = &windows[i];
+        ili9341_write_window(w, &shadow[w->y1 * LV_HOR_RES_MAX + w->x1], LV_HOR_RES_MAX, i == count - 1);
+    }
+}
+
+bool DispDiff_Flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map) {
+    if (shadow == NULL) {
+        return false;
+    }
+
+    lv_coord_t w = lv_area_get_width(area);
+    const lv_color_t *src = color_map;
+    for (lv_coord_t y = area->y1; y <= area->y2; y++) {
+        lv_color_t *dst = &shadow[y * LV_HOR_RES_MAX + area->x1];
+        if (send_all) {
+            span_add(y, area->x1, area->x2);
+            memcpy(dst, src, w * sizeof(lv_color_t));
+        } else {
+            diff_row(y, area->x1, src, dst, w);
+        }
+        src += w;
+    }
+    frame_px_rendered += lv_area_get_size(area);
+
+    if (lv_disp_flush_is_last(drv)) {
+        frame_end(drv);
+    } else {
+        /* The area is in the shadow framebuffer, LVGL can render the next one */
+        lv_disp_flush_ready(drv);
+    }
+    return true;
+}
+
+esp_err_t DispDiff_GetStats(disp_diff_stats_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+    return ESP_OK;
+}
+
+#endif /* CONFIG_LV_DISP_SCANLINE_DIFF */
@@ -8,12 +8,21 @@
 
 #include "disp_driver.h"
 #include "disp_spi.h"
+#include "disp_diff.h"
 
 void disp_driver_init(void) {
     ili9341_init();
+#if CONFIG_LV_DISP_SCANLINE_DIFF
+    DispDiff_Init();
+#endif
 }
 
 void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map) {
+#if CONFIG_LV_DISP_SCANLINE_DIFF
+    if (DispDiff_Flush(drv, area, color_map)) {
+        return;
+    }
+#endif
     ili9341_flush(drv, area, color_map);
 }
 
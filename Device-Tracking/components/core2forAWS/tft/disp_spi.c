@@ -4,8 +4,10 @@
  */
 
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
+#include "soc/soc_memory_layout.h"
 
 #include <string.h>
 
@@ -17,20 +19,49 @@
 
 #include "disp_spi.h"
 #include "disp_driver.h"
+#include "disp_profiler.h"
 
 SemaphoreHandle_t spi_mutex;
 
+static void IRAM_ATTR spi_pre (spi_transaction_t *trans);
 static void IRAM_ATTR spi_ready (spi_transaction_t *trans);
 
 static spi_host_device_t spi_host;
 static spi_device_handle_t spi;
 static volatile uint8_t spi_pending_trans = 0;
+static transaction_cb_t chained_pre_cb;
 static transaction_cb_t chained_post_cb;
 
 static uint8_t tft_used_spi_dma = 0;
 
 #define CONFIG_LV_DISP_SPI_CS   5
 
+/* Queued transactions live in this ring until their result has been collected.
+ * A window update (3 commands, 2 parameter blocks and the pixels) fits in it. */
+#define DISP_SPI_TRANS_RING_SIZE    8
+
+static spi_transaction_ext_t trans_ring[DISP_SPI_TRANS_RING_SIZE];
+static uint8_t trans_ring_head = 0;
+static uint32_t trans_queued = 0;
+
+/* Set while a queued sequence owns the bus; the DISP_SPI_SIGNAL_FLUSH transaction closes it */
+static bool queued_sequence_open = false;
+
+#if CONFIG_LV_DISP_BUF_MODE_SPIRAM_BOUNCE
+#define DISP_SPI_BOUNCE_SIZE    (LV_HOR_RES_MAX * CONFIG_LV_DISP_BOUNCE_LINES * sizeof(lv_color_t))
+
+static uint8_t *bounce_buf[CONFIG_LV_DISP_BOUNCE_COUNT];
+static uint32_t bounce_seq[CONFIG_LV_DISP_BOUNCE_COUNT];
+static bool bounce_used[CONFIG_LV_DISP_BOUNCE_COUNT];
+static uint8_t bounce_head = 0;
+
+static void disp_spi_send_bounced(const uint8_t *data, size_t row_length, size_t stride,
+    uint16_t rows, disp_spi_send_flag_t flags);
+#endif
+
+static void disp_spi_reclaim(uint8_t max_pending);
+static void disp_spi_queue(spi_transaction_ext_t *t);
+
 void spi_poll() {
     if (!tft_used_spi_dma) {
         return ;
@@ -48,7 +79,9 @@ void spi_poll() {
 
 void disp_spi_add_device_config(spi_host_device_t host, spi_device_interface_config_t *devcfg) {
     spi_host=host;
+    chained_pre_cb=devcfg->pre_cb;
     chained_post_cb=devcfg->post_cb;
+    devcfg->pre_cb=spi_pre;
     devcfg->post_cb=spi_ready;
     esp_err_t ret=spi_bus_add_device(host, devcfg, &spi);
     assert(ret==ESP_OK);
@@ -65,13 +98,20 @@ void disp_spi_add_device(spi_host_device_t host) {
         .mode = 0,
         .spics_io_num=CONFIG_LV_DISP_SPI_CS,              // CS pin
         .input_delay_ns=0,
-        .queue_size=1,
+        .queue_size=DISP_SPI_TRANS_RING_SIZE,
         .pre_cb=NULL,
         .post_cb=NULL,
         .flags = SPI_DEVICE_NO_DUMMY,
     };
 
     disp_spi_add_device_config(host, &devcfg);
+
+#if CONFIG_LV_DISP_BUF_MODE_SPIRAM_BOUNCE
+    for (uint8_t i = 0; i < CONFIG_LV_DISP_BOUNCE_COUNT; i++) {
+        bounce_buf[i] = heap_caps_malloc(DISP_SPI_BOUNCE_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        assert(bounce_buf[i] != NULL);
+    }
+#endif
 }
 
 void disp_spi_transaction(const uint8_t *data, size_t length,
@@ -81,8 +121,24 @@ void disp_spi_transaction(const uint8_t *data, size_t length,
         return;
     }
 
-    /* Wait for previous pending transaction results */
-    disp_wait_for_pending_transactions();
+#if CONFIG_LV_DISP_PROFILER
+    DispProfiler_AddSpiBytes(length);
+#endif
+
+    bool queued = !(flags & (DISP_SPI_SEND_POLLING | DISP_SPI_SEND_SYNCHRONOUS));
+
+#if CONFIG_LV_DISP_BUF_MODE_SPIRAM_BOUNCE
+    /* Large queued writes from memory the DMA cannot read go through the bounce ring */
+    if (queued && length > 4 && !esp_ptr_dma_capable(data)) {
+        disp_spi_send_bounced(data, length, length, 1, flags);
+        return;
+    }
+#endif
+
+    /* Blocking transactions must not overtake the queued ones */
+    if (!queued) {
+        disp_wait_for_pending_transactions();
+    }
 
     spi_transaction_ext_t t = {0};
 
@@ -119,41 +175,154 @@ void disp_spi_transaction(const uint8_t *data, size_t length,
     /* Save flags for pre/post transaction processing */
     t.base.user = (void *) flags;
 
-    xSemaphoreTake(spi_mutex, portMAX_DELAY);
-    spi_device_acquire_bus(spi, portMAX_DELAY);
-    gpio_set_level(CONFIG_LV_DISP_SPI_CS, 0);
-
     /* Poll/Complete/Queue transaction */
     if (flags & DISP_SPI_SEND_POLLING) {
+        xSemaphoreTake(spi_mutex, portMAX_DELAY);
+        spi_device_acquire_bus(spi, portMAX_DELAY);
+        gpio_set_level(CONFIG_LV_DISP_SPI_CS, 0);
         spi_device_polling_transmit(spi, (spi_transaction_t *) &t);
         gpio_set_level(CONFIG_LV_DISP_SPI_CS, 1);
         spi_device_release_bus(spi);
         xSemaphoreGive(spi_mutex);
     } else if (flags & DISP_SPI_SEND_SYNCHRONOUS) {
+        xSemaphoreTake(spi_mutex, portMAX_DELAY);
+        spi_device_acquire_bus(spi, portMAX_DELAY);
+        gpio_set_level(CONFIG_LV_DISP_SPI_CS, 0);
         spi_device_transmit(spi, (spi_transaction_t *) &t);
         gpio_set_level(CONFIG_LV_DISP_SPI_CS, 1);
         spi_device_release_bus(spi);
         xSemaphoreGive(spi_mutex);
     } else {
-        static spi_transaction_ext_t queuedt;
-        memcpy(&queuedt, &t, sizeof t);
-        spi_pending_trans++;
-        if (spi_device_queue_trans(spi, (spi_transaction_t *) &queuedt, portMAX_DELAY) != ESP_OK) {
-            spi_pending_trans--; /* Clear wait state */
-        }
+        disp_spi_queue(&t);
+    }
+}
+
+void disp_spi_queue_rows(const uint8_t *data, size_t row_length, size_t stride,
+    uint16_t rows, disp_spi_send_flag_t flags) {
+#if CONFIG_LV_DISP_BUF_MODE_SPIRAM_BOUNCE
+    if (row_length > 4 && !esp_ptr_dma_capable(data)) {
+#if CONFIG_LV_DISP_PROFILER
+        DispProfiler_AddSpiBytes(row_length * rows);
+#endif
+        disp_spi_send_bounced(data, row_length, stride, rows, flags);
+        return;
+    }
+#endif
+
+    /* One transaction per row, only the last one carries the caller flags */
+    for (uint16_t row = 0; row < rows; row++) {
+        disp_spi_transaction(data, row_length,
+            row == rows - 1 ? flags : (flags & DISP_SPI_SEND_CMD), NULL, 0);
+        data += stride;
     }
 }
 
 void disp_wait_for_pending_transactions(void) {
+    disp_spi_reclaim(0);
+}
+
+/* Collects finished transactions until at most max_pending are still in flight */
+static void disp_spi_reclaim(uint8_t max_pending) {
     spi_transaction_t *presult;
 
-    while (spi_pending_trans) {
+    while (spi_pending_trans > max_pending) {
         if (spi_device_get_trans_result(spi, &presult, portMAX_DELAY) == ESP_OK) {
             spi_pending_trans--;
         }
     }
 }
 
+/* Copies the transaction into the ring and queues it, taking the bus for the
+ * first transaction of a sequence. Results are collected in queue order, so the
+ * slot at the ring head is free once fewer than DISP_SPI_TRANS_RING_SIZE are pending. */
+static void disp_spi_queue(spi_transaction_ext_t *t) {
+    disp_spi_send_flag_t flags = (disp_spi_send_flag_t) t->base.user;
+
+    if (!queued_sequence_open) {
+        /* Blocks until the previous flush released the bus from spi_ready() */
+        xSemaphoreTake(spi_mutex, portMAX_DELAY);
+        spi_device_acquire_bus(spi, portMAX_DELAY);
+        gpio_set_level(CONFIG_LV_DISP_SPI_CS, 0);
+        queued_sequence_open = true;
+    }
+    if (flags & DISP_SPI_SIGNAL_FLUSH) {
+        queued_sequence_open = false;
+    }
+
+    disp_spi_reclaim(DISP_SPI_TRANS_RING_SIZE - 1);
+
+    spi_transaction_ext_t *slot = &trans_ring[trans_ring_head];
+    trans_ring_head = (trans_ring_head + 1) % DISP_SPI_TRANS_RING_SIZE;
+    memcpy(slot, t, sizeof(*slot));
+
+    spi_pending_trans++;
+    trans_queued++;
+    if (spi_device_queue_trans(spi, (spi_transaction_t *) slot, portMAX_DELAY) != ESP_OK) {
+        spi_pending_trans--; /* Clear wait state */
+    }
+}
+
+#if CONFIG_LV_DISP_BUF_MODE_SPIRAM_BOUNCE
+/* Copies the data chunk by chunk into the bounce buffers. Up to CONFIG_LV_DISP_BOUNCE_COUNT
+ * chunks are in flight at once, so the next chunk is copied while the previous one is sent.
+ * Rows that are stride bytes apart are packed back to back into the chunks.
+ * Only the last chunk carries the caller flags, which release the bus and signal LVGL. */
+static void disp_spi_send_bounced(const uint8_t *data, size_t row_length, size_t stride,
+    uint16_t rows, disp_spi_send_flag_t flags) {
+    size_t row_offset = 0;
+
+    while (rows) {
+        uint8_t i = bounce_head;
+
+        /* Wait until the transaction that last used this buffer has been collected */
+        if (bounce_used[i]) {
+            uint32_t newer = trans_queued - bounce_seq[i] - 1;
+            if (newer < spi_pending_trans) {
+                disp_spi_reclaim(newer);
+            }
+        }
+
+        size_t chunk = 0;
+        while (rows && chunk < DISP_SPI_BOUNCE_SIZE) {
+            size_t n = row_length - row_offset;
+            if (n > DISP_SPI_BOUNCE_SIZE - chunk) {
+                n = DISP_SPI_BOUNCE_SIZE - chunk;
+            }
+            memcpy(bounce_buf[i] + chunk, data + row_offset, n);
+            chunk += n;
+            row_offset += n;
+            if (row_offset == row_length) {
+                data += stride;
+                row_offset = 0;
+                rows--;
+            }
+        }
+
+        spi_transaction_ext_t t = {0};
+        t.base.length = chunk * 8;
+        t.base.tx_buffer = bounce_buf[i];
+        t.base.user = (void *) (rows == 0 ? flags : (flags & DISP_SPI_SEND_CMD));
+
+        bounce_seq[i] = trans_queued;
+        bounce_used[i] = true;
+        disp_spi_queue(&t);
+
+        bounce_head = (bounce_head + 1) % CONFIG_LV_DISP_BOUNCE_COUNT;
+    }
+}
+#endif
+
+/* Drives the D/C line of the ILI9342C for the transaction about to start */
+static void IRAM_ATTR spi_pre(spi_transaction_t *trans) {
+    disp_spi_send_flag_t flags = (disp_spi_send_flag_t) trans->user;
+
+    gpio_set_level(ILI9341_DC, (flags & DISP_SPI_SEND_CMD) ? 0 : 1);
+
+    if (chained_pre_cb) {
+        chained_pre_cb(trans);
+    }
+}
+
 static void IRAM_ATTR spi_ready(spi_transaction_t *trans) {
     disp_spi_send_flag_t flags = (disp_spi_send_flag_t) trans->user;
     int higher_priority_task_awoken = pdFALSE;
@@ -161,6 +330,9 @@ static void IRAM_ATTR spi_ready(spi_transaction_t *trans) {
     if (flags & DISP_SPI_SIGNAL_FLUSH) {
         lv_disp_t * disp = NULL;
         disp = _lv_refr_get_disp_refreshing();
+#if CONFIG_LV_DISP_PROFILER
+        DispProfiler_FlushDoneFromISR();
+#endif
         lv_disp_flush_ready(&disp->driver);
 
     }
@@ -32,6 +32,10 @@ extern "C" {
 
 void ili9341_init(void);
 void ili9341_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
+/* Queues a window update from pixels whose rows are stride pixels apart. With
+ * signal_flush the last transaction releases the bus and calls lv_disp_flush_ready(),
+ * otherwise the bus stays taken for the next window. */
+void ili9341_write_window(const lv_area_t * area, const lv_color_t * pixels, uint16_t stride, bool signal_flush);
 void ili9341_sleep_in(void);
 void ili9341_sleep_out(void);
 
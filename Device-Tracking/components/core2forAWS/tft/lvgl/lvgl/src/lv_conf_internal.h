@@ -500,6 +500,15 @@ e.g. "stm32f769xx.h" or "stm32f429xx.h" */
 #  endif
 #endif
 
+/*1: Use the software blending kernels specialized for RGB565 (lv_draw_blend_rgb565.c)*/
+#ifndef LV_USE_BLEND_RGB565
+#  ifdef CONFIG_LV_USE_BLEND_RGB565
+#    define LV_USE_BLEND_RGB565 CONFIG_LV_USE_BLEND_RGB565
+#  else
+#    define  LV_USE_BLEND_RGB565     0
+#  endif
+#endif
+
 /*1: Use PXP for CPU off-load on NXP RTxxx platforms */
 #ifndef LV_USE_GPU_NXP_PXP
 #  ifdef CONFIG_LV_USE_GPU_NXP_PXP
@@ -129,6 +129,26 @@ lv_img_dsc_t * lv_canvas_get_img(lv_obj_t * canvas);
 void lv_canvas_copy_buf(lv_obj_t * canvas, const void * to_copy, lv_coord_t x, lv_coord_t y, lv_coord_t w,
                         lv_coord_t h);
 
+/**
+ * Write a whole column of the canvas from palette indices, e.g. a spectrum of a spectrogram.
+ * Only the column is invalidated (the whole canvas if it is zoomed, rotated or offset).
+ * @param canvas pointer to a canvas object
+ * @param x the column to write
+ * @param idx palette index of every pixel of the column, top to bottom (canvas height entries)
+ * @param palette the colors to look the indices up in
+ */
+void lv_canvas_set_col_palette(lv_obj_t * canvas, lv_coord_t x, const uint8_t * idx, const lv_color_t * palette);
+
+/**
+ * Scroll the canvas content left by one column and write the new rightmost column from
+ * palette indices, e.g. to show a spectrogram as a waterfall.
+ * The canvas is invalidated once.
+ * @param canvas pointer to a canvas object
+ * @param idx palette index of every pixel of the new column, top to bottom (canvas height entries)
+ * @param palette the colors to look the indices up in
+ */
+void lv_canvas_scroll_col_palette(lv_obj_t * canvas, const uint8_t * idx, const lv_color_t * palette);
+
 /**
  * Transform and image and store the result on a canvas.
  * @param canvas pointer to a canvas object to store the result of the transformation.
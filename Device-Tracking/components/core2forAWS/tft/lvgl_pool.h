@@ -0,0 +1,140 @@
+/**
+ * @file lvgl_pool.h
+ * @brief Size-class pool allocator backing lv_mem_alloc().
+ *
+ * Enabled with CONFIG_LV_MEM_POOL. Small allocations (objects, style
+ * lists, linked list nodes, short texts) come from slabs of equally sized
+ * blocks in a static internal RAM arena of CONFIG_LV_MEM_POOL_INTERNAL_KB.
+ * The arena is split into pages which are handed to a size class when it
+ * needs more blocks and returned when they are empty again, so screens
+ * that are rebuilt over and over reuse the same blocks instead of
+ * fragmenting a general purpose heap. Allocating and freeing a block
+ * takes constant time.
+ *
+ * Larger allocations, and small ones once the arena is full, overflow
+ * into PSRAM (internal RAM if there is none).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "lvgl/lvgl.h"
+
+/**
+ * @brief Number of size classes.
+ */
+#define LVGL_POOL_CLASSES       9
+
+/**
+ * @brief Largest block size served by the internal slabs.
+ */
+#define LVGL_POOL_MAX_BLOCK     256
+
+/**
+ * @brief Size of an arena page.
+ */
+#define LVGL_POOL_PAGE_SIZE     1024
+
+/**
+ * @brief Statistics of one size class.
+ */
+/* @[declare_lvgl_pool_class_stats_t] */
+typedef struct {
+    uint16_t block_size;        /**< Size of the blocks of this class. */
+    uint16_t pages;             /**< Arena pages holding blocks of this class. */
+    uint32_t used;              /**< Blocks in use. */
+    uint32_t peak_used;         /**< Most blocks in use at once. */
+    uint32_t allocs;            /**< Blocks allocated since boot. */
+} lvgl_pool_class_stats_t;
+/* @[declare_lvgl_pool_class_stats_t] */
+
+/**
+ * @brief Statistics of the whole allocator.
+ */
+/* @[declare_lvgl_pool_stats_t] */
+typedef struct {
+    lvgl_pool_class_stats_t classes[LVGL_POOL_CLASSES]; /**< Per size class. */
+    uint32_t arena_size;        /**< Size of the internal arena. */
+    uint32_t pages_free;        /**< Arena pages not assigned to a class. */
+    uint32_t internal_used;     /**< Bytes of arena blocks in use. */
+    uint32_t internal_peak;     /**< Most bytes of arena blocks in use at once. */
+    uint32_t overflow_used;     /**< Bytes allocated outside of the arena. */
+    uint32_t overflow_peak;     /**< Most bytes allocated outside of the arena at once. */
+    uint32_t overflow_count;    /**< Allocations currently outside of the arena. */
+    uint32_t arena_full;        /**< Small allocations that overflowed because the arena was full. */
+    uint32_t failed;            /**< Allocations that failed. */
+    uint32_t allocs;            /**< Allocations since boot. */
+    uint32_t frees;             /**< Frees since boot. */
+    uint32_t allocs_per_sec;    /**< Allocation rate since the previous LvglPool_GetStats() call. */
+    uint8_t frag_pct;           /**< Free arena bytes stuck in partially used pages, in percent of all free arena bytes. */
+} lvgl_pool_stats_t;
+/* @[declare_lvgl_pool_stats_t] */
+
+/**
+ * @brief Allocates memory for LVGL.
+ *
+ * Called by lv_mem_alloc() through LV_MEM_CUSTOM_ALLOC, it should not be
+ * used directly.
+ *
+ * @param[in] size Number of bytes.
+ *
+ * @return The memory, or NULL if neither the arena nor the heap can
+ * provide it.
+ */
+/* @[declare_lvglpool_alloc] */
+void *LvglPool_Alloc(size_t size);
+/* @[declare_lvglpool_alloc] */
+
+/**
+ * @brief Frees memory returned by LvglPool_Alloc().
+ *
+ * @param[in] ptr The memory, or NULL.
+ */
+/* @[declare_lvglpool_free] */
+void LvglPool_Free(void *ptr);
+/* @[declare_lvglpool_free] */
+
+/**
+ * @brief Copies the allocator statistics.
+ *
+ * **Example:**
+ *
+ * Log the memory used by the GUI.
+ * @code{c}
+ *  lvgl_pool_stats_t stats;
+ *  LvglPool_GetStats(&stats);
+ *  ESP_LOGI(TAG, "GUI memory: %u B internal (peak %u), %u B PSRAM, %u allocs/s",
+ *           stats.internal_used, stats.internal_peak, stats.overflow_used, stats.allocs_per_sec);
+ * @endcode
+ *
+ * @param[out] stats The statistics.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : stats is NULL
+ */
+/* @[declare_lvglpool_getstats] */
+esp_err_t LvglPool_GetStats(lvgl_pool_stats_t *stats);
+/* @[declare_lvglpool_getstats] */
+
+/**
+ * @brief Prints the allocator statistics to the console.
+ */
+/* @[declare_lvglpool_dump] */
+void LvglPool_Dump(void);
+/* @[declare_lvglpool_dump] */
+
+/**
+ * @brief Fills the lv_mem_monitor() results.
+ *
+ * Called by lv_mem_monitor() through LV_MEM_CUSTOM_MONITOR, so LVGL's
+ * own memory monitor keeps working with the pool allocator.
+ *
+ * @param[out] mon The monitor results.
+ */
+/* @[declare_lvglpool_monitor] */
+void LvglPool_Monitor(lv_mem_monitor_t *mon);
+/* @[declare_lvglpool_monitor] */
@@ -0,0 +1,137 @@
+/*
+ * Host test for the scanline-diff display updates (disp_diff.c).
+ *
+ * LVGL renders into 40 line draw buffers which are flushed through
+ * DispDiff_Flush(). The windows it sends land in a simulated panel, while
+ * every rendered area is also copied as is into a reference framebuffer.
+ * After each frame the panel must match the reference. Two busy screens are
+ * animated: a gauge whose needle moves like a clock hand and a column chart
+ * like the spectrum bars. Exits with 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lvgl/lvgl.h"
+#include "disp_diff.h"
+#include "ili9341.h"
+
+#define FRAMES      200
+#define BUF_LINES   40
+
+static lv_color_t buf1[LV_HOR_RES_MAX * BUF_LINES];
+static lv_color_t buf2[LV_HOR_RES_MAX * BUF_LINES];
+static lv_color_t panel[LV_VER_RES_MAX][LV_HOR_RES_MAX];
+static lv_color_t reference[LV_VER_RES_MAX][LV_HOR_RES_MAX];
+static lv_disp_drv_t * flushing_drv;
+
+/* Stands in for the SPI transfer of the window */
+void ili9341_write_window(const lv_area_t * area, const lv_color_t * pixels, uint16_t stride, bool signal_flush)
+{
+    for(lv_coord_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&panel[y][area->x1], pixels, lv_area_get_width(area) * sizeof(lv_color_t));
+        pixels += stride;
+    }
+    if(signal_flush) lv_disp_flush_ready(flushing_drv);
+}
+
+static void flush_cb(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    const lv_color_t * src = color_p;
+    for(lv_coord_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&reference[y][area->x1], src, lv_area_get_width(area) * sizeof(lv_color_t));
+        src += lv_area_get_width(area);
+    }
+
+    flushing_drv = drv;
+    DispDiff_Flush(drv, area, color_p);
+}
+
+static int run(const char * name, void (*step)(int frame))
+{
+    disp_diff_stats_t before, after;
+    DispDiff_GetStats(&before);
+
+    int errors = 0;
+    for(int f = 0; f < FRAMES && !errors; f++) {
+        step(f);
+        lv_refr_now(NULL);
+        if(memcmp(panel, reference, sizeof(panel))) {
+            printf("%s: frame %d differs from the rendered screen\n", name, f);
+            errors++;
+        }
+    }
+
+    DispDiff_GetStats(&after);
+    uint32_t frames = after.frames - before.frames;
+    uint64_t rendered = after.px_rendered - before.px_rendered;
+    uint64_t sent = after.px_sent - before.px_sent;
+    printf("%-8s %6u %12llu %12llu %7.1f%% %10.1f\n", name, frames, (unsigned long long) rendered * 2,
+           (unsigned long long) sent * 2, rendered ? 100.0 * sent / rendered : 0.0,
+           frames ? (double) (after.windows - before.windows) / frames : 0.0);
+    return errors;
+}
+
+static lv_obj_t * gauge;
+static lv_obj_t * chart;
+static lv_chart_series_t * series;
+
+static void gauge_step(int frame)
+{
+    lv_gauge_set_value(gauge, 0, frame % 60);
+}
+
+static void chart_step(int frame)
+{
+    (void) frame;
+    for(int i = 0; i < 32; i++) {
+        /*Bars move a little from frame to frame like a spectrum*/
+        lv_coord_t v = series->points[i] + rand() % 21 - 10;
+        series->points[i] = LV_MATH_MAX(0, LV_MATH_MIN(100, v));
+    }
+    lv_chart_refresh(chart);
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    lv_init();
+    lv_disp_buf_t disp_buf;
+    lv_disp_buf_init(&disp_buf, buf1, buf2, LV_HOR_RES_MAX * BUF_LINES);
+    lv_disp_drv_t disp_drv;
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.flush_cb = flush_cb;
+    disp_drv.buffer = &disp_buf;
+    lv_disp_drv_register(&disp_drv);
+
+    /*The panel starts with garbage, the first frame must overwrite all of it*/
+    memset(panel, 0xA5, sizeof(panel));
+    DispDiff_Init();
+
+    printf("%-8s %6s %12s %12s %8s %10s\n", "screen", "frames", "rendered B", "sent B", "sent", "windows/f");
+
+    gauge = lv_gauge_create(lv_scr_act(), NULL);
+    lv_obj_set_size(gauge, 200, 200);
+    lv_obj_align(gauge, NULL, LV_ALIGN_CENTER, 0, 0);
+    lv_refr_now(NULL);
+    if(memcmp(panel, reference, sizeof(panel))) {
+        printf("first frame differs from the rendered screen\n");
+        errors++;
+    }
+    errors += run("gauge", gauge_step);
+    lv_obj_del(gauge);
+
+    chart = lv_chart_create(lv_scr_act(), NULL);
+    lv_obj_set_size(chart, 300, 200);
+    lv_obj_align(chart, NULL, LV_ALIGN_CENTER, 0, 0);
+    lv_chart_set_type(chart, LV_CHART_TYPE_COLUMN);
+    lv_chart_set_point_count(chart, 32);
+    series = lv_chart_add_series(chart, LV_COLOR_RED);
+    lv_chart_init_points(chart, series, 50);
+    errors += run("chart", chart_step);
+
+    if(errors) printf("FAILED\n");
+    return errors ? 1 : 0;
+}
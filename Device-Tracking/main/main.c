@@ -160,14 +160,54 @@ void produce_gps_points_task(void *param) {
     // Don't bother producing GPS points until we connect to the network for the first time.
     wifi_wait_for_connection_up();
 
+    // Watch for motion with the accelerometer in its low power mode (the gyroscope is not needed).
+    bool motionDetect = (ESP_OK == MPU6886_EnableMotionDetect(MOTION_THRESHOLD_IN_MG, MOTION_SAMPLE_RATE_IN_HZ));
+
+    if(!motionDetect) {
+        ESP_LOGW(TAG, "Wake-on-motion unavailable; producing GPS points while still.");
+    }
+
     // vTaskDelayUntil() below requires an initial starting time.
     TickType_t xLastWakeTime = xTaskGetTickCount();
+    TickType_t xLastMotionTime = xLastWakeTime;
 
     // Some complexity for mock mode due to looping faster than GPS point production period.
     for(int loops = 0; !giveUp; loops = (loops + 1) % get_produce_loops_per_gps_point()) {
         // Pause here to produce GPS points at a given frequency.
         vTaskDelayUntil(&xLastWakeTime, xWakePeriod / get_produce_loops_per_gps_point());
 
+        if(motionDetect) {
+            if(ESP_OK == MPU6886_WaitForMotion(0)) {
+                xLastMotionTime = xTaskGetTickCount();
+            }
+            else if(xTaskGetTickCount() - xLastMotionTime >= pdMS_TO_TICKS(STILL_TIMEOUT_IN_MS)) {
+                // Nothing to track while lying still; block until the EduKit moves.
+                ESP_LOGI(TAG, "No motion for %d s; pausing GPS points.", STILL_TIMEOUT_IN_MS / 1000);
+                ui_out_txt_add("Still\n", NULL, 0);
+
+                esp_err_t err;
+                do {
+                    err = MPU6886_WaitForMotion(pdMS_TO_TICKS(STILL_RECHECK_IN_MS));
+                } while(!giveUp && ESP_ERR_TIMEOUT == err);
+
+                if(giveUp) {
+                    break;
+                }
+                if(ESP_OK != err) {
+                    ESP_LOGW(TAG, "Wake-on-motion failed (%s); producing GPS points while still.", esp_err_to_name(err));
+                    motionDetect = false;
+                }
+                else {
+                    ESP_LOGI(TAG, "Motion detected; resuming GPS points.");
+                }
+                ui_out_txt_add("Moving\n", NULL, 0);
+
+                // Produce a point right away rather than waiting out the rest of the period.
+                xLastWakeTime = xLastMotionTime = xTaskGetTickCount();
+                loops = 0;
+            }
+        }
+
         get_gps_point(&gpsPoint);
 
         // If mocking GPS points, only produce at the desired upload rate despite calculating (looping) more frequently.
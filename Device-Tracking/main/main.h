@@ -36,6 +36,19 @@ const uint32_t GPS_POINT_BUFFER_DURATION_IN_MS = GPS_POINT_BUFFER_DURATION_IN_MI
 // Should be an even divisor of GPS_POINT_PERIOD_IN_MS above for accurate smoothing.
 const uint32_t GPS_MOCK_CALC_PERIOD_IN_MS = 100;
 
+// GPS point production pauses once the EduKit has lain still this long, and resumes as soon as it moves.
+const uint32_t STILL_TIMEOUT_IN_MS = 30000;
+
+// While paused, the wait for motion wakes this often to check whether the task should stop.
+const uint32_t STILL_RECHECK_IN_MS = 1000;
+
+// Change in acceleration, in milli-G's, that counts as motion (multiple of 4).
+const uint16_t MOTION_THRESHOLD_IN_MG = 40;
+
+// Accelerometer-only low power sample rate while watching for motion. Motion is noticed within one sample plus
+// one CONFIG_MPU6886_WOM_POLL_MS poll (20 ms by default), as the INT pin is not routed on the EduKit.
+const uint16_t MOTION_SAMPLE_RATE_IN_HZ = 20;
+
 // Mock GPS is not absolute; it must be relative to a given starting point.
 const double GPS_MOCK_START_LAT = 44.98421;
 const double GPS_MOCK_START_LON = -93.27502;
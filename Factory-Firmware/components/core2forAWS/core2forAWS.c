@@ -1,4 +1,5 @@
 #include "stdbool.h"
+#include <assert.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -270,8 +271,12 @@ void Core2ForAWS_Sk6812_Clear(void) {
 
 SemaphoreHandle_t xGuiSemaphore;
 
+static TaskHandle_t gui_task_handle;
+
 static void guiTask(void *pvParameter);
+#if !CONFIG_LV_GUI_TASK_EVENT_DRIVEN
 static void lv_tick_task(void *arg);
+#endif
 
 #if CONFIG_SOFTWARE_FT6336U_SUPPORT
 static bool ft6336u_read(lv_indev_drv_t * drv, lv_indev_data_t * data);
@@ -282,6 +287,10 @@ void Core2ForAWS_Display_Init(void) {
 
     xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
     lv_init();
+    UIUpdate_Init();
+#if CONFIG_LV_IMG_RLE_DECODER
+    ImgRle_Init();
+#endif
     
     disp_spi_add_device(SPI_HOST_USE);
     disp_driver_init();
@@ -293,9 +302,18 @@ void Core2ForAWS_Display_Init(void) {
 
     static lv_disp_buf_t disp_buf;
 
+#if CONFIG_LV_DISP_BUF_MODE_INTERNAL_DMA
+    /* Small stripes the SPI DMA reads directly; LVGL renders into one while the other is sent */
+    const uint32_t buf_caps = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL;
+#else
+    /* PSRAM buffers; with CONFIG_LV_DISP_BUF_MODE_SPIRAM_BOUNCE disp_spi copies them through internal bounce buffers */
+    const uint32_t buf_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+#endif
+
     uint32_t size_in_px = DISP_BUF_SIZE;
-    lv_color_t *buf1 = heap_caps_malloc(DISP_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); //Assuming max size of lv_color_t = 16bit, DISP_BUF_SIZE calculated from max horizontal display size 480
-    lv_color_t *buf2 = heap_caps_malloc(DISP_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); //Assuming max size of lv_color_t = 16bit, DISP_BUF_SIZE calculated from max horizontal display size 480
+    lv_color_t *buf1 = heap_caps_malloc(DISP_BUF_SIZE * sizeof(lv_color_t), buf_caps); //Assuming max size of lv_color_t = 16bit, DISP_BUF_SIZE calculated from CONFIG_LV_DISP_BUF_LINES
+    lv_color_t *buf2 = heap_caps_malloc(DISP_BUF_SIZE * sizeof(lv_color_t), buf_caps); //Assuming max size of lv_color_t = 16bit, DISP_BUF_SIZE calculated from CONFIG_LV_DISP_BUF_LINES
+    assert(buf1 != NULL && buf2 != NULL);
     
     /* Initialize the working buffer depending on the selected display */
     lv_disp_buf_init(&disp_buf, buf1, buf2, size_in_px);
@@ -314,8 +332,12 @@ void Core2ForAWS_Display_Init(void) {
     indev_drv.read_cb = ft6336u_read;
     indev_drv.type = LV_INDEV_TYPE_POINTER;
     lv_indev_drv_register(&indev_drv);
+#if CONFIG_LV_GUI_TASK_EVENT_DRIVEN
+    FT6336U_AddTouchCallback(Core2ForAWS_Display_Notify);
+#endif
 #endif
 
+#if !CONFIG_LV_GUI_TASK_EVENT_DRIVEN
     /* Create and start a periodic timer interrupt to call lv_tick_inc */
     const esp_timer_create_args_t periodic_timer_args = {
         .callback = &lv_tick_task,
@@ -324,10 +346,27 @@ void Core2ForAWS_Display_Init(void) {
     esp_timer_handle_t periodic_timer;
     ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
     ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, LV_TICK_PERIOD_MS * 1000));
+#endif
 
     xSemaphoreGive(xGuiSemaphore);
 
-    xTaskCreatePinnedToCore(guiTask, "gui", 4096*2, NULL, 2, NULL, 1);
+    xTaskCreatePinnedToCore(guiTask, "gui", 4096*2, NULL, 2, &gui_task_handle, 1);
+}
+
+void Core2ForAWS_Display_Notify(void) {
+#if CONFIG_LV_GUI_TASK_EVENT_DRIVEN
+    /* The gui task picks up its own work before it goes back to sleep */
+    if (gui_task_handle != NULL && xTaskGetCurrentTaskHandle() != gui_task_handle) {
+        xTaskNotifyGive(gui_task_handle);
+    }
+#endif
+}
+
+void Core2ForAWS_Display_AsyncCall(lv_async_cb_t async_xcb, void *user_data) {
+    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+    lv_async_call(async_xcb, user_data);
+    xSemaphoreGive(xGuiSemaphore);
+    Core2ForAWS_Display_Notify();
 }
 
 void Core2ForAWS_Display_SetBrightness(uint8_t brightness) {
@@ -345,21 +384,78 @@ void Core2ForAWS_LED_Enable(uint8_t enable) {
 
 #if CONFIG_SOFTWARE_FT6336U_SUPPORT
 static bool ft6336u_read(lv_indev_drv_t * drv, lv_indev_data_t * data) {
-    bool valid = true;
-    uint16_t x = 0;
-    uint16_t y = 0;
-    FT6336U_GetTouch(&x, &y, &valid);
-    data->point.x = x;
-    data->point.y = y;
-    data->state = valid == false ? LV_INDEV_STATE_REL : LV_INDEV_STATE_PR;
-    return false;
+    static uint32_t cursor;
+    static ft6336u_touch_t touch;
+
+    /* Without a new sample the last one still holds */
+    uint32_t waiting = FT6336U_ReadTouch(&cursor, &touch);
+    data->point.x = touch.points[0].x;
+    data->point.y = touch.points[0].y;
+    data->state = touch.count == 0 ? LV_INDEV_STATE_REL : LV_INDEV_STATE_PR;
+
+    /* LVGL reads again right away while samples are buffered, so quick taps are not lost */
+    return waiting > 1;
 }
 #endif
 
+#if !CONFIG_LV_GUI_TASK_EVENT_DRIVEN
 static void lv_tick_task(void *arg) {
     (void) arg;
     lv_tick_inc(LV_TICK_PERIOD_MS);
 }
+#endif
+
+#if CONFIG_LV_GUI_TASK_EVENT_DRIVEN
+/* Milliseconds until the earliest enabled lv_task is due, LV_NO_TASK_READY if none */
+static uint32_t gui_next_deadline(void) {
+    uint32_t time_till_next = LV_NO_TASK_READY;
+    lv_task_t *task = lv_task_get_next(NULL);
+
+    /* The list is sorted by priority, so disabled tasks are at the end */
+    while (task != NULL && task->prio != LV_TASK_PRIO_OFF) {
+        uint32_t elapsed = lv_tick_elaps(task->last_run);
+        uint32_t remaining = elapsed >= task->period ? 0 : task->period - elapsed;
+        if (remaining < time_till_next) {
+            time_till_next = remaining;
+        }
+        task = lv_task_get_next(task);
+    }
+    return time_till_next;
+}
+
+/* Pauses the input read tasks while nothing is pressed (or resumes them on a touch),
+ * so an idle screen leaves no periodic LVGL work behind */
+static void gui_update_indev_tasks(bool resume) {
+    lv_indev_t *indev = lv_indev_get_next(NULL);
+
+    while (indev != NULL) {
+        if (resume) {
+            lv_task_set_prio(indev->driver.read_task, LV_TASK_PRIO_HIGH);
+        } else if (indev->proc.state == LV_INDEV_STATE_REL) {
+            lv_task_set_prio(indev->driver.read_task, LV_TASK_PRIO_OFF);
+        }
+        indev = lv_indev_get_next(indev);
+    }
+}
+#endif
+
+#if CONFIG_LV_DISP_PROFILER
+static inline int64_t gui_profile_time(void) {
+    return esp_timer_get_time();
+}
+
+/* Reports how long the gui task waited for and then held xGuiSemaphore */
+static inline void gui_profile_lock(int64_t requested_us, int64_t taken_us) {
+    DispProfiler_GuiLock((uint32_t) (taken_us - requested_us), (uint32_t) (esp_timer_get_time() - taken_us));
+}
+#else
+static inline int64_t gui_profile_time(void) {
+    return 0;
+}
+
+static inline void gui_profile_lock(int64_t requested_us, int64_t taken_us) {
+}
+#endif
 
 /**
  * @brief The FreeRTOS task that periodically calls lv_task_handler
@@ -368,22 +464,62 @@ static void lv_tick_task(void *arg) {
  * after a tick (depends on task prioritization), which executes 
  * LVGL tasks to then pass to the display controller. Learn more 
  * about LVGL Tasks[https://docs.lvgl.io/7.11/overview/task.html].
+ *
+ * With CONFIG_LV_GUI_TASK_EVENT_DRIVEN it instead sleeps until the
+ * earliest LVGL task deadline or until Core2ForAWS_Display_Notify()
+ * wakes it up.
  */
 static void guiTask(void *pvParameter) {
     
     (void) pvParameter;
 
+#if CONFIG_LV_GUI_TASK_EVENT_DRIVEN
+    bool notified = true;
 
+    while (1) {
+        uint32_t sleep_ms;
+
+        int64_t lock_requested_us = gui_profile_time();
+        if (pdTRUE == xSemaphoreTake(xGuiSemaphore, portMAX_DELAY)) {
+            int64_t lock_taken_us = gui_profile_time();
+            /* Any notification may be a touch, so give the input tasks a chance to read it */
+            if (notified) {
+                gui_update_indev_tasks(true);
+            }
+            UIUpdate_Process();
+            lv_task_handler();
+            gui_update_indev_tasks(false);
+            sleep_ms = gui_next_deadline();
+            gui_profile_lock(lock_requested_us, lock_taken_us);
+            xSemaphoreGive(xGuiSemaphore);
+        } else {
+            sleep_ms = 0;
+        }
+
+        if (sleep_ms > CONFIG_LV_GUI_TASK_MAX_SLEEP_MS) {
+            sleep_ms = CONFIG_LV_GUI_TASK_MAX_SLEEP_MS;
+        }
+
+        /* Sleep at least one tick so lower priority tasks on this core can run */
+        TickType_t sleep_ticks = pdMS_TO_TICKS(sleep_ms);
+        notified = ulTaskNotifyTake(pdTRUE, sleep_ticks > 0 ? sleep_ticks : 1) != 0;
+    }
+#else
     while (1) {
         /* Delay 1 tick (assumes FreeRTOS tick is 10ms */
         vTaskDelay(pdMS_TO_TICKS(10));
 
         /* Try to take the semaphore, call lvgl related function on success */
+        int64_t lock_requested_us = gui_profile_time();
         if (pdTRUE == xSemaphoreTake(xGuiSemaphore, portMAX_DELAY)) {
+            int64_t lock_taken_us = gui_profile_time();
+            UIUpdate_Process();
             lv_task_handler();
+            gui_profile_lock(lock_requested_us, lock_taken_us);
             xSemaphoreGive(xGuiSemaphore);
        }
     }
+#endif
 
     /* A task should NEVER return */
     vTaskDelete(NULL);
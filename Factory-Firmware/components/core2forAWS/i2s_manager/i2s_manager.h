@@ -0,0 +1,187 @@
+/**
+ * @file i2s_manager.h
+ * @brief Sharing of the I2S clock pin of the speaker and the microphone.
+ *
+ * On the Core2 for AWS, the LRCK line of the NS4168 speaker amplifier and the
+ * clock line of the SPM1423 PDM microphone are the same pin, GPIO0. Only one
+ * of them can be clocked at a time, but they do not need to share one I2S
+ * peripheral: the microphone has I2S0, the only one with PDM, and the speaker
+ * has I2S1. Both drivers stay installed, with their DMA buffers, and a switch
+ * only stops one peripheral, routes GPIO0 to the other in the GPIO matrix and
+ * starts it.
+ *
+ * The microphone has the pin by default. The speaker takes it around its writes
+ * with @ref I2SManager_AcquireTx() and @ref I2SManager_ReleaseTx(), which hand
+ * it back once the samples in the DMA buffers have played. For continuous
+ * playback while listening, @ref I2SManager_StartDuplex() alternates the pin
+ * between the two on a fixed schedule instead.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/i2s.h"
+
+/**
+ * @brief The pin the speaker and the microphone share.
+ */
+/* @[declare_i2smanager_shared_pin] */
+#define I2S_MANAGER_SHARED_PIN 0
+/* @[declare_i2smanager_shared_pin] */
+
+/**
+ * @brief I2S port of the microphone, PDM needs I2S0.
+ */
+/* @[declare_i2smanager_rx_port] */
+#define I2S_MANAGER_RX_PORT I2S_NUM_0
+/* @[declare_i2smanager_rx_port] */
+
+/**
+ * @brief I2S port of the speaker.
+ */
+/* @[declare_i2smanager_tx_port] */
+#define I2S_MANAGER_TX_PORT I2S_NUM_1
+/* @[declare_i2smanager_tx_port] */
+
+/**
+ * @brief The users of the shared pin.
+ */
+/* @[declare_i2smanager_dir_t] */
+typedef enum {
+    I2S_MANAGER_RX = 0,     /**< @brief The microphone. */
+    I2S_MANAGER_TX,         /**< @brief The speaker. */
+    I2S_MANAGER_NONE,       /**< @brief Nobody. */
+} i2s_manager_dir_t;
+/* @[declare_i2smanager_dir_t] */
+
+/**
+ * @brief Statistics of the switches of the shared pin.
+ */
+/* @[declare_i2smanager_stats_t] */
+typedef struct {
+    i2s_manager_dir_t owner;    /**< @brief Who has the pin now. */
+    bool duplex;                /**< @brief @ref I2SManager_StartDuplex() is running. */
+    uint32_t switches;          /**< @brief Times the pin changed hands. */
+    uint32_t switch_us_last;    /**< @brief Duration of the last switch in microseconds. */
+    uint32_t switch_us_max;     /**< @brief Longest switch in microseconds. */
+    uint64_t switch_us_total;   /**< @brief Time spent switching in microseconds. */
+    uint32_t drain_us_max;      /**< @brief Longest wait of @ref I2SManager_ReleaseTx() for the speaker DMA to play out. */
+} i2s_manager_stats_t;
+/* @[declare_i2smanager_stats_t] */
+
+/**
+ * @brief Installs the I2S driver of the speaker or of the microphone.
+ *
+ * The microphone takes the shared pin unless the speaker is writing, the
+ * speaker takes it if the microphone is not open.
+ *
+ * @param[in] dir @ref I2S_MANAGER_RX or @ref I2S_MANAGER_TX.
+ * @param[in] config The I2S configuration.
+ * @param[in] pins The I2S pins, the shared one as ws_io_num.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : Bad direction or configuration
+ *  - ESP_ERR_INVALID_STATE : Already open
+ *  - ESP_ERR_NO_MEM        : Out of memory
+ */
+/* @[declare_i2smanager_open] */
+esp_err_t I2SManager_Open(i2s_manager_dir_t dir, const i2s_config_t *config, const i2s_pin_config_t *pins);
+/* @[declare_i2smanager_open] */
+
+/**
+ * @brief Uninstalls the I2S driver of the speaker or of the microphone.
+ *
+ * The shared pin goes to the other one if it is open, and the pins nobody
+ * uses any more are reset.
+ *
+ * @param[in] dir @ref I2S_MANAGER_RX or @ref I2S_MANAGER_TX.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : Bad direction
+ *  - ESP_ERR_INVALID_STATE : Not open
+ */
+/* @[declare_i2smanager_close] */
+esp_err_t I2SManager_Close(i2s_manager_dir_t dir);
+/* @[declare_i2smanager_close] */
+
+/**
+ * @brief Gives the shared pin to the speaker for a write.
+ *
+ * Writers are served one at a time. In duplex mode the pin is not switched, the
+ * writes fill the DMA buffers and wait through the microphone time slots.
+ *
+ * @param[in] wait The most ticks to wait for another writer.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The speaker is not open
+ *  - ESP_ERR_TIMEOUT       : Another writer kept the speaker
+ */
+/* @[declare_i2smanager_acquiretx] */
+esp_err_t I2SManager_AcquireTx(TickType_t wait);
+/* @[declare_i2smanager_acquiretx] */
+
+/**
+ * @brief Ends a write of the speaker.
+ *
+ * If the microphone is open, waits for the samples in the DMA buffers to
+ * play out, then gives it the shared pin back.
+ */
+/* @[declare_i2smanager_releasetx] */
+void I2SManager_ReleaseTx(void);
+/* @[declare_i2smanager_releasetx] */
+
+/**
+ * @brief Ends a write of the speaker whose DMA buffers already played out.
+ *
+ * Same as @ref I2SManager_ReleaseTx() for a writer that waited for the
+ * samples to play, the pin goes back to the microphone without waiting again.
+ */
+/* @[declare_i2smanager_releasetxdrained] */
+void I2SManager_ReleaseTxDrained(void);
+/* @[declare_i2smanager_releasetxdrained] */
+
+/**
+ * @brief Alternates the shared pin between the microphone and the speaker.
+ *
+ * The microphone reads nothing during the speaker slots and the speaker plays
+ * nothing during the microphone slots, each picks up where it stopped. After
+ * each switch to the microphone, the first milliseconds of samples hold its
+ * wake-up transient.
+ *
+ * @param[in] rx_ms Length of the microphone slots, 1 to 1000.
+ * @param[in] tx_ms Length of the speaker slots, 1 to 1000.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : A slot length is out of range
+ *  - ESP_ERR_INVALID_STATE : Both are not open, or duplex is already running
+ *  - ESP_ERR_NO_MEM        : The task could not be created
+ */
+/* @[declare_i2smanager_startduplex] */
+esp_err_t I2SManager_StartDuplex(uint16_t rx_ms, uint16_t tx_ms);
+/* @[declare_i2smanager_startduplex] */
+
+/**
+ * @brief Stops the duplex mode, the microphone keeps the shared pin.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : Duplex is not running
+ */
+/* @[declare_i2smanager_stopduplex] */
+esp_err_t I2SManager_StopDuplex(void);
+/* @[declare_i2smanager_stopduplex] */
+
+/**
+ * @brief Retrieves the statistics of the switches.
+ *
+ * @param[out] stats The statistics.
+ */
+/* @[declare_i2smanager_getstats] */
+void I2SManager_GetStats(i2s_manager_stats_t *stats);
+/* @[declare_i2smanager_getstats] */
@@ -0,0 +1,55 @@
+/**
+ * @file latency_histogram.h
+ * @brief Histogram of durations with power of two buckets, shared by the
+ * I2C trace and the display profiler.
+ *
+ * The histogram is not synchronized, its owner guards it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Number of histogram buckets. Bucket i counts durations below
+ * (LATENCY_HISTOGRAM_BASE_US << i) microseconds, the last bucket counts
+ * everything longer.
+ */
+#define LATENCY_HISTOGRAM_BUCKETS   16
+#define LATENCY_HISTOGRAM_BASE_US   16U
+
+/**
+ * @brief Histogram of durations.
+ */
+/* @[declare_latency_histogram_t] */
+typedef struct {
+    uint32_t count;                                 /**< Number of samples. */
+    uint32_t min_us;                                /**< Shortest sample. */
+    uint32_t max_us;                                /**< Longest sample. */
+    uint64_t total_us;                              /**< Sum of all samples. */
+    uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];    /**< Samples per duration bucket. */
+} latency_histogram_t;
+/* @[declare_latency_histogram_t] */
+
+/**
+ * @brief Adds a duration to the histogram.
+ *
+ * @param[in,out] hist The histogram, zeroed before its first sample.
+ * @param[in] us The duration.
+ */
+/* @[declare_latencyhistogram_add] */
+void LatencyHistogram_Add(latency_histogram_t *hist, uint32_t us);
+/* @[declare_latencyhistogram_add] */
+
+/**
+ * @brief Upper bound of the bucket holding a percentile of the samples.
+ *
+ * @param[in] hist The histogram.
+ * @param[in] percent The percentile, 0 to 100.
+ *
+ * @return The upper bound of the bucket in microseconds, the longest sample
+ * for the open-ended last bucket.
+ */
+/* @[declare_latencyhistogram_percentile] */
+uint32_t LatencyHistogram_Percentile(const latency_histogram_t *hist, uint32_t percent);
+/* @[declare_latencyhistogram_percentile] */
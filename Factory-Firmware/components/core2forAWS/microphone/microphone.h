@@ -5,6 +5,12 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
 /**
  * @brief Microphone I2S port number. 
  */
@@ -15,10 +21,8 @@
 /**
  * @brief Initializes the microphone over I2S.
  * 
- * @note The microphone cannot be enabled at the same time
- * as the speaker since they both share a common pin (GPIO0).
- * Attempting to enable and use both at the same time will 
- * cause the device to hard fault.
+ * @note The microphone shares a common pin (GPIO0) with the speaker,
+ * it receives no samples while the speaker writes. See i2s_manager.h.
  */
 /* @[declare_microphone_init] */
 void Microphone_Init();
@@ -30,3 +34,189 @@ void Microphone_Init();
 /* @[declare_microphone_deinit] */
 void Microphone_Deinit();
 /* @[declare_microphone_deinit] */
+
+/**
+ * @brief Settings of the capture service of @ref Microphone_StartCapture().
+ *
+ * Settings left at 0 take the value of the menuconfig "Microphone SPM1423" options.
+ */
+/* @[declare_microphone_capture_config_t] */
+typedef struct {
+    uint32_t sample_rate;       /**< @brief Samples per second. */
+    uint16_t dma_buf_count;     /**< @brief I2S DMA buffers, 2 to 128. */
+    uint16_t dma_buf_len;       /**< @brief Samples per DMA buffer, 8 to 1024. */
+    uint16_t frame_samples;     /**< @brief Samples per published frame. */
+    uint8_t pool_frames;        /**< @brief Frames in the pool shared by the consumers, at least 2. */
+} mic_capture_config_t;
+/* @[declare_microphone_capture_config_t] */
+
+/**
+ * @brief A frame of samples published by the capture service.
+ *
+ * Frames are shared by every consumer and must not be written to.
+ * Each received frame must be handed back with @ref Microphone_ReleaseFrame().
+ *
+ * discontinuity only tells of samples the capture itself lost. A frame a
+ * consumer missed because its own queue was full is not flagged, as the
+ * other consumers received it: consumers detect their misses from gaps in
+ * sequence.
+ */
+/* @[declare_microphone_frame_t] */
+typedef struct {
+    const int16_t *samples;     /**< @brief The samples, mono 16 bit. */
+    uint16_t count;             /**< @brief Number of samples. */
+    uint32_t sequence;          /**< @brief Frames captured before this one, published or not. */
+    int64_t time_us;            /**< @brief When the first sample was taken, from esp_timer_get_time(). */
+    bool discontinuity;         /**< @brief The capture lost samples between the previous frame and this one. */
+    uint8_t refs;               /**< @brief Internal, consumers still holding the frame. */
+} mic_frame_t;
+/* @[declare_microphone_frame_t] */
+
+/**
+ * @brief A consumer of the capture service.
+ */
+/* @[declare_microphone_subscriber_t] */
+typedef struct mic_subscriber *mic_subscriber_t;
+/* @[declare_microphone_subscriber_t] */
+
+/**
+ * @brief Statistics of the capture service since it was started.
+ */
+/* @[declare_microphone_capture_stats_t] */
+typedef struct {
+    uint32_t frames;            /**< @brief Frames captured. */
+    uint32_t published;         /**< @brief Frames handed to at least one consumer. */
+    uint32_t pool_empty;        /**< @brief Frames dropped because consumers held every frame of the pool. */
+    uint32_t queue_full;        /**< @brief Frames a consumer missed because its queue was full, all consumers. */
+    uint32_t dma_overruns;      /**< @brief Times the DMA buffers filled up before they were read. */
+    uint32_t dma_lost_samples;  /**< @brief Samples the DMA overruns lost. */
+    int64_t last_overrun_us;    /**< @brief When the last DMA overrun was seen, 0 if never. */
+    uint8_t free_frames;        /**< @brief Frames of the pool no consumer holds now. */
+} mic_capture_stats_t;
+/* @[declare_microphone_capture_stats_t] */
+
+/**
+ * @brief Starts the capture service.
+ *
+ * The service installs the I2S driver of the microphone and reads it from the
+ * `MicCaptureTask` FreeRTOS task, one frame at a time, straight into a frame
+ * of a pool. While the consumers process a frame the next one is filled.
+ * Every frame is queued to every consumer without copies: all of them get
+ * a pointer to the same samples, and the frame returns to the pool when the
+ * last one releases it. A frame that finds the pool empty is dropped, as is
+ * a frame for a consumer whose queue is full, and both are counted.
+ *
+ * @note Like @ref Microphone_Init(), the capture cannot run at the same time
+ * as the speaker, and it cannot run with @ref Microphone_Init().
+ *
+ * **Example:**
+ *
+ * A level meter running on the frames.
+ * @code{c}
+ *  mic_capture_config_t config = { .sample_rate = 8000 };
+ *  mic_subscriber_t meter;
+ *  const mic_frame_t *frame;
+ *
+ *  Microphone_StartCapture(&config);
+ *  Microphone_Subscribe(2, &meter);
+ *  for (;;) {
+ *      if (Microphone_ReceiveFrame(meter, &frame, portMAX_DELAY) == ESP_OK) {
+ *          int16_t peak = 0;
+ *          for (int i = 0; i < frame->count; i++) {
+ *              peak = abs(frame->samples[i]) > peak ? abs(frame->samples[i]) : peak;
+ *          }
+ *          Microphone_ReleaseFrame(frame);
+ *          printf("peak %d\n", peak);
+ *      }
+ *  }
+ * @endcode
+ *
+ * @param[in] config The settings, NULL for the menuconfig ones.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : A setting is out of range
+ *  - ESP_ERR_INVALID_STATE : The capture is already running or the I2S port is in use
+ *  - ESP_ERR_NO_MEM        : Out of memory
+ */
+/* @[declare_microphone_startcapture] */
+esp_err_t Microphone_StartCapture(const mic_capture_config_t *config);
+/* @[declare_microphone_startcapture] */
+
+/**
+ * @brief Stops the capture service and frees the I2S port and the pool.
+ *
+ * @note Every consumer must release its frames and unsubscribe first. The
+ * capture keeps running while a frame is not released, as freeing the pool
+ * would free it under its consumer.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The capture is not running, consumers are still subscribed or frames are not released
+ */
+/* @[declare_microphone_stopcapture] */
+esp_err_t Microphone_StopCapture(void);
+/* @[declare_microphone_stopcapture] */
+
+/**
+ * @brief Adds a consumer of the frames.
+ *
+ * @param[in] depth Frames the consumer can have waiting, later ones are dropped for it.
+ * @param[out] subscriber The consumer.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : depth is 0 or subscriber is NULL
+ *  - ESP_ERR_INVALID_STATE : The capture is not running
+ *  - ESP_ERR_NO_MEM        : CONFIG_MIC_CAPTURE_MAX_SUBSCRIBERS are already subscribed, or out of memory
+ */
+/* @[declare_microphone_subscribe] */
+esp_err_t Microphone_Subscribe(uint8_t depth, mic_subscriber_t *subscriber);
+/* @[declare_microphone_subscribe] */
+
+/**
+ * @brief Removes a consumer, releasing the frames still queued for it.
+ *
+ * @param[in] subscriber The consumer.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : Not a subscribed consumer
+ */
+/* @[declare_microphone_unsubscribe] */
+esp_err_t Microphone_Unsubscribe(mic_subscriber_t subscriber);
+/* @[declare_microphone_unsubscribe] */
+
+/**
+ * @brief Waits for the next frame of a consumer.
+ *
+ * @param[in] subscriber The consumer.
+ * @param[out] frame The frame, to be released with @ref Microphone_ReleaseFrame().
+ * @param[in] wait The most ticks to wait.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : subscriber or frame is NULL
+ *  - ESP_ERR_TIMEOUT       : No frame came in time
+ */
+/* @[declare_microphone_receiveframe] */
+esp_err_t Microphone_ReceiveFrame(mic_subscriber_t subscriber, const mic_frame_t **frame, TickType_t wait);
+/* @[declare_microphone_receiveframe] */
+
+/**
+ * @brief Hands a received frame back, it returns to the pool once every consumer has.
+ *
+ * @param[in] frame The frame.
+ */
+/* @[declare_microphone_releaseframe] */
+void Microphone_ReleaseFrame(const mic_frame_t *frame);
+/* @[declare_microphone_releaseframe] */
+
+/**
+ * @brief Retrieves the statistics of the capture service.
+ *
+ * @param[out] stats The statistics.
+ */
+/* @[declare_microphone_getcapturestats] */
+void Microphone_GetCaptureStats(mic_capture_stats_t *stats);
+/* @[declare_microphone_getcapturestats] */
@@ -0,0 +1,167 @@
+/**
+ * @file mpu6886_fusion.h
+ * @brief Orientation estimation from the MPU6886 accelerometer and gyroscope.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "mpu6886.h"
+
+/**
+ * @brief State of a Mahony complementary filter.
+ *
+ * The gyroscope is integrated into the orientation and the accelerometer
+ * pulls it towards gravity, which also estimates the remaining gyroscope
+ * bias. Everything is single-precision float, which the ESP32 computes in
+ * hardware. Roll and pitch are absolute, the yaw drifts slowly since there
+ * is no magnetometer to correct it.
+ */
+/* @[declare_mpu6886_fusion_t] */
+typedef struct {
+    float q[4];             /**< @brief Orientation quaternion w, x, y, z rotating device coordinates into the world. */
+    float gyro_bias[3];     /**< @brief Calibrated gyroscope bias in degrees per second, subtracted from the samples. */
+    float integral[3];      /**< @brief Bias left after the calibration, estimated by the filter in radians per second. */
+    float accel[3];         /**< @brief Accelerometer reading of the last update in G's. */
+    float kp;               /**< @brief Proportional gain of the accelerometer correction. */
+    float ki;               /**< @brief Integral gain of the accelerometer correction. */
+    int64_t time_us;        /**< @brief Time of the last sample. */
+    bool started;           /**< @brief Whether the orientation was set from a first sample. */
+    uint32_t updates;       /**< @brief Samples processed. */
+    uint64_t cycles;        /**< @brief CPU cycles spent in MPU6886_FusionUpdate(). */
+    uint32_t cycles_max;    /**< @brief Most CPU cycles of one update. */
+} mpu6886_fusion_t;
+/* @[declare_mpu6886_fusion_t] */
+
+/**
+ * @brief Orientation and motion derived from the filter state.
+ */
+/* @[declare_mpu6886_attitude_t] */
+typedef struct {
+    float q[4];                 /**< @brief Orientation quaternion w, x, y, z rotating device coordinates into the world. */
+    float roll;                 /**< @brief Rotation around X in degrees, from -180 to 180. */
+    float pitch;                /**< @brief Rotation around Y in degrees, from -90 to 90. */
+    float yaw;                  /**< @brief Rotation around Z in degrees, from -180 to 180, relative to the start. */
+    float gravity[3];           /**< @brief Direction of gravity in device coordinates, a unit vector. */
+    float linear_accel[3];      /**< @brief Acceleration with gravity removed in device coordinates in G's. */
+    float linear_accel_world[3];/**< @brief Acceleration with gravity removed in world coordinates in G's, Z is up. */
+} mpu6886_attitude_t;
+/* @[declare_mpu6886_attitude_t] */
+
+/**
+ * @brief Initializes a filter.
+ *
+ * The gains come from CONFIG_MPU6886_FUSION_KP and CONFIG_MPU6886_FUSION_KI,
+ * and the gyroscope bias saved by MPU6886_CalibrateGyroBias() is loaded from
+ * NVS if there is one. NVS must have been initialized with nvs_flash_init()
+ * for that. The orientation is set from the first sample.
+ *
+ * @param[out] fusion The filter.
+ */
+/* @[declare_mpu6886_fusioninit] */
+void MPU6886_FusionInit(mpu6886_fusion_t *fusion);
+/* @[declare_mpu6886_fusioninit] */
+
+/**
+ * @brief Updates a filter with a sample.
+ *
+ * Meant to be fed every sample of MPU6886_ReadSample(), so it runs at the
+ * output data rate of the stream. The time step is taken from the sample
+ * timestamps. After a gap of more than 100 ms the orientation is set again
+ * from the accelerometer. While the acceleration is far from 1 G, e.g. when
+ * the device is shaken, only the gyroscope is used.
+ *
+ * An update with the accelerometer correction takes about 60 float
+ * multiplications, 40 additions, two square roots and two divisions. The
+ * ESP32 FPU computes the last two with instruction sequences rather than
+ * single instructions, so they weigh the most. The cycles are counted into
+ * the filter state, and fusion.cycles / fusion.updates is the cost per
+ * update on the device that runs it. No ESP32 measurement has been recorded
+ * yet. The cycles printed by test_host/bench_fusion are host time stamp
+ * counter cycles and do not reflect the Xtensa FPU.
+ *
+ * **Example:**
+ *
+ * Print the tilt of the device and the cycles of an update.
+ * @code{c}
+ *  static mpu6886_fusion_t fusion;
+ *  static uint32_t cursor = 0;
+ *  mpu6886_sample_t sample;
+ *  mpu6886_attitude_t attitude;
+ *
+ *  MPU6886_FusionInit(&fusion);
+ *  MPU6886_StartStream(500);
+ *  for (;;) {
+ *      vTaskDelay(pdMS_TO_TICKS(100));
+ *      while (MPU6886_ReadSample(&cursor, &sample)) {
+ *          MPU6886_FusionUpdate(&fusion, &sample);
+ *      }
+ *      MPU6886_FusionGetAttitude(&fusion, &attitude);
+ *      printf("Roll: %.1f Pitch: %.1f, %u cycles per update\n", attitude.roll, attitude.pitch,
+ *             (uint32_t) (fusion.cycles / fusion.updates));
+ *  }
+ * @endcode
+ *
+ * @param[in,out] fusion The filter.
+ * @param[in] sample The next sample.
+ */
+/* @[declare_mpu6886_fusionupdate] */
+void MPU6886_FusionUpdate(mpu6886_fusion_t *fusion, const mpu6886_sample_t *sample);
+/* @[declare_mpu6886_fusionupdate] */
+
+/**
+ * @brief Retrieves the orientation and the acceleration without gravity.
+ *
+ * @param[in] fusion The filter.
+ * @param[out] attitude The orientation as of the last sample.
+ */
+/* @[declare_mpu6886_fusiongetattitude] */
+void MPU6886_FusionGetAttitude(const mpu6886_fusion_t *fusion, mpu6886_attitude_t *attitude);
+/* @[declare_mpu6886_fusiongetattitude] */
+
+/**
+ * @brief Measures the gyroscope bias and saves it to NVS.
+ *
+ * The device must lie still while the gyroscope and the accelerometer are
+ * read every 2 ms, or every tick if that is longer, for the duration. The bias is the average reading. Filters initialized afterwards
+ * load it, running ones can be given it with MPU6886_FusionSetGyroBias().
+ *
+ * @param[in] duration_ms How long to measure, at least 100 ms.
+ * @param[out] bias The bias around X, Y and Z in degrees per second.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : The duration is too short
+ *  - ESP_ERR_INVALID_STATE : The device moved during the measurement, nothing was saved
+ *  - Others                : The error of the NVS functions
+ */
+/* @[declare_mpu6886_calibrategyrobias] */
+esp_err_t MPU6886_CalibrateGyroBias(uint32_t duration_ms, float bias[3]);
+/* @[declare_mpu6886_calibrategyrobias] */
+
+/**
+ * @brief Loads the gyroscope bias saved by MPU6886_CalibrateGyroBias().
+ *
+ * @param[out] bias The bias around X, Y and Z in degrees per second.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_NVS_NOT_FOUND : No bias was saved
+ *  - Others                : The error of the NVS functions
+ */
+/* @[declare_mpu6886_loadgyrobias] */
+esp_err_t MPU6886_LoadGyroBias(float bias[3]);
+/* @[declare_mpu6886_loadgyrobias] */
+
+/**
+ * @brief Sets the gyroscope bias of a filter.
+ *
+ * @param[in,out] fusion The filter.
+ * @param[in] bias The bias around X, Y and Z in degrees per second.
+ */
+/* @[declare_mpu6886_fusionsetgyrobias] */
+void MPU6886_FusionSetGyroBias(mpu6886_fusion_t *fusion, const float bias[3]);
+/* @[declare_mpu6886_fusionsetgyrobias] */
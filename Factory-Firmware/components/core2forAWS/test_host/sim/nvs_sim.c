@@ -0,0 +1,146 @@
+/*
+ * Non-volatile storage of the simulated board.
+ *
+ * Blobs are kept in memory for the life of the program. Namespaces get a
+ * handle each and nothing is written before nvs_commit(), like the flash.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "sim.h"
+
+#define SIM_NVS_ENTRIES     32
+#define SIM_NVS_NAMESPACES  8
+#define SIM_NVS_KEY_LEN     16
+#define SIM_NVS_BLOB_MAX    256
+
+typedef struct {
+    bool used;
+    bool committed;
+    uint8_t ns;
+    char key[SIM_NVS_KEY_LEN];
+    uint8_t value[SIM_NVS_BLOB_MAX];
+    size_t length;
+    /* Written by nvs_set_blob() and not committed yet */
+    bool pending;
+    uint8_t pending_value[SIM_NVS_BLOB_MAX];
+    size_t pending_length;
+} sim_nvs_entry_t;
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char namespaces[SIM_NVS_NAMESPACES][SIM_NVS_KEY_LEN];
+static sim_nvs_entry_t entries[SIM_NVS_ENTRIES];
+
+static sim_nvs_entry_t *sim_nvs_find(nvs_handle_t handle, const char *key, bool create) {
+    sim_nvs_entry_t *free_entry = NULL;
+    for (int i = 0; i < SIM_NVS_ENTRIES; i++) {
+        if (entries[i].used && entries[i].ns == handle - 1 && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+        if (!entries[i].used && free_entry == NULL) {
+            free_entry = &entries[i];
+        }
+    }
+    if (!create || free_entry == NULL) {
+        return NULL;
+    }
+    memset(free_entry, 0, sizeof(*free_entry));
+    free_entry->used = true;
+    free_entry->ns = handle - 1;
+    strncpy(free_entry->key, key, SIM_NVS_KEY_LEN - 1);
+    return free_entry;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    (void) open_mode;
+    if (name == NULL || strlen(name) >= SIM_NVS_KEY_LEN || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    for (int i = 0; i < SIM_NVS_NAMESPACES; i++) {
+        if (namespaces[i][0] == '\0') {
+            strcpy(namespaces[i], name);
+        }
+        if (strcmp(namespaces[i], name) == 0) {
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    pthread_mutex_lock(&nvs_lock);
+    sim_nvs_entry_t *entry = sim_nvs_find(handle, key, false);
+    esp_err_t err = ESP_OK;
+    if (entry == NULL || !entry->committed) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out_value == NULL) {
+        *length = entry->length;
+    } else if (*length < entry->length) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out_value, entry->value, entry->length);
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if (key == NULL || strlen(key) >= SIM_NVS_KEY_LEN || length > SIM_NVS_BLOB_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    sim_nvs_entry_t *entry = sim_nvs_find(handle, key, true);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (entry) {
+        memcpy(entry->pending_value, value, length);
+        entry->pending_length = length;
+        entry->pending = true;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    pthread_mutex_lock(&nvs_lock);
+    sim_nvs_entry_t *entry = sim_nvs_find(handle, key, false);
+    esp_err_t err = entry ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+    if (entry) {
+        entry->used = false;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < SIM_NVS_ENTRIES; i++) {
+        sim_nvs_entry_t *entry = &entries[i];
+        if (entry->used && entry->ns == handle - 1 && entry->pending) {
+            memcpy(entry->value, entry->pending_value, entry->pending_length);
+            entry->length = entry->pending_length;
+            entry->committed = true;
+            entry->pending = false;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    (void) handle;
+}
+
+void sim_nvs_erase_all(void) {
+    pthread_mutex_lock(&nvs_lock);
+    memset(entries, 0, sizeof(entries));
+    pthread_mutex_unlock(&nvs_lock);
+}
@@ -0,0 +1,3 @@
+/* Host stand-in, the simulated drivers touch no DPORT registers */
+
+#pragma once
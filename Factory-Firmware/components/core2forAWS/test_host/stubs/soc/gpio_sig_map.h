@@ -0,0 +1,11 @@
+/* Host stand-in for the GPIO matrix signals of the ESP32, the ones the drivers route */
+
+#pragma once
+
+#define I2S0O_BCK_OUT_IDX       12
+#define I2S0O_WS_OUT_IDX        13
+#define I2S1O_BCK_OUT_IDX       14
+#define I2S1O_WS_OUT_IDX        15
+#define I2S0O_DATA_OUT23_IDX    166
+#define I2S1O_DATA_OUT23_IDX    190
+#define SIG_GPIO_OUT_IDX        256
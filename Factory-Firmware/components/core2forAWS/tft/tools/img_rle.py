@@ -0,0 +1,260 @@
+#!/usr/bin/env python
+#
+# Converts an image C file written by the LVGL image converter
+# (https://lvgl.io/tools/imageconverter) into a run-length encoded image
+# for the decoder in tft/img_rle.c. The output declares the same
+# lv_img_dsc_t, so it replaces the input file in the build.
+#
+#   img_rle.py house_on.c -o house_on_rle.c --color-depth 16 --swap
+#
+# True color images keep their color format, indexed images are expanded
+# to LV_IMG_CF_TRUE_COLOR_ALPHA the same way LVGL's built-in decoder
+# expands them while drawing. The layout is described in tft/img_rle.h.
+#
+# Images the encoding does not make smaller than the input, at the chosen
+# color depth, are written unencoded in their own color format and are
+# drawn by LVGL's built-in decoder.
+
+from __future__ import print_function
+
+import argparse
+import re
+import struct
+import sys
+
+RLE_VERSION = 1
+
+# Values of lv_img_cf_t
+CF_TRUE_COLOR = 4
+CF_TRUE_COLOR_ALPHA = 5
+CF_TRUE_COLOR_CHROMA_KEYED = 6
+CF_INDEXED = {'LV_IMG_CF_INDEXED_1BIT': 1, 'LV_IMG_CF_INDEXED_2BIT': 2,
+              'LV_IMG_CF_INDEXED_4BIT': 4, 'LV_IMG_CF_INDEXED_8BIT': 8}
+CF_TRUE = {'LV_IMG_CF_TRUE_COLOR': CF_TRUE_COLOR,
+           'LV_IMG_CF_TRUE_COLOR_ALPHA': CF_TRUE_COLOR_ALPHA,
+           'LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED': CF_TRUE_COLOR_CHROMA_KEYED}
+
+MAX_PACKET = 128
+
+
+def fail(msg):
+    print('img_rle.py: ' + msg, file=sys.stderr)
+    sys.exit(1)
+
+
+def eval_condition(cond, depth, swap):
+    expr = cond.replace('||', ' or ').replace('&&', ' and ')
+    expr = expr.replace('LV_COLOR_DEPTH', str(depth)).replace('LV_COLOR_16_SWAP', str(swap))
+    if not re.match(r'^[\s\d=!<>()andor]*$', expr):
+        fail('unsupported condition: ' + cond)
+    return eval(expr)
+
+
+def parse(path, depth, swap):
+    with open(path) as f:
+        text = re.sub(r'/\*.*?\*/', '', f.read(), flags=re.S)
+        text = re.sub(r'//[^\n]*', '', text)
+
+    def field(name):
+        m = re.search(r'\.' + re.escape(name) + r'\s*=\s*([^,\n]+),', text)
+        if not m:
+            fail('%s: no %s' % (path, name))
+        return m.group(1).strip()
+
+    img = {
+        'w': int(field('header.w'), 0),
+        'h': int(field('header.h'), 0),
+        'cf': field('header.cf'),
+        'data': field('data'),
+    }
+    m = re.search(r'const\s+lv_img_dsc_t\s+(\w+)\s*=', text)
+    if not m:
+        fail('%s: no lv_img_dsc_t' % path)
+    img['name'] = m.group(1)
+
+    m = re.search(r'uint8_t\s+' + re.escape(img['data']) + r'\s*\[\s*\]\s*=\s*\{(.*?)\};', text, re.S)
+    if not m:
+        fail('%s: no %s array' % (path, img['data']))
+
+    # Keep the lines of the array that apply to the requested color depth
+    values = []
+    active = [True]
+    for line in m.group(1).split('\n'):
+        line = line.strip()
+        if line.startswith('#if'):
+            active.append(active[-1] and eval_condition(line[3:], depth, swap))
+        elif line.startswith('#elif') or line.startswith('#else'):
+            fail('%s: #elif/#else are not supported' % path)
+        elif line.startswith('#endif'):
+            active.pop()
+        elif active[-1]:
+            values += [int(v, 16) for v in re.findall(r'0x[0-9a-fA-F]+', line)]
+    img['bytes'] = bytes(bytearray(values))
+    return img
+
+
+def color_bytes(r, g, b, depth, swap):
+    """Same conversion as lv_color_make()"""
+    if depth == 32:
+        return bytearray([b, g, r, 0xFF])
+    full = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+    if swap:
+        full = ((full & 0xFF) << 8) | (full >> 8)
+    return bytearray(struct.pack('<H', full))
+
+
+def alpha_px_size(depth):
+    """Same as LV_IMG_PX_SIZE_ALPHA_BYTE, ARGB8888 at depth 32"""
+    return 4 if depth == 32 else depth // 8 + 1
+
+
+def to_pixels(img, depth, swap):
+    """Returns the decoded color format, pixel size and the pixels line by line"""
+    w, h, data = img['w'], img['h'], img['bytes']
+
+    if img['cf'] in CF_TRUE:
+        cf = CF_TRUE[img['cf']]
+        px_size = alpha_px_size(depth) if cf == CF_TRUE_COLOR_ALPHA else depth // 8
+        if len(data) < w * h * px_size:
+            fail('%s: expected %d bytes, found %d' % (img['name'], w * h * px_size, len(data)))
+        lines = []
+        for y in range(h):
+            line = data[y * w * px_size:(y + 1) * w * px_size]
+            lines.append([line[x * px_size:(x + 1) * px_size] for x in range(w)])
+        return cf, px_size, lines
+
+    if img['cf'] in CF_INDEXED:
+        bpp = CF_INDEXED[img['cf']]
+        colors = 1 << bpp
+        palette = []
+        for i in range(colors):
+            b, g, r, a = bytearray(data[i * 4:i * 4 + 4])
+            color = color_bytes(r, g, b, depth, swap)
+            # The alpha takes the place of the opaque fourth byte at depth 32
+            palette.append(bytes(color[:3] + bytearray([a]) if depth == 32 else color + bytearray([a])))
+        indices = bytearray(data[colors * 4:])
+        stride = (w * bpp + 7) // 8
+        if len(indices) < stride * h:
+            fail('%s: expected %d index bytes, found %d' % (img['name'], stride * h, len(indices)))
+        lines = []
+        for y in range(h):
+            line = []
+            for x in range(w):
+                bit = x * bpp
+                byte = indices[y * stride + bit // 8]
+                index = (byte >> (8 - bpp - bit % 8)) & (colors - 1)
+                line.append(palette[index])
+            lines.append(line)
+        return CF_TRUE_COLOR_ALPHA, alpha_px_size(depth), lines
+
+    fail('%s: color format %s is not supported' % (img['name'], img['cf']))
+
+
+def encode_line(line):
+    out = bytearray()
+    literal = []
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:MAX_PACKET]
+            del literal[:MAX_PACKET]
+            out.append(len(chunk) - 1)
+            for px in chunk:
+                out.extend(px)
+
+    x = 0
+    while x < len(line):
+        run = 1
+        while x + run < len(line) and run < MAX_PACKET and line[x + run] == line[x]:
+            run += 1
+        if run >= 2:
+            flush_literal()
+            out.append(0x7F + run)
+            out.extend(line[x])
+        else:
+            literal.append(line[x])
+        x += run
+    flush_literal()
+    return out
+
+
+def encode(img, depth, swap):
+    cf, px_size, lines = to_pixels(img, depth, swap)
+
+    encoded = [encode_line(line) for line in lines]
+    offset = 4 + 4 * len(lines)
+    out = bytearray([RLE_VERSION, cf, depth, swap])
+    for line in encoded:
+        out.extend(struct.pack('<I', offset))
+        offset += len(line)
+    for line in encoded:
+        out.extend(line)
+    return cf, px_size, out
+
+
+def write_header(f, img, depth, swap):
+    name = img['name']
+    f.write('/* Generated by img_rle.py from %s, do not edit. */\n\n' % name)
+    f.write('#if defined(LV_LVGL_H_INCLUDE_SIMPLE)\n#include "lvgl.h"\n#else\n#include "lvgl/lvgl.h"\n#endif\n\n')
+    f.write('#if LV_COLOR_DEPTH != %d || LV_COLOR_16_SWAP != %d\n' % (depth, swap))
+    f.write('#error "%s was encoded for LV_COLOR_DEPTH %d and LV_COLOR_16_SWAP %d"\n#endif\n\n' % (name, depth, swap))
+    f.write('#ifndef LV_ATTRIBUTE_MEM_ALIGN\n#define LV_ATTRIBUTE_MEM_ALIGN\n#endif\n\n')
+
+
+def write_array(f, name, data, storage=''):
+    f.write(storage + 'const LV_ATTRIBUTE_MEM_ALIGN LV_ATTRIBUTE_LARGE_CONST uint8_t %s[] = {\n' % name)
+    for i in range(0, len(data), 16):
+        f.write('  ' + ', '.join('0x%02x' % b for b in bytearray(data[i:i + 16])) + ',\n')
+    f.write('};\n\n')
+
+
+def write_dsc(f, img, cf, data_name, data_size):
+    f.write('const lv_img_dsc_t %s = {\n' % img['name'])
+    f.write('  .header.always_zero = 0,\n')
+    f.write('  .header.w = %d,\n' % img['w'])
+    f.write('  .header.h = %d,\n' % img['h'])
+    f.write('  .data_size = %d,\n' % data_size)
+    f.write('  .header.cf = %s,\n' % cf)
+    f.write('  .data = %s,\n' % data_name)
+    f.write('};\n')
+
+
+def write_c(path, img, depth, swap, out, raw_size):
+    name = img['name']
+    with open(path, 'w') as f:
+        write_header(f, img, depth, swap)
+        f.write('/* %d bytes, %d decoded */\n' % (len(out), raw_size))
+        write_array(f, name + '_rle_map', out)
+        write_dsc(f, img, 'LV_IMG_CF_USER_ENCODED_0', name + '_rle_map', len(out))
+
+
+def write_plain_c(path, img, depth, swap, rle_size):
+    """Writes the input pixels for the color depth, in their own color format"""
+    name = img['name']
+    with open(path, 'w') as f:
+        write_header(f, img, depth, swap)
+        f.write('/* Not encoded, %d bytes would have been %d */\n' % (len(img['bytes']), rle_size))
+        # Static, the input that declares the same array is left out of the build
+        write_array(f, name + '_map', img['bytes'], 'static ')
+        write_dsc(f, img, img['cf'], name + '_map', len(img['bytes']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run-length encode an LVGL image C file')
+    parser.add_argument('input', help='C file written by the LVGL image converter')
+    parser.add_argument('-o', '--output', required=True, help='C file to write')
+    parser.add_argument('--color-depth', type=int, choices=[16, 32], default=16, help='LV_COLOR_DEPTH')
+    parser.add_argument('--swap', action='store_true', help='LV_COLOR_16_SWAP is enabled')
+    args = parser.parse_args()
+
+    swap = 1 if args.swap and args.color_depth == 16 else 0
+    img = parse(args.input, args.color_depth, swap)
+    cf, px_size, out = encode(img, args.color_depth, swap)
+    if len(out) >= len(img['bytes']):
+        write_plain_c(args.output, img, args.color_depth, swap, len(out))
+    else:
+        write_c(args.output, img, args.color_depth, swap, out, img['w'] * img['h'] * px_size)
+
+
+if __name__ == '__main__':
+    main()
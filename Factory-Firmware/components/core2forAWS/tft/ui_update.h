@@ -0,0 +1,132 @@
+/**
+ * @file ui_update.h
+ * @brief Non-blocking channel to update LVGL widgets from other FreeRTOS tasks.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "lvgl/lvgl.h"
+
+/**
+ * @brief Creates the update queue.
+ *
+ * @note Core2ForAWS_Display_Init() calls this function when the
+ * display hardware feature is enabled.
+ */
+/* @[declare_uiupdate_init] */
+void UIUpdate_Init(void);
+/* @[declare_uiupdate_init] */
+
+/**
+ * @brief Queues a new text for a label.
+ *
+ * The text is copied (up to CONFIG_LV_UI_UPDATE_TEXT_LEN - 1 characters)
+ * and applied by the `gui` task at the start of its next frame. This
+ * never waits for xGuiSemaphore, so sensor and network tasks are not
+ * stalled behind rendering. If several updates for the same label are
+ * pending, only the newest one is applied.
+ *
+ * @note The widget must not be deleted while updates for it are pending.
+ * Delete it from the `gui` task, or call UIUpdate_Process() with
+ * xGuiSemaphore taken right before deleting it.
+ *
+ * **Example:**
+ *
+ * Show the latest temperature reading from a sensor task.
+ * @code{c}
+ *  char buf[16];
+ *  snprintf(buf, sizeof(buf), "%.1f C", temperature);
+ *  UIUpdate_SetLabelText(temperature_label, buf);
+ * @endcode
+ *
+ * @param[in] label The label to update.
+ * @param[in] text The new text.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Update queued
+ *  - ESP_ERR_NO_MEM        : Queue full, update dropped
+ */
+/* @[declare_uiupdate_setlabeltext] */
+esp_err_t UIUpdate_SetLabelText(lv_obj_t *label, const char *text);
+/* @[declare_uiupdate_setlabeltext] */
+
+/**
+ * @brief Queues a new value for a bar, without animation.
+ *
+ * @param[in] bar The bar to update.
+ * @param[in] value The new value.
+ *
+ * @return ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full.
+ */
+/* @[declare_uiupdate_setbarvalue] */
+esp_err_t UIUpdate_SetBarValue(lv_obj_t *bar, int16_t value);
+/* @[declare_uiupdate_setbarvalue] */
+
+/**
+ * @brief Queues a new value for an arc.
+ *
+ * @param[in] arc The arc to update.
+ * @param[in] value The new value.
+ *
+ * @return ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full.
+ */
+/* @[declare_uiupdate_setarcvalue] */
+esp_err_t UIUpdate_SetArcValue(lv_obj_t *arc, int16_t value);
+/* @[declare_uiupdate_setarcvalue] */
+
+/**
+ * @brief Queues a local style color change of a widget part.
+ *
+ * **Example:**
+ *
+ * Turn a status label red.
+ * @code{c}
+ *  UIUpdate_SetStyleColor(status_label, LV_LABEL_PART_MAIN, LV_STYLE_TEXT_COLOR, LV_COLOR_RED);
+ * @endcode
+ *
+ * @param[in] obj The widget to update.
+ * @param[in] part The widget part, e.g. LV_OBJ_PART_MAIN.
+ * @param[in] prop A color style property, e.g. LV_STYLE_BG_COLOR.
+ * @param[in] color The new color, applied to the default state.
+ *
+ * @return ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full.
+ */
+/* @[declare_uiupdate_setstylecolor] */
+esp_err_t UIUpdate_SetStyleColor(lv_obj_t *obj, uint8_t part, lv_style_property_t prop, lv_color_t color);
+/* @[declare_uiupdate_setstylecolor] */
+
+/**
+ * @brief Queues showing or hiding a widget.
+ *
+ * @param[in] obj The widget to update.
+ * @param[in] hidden true to hide the widget, false to show it.
+ *
+ * @return ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full.
+ */
+/* @[declare_uiupdate_sethidden] */
+esp_err_t UIUpdate_SetHidden(lv_obj_t *obj, bool hidden);
+/* @[declare_uiupdate_sethidden] */
+
+/**
+ * @brief Applies all pending updates, keeping only the newest update
+ * for each widget and property.
+ *
+ * @note Must be called with xGuiSemaphore taken. The `gui` task calls it
+ * before every lv_task_handler().
+ */
+/* @[declare_uiupdate_process] */
+void UIUpdate_Process(void);
+/* @[declare_uiupdate_process] */
+
+/**
+ * @brief Number of updates dropped because the queue was full.
+ *
+ * @return The dropped update count since boot.
+ */
+/* @[declare_uiupdate_getdropped] */
+uint32_t UIUpdate_GetDropped(void);
+/* @[declare_uiupdate_getdropped] */
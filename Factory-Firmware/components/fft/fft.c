@@ -39,12 +39,18 @@
 #include <math.h>
 #include <complex.h>
 
+#include "freertos/FreeRTOS.h"
+
 #include "fft.h"
 
 #define TWO_PI 6.28318530
 #define USE_SPLIT_RADIX 1
 #define LARGE_BASE_CASE 1
 
+static void rfft_post_processing(float *y, float *twiddle_factors, int n);
+static void fft_inplace_primitive(float *x, int n, unsigned short *bit_reversal, int pairs,
+                                  float *twiddle_factors, int tw_stride);
+
 fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, float *input, float *output)
 {
   /*
@@ -54,17 +60,22 @@ fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, flo
    */
   int k,m;
 
-  fft_config_t *config = (fft_config_t *)malloc(sizeof(fft_config_t));
-
   // Check if the size is a power of two
   if ((size & (size-1)) != 0)  // tests if size is a power of two
     return NULL;
 
+  // Zeroed, so the buffers of a type without one stay NULL
+  fft_config_t *config = (fft_config_t *)calloc(1, sizeof(fft_config_t));
+  if (config == NULL)
+    return NULL;
+
   // start configuration
   config->flags = 0;
   config->type = type;
   config->direction = direction;
   config->size = size;
+  config->bit_reversal = NULL;
+  config->bit_reversal_pairs = 0;
 
   // Allocate and precompute twiddle factors
   config->twiddle_factors = (float *)malloc(2 * config->size * sizeof(float));
@@ -109,17 +120,108 @@ fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, flo
   if (config->output == NULL)
     return NULL;
 
+  // Bit reversal permutation of the complex transform, half the size for a real one
+  int n = (config->type == FFT_REAL) ? config->size / 2 : config->size;
+  int bits = 0;
+  while ((1 << bits) < n)
+    bits++;
+
+  // Indices equal to their reversal stay in place, so at most n / 2 pairs
+  config->bit_reversal = (unsigned short *)malloc((n > 1 ? n : 1) * sizeof(unsigned short));
+  if (config->bit_reversal == NULL)
+    return NULL;
+
+  for (k = 0 ; k < n ; k++)
+  {
+    int r = 0;
+    for (m = 0 ; m < bits ; m++)
+      r |= ((k >> m) & 1) << (bits - 1 - m);
+
+    if (k < r)
+    {
+      config->bit_reversal[2 * config->bit_reversal_pairs] = k;
+      config->bit_reversal[2 * config->bit_reversal_pairs + 1] = r;
+      config->bit_reversal_pairs++;
+    }
+  }
+
   return config;
 }
 
+fft_config_t *fft_plan_get(int size, fft_type_t type, fft_direction_t direction)
+{
+  /*
+   * Returns a plan of the given size, type and direction with its own buffers,
+   * prepared on the first call and the same one on every later call, so tasks
+   * running transforms in a loop do not allocate or compute twiddle factors.
+   *
+   * The plan and its buffers are shared by every caller asking for the same
+   * parameters and must not be passed to fft_destroy(). Returns NULL if the
+   * plan cannot be prepared or FFT_PLAN_CACHE_SIZE plans are already kept.
+   */
+  static fft_config_t *plans[FFT_PLAN_CACHE_SIZE];
+  static portMUX_TYPE plans_mux = portMUX_INITIALIZER_UNLOCKED;
+  fft_config_t *plan = NULL;
+  int k;
+
+  portENTER_CRITICAL(&plans_mux);
+  for (k = 0 ; k < FFT_PLAN_CACHE_SIZE && plans[k] != NULL ; k++)
+  {
+    if (plans[k]->size == size && plans[k]->type == type && plans[k]->direction == direction)
+    {
+      plan = plans[k];
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&plans_mux);
+
+  if (plan != NULL || k == FFT_PLAN_CACHE_SIZE)
+    return plan;
+
+  // Allocation cannot happen in the critical section, another task may get there first
+  fft_config_t *created = fft_init(size, type, direction, NULL, NULL);
+  if (created == NULL)
+    return NULL;
+  created->flags |= FFT_CACHED_PLAN;
+
+  portENTER_CRITICAL(&plans_mux);
+  for (k = 0 ; k < FFT_PLAN_CACHE_SIZE && plans[k] != NULL ; k++)
+  {
+    if (plans[k]->size == size && plans[k]->type == type && plans[k]->direction == direction)
+    {
+      plan = plans[k];
+      break;
+    }
+  }
+  if (plan == NULL && k < FFT_PLAN_CACHE_SIZE)
+  {
+    plans[k] = created;
+    plan = created;
+  }
+  portEXIT_CRITICAL(&plans_mux);
+
+  if (plan != created)
+  {
+    created->flags &= ~FFT_CACHED_PLAN;
+    fft_destroy(created);
+  }
+
+  return plan;
+}
+
 void fft_destroy(fft_config_t *config)
 {
+  // Cached plans live as long as the program
+  if (config->flags & FFT_CACHED_PLAN)
+    return;
+
   if (config->flags & FFT_OWN_INPUT_MEM)
     free(config->input);
 
   if (config->flags & FFT_OWN_OUTPUT_MEM)
     free(config->output);
 
+  free(config->bit_reversal);
   free(config->twiddle_factors);
   free(config);
 }
@@ -191,8 +293,15 @@ void rfft(float *x, float *y, float *twiddle_factors, int n)
   fft_primitive(x, y, n / 2, 2, twiddle_factors, 4);
 #endif
 
-  // Now apply post processing to recover positive
-  // frequencies of the real FFT
+  rfft_post_processing(y, twiddle_factors, n);
+}
+
+static void rfft_post_processing(float *y, float *twiddle_factors, int n)
+{
+  /*
+   * Turns the half size complex FFT of the even and odd samples, in place,
+   * into the positive frequencies of the real FFT
+   */
   float t = y[0];
   y[0] = t + y[1];  // DC coefficient
   y[1] = t - y[1];  // Center coefficient
@@ -229,6 +338,108 @@ void rfft(float *x, float *y, float *twiddle_factors, int n)
   }
 }
 
+void rfft_inplace(fft_config_t *config, float *data)
+{
+  /*
+   * Forward real FFT computed in place, with the bit reversal table of the
+   * plan instead of the recursion of rfft()
+   *
+   * Parameters
+   * ----------
+   *  config (fft_config_t *)
+   *    A FFT_REAL plan, only its size and tables are used
+   *  data (float *)
+   *    The `size` real samples, replaced by the spectrum in the same
+   *    packed layout as the output of rfft()
+   */
+  int n = config->size;
+
+  // The real samples are read as n / 2 complex ones, even samples real and odd ones imaginary
+  fft_inplace_primitive(data, n / 2, config->bit_reversal, config->bit_reversal_pairs,
+                        config->twiddle_factors, 4);
+  rfft_post_processing(data, config->twiddle_factors, n);
+}
+
+void rfft_magnitude(fft_config_t *config, float *data)
+{
+  /*
+   * Forward real FFT computed in place, reduced to the magnitudes of the
+   * frequencies 0 to size / 2, written to data[0] to data[size / 2]
+   */
+  int n = config->size;
+  int k;
+
+  rfft_inplace(config, data);
+
+  // Magnitude k is read from [2k] and [2k + 1] before it is written to [k]
+  float nyquist = fabsf(data[1]);
+  data[0] = fabsf(data[0]);
+  for (k = 1 ; k < n / 2 ; k++)
+    data[k] = sqrtf(data[2 * k] * data[2 * k] + data[2 * k + 1] * data[2 * k + 1]);
+  data[n / 2] = nyquist;
+}
+
+static void fft_inplace_primitive(float *x, int n, unsigned short *bit_reversal, int pairs,
+                                  float *twiddle_factors, int tw_stride)
+{
+  /*
+   * Forward fast Fourier transform
+   * DIT, radix-2, iterative in-place implementation
+   *
+   * Parameters
+   * ----------
+   *  x (float *)
+   *    The n complex samples with real/imaginary parts interleaved,
+   *    replaced by their transform
+   *  bit_reversal (unsigned short *)
+   *    The pairs of indices to swap to put the samples in bit reversed order
+   *  twiddle_factors (float *)
+   *    The array of twiddle factors, W_n^k at [k * tw_stride]
+   */
+  int k, i, j;
+
+  for (k = 0 ; k < pairs ; k++)
+  {
+    int a = 2 * bit_reversal[2 * k];
+    int b = 2 * bit_reversal[2 * k + 1];
+    float t;
+
+    t = x[a];
+    x[a] = x[b];
+    x[b] = t;
+
+    t = x[a + 1];
+    x[a + 1] = x[b + 1];
+    x[b + 1] = t;
+  }
+
+  for (int len = 2 ; len <= n ; len *= 2)
+  {
+    int half = len / 2;
+    // W_len^j is W_n^(j * n / len)
+    int step = (n / len) * tw_stride;
+
+    for (j = 0 ; j < half ; j++)
+    {
+      float c = twiddle_factors[j * step];
+      float s = twiddle_factors[j * step + 1];
+
+      for (i = j ; i < n ; i += len)
+      {
+        float *u = &x[2 * i];
+        float *v = &x[2 * (i + half)];
+        float tr =  c * v[0] + s * v[1];
+        float ti = -s * v[0] + c * v[1];
+
+        v[0] = u[0] - tr;
+        v[1] = u[1] - ti;
+        u[0] += tr;
+        u[1] += ti;
+      }
+    }
+  }
+}
+
 void irfft(float *x, float *y, float *twiddle_factors, int n)
 {
   /*
@@ -0,0 +1,127 @@
+/*
+ * Host benchmark of the real FFTs of the fft component.
+ *
+ * Cycles: the fastest of RUNS transforms of a frame of 16-bit samples, with the copy of the
+ * frame into the buffer the transform works in, for
+ *  - float:      fft_execute() on a plan from fft_init(), the samples converted to float
+ *  - float mag:  rfft_magnitude() on a cached plan, down to the magnitudes
+ *  - q15:        rfft_q15()
+ *  - q15 power:  rfft_q15_power(), down to the squared magnitudes
+ *
+ * Accuracy: the signal to noise ratio of the Q15 spectrum against the float
+ * one, for a loud and a quiet frame. The benchmark fails under MIN_SNR_DB.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "xtensa/hal.h"
+#include "fft.h"
+#include "fft_q15.h"
+
+#define RUNS        2000
+#define MIN_SNR_DB  50.0
+
+static int16_t samples[1024];
+static float float_buf[1024];
+static int16_t q15_buf[1024];
+static uint32_t power[513];
+
+/* Tones and noise like a microphone frame, peaking around amplitude */
+static void make_frame(int16_t *frame, int size, int amplitude)
+{
+    srand(size + amplitude);
+    for (int k = 0; k < size; k++) {
+        double v = 0.5 * sin(2 * M_PI * 17.3 * k / size) + 0.25 * sin(2 * M_PI * 101.7 * k / size + 1.0)
+                   + 0.1 * ((double) rand() / RAND_MAX - 0.5);
+        frame[k] = (int16_t) lrint(v * amplitude / 0.85);
+    }
+}
+
+static double snr_db(int size, int amplitude)
+{
+    fft_config_t *plan = fft_plan_get(size, FFT_REAL, FFT_FORWARD);
+    fft_q15_config_t *q15 = fft_q15_init(size);
+    double signal = 0, noise = 0;
+
+    make_frame(samples, size, amplitude);
+    for (int k = 0; k < size; k++) {
+        float_buf[k] = samples[k];
+    }
+    memcpy(q15_buf, samples, size * sizeof(int16_t));
+
+    rfft_inplace(plan, float_buf);
+    double scale = ldexp(1.0, rfft_q15(q15, q15_buf));
+    for (int k = 0; k < size; k++) {
+        double e = q15_buf[k] * scale - float_buf[k];
+        signal += (double) float_buf[k] * float_buf[k];
+        noise += e * e;
+    }
+    fft_q15_destroy(q15);
+    return 10 * log10(signal / (noise > 0 ? noise : 1e-30));
+}
+
+static void bench_size(int size, bool *ok)
+{
+    fft_config_t *plan = fft_init(size, FFT_REAL, FFT_FORWARD, NULL, NULL);
+    fft_config_t *cached = fft_plan_get(size, FFT_REAL, FFT_FORWARD);
+    fft_q15_config_t *q15 = fft_q15_init(size);
+    uint32_t cycles[4] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+
+    make_frame(samples, size, 8000);
+    for (int r = 0; r < RUNS; r++) {
+        uint32_t start = xthal_get_ccount();
+        for (int k = 0; k < size; k++) {
+            plan->input[k] = samples[k];
+        }
+        fft_execute(plan);
+        uint32_t t1 = xthal_get_ccount();
+        for (int k = 0; k < size; k++) {
+            float_buf[k] = samples[k];
+        }
+        rfft_magnitude(cached, float_buf);
+        uint32_t t2 = xthal_get_ccount();
+        memcpy(q15_buf, samples, size * sizeof(int16_t));
+        rfft_q15(q15, q15_buf);
+        uint32_t t3 = xthal_get_ccount();
+        memcpy(q15_buf, samples, size * sizeof(int16_t));
+        rfft_q15_power(q15, q15_buf, power);
+        uint32_t t4 = xthal_get_ccount();
+
+        uint32_t spent[4] = { t1 - start, t2 - t1, t3 - t2, t4 - t3 };
+        for (int i = 0; i < 4; i++) {
+            cycles[i] = spent[i] < cycles[i] ? spent[i] : cycles[i];
+        }
+    }
+    fft_destroy(plan);
+    fft_q15_destroy(q15);
+
+    double loud = snr_db(size, 8000);
+    double quiet = snr_db(size, 40);
+    *ok = *ok && loud >= MIN_SNR_DB && quiet >= MIN_SNR_DB;
+
+    printf("%5d %10u %10u %10u %10u %9.1f %9.1f\n", size, cycles[0], cycles[1], cycles[2], cycles[3], loud,
+           quiet);
+}
+
+int main(void)
+{
+    bool ok = true;
+
+    printf("cycles per transform, Q15 SNR against float in dB\n");
+    printf("%5s %10s %10s %10s %10s %9s %9s\n", "size", "float", "float mag", "q15", "q15 power", "snr loud",
+           "snr quiet");
+    bench_size(256, &ok);
+    bench_size(512, &ok);
+    bench_size(1024, &ok);
+
+    if (!ok) {
+        printf("FAIL: Q15 spectrum under %.0f dB SNR\n", MIN_SNR_DB);
+        return 1;
+    }
+    return 0;
+}
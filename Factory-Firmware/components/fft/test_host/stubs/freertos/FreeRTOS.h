@@ -0,0 +1,9 @@
+/* Host stand-in for FreeRTOS, the benchmark is single threaded and critical sections are no-ops */
+
+#pragma once
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void) (mux))
+#define portEXIT_CRITICAL(mux)          ((void) (mux))
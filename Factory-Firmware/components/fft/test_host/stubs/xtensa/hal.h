@@ -0,0 +1,23 @@
+/* Host stand-in for the Xtensa HAL, the cycle counter is the time stamp counter of the host */
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline uint32_t xthal_get_ccount(void)
+{
+    return (uint32_t) __rdtsc();
+}
+#else
+#include <time.h>
+
+static inline uint32_t xthal_get_ccount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((uint64_t) now.tv_sec * 1000000000 + now.tv_nsec);
+}
+#endif
@@ -31,6 +31,8 @@
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 
+#include "esp_log.h"
+
 #include "driver/i2s.h"
 
 #include "core2forAWS.h"
@@ -44,6 +46,9 @@ static const char *TAG = MICROPHONE_TAB_NAME;
 #define CANVAS_WIDTH 240
 #define CANVAS_HEIGHT 60
 
+/* Two columns can wait in the queue and one be drawn, so a fourth is always free to fill */
+#define FFT_COLUMNS 4
+
 static long map(long x, long in_min, long in_max, long out_min, long out_max) {
     long divisor = (in_max - in_min);
     if(divisor == 0){
@@ -97,32 +102,45 @@ void display_microphone_tab(lv_obj_t* tv){
 void microphoneTask(void* pvParameters) {
     vTaskSuspend(NULL);
 
-    static int8_t i2s_readraw_buff[1024];
-    size_t bytesread;
-    int16_t* buffptr;
+    const mic_frame_t* frame;
+    mic_subscriber_t subscriber;
     double data = 0;
+    static uint8_t fft_columns[FFT_COLUMNS][CANVAS_HEIGHT];
+    uint8_t column = 0;
     uint8_t* fft_dis_buff = NULL;
-    Microphone_Init();
+    mic_capture_config_t mic_config = { .sample_rate = 44100, .frame_samples = 512 };
+    if (Microphone_StartCapture(&mic_config) != ESP_OK || Microphone_Subscribe(1, &subscriber) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the microphone capture");
+        vTaskDelete(NULL);
+    }
     QueueHandle_t queue = (QueueHandle_t) pvParameters;
 
+    /* Prepared once, the loop below transforms in place without allocating */
+    fft_config_t* real_fft_plan = fft_plan_get(512, FFT_REAL, FFT_FORWARD);
+    if (real_fft_plan == NULL) {
+        ESP_LOGE(TAG, "Failed to prepare the FFT plan");
+        vTaskDelete(NULL);
+    }
+
     for (;;) {
-        fft_dis_buff = (uint8_t*)heap_caps_malloc(CANVAS_HEIGHT * sizeof(uint8_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM);
+        fft_dis_buff = fft_columns[column];
         memset(fft_dis_buff, 0, CANVAS_HEIGHT);
-        fft_config_t* real_fft_plan = fft_init(512, FFT_REAL, FFT_FORWARD, NULL, NULL);
-        i2s_read(I2S_NUM_0, (char*)i2s_readraw_buff, 1024, &bytesread, pdMS_TO_TICKS(100));
-        buffptr = (int16_t*)i2s_readraw_buff;
+        if (Microphone_ReceiveFrame(subscriber, &frame, pdMS_TO_TICKS(100)) != ESP_OK) {
+            continue;
+        }
         for (uint16_t count_n = 0; count_n < real_fft_plan->size; count_n++) {
-            real_fft_plan->input[count_n] = (float)map(buffptr[count_n], INT16_MIN, INT16_MAX, -1000, 1000);
+            real_fft_plan->input[count_n] = (float)map(frame->samples[count_n], INT16_MIN, INT16_MAX, -1000, 1000);
         }
-        fft_execute(real_fft_plan);
+        Microphone_ReleaseFrame(frame);
+        rfft_magnitude(real_fft_plan, real_fft_plan->input);
 
         for (uint16_t count_n = 1; count_n < CANVAS_HEIGHT; count_n++) {
-            data = sqrt(real_fft_plan->output[2 * count_n] * real_fft_plan->output[2 * count_n] + real_fft_plan->output[2 * count_n + 1] * real_fft_plan->output[2 * count_n + 1]);
+            data = real_fft_plan->input[count_n];
             fft_dis_buff[CANVAS_HEIGHT - count_n]  = map(data, 0, 2000, 0, 256);
         }
-        fft_destroy(real_fft_plan);
-        if(xQueueSend(queue, &fft_dis_buff, 0) != pdPASS) {
-            free(fft_dis_buff);
+        /* A column the queue had no room for is filled again */
+        if(xQueueSend(queue, &fft_dis_buff, 0) == pdPASS) {
+            column = (column + 1) % FFT_COLUMNS;
         }
     }
     vTaskDelete(NULL); // Should never get to here...
@@ -134,8 +152,7 @@ void fft_show_task(void* pvParameters) {
     
     vTaskSuspend(NULL);
     static uint16_t position_data = 0;
-    uint16_t color_position;
-    uint8_t* fft_dis_buff = heap_caps_malloc(sizeof (uint8_t) * CANVAS_HEIGHT, MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM);
+    uint8_t* fft_dis_buff;
     
     xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
     lv_obj_t* canvas = lv_canvas_create((lv_obj_t*)pvParameters, NULL);
@@ -146,21 +163,24 @@ void fft_show_task(void* pvParameters) {
     xSemaphoreGive(xGuiSemaphore);
 
     extern const unsigned char color_map[768];
+
+    /* Convert the RGB color map once, columns are then drawn straight from the magnitudes */
+    static lv_color_t palette[256];
+    for (uint16_t i = 0; i < 256; i++) {
+        palette[i] = LV_COLOR_MAKE(color_map[i * 3 + 0], color_map[i * 3 + 1], color_map[i * 3 + 2]);
+    }
     
     for (;;) {
-        if(mic_queue != NULL){
-            xQueueReceive(mic_queue, &fft_dis_buff, 0);
-            for (uint16_t count_y = 0; count_y < CANVAS_HEIGHT; count_y++) {
-                color_position = fft_dis_buff[count_y];
-                xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
-                lv_canvas_set_px(canvas, position_data, count_y, LV_COLOR_MAKE(color_map[color_position * 3 + 0], color_map[color_position * 3 + 1], color_map[color_position * 3 + 2]));
-                xSemaphoreGive(xGuiSemaphore);
-            }
+        /* Draws one column per FFT frame, as soon as the microphone task produces it */
+        if (xQueueReceive(mic_queue, &fft_dis_buff, portMAX_DELAY) == pdPASS) {
+            xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+            lv_canvas_set_col_palette(canvas, position_data, fft_dis_buff, palette);
+            xSemaphoreGive(xGuiSemaphore);
+
             position_data ++;
             if (position_data == CANVAS_WIDTH) {
                 position_data = 0;
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(10));
     }
-}
\ No newline at end of file
+}
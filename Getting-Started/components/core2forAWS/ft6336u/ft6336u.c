@@ -1,9 +1,13 @@
 #include "stdio.h"
 #include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "ft6336u.h"
 #include "i2c_device.h"
@@ -11,86 +15,384 @@
 #define FT6336U_I2C_ADDR 0x38
 #define FT6336U_INTR_PIN 39
 
-static uint16_t _x, _y;
-static bool _pressed;
+/* TD_STATUS followed by the XH, XL, YH, YL, weight and area registers of both points */
+#define FT6336U_REG_TD_STATUS   0x02
+#define FT6336U_REG_G_MODE      0xa4
+#define FT6336U_POINT_REGS      6
+#define FT6336U_READ_LEN        (1 + FT6336U_MAX_POINTS * FT6336U_POINT_REGS)
+
+#ifndef CONFIG_FT6336U_TOUCH_RING_LEN
+#define CONFIG_FT6336U_TOUCH_RING_LEN 32
+#endif
+#ifndef CONFIG_FT6336U_POLL_MS
+#define CONFIG_FT6336U_POLL_MS 10
+#endif
+#ifndef CONFIG_FT6336U_GESTURE_QUEUE_LEN
+#define CONFIG_FT6336U_GESTURE_QUEUE_LEN 8
+#endif
+#ifndef CONFIG_FT6336U_LONG_PRESS_MS
+#define CONFIG_FT6336U_LONG_PRESS_MS 800
+#endif
+#ifndef CONFIG_FT6336U_SWIPE_MIN_PX
+#define CONFIG_FT6336U_SWIPE_MIN_PX 40
+#endif
+#ifndef CONFIG_FT6336U_VELOCITY_WINDOW_MS
+#define CONFIG_FT6336U_VELOCITY_WINDOW_MS 50
+#endif
+
+/* Movement still counted as holding a finger still */
+#define FT6336U_TOUCH_SLOP_PX   10
+/* Swipes must finish within this time, slower drags are not swipes */
+#define FT6336U_SWIPE_MAX_US    (1000 * 1000)
+/* Pinch scale change, in 1/256, between two reported pinch gestures */
+#define FT6336U_PINCH_STEP      16
+
 static I2CDevice_t ft6336u_i2c;
 static xTaskHandle ft6336_task_handle;
-static SemaphoreHandle_t thread_mutex;
+/* Changed under touch_mux, the task calls a copy it takes under the mux */
+static FT6336U_TouchCallback_t touch_callbacks[FT6336U_MAX_TOUCH_CALLBACKS];
+static uint8_t touch_callback_count;
+static QueueHandle_t gesture_queue;
+
+/* Samples are only written by the FT6336U task, readers copy them out under the mux */
+static ft6336u_touch_t touch_ring[CONFIG_FT6336U_TOUCH_RING_LEN];
+static uint32_t touch_head;
+static portMUX_TYPE touch_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Gesture recognition state, only used by the FT6336U task */
+typedef struct {
+    bool down;
+    bool still;
+    bool long_reported;
+    bool pinched;
+    int64_t start_us;
+    ft6336u_point_t start;
+    ft6336u_point_t last;
+    uint32_t pinch_start_dist;
+    uint16_t pinch_scale;
+} gesture_state_t;
+
+static gesture_state_t gesture_state;
 
 static void IRAM_ATTR FT6336U_ISRHandler(void* arg);
 static void FT6336U_UpdateTask(void *arg);
 
 void FT6336U_Init() {
     ft6336u_i2c = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, FT6336U_I2C_ADDR);
-    i2c_write_byte(ft6336u_i2c, 0xa4, 0x00);
-    
-    thread_mutex = xSemaphoreCreateMutex();
+    i2c_device_set_priority(ft6336u_i2c, I2C_PRIORITY_HIGH);
+    /* Trigger mode, the interrupt pin pulses for every new report instead of staying low while touched */
+    i2c_write_byte(ft6336u_i2c, FT6336U_REG_G_MODE, 0x01);
+
+    gesture_queue = xQueueCreate(CONFIG_FT6336U_GESTURE_QUEUE_LEN, sizeof(ft6336u_gesture_t));
 
     gpio_config_t io_conf;
-    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+    io_conf.intr_type = GPIO_INTR_NEGEDGE;
     io_conf.pin_bit_mask = (1ULL << FT6336U_INTR_PIN);
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.pull_up_en = 1;
+    io_conf.pull_down_en = 0;
     gpio_config(&io_conf);
-    xTaskCreatePinnedToCore(FT6336U_UpdateTask, "FT6336Task", 2 * 1024, NULL, 1, &ft6336_task_handle, 0);
+    xTaskCreatePinnedToCore(FT6336U_UpdateTask, "FT6336Task", 3 * 1024, NULL, 2, &ft6336_task_handle, 0);
     gpio_install_isr_service(0);
     gpio_isr_handler_add(FT6336U_INTR_PIN, FT6336U_ISRHandler, &ft6336_task_handle);
 }
 
 static void IRAM_ATTR FT6336U_ISRHandler(void* arg) {
     xTaskHandle task_handle = *(xTaskHandle *)arg;
-    xTaskResumeFromISR(task_handle);
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    /* A notification, unlike resuming a suspended task, is not lost if the task is still reading */
+    vTaskNotifyGiveFromISR(task_handle, &higher_priority_task_woken);
+    if (higher_priority_task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static uint32_t FT6336U_Distance(const ft6336u_point_t* a, const ft6336u_point_t* b) {
+    int32_t dx = (int32_t) a->x - b->x;
+    int32_t dy = (int32_t) a->y - b->y;
+    uint32_t sq = dx * dx + dy * dy;
+
+    /* Integer square root */
+    uint32_t root = 0;
+    for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+        if (sq >= root + bit) {
+            sq -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+/* Velocity of the first finger over the pressed samples within the window before the newest one.
+ * Must be called with touch_mux taken. */
+static void FT6336U_VelocityLocked(int32_t* vx, int32_t* vy) {
+    *vx = 0;
+    *vy = 0;
+
+    uint32_t stored = touch_head < CONFIG_FT6336U_TOUCH_RING_LEN ? touch_head : CONFIG_FT6336U_TOUCH_RING_LEN;
+    const ft6336u_touch_t* newest = NULL;
+    const ft6336u_touch_t* oldest = NULL;
+    for (uint32_t i = 1; i <= stored; i++) {
+        const ft6336u_touch_t* touch = &touch_ring[(touch_head - i) % CONFIG_FT6336U_TOUCH_RING_LEN];
+        if (touch->count == 0) {
+            /* Samples before a release belong to an earlier touch */
+            if (newest == NULL) {
+                continue;
+            }
+            break;
+        }
+        if (newest == NULL) {
+            newest = touch;
+        } else if (touch->points[0].id != newest->points[0].id) {
+            break;
+        }
+        oldest = touch;
+        if (newest->time_us - touch->time_us >= CONFIG_FT6336U_VELOCITY_WINDOW_MS * 1000) {
+            break;
+        }
+    }
+
+    if (newest == NULL || newest == oldest || newest->time_us == oldest->time_us) {
+        return;
+    }
+    int64_t dt_us = newest->time_us - oldest->time_us;
+    *vx = ((int64_t) newest->points[0].x - oldest->points[0].x) * 1000000 / dt_us;
+    *vy = ((int64_t) newest->points[0].y - oldest->points[0].y) * 1000000 / dt_us;
+}
+
+static void FT6336U_SendGesture(ft6336u_gesture_t* gesture) {
+    /* Nobody may be listening, so a full queue drops the gesture rather than blocking touch reads */
+    xQueueSend(gesture_queue, gesture, 0);
+}
+
+static void FT6336U_RecognizeGestures(const ft6336u_touch_t* touch) {
+    gesture_state_t* g = &gesture_state;
+    ft6336u_gesture_t gesture = { .time_us = touch->time_us };
+
+    if (touch->count == 0) {
+        if (!g->down) {
+            return;
+        }
+        g->down = false;
+
+        int32_t dx = (int32_t) g->last.x - g->start.x;
+        int32_t dy = (int32_t) g->last.y - g->start.y;
+        bool horizontal = abs(dx) >= abs(dy);
+        if (g->pinched || g->long_reported || touch->time_us - g->start_us > FT6336U_SWIPE_MAX_US ||
+            (horizontal ? abs(dx) : abs(dy)) < CONFIG_FT6336U_SWIPE_MIN_PX) {
+            return;
+        }
+
+        if (horizontal) {
+            gesture.type = dx < 0 ? FT6336U_GESTURE_SWIPE_LEFT : FT6336U_GESTURE_SWIPE_RIGHT;
+        } else {
+            gesture.type = dy < 0 ? FT6336U_GESTURE_SWIPE_UP : FT6336U_GESTURE_SWIPE_DOWN;
+        }
+        gesture.x = g->start.x;
+        gesture.y = g->start.y;
+        gesture.dx = dx;
+        gesture.dy = dy;
+        /* The velocity skips the release and uses the pressed samples before it */
+        portENTER_CRITICAL(&touch_mux);
+        FT6336U_VelocityLocked(&gesture.vx, &gesture.vy);
+        portEXIT_CRITICAL(&touch_mux);
+        FT6336U_SendGesture(&gesture);
+        return;
+    }
+
+    if (!g->down) {
+        g->down = true;
+        g->still = true;
+        g->long_reported = false;
+        g->pinched = false;
+        g->start_us = touch->time_us;
+        g->start = touch->points[0];
+    }
+    g->last = touch->points[0];
+
+    if (touch->count == FT6336U_MAX_POINTS) {
+        uint32_t dist = FT6336U_Distance(&touch->points[0], &touch->points[1]);
+        if (!g->pinched) {
+            g->pinched = true;
+            g->still = false;
+            g->pinch_start_dist = dist ? dist : 1;
+            g->pinch_scale = 256;
+            return;
+        }
+
+        uint32_t scale = dist * 256 / g->pinch_start_dist;
+        if (scale > UINT16_MAX) {
+            scale = UINT16_MAX;
+        }
+        if (abs((int32_t) scale - g->pinch_scale) >= FT6336U_PINCH_STEP) {
+            g->pinch_scale = scale;
+            gesture.type = FT6336U_GESTURE_PINCH;
+            gesture.x = (touch->points[0].x + touch->points[1].x) / 2;
+            gesture.y = (touch->points[0].y + touch->points[1].y) / 2;
+            gesture.scale = scale;
+            FT6336U_SendGesture(&gesture);
+        }
+        return;
+    }
+
+    if (g->still && FT6336U_Distance(&g->start, &touch->points[0]) > FT6336U_TOUCH_SLOP_PX) {
+        g->still = false;
+    }
+    if (g->still && !g->long_reported && !g->pinched &&
+        touch->time_us - g->start_us >= CONFIG_FT6336U_LONG_PRESS_MS * 1000) {
+        g->long_reported = true;
+        gesture.type = FT6336U_GESTURE_LONG_PRESS;
+        gesture.x = g->start.x;
+        gesture.y = g->start.y;
+        FT6336U_SendGesture(&gesture);
+    }
 }
 
 static void FT6336U_UpdateTask(void *arg) {
-    uint8_t buff[5] = {0x00, 0x00, 0x00, 0x00, 0x00};
-    bool press_stash;
+    uint8_t buff[FT6336U_READ_LEN];
+    bool pressed = false;
+
     for (;;) {
-        i2c_read_bytes(ft6336u_i2c, 0x02, buff, 5);
-        
-        xSemaphoreTake(thread_mutex, portMAX_DELAY);
-        _pressed = buff[0] ? true : false;
-        _x = ((buff[1] & 0x0f) << 8) | buff[2];
-        _y = ((buff[3] & 0x0f) << 8) | buff[4];
-        press_stash = _pressed;
-        xSemaphoreGive(thread_mutex);
-
-        if (press_stash == false) {
-            vTaskSuspend(NULL);
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(20));
+        /* Sleep until the next report, but keep sampling while pressed in case a pulse was missed */
+        ulTaskNotifyTake(pdTRUE, pressed ? pdMS_TO_TICKS(CONFIG_FT6336U_POLL_MS) : portMAX_DELAY);
+
+        if (i2c_read_bytes(ft6336u_i2c, FT6336U_REG_TD_STATUS, buff, FT6336U_READ_LEN) != ESP_OK) {
+            continue;
         }
+
+        ft6336u_touch_t touch = { .time_us = esp_timer_get_time() };
+        touch.count = buff[0] & 0x0f;
+        if (touch.count > FT6336U_MAX_POINTS) {
+            touch.count = 0;
+        }
+        for (uint8_t i = 0; i < touch.count; i++) {
+            const uint8_t* p = &buff[1 + i * FT6336U_POINT_REGS];
+            touch.points[i].x = ((p[0] & 0x0f) << 8) | p[1];
+            touch.points[i].y = ((p[2] & 0x0f) << 8) | p[3];
+            touch.points[i].id = p[2] >> 4;
+        }
+
+        portENTER_CRITICAL(&touch_mux);
+        const ft6336u_touch_t* prev = &touch_ring[(touch_head - 1) % CONFIG_FT6336U_TOUCH_RING_LEN];
+        if (touch.count == 0 && touch_head) {
+            /* A release keeps the position where the first finger lifted */
+            touch.points[0] = prev->points[0];
+        }
+        /* Repeated reads of a finger that did not move add nothing for the readers */
+        bool changed = touch_head == 0 || prev->count != touch.count ||
+                       memcmp(prev->points, touch.points, touch.count * sizeof(ft6336u_point_t)) != 0;
+        if (changed) {
+            touch_ring[touch_head % CONFIG_FT6336U_TOUCH_RING_LEN] = touch;
+            touch_head++;
+        }
+        FT6336U_TouchCallback_t callbacks[FT6336U_MAX_TOUCH_CALLBACKS];
+        uint8_t callback_count = changed ? touch_callback_count : 0;
+        memcpy(callbacks, touch_callbacks, callback_count * sizeof(callbacks[0]));
+        portEXIT_CRITICAL(&touch_mux);
+
+        pressed = touch.count > 0;
+        FT6336U_RecognizeGestures(&touch);
+
+        /* Called outside the mux, they may use FreeRTOS */
+        for (uint8_t i = 0; i < callback_count; i++) {
+            callbacks[i]();
+        }
+    }
+}
+
+void FT6336U_SetTouchCallback(FT6336U_TouchCallback_t callback) {
+    portENTER_CRITICAL(&touch_mux);
+    touch_callbacks[0] = callback;
+    touch_callback_count = callback ? 1 : 0;
+    portEXIT_CRITICAL(&touch_mux);
+}
+
+esp_err_t FT6336U_AddTouchCallback(FT6336U_TouchCallback_t callback) {
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    portENTER_CRITICAL(&touch_mux);
+    if (touch_callback_count == FT6336U_MAX_TOUCH_CALLBACKS) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        touch_callbacks[touch_callback_count] = callback;
+        touch_callback_count++;
+    }
+    portEXIT_CRITICAL(&touch_mux);
+    return err;
+}
+
+uint32_t FT6336U_ReadTouch(uint32_t* cursor, ft6336u_touch_t* touch) {
+    uint32_t waiting;
+
+    portENTER_CRITICAL(&touch_mux);
+    if (touch_head - *cursor > CONFIG_FT6336U_TOUCH_RING_LEN) {
+        *cursor = touch_head - CONFIG_FT6336U_TOUCH_RING_LEN;
     }
+    waiting = touch_head - *cursor;
+    if (waiting) {
+        *touch = touch_ring[*cursor % CONFIG_FT6336U_TOUCH_RING_LEN];
+        (*cursor)++;
+    }
+    portEXIT_CRITICAL(&touch_mux);
+
+    return waiting;
+}
+
+void FT6336U_GetPoints(ft6336u_touch_t* touch) {
+    portENTER_CRITICAL(&touch_mux);
+    if (touch_head) {
+        *touch = touch_ring[(touch_head - 1) % CONFIG_FT6336U_TOUCH_RING_LEN];
+    } else {
+        memset(touch, 0, sizeof(*touch));
+    }
+    portEXIT_CRITICAL(&touch_mux);
+}
+
+void FT6336U_GetVelocity(int32_t* vx, int32_t* vy) {
+    *vx = 0;
+    *vy = 0;
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&touch_mux);
+    const ft6336u_touch_t* newest = &touch_ring[(touch_head - 1) % CONFIG_FT6336U_TOUCH_RING_LEN];
+    /* Samples are only stored when they change, so no recent sample means the finger rests */
+    if (touch_head && newest->count && now_us - newest->time_us < CONFIG_FT6336U_VELOCITY_WINDOW_MS * 1000) {
+        FT6336U_VelocityLocked(vx, vy);
+    }
+    portEXIT_CRITICAL(&touch_mux);
+}
+
+bool FT6336U_GetGesture(ft6336u_gesture_t* gesture, TickType_t wait) {
+    return xQueueReceive(gesture_queue, gesture, wait) == pdTRUE;
 }
 
 void FT6336U_GetTouch(uint16_t* x, uint16_t* y, bool* press_down) {
-    xSemaphoreTake(thread_mutex, portMAX_DELAY);
-    *x = _x;
-    *y = _y;
-    *press_down = _pressed;
-    xSemaphoreGive(thread_mutex);
+    ft6336u_touch_t touch;
+    FT6336U_GetPoints(&touch);
+    *x = touch.points[0].x;
+    *y = touch.points[0].y;
+    *press_down = touch.count > 0;
 }
 
 bool FT6336U_WasPressed() {
-    bool state = 0;
-    xSemaphoreTake(thread_mutex, portMAX_DELAY);
-    state = _pressed;
-    xSemaphoreGive(thread_mutex);
-    return state;
+    ft6336u_touch_t touch;
+    FT6336U_GetPoints(&touch);
+    return touch.count > 0;
 }
 
 uint16_t FT6336U_GetPressPosX() {
-    uint16_t stash = 0;
-    xSemaphoreTake(thread_mutex, portMAX_DELAY);
-    stash = _x;
-    xSemaphoreGive(thread_mutex);
-    return stash;
+    ft6336u_touch_t touch;
+    FT6336U_GetPoints(&touch);
+    return touch.points[0].x;
 }
 
 uint16_t FT6336U_GetPressPosY() {
-    uint16_t stash = 0;
-    xSemaphoreTake(thread_mutex, portMAX_DELAY);
-    stash = _y;
-    xSemaphoreGive(thread_mutex);
-    return stash;
+    ft6336u_touch_t touch;
+    FT6336U_GetPoints(&touch);
+    return touch.points[0].y;
 }
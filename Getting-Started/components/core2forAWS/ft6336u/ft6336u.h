@@ -5,6 +5,70 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+/**
+ * @brief Number of touch points reported by the FT6336U.
+ */
+#define FT6336U_MAX_POINTS 2
+
+/**
+ * @brief A touch point.
+ */
+/* @[declare_ft6336u_point_t] */
+typedef struct {
+    uint16_t x;         /**< @brief X-coordinate of the point. */
+    uint16_t y;         /**< @brief Y-coordinate of the point. */
+    uint8_t id;         /**< @brief Touch ID assigned by the FT6336U, stays the same while the finger is down. */
+} ft6336u_point_t;
+/* @[declare_ft6336u_point_t] */
+
+/**
+ * @brief A timestamped touch sample with all the points read at once.
+ */
+/* @[declare_ft6336u_touch_t] */
+typedef struct {
+    int64_t time_us;                                /**< @brief Time of the read, from esp_timer_get_time(). */
+    uint8_t count;                                  /**< @brief Number of points, 0 when the screen was released. */
+    ft6336u_point_t points[FT6336U_MAX_POINTS];     /**< @brief The points, the first finger down first. On release the first one is where it lifted. */
+} ft6336u_touch_t;
+/* @[declare_ft6336u_touch_t] */
+
+/**
+ * @brief Gestures recognized from the touch samples.
+ */
+/* @[declare_ft6336u_gesture_type_t] */
+typedef enum {
+    FT6336U_GESTURE_SWIPE_LEFT,     /**< @brief One finger moved left and lifted. */
+    FT6336U_GESTURE_SWIPE_RIGHT,    /**< @brief One finger moved right and lifted. */
+    FT6336U_GESTURE_SWIPE_UP,       /**< @brief One finger moved up and lifted. */
+    FT6336U_GESTURE_SWIPE_DOWN,     /**< @brief One finger moved down and lifted. */
+    FT6336U_GESTURE_LONG_PRESS,     /**< @brief One finger held still for CONFIG_FT6336U_LONG_PRESS_MS, reported while it is still down. */
+    FT6336U_GESTURE_PINCH,          /**< @brief The distance between two fingers changed. */
+} ft6336u_gesture_type_t;
+/* @[declare_ft6336u_gesture_type_t] */
+
+/**
+ * @brief A recognized gesture.
+ */
+/* @[declare_ft6336u_gesture_t] */
+typedef struct {
+    ft6336u_gesture_type_t type;    /**< @brief The gesture. */
+    int64_t time_us;                /**< @brief Time of the sample that completed the gesture. */
+    uint16_t x;                     /**< @brief Starting X-coordinate, or the X-coordinate between the fingers of a pinch. */
+    uint16_t y;                     /**< @brief Starting Y-coordinate, or the Y-coordinate between the fingers of a pinch. */
+    int16_t dx;                     /**< @brief Distance moved in X, for swipes. */
+    int16_t dy;                     /**< @brief Distance moved in Y, for swipes. */
+    int32_t vx;                     /**< @brief Velocity in X in pixels per second when the finger lifted, for swipes. */
+    int32_t vy;                     /**< @brief Velocity in Y in pixels per second when the finger lifted, for swipes. */
+    uint16_t scale;                 /**< @brief Finger distance relative to the start of a pinch, 256 is unchanged. */
+} ft6336u_gesture_t;
+/* @[declare_ft6336u_gesture_t] */
+
 /**
  * @brief Initializes the FT6336U over I2C.
  * 
@@ -13,19 +77,64 @@
  * @note It creates a FreeRTOS task with the task name `FT6336Task` and installs
  * an ISR on the interrupt pin FT6336U_INTR_PIN.
  *
- * The most recent button press state is stored within the library and can
- * be queried using the functions provided by this library.
+ * The FreeRTOS task sleeps until the FT6336U signals a new report on the
+ * FT6336U_INTR_PIN. Both touch points are then read in one I2C transfer,
+ * timestamped and stored in a ring of CONFIG_FT6336U_TOUCH_RING_LEN samples,
+ * so every reader gets every sample even if it runs late. While the screen
+ * is pressed the task also reads every CONFIG_FT6336U_POLL_MS in case a
+ * report did not raise the interrupt. Gestures are recognized from the
+ * samples and queued for FT6336U_GetGesture().
  *
- * The FreeRTOS task remains suspended and only resumes when the screen is
- * pressed (which is informed by the FT6336U using the interrupt on the
- * FT6336U_INTR_PIN). If multiple press events are stashed by the hardware, the
- * FreeRTOS task keeps retrieving them one by one at an interval of 20 ticks.
- * Once all the events are retrieved, the task suspends itself.
+ * The most recent touch state can also be queried with the functions below.
  */
 /* @[declare_ft6336_init] */
 void FT6336U_Init();
 /* @[declare_ft6336_init] */
 
+/**
+ * @brief Function called by the FT6336U task after each touch read.
+ */
+/* @[declare_ft6336_touch_callback_t] */
+typedef void (*FT6336U_TouchCallback_t)(void);
+/* @[declare_ft6336_touch_callback_t] */
+
+/**
+ * @brief Most touch callbacks that can be registered at once.
+ */
+#define FT6336U_MAX_TOUCH_CALLBACKS 4
+
+/**
+ * @brief Replaces every registered touch callback with one function.
+ *
+ * The callback runs in the `FT6336Task` FreeRTOS task whenever a new sample
+ * is stored, both on press and on release, and must not block. The task
+ * calls the callbacks registered when the sample was stored, so a callback
+ * replaced while the task is calling it may still run for that sample.
+ *
+ * @param[in] callback The function to call, or NULL to remove all of them.
+ */
+/* @[declare_ft6336_settouchcallback] */
+void FT6336U_SetTouchCallback(FT6336U_TouchCallback_t callback);
+/* @[declare_ft6336_settouchcallback] */
+
+/**
+ * @brief Registers one more function to be called whenever a new sample is stored.
+ *
+ * Runs like the callback of FT6336U_SetTouchCallback(). The display driver
+ * uses it to wake the event-driven gui task and the virtual buttons to wake
+ * their task, so neither polls the touch screen.
+ *
+ * @param[in] callback The function to call.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : callback is NULL
+ *  - ESP_ERR_NO_MEM        : FT6336U_MAX_TOUCH_CALLBACKS are already registered
+ */
+/* @[declare_ft6336_addtouchcallback] */
+esp_err_t FT6336U_AddTouchCallback(FT6336U_TouchCallback_t callback);
+/* @[declare_ft6336_addtouchcallback] */
+
 /**
  * @brief Retrieves the most recent touch data from the FT6336U.
  * 
@@ -76,3 +185,81 @@ uint16_t FT6336U_GetPressPosX();
 /* @[declare_ft6336_getpressposy] */
 uint16_t FT6336U_GetPressPosY();
 /* @[declare_ft6336_getpressposy] */
+
+/**
+ * @brief Reads the next touch sample of a reader.
+ *
+ * Each reader keeps its own cursor, starting at 0, so the LVGL input
+ * device, the virtual buttons and the application all see every sample.
+ * A reader that falls more than CONFIG_FT6336U_TOUCH_RING_LEN samples
+ * behind skips to the oldest sample still stored.
+ *
+ * **Example:**
+ *
+ * Print every touch sample.
+ * @code{c}
+ *  static uint32_t cursor = 0;
+ *  ft6336u_touch_t touch;
+ *
+ *  while (FT6336U_ReadTouch(&cursor, &touch)) {
+ *      printf("%lld us: %d points, X: %d, Y: %d\n", touch.time_us, touch.count, touch.points[0].x, touch.points[0].y);
+ *  }
+ * @endcode
+ *
+ * @param[in,out] cursor The reader cursor, advanced past the returned sample.
+ * @param[out] touch The sample.
+ *
+ * @return The number of samples that were waiting for this reader,
+ * including the returned one, or 0 if there was none.
+ */
+/* @[declare_ft6336u_readtouch] */
+uint32_t FT6336U_ReadTouch(uint32_t* cursor, ft6336u_touch_t* touch);
+/* @[declare_ft6336u_readtouch] */
+
+/**
+ * @brief Retrieves the most recent touch sample with all points.
+ *
+ * @param[out] touch The sample.
+ */
+/* @[declare_ft6336u_getpoints] */
+void FT6336U_GetPoints(ft6336u_touch_t* touch);
+/* @[declare_ft6336u_getpoints] */
+
+/**
+ * @brief Retrieves the velocity of the first finger.
+ *
+ * Computed over the samples of the last CONFIG_FT6336U_VELOCITY_WINDOW_MS,
+ * 0 while the screen is released.
+ *
+ * @param[out] vx Velocity in X in pixels per second.
+ * @param[out] vy Velocity in Y in pixels per second.
+ */
+/* @[declare_ft6336u_getvelocity] */
+void FT6336U_GetVelocity(int32_t* vx, int32_t* vy);
+/* @[declare_ft6336u_getvelocity] */
+
+/**
+ * @brief Waits for the next recognized gesture.
+ *
+ * Gestures are dropped when CONFIG_FT6336U_GESTURE_QUEUE_LEN of them are
+ * already waiting.
+ *
+ * **Example:**
+ *
+ * Print the speed of left swipes.
+ * @code{c}
+ *  ft6336u_gesture_t gesture;
+ *
+ *  if (FT6336U_GetGesture(&gesture, portMAX_DELAY) && gesture.type == FT6336U_GESTURE_SWIPE_LEFT) {
+ *      printf("Swiped left at %d px/s\n", -gesture.vx);
+ *  }
+ * @endcode
+ *
+ * @param[out] gesture The gesture.
+ * @param[in] wait Ticks to wait for a gesture.
+ *
+ * @return true if a gesture was returned, false on timeout.
+ */
+/* @[declare_ft6336u_getgesture] */
+bool FT6336U_GetGesture(ft6336u_gesture_t* gesture, TickType_t wait);
+/* @[declare_ft6336u_getgesture] */
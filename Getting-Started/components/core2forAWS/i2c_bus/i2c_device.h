@@ -4,6 +4,8 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "driver/i2c.h"
@@ -41,6 +43,54 @@ extern "C" {
 typedef void * I2CDevice_t;
 /* @[declare_i2cdevice_t] */
 
+/**
+ * @brief Priorities of the queued I2C transactions.
+ *
+ * The transactions of a bus are served in priority order, so latency
+ * sensitive devices like the touch controller and the IMU are not held up
+ * behind the power management or bulk transfers.
+ */
+/* @[declare_i2c_priority_t] */
+typedef enum {
+    I2C_PRIORITY_HIGH = 0,      /**< @brief Served first, e.g. touch and IMU reads. */
+    I2C_PRIORITY_NORMAL,        /**< @brief The default of new devices. */
+    I2C_PRIORITY_BULK,          /**< @brief Served when nothing else is waiting. */
+    I2C_PRIORITY_MAX,
+} i2c_priority_t;
+/* @[declare_i2c_priority_t] */
+
+typedef struct _i2c_trans_t i2c_trans_t;
+
+/**
+ * @brief Function called when a queued transaction completed.
+ *
+ * Runs in the I2C scheduler task of the bus and must not block for long.
+ * It may queue more transactions or call the blocking functions.
+ */
+/* @[declare_i2c_trans_cb_t] */
+typedef void (*i2c_trans_cb_t)(i2c_trans_t *trans);
+/* @[declare_i2c_trans_cb_t] */
+
+/**
+ * @brief A register read or write queued with i2c_queue_trans().
+ *
+ * The descriptor and its data must stay valid until the callback ran.
+ */
+/* @[declare_i2c_trans_t] */
+struct _i2c_trans_t {
+    I2CDevice_t device;         /**< @brief The device to access. */
+    uint32_t reg_addr;          /**< @brief The register address, or I2C_NO_REG. */
+    uint8_t *data;              /**< @brief The bytes to write, or the buffer for the bytes read. */
+    uint16_t length;            /**< @brief Number of bytes to read or write. */
+    bool write;                 /**< @brief Writes data if true, reads into data if false. */
+    i2c_priority_t priority;    /**< @brief The queue the transaction is served from. */
+    i2c_trans_cb_t callback;    /**< @brief Called when complete, may be NULL. */
+    void *user;                 /**< @brief Free for the callback. */
+    esp_err_t err;              /**< @brief Result of the transaction, set before the callback. */
+    int64_t queued_us;          /**< @brief Set when queued, for the bus wait of CONFIG_I2C_TRACE. */
+};
+/* @[declare_i2c_trans_t] */
+
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr);
 
 void i2c_free_device(I2CDevice_t i2c_device);
@@ -87,6 +137,65 @@ esp_err_t i2c_write_bits(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t data
 
 esp_err_t i2c_device_valid(I2CDevice_t i2c_device);
 
+/**
+ * @brief Sets the priority of the blocking reads and writes of a device.
+ *
+ * @param[in] i2c_device The device.
+ * @param[in] priority The priority its transactions are queued with.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : Invalid device or priority
+ */
+/* @[declare_i2c_device_set_priority] */
+esp_err_t i2c_device_set_priority(I2CDevice_t i2c_device, i2c_priority_t priority);
+/* @[declare_i2c_device_set_priority] */
+
+/**
+ * @brief Queues a transaction to the I2C scheduler of its bus.
+ *
+ * With CONFIG_I2C_SCHEDULER, every bus has a task that serves the queued
+ * transactions highest priority first. Register transactions of the same
+ * device and priority waiting together are sent in one command link,
+ * holding the bus only once. If a batched link fails, every transaction of
+ * the batch reports the error, so one device cannot fail another's
+ * transactions. Transactions without a register address are always sent on
+ * their own.
+ *
+ * Without CONFIG_I2C_SCHEDULER the transaction runs right away and the
+ * callback is called before returning.
+ *
+ * The blocking read and write functions queue their transaction with the
+ * priority of the device and wait for it.
+ *
+ * **Example:**
+ *
+ * Read the accelerometer without waiting for it.
+ * @code{c}
+ *  static uint8_t accel[6];
+ *  static i2c_trans_t accel_trans = {
+ *      .reg_addr = 0x3B,
+ *      .data = accel,
+ *      .length = sizeof(accel),
+ *      .priority = I2C_PRIORITY_HIGH,
+ *      .callback = accel_read_done,
+ *  };
+ *  accel_trans.device = imu_device;
+ *  i2c_queue_trans(&accel_trans, portMAX_DELAY);
+ * @endcode
+ *
+ * @param[in,out] trans The transaction.
+ * @param[in] wait The ticks to wait for space in the queue.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Queued
+ *  - ESP_ERR_INVALID_ARG   : Invalid transaction
+ *  - ESP_ERR_TIMEOUT       : The queue stayed full
+ */
+/* @[declare_i2c_queue_trans] */
+esp_err_t i2c_queue_trans(i2c_trans_t *trans, TickType_t wait);
+/* @[declare_i2c_queue_trans] */
+
 BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout);
 
 BaseType_t i2c_free_port(i2c_port_t i2c_num);
@@ -0,0 +1,156 @@
+/*
+ * Host benchmark of the MPU6886 orientation filter.
+ *
+ * The gyroscope bias of a device lying still is calibrated and saved to NVS.
+ * The device then tumbles around all three axes while the filter runs on
+ * every sample of the 1 kHz stream, first without the bias and then with the
+ * one loaded from NVS. The tilt, the angle between the gravity the filter
+ * expects and the true one of the model, is compared after the first second,
+ * and must stay within MAX_TILT_DEG with the calibration.
+ * A level device shaken up and down checks the acceleration without gravity.
+ *
+ * The cycles of an update are counted with xthal_get_ccount(), which is the
+ * time stamp counter here. They compare builds of the filter on the host
+ * only and say nothing about the ESP32 FPU. On the device mpu6886_fusion_t
+ * counts the CPU cycles the same way. Exits with 1 when the filter is off.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "axp192.h"
+#include "mpu6886.h"
+#include "mpu6886_fusion.h"
+
+#define RATE_HZ         1000
+#define RUN_MS          4000
+#define SETTLE_US       1000000
+#define MAX_TILT_DEG    2.0f
+
+static const sim_imu_motion_t still = { .gyro_bias_dps = { 1.5f, -2.0f, 0.5f }, .noise = 0.02f };
+static const sim_imu_motion_t tumbling = {
+    .rate_dps = { 40, -25, 15 },
+    .gyro_bias_dps = { 1.5f, -2.0f, 0.5f },
+    .noise = 0.02f,
+};
+
+/* Angle between the gravity the filter expects and the true one, in degrees */
+static float tilt_error(const mpu6886_attitude_t *attitude, int64_t time_us)
+{
+    float q[4], g[3];
+    sim_mpu6886_get_orientation(time_us, q);
+    g[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+    g[1] = 2 * (q[2] * q[3] + q[0] * q[1]);
+    g[2] = 1 - 2 * (q[1] * q[1] + q[2] * q[2]);
+    float dot = g[0] * attitude->gravity[0] + g[1] * attitude->gravity[1] + g[2] * attitude->gravity[2];
+    return acosf(dot > 1.0f ? 1.0f : dot) * 180.0f / (float) M_PI;
+}
+
+static int run_tumbling(const char *name, bool calibrated)
+{
+    mpu6886_fusion_t fusion;
+    mpu6886_attitude_t attitude;
+    mpu6886_sample_t sample;
+    uint32_t cursor = 0, compared = 0;
+    double tilt_sum = 0;
+    float tilt_max = 0;
+
+    MPU6886_FusionInit(&fusion);
+    if (!calibrated) {
+        float zero[3] = { 0 };
+        MPU6886_FusionSetGyroBias(&fusion, zero);
+    }
+    sim_mpu6886_set_motion(&tumbling);
+    MPU6886_StartStream(RATE_HZ);
+    /* Start from the newest sample */
+    while (MPU6886_ReadSample(&cursor, &sample) > 1) {
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    while (esp_timer_get_time() - start_us < RUN_MS * 1000) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        while (MPU6886_ReadSample(&cursor, &sample)) {
+            MPU6886_FusionUpdate(&fusion, &sample);
+            if (sample.time_us - start_us < SETTLE_US) {
+                continue;
+            }
+            MPU6886_FusionGetAttitude(&fusion, &attitude);
+            float tilt = tilt_error(&attitude, sample.time_us);
+            tilt_sum += tilt;
+            tilt_max = tilt > tilt_max ? tilt : tilt_max;
+            compared++;
+        }
+    }
+    MPU6886_StopStream();
+
+    printf("%-10s %7u %8.0f %8u %9.2f %9.2f\n", name, fusion.updates,
+           fusion.updates ? (double) fusion.cycles / fusion.updates : 0.0, fusion.cycles_max,
+           compared ? tilt_sum / compared : 0.0, tilt_max);
+    /* Without the calibration the tilt lags by about the bias over the proportional gain */
+    return compared > 0 && (!calibrated || tilt_max < MAX_TILT_DEG) ? 0 : 1;
+}
+
+/* Level and shaken along Z, the acceleration without gravity follows the shake */
+static int run_shake(void)
+{
+    sim_imu_motion_t shake = { .shake_g = 0.1f, .shake_hz = 2.0f };
+    mpu6886_fusion_t fusion;
+    mpu6886_attitude_t attitude;
+    mpu6886_sample_t sample;
+    uint32_t cursor = 0, compared = 0;
+    double error_sq = 0;
+
+    MPU6886_FusionInit(&fusion);
+    sim_mpu6886_set_motion(&shake);
+    int64_t motion_us = esp_timer_get_time();
+    MPU6886_StartStream(RATE_HZ);
+    while (MPU6886_ReadSample(&cursor, &sample) > 1) {
+    }
+
+    while (esp_timer_get_time() - motion_us < 2000000) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        while (MPU6886_ReadSample(&cursor, &sample)) {
+            MPU6886_FusionUpdate(&fusion, &sample);
+            MPU6886_FusionGetAttitude(&fusion, &attitude);
+            float t = (sample.time_us - motion_us) / 1e6f;
+            float expected = shake.shake_g * sinf(2.0f * (float) M_PI * shake.shake_hz * t);
+            float e = attitude.linear_accel_world[2] - expected;
+            error_sq += e * e;
+            compared++;
+        }
+    }
+    MPU6886_StopStream();
+
+    double rms = compared ? sqrt(error_sq / compared) : 1.0;
+    printf("shake 0.1 G at 2 Hz, vertical acceleration without gravity off by %.4f G rms\n", rms);
+    return rms < 0.01 ? 0 : 1;
+}
+
+int main(void)
+{
+    int errors = 0;
+    float bias[3];
+
+    sim_board_init();
+    Axp192_Init();
+    MPU6886_Init();
+
+    sim_mpu6886_set_motion(&still);
+    esp_err_t err = MPU6886_CalibrateGyroBias(500, bias);
+    printf("gyro bias %+.2f %+.2f %+.2f dps (%s)\n", bias[0], bias[1], bias[2], esp_err_to_name(err));
+    errors += err != ESP_OK;
+
+    printf("%-10s %7s %8s %8s %9s %9s\n", "filter", "updates", "host avg", "host max", "tilt avg", "tilt max");
+    errors += run_tumbling("uncalib", false);
+    errors += run_tumbling("calibrated", true);
+    errors += run_shake();
+
+    if (errors) printf("FAILED\n");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,6 @@
+/* Host stand-in for the ESP-IDF placement attributes */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
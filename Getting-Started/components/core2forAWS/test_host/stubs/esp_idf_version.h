@@ -0,0 +1,6 @@
+/* Host stand-in for the ESP-IDF version macros, the drivers are simulated as on v4.2 */
+
+#pragma once
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch)    (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION                             ESP_IDF_VERSION_VAL(4, 2, 0)
@@ -0,0 +1,13 @@
+/* Host stand-in for the ESP-IDF logging macros */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) printf("E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) printf("I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void) 0)
+#define ESP_LOGV(tag, fmt, ...) ((void) 0)
+#define ESP_LOG_BUFFER_HEX(tag, buffer, length) ((void) 0)
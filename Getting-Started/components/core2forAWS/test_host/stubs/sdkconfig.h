@@ -0,0 +1 @@
+/* Host builds pass the CONFIG_ options they need on the command line */
@@ -0,0 +1,110 @@
+/**
+ * @file disp_diff.h
+ * @brief Scanline-diff display updates through a shadow framebuffer.
+ *
+ * Enabled with CONFIG_LV_DISP_SCANLINE_DIFF. A copy of the whole 320x240
+ * RGB565 panel content is kept in PSRAM. Every area LVGL renders is compared
+ * with it row by row and only the changed spans of each scanline are
+ * recorded. Once the last area of a frame is rendered, the spans are merged
+ * into a few rectangular windows and those are sent from the shadow
+ * framebuffer in a single bus sequence, top to bottom.
+ *
+ * Screens which change many scattered pixels inside large invalidated areas,
+ * like a clock hand or spectrum bars, send only the pixels that actually
+ * changed instead of whole areas. Spans closer than
+ * CONFIG_LV_DISP_DIFF_WINDOW_COST bytes are merged, because the commands and
+ * transactions of another window cost about as much as sending the unchanged
+ * pixels in between.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "lvgl/lvgl.h"
+
+/**
+ * @brief Most windows sent for a frame, further changes are merged into them.
+ */
+#define DISP_DIFF_MAX_WINDOWS   32
+
+/**
+ * @brief Scanline-diff statistics.
+ */
+/* @[declare_disp_diff_stats_t] */
+typedef struct {
+    uint32_t frames;            /**< Frames diffed. */
+    uint32_t frames_unchanged;  /**< Frames that sent nothing at all. */
+    uint64_t px_rendered;       /**< Pixels rendered by LVGL. */
+    uint64_t px_sent;           /**< Pixels sent to the display. */
+    uint32_t windows;           /**< Windows sent. */
+    uint32_t last_px_rendered;  /**< Pixels rendered in the last frame. */
+    uint32_t last_px_sent;      /**< Pixels sent in the last frame. */
+    uint16_t last_windows;      /**< Windows sent in the last frame. */
+} disp_diff_stats_t;
+/* @[declare_disp_diff_stats_t] */
+
+/**
+ * @brief Allocates the shadow framebuffer.
+ *
+ * Called by disp_driver_init(). If PSRAM is not available, the display is
+ * flushed area by area as without CONFIG_LV_DISP_SCANLINE_DIFF.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_NO_MEM        : The shadow framebuffer could not be allocated
+ */
+/* @[declare_dispdiff_init] */
+esp_err_t DispDiff_Init(void);
+/* @[declare_dispdiff_init] */
+
+/**
+ * @brief Diffs a rendered area against the shadow framebuffer.
+ *
+ * Called by disp_driver_flush(). The last area of a frame queues the
+ * changed windows and its last transaction signals lv_disp_flush_ready().
+ *
+ * @return false if the shadow framebuffer is not available and the area
+ * must be flushed as is.
+ */
+/* @[declare_dispdiff_flush] */
+bool DispDiff_Flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
+/* @[declare_dispdiff_flush] */
+
+/**
+ * @brief Sends every rendered pixel of the next frame.
+ *
+ * Call it when the panel lost its content, e.g. after a reset, so that the
+ * shadow framebuffer is not trusted for the next frame. Call
+ * lv_obj_invalidate(lv_scr_act()) too to redraw the whole screen.
+ *
+ * Must be called with xGuiSemaphore taken.
+ */
+/* @[declare_dispdiff_invalidate] */
+void DispDiff_Invalidate(void);
+/* @[declare_dispdiff_invalidate] */
+
+/**
+ * @brief Copies the scanline-diff statistics.
+ *
+ * **Example:**
+ *
+ * Log the share of the rendered pixels that were actually sent.
+ * @code{c}
+ *  disp_diff_stats_t stats;
+ *  DispDiff_GetStats(&stats);
+ *  ESP_LOGI(TAG, "Sent %llu of %llu rendered pixels in %u windows",
+ *           stats.px_sent, stats.px_rendered, stats.windows);
+ * @endcode
+ *
+ * @param[out] stats The statistics.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : stats is NULL
+ */
+/* @[declare_dispdiff_getstats] */
+esp_err_t DispDiff_GetStats(disp_diff_stats_t *stats);
+/* @[declare_dispdiff_getstats] */
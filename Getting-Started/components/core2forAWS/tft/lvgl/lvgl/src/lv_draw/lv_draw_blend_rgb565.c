@@ -0,0 +1,240 @@
+/**
+ * @file lv_draw_blend_rgb565.c
+ *
+ * The generic blending loops mix colors channel by channel through the `lv_color_t` bit fields,
+ * which is slow when the green channel is split by `LV_COLOR_16_SWAP`.
+ * These kernels work on the raw 16 bit values instead:
+ * - red and blue (or the same channel of two pixels) are mixed in two 16 bit lanes of one 32 bit word,
+ * - the division by 255 is done in the lanes too, with `(x + 1 + (x >> 8)) >> 8` (exact for x < 65535),
+ * - pixels are read and written in pairs with 32 bit accesses where the alignment allows it.
+ * Masked fills and images stay on the generic loops, whose cache of the last mixed color already makes
+ * them as fast.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lv_draw_blend_rgb565.h"
+#include "../lv_misc/lv_mem.h"
+
+#if LV_DRAW_BLEND_RGB565
+
+/*********************
+ *      DEFINES
+ *********************/
+#define LANE_MASK_5     0x001F001FU
+#define LANE_MASK_6     0x003F003FU
+#define LANE_MASK_8     0x00FF00FFU
+#define LANE_ONE        0x00010001U
+#define LANE_ROUND      (LANE_ONE * LV_COLOR_MIX_ROUND_OFS)
+
+/**********************
+ *      MACROS
+ **********************/
+
+/*Convert between the buffer's byte order and plain RGB565 (one pixel or a pixel pair)*/
+#if LV_COLOR_16_SWAP
+#define PX_TO_565(px)       ((uint16_t)(((px) >> 8) | ((px) << 8)))
+#define PAIR_TO_565(pair)   ((((pair) & LANE_MASK_8) << 8) | (((pair) >> 8) & LANE_MASK_8))
+#else
+#define PX_TO_565(px)       ((uint16_t)(px))
+#define PAIR_TO_565(pair)   (pair)
+#endif
+#define PX_FROM_565(px)     PX_TO_565(px)
+#define PAIR_FROM_565(pair) PAIR_TO_565(pair)
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/*Divide both 16 bit lanes by 255*/
+LV_ATTRIBUTE_BLEND_RGB565 static inline uint32_t lane_div255(uint32_t x)
+{
+    x = x + LANE_ONE + ((x >> 8) & LANE_MASK_8);
+    return (x >> 8) & LANE_MASK_8;
+}
+
+/*Red in the high lane, blue in the low lane*/
+LV_ATTRIBUTE_BLEND_RGB565 static inline uint32_t px_rb(uint32_t c565)
+{
+    return ((c565 & 0xF800) << 5) | (c565 & 0x1F);
+}
+
+/**
+ * Same result as `lv_color_mix(fg, bg, mix)` on raw buffer values
+ */
+LV_ATTRIBUTE_BLEND_RGB565 static inline uint16_t px_mix(uint16_t fg, uint16_t bg, uint32_t mix)
+{
+    uint32_t f = PX_TO_565(fg);
+    uint32_t b = PX_TO_565(bg);
+    uint32_t mix_inv = 255 - mix;
+
+    uint32_t rb = lane_div255(px_rb(f) * mix + px_rb(b) * mix_inv + LANE_ROUND);
+    uint32_t g = lane_div255(((f >> 5) & 0x3F) * mix + ((b >> 5) & 0x3F) * mix_inv + LANE_ROUND) & 0x3F;
+
+    uint32_t res = ((rb >> 5) & 0xF800) | (g << 5) | (rb & 0x1F);
+    return PX_FROM_565(res);
+}
+
+/**
+ * Mix the same channel of two pixels. `fg` and `bg` hold the channel of the first pixel in the low lane.
+ */
+LV_ATTRIBUTE_BLEND_RGB565 static inline uint32_t pair_mix(uint32_t fg, uint32_t bg, uint32_t mix)
+{
+    /*Premultiplied channels fit the lanes: 63 * 255 + 128 < 65535*/
+    return lane_div255(fg * mix + bg * (255 - mix) + LANE_ROUND);
+}
+
+/**
+ * Mix two pixels of `src` over two pixels of `dest` with the same ratio
+ */
+LV_ATTRIBUTE_BLEND_RGB565 static inline uint32_t pair_mix_px(uint32_t src, uint32_t dest, uint32_t mix)
+{
+    uint32_t s = PAIR_TO_565(src);
+    uint32_t d = PAIR_TO_565(dest);
+
+    uint32_t b = pair_mix(s & LANE_MASK_5, d & LANE_MASK_5, mix);
+    uint32_t g = pair_mix((s >> 5) & LANE_MASK_6, (d >> 5) & LANE_MASK_6, mix);
+    uint32_t r = pair_mix((s >> 11) & LANE_MASK_5, (d >> 11) & LANE_MASK_5, mix);
+
+    return PAIR_FROM_565(b | (g << 5) | (r << 11));
+}
+
+/*Read two (maybe not 32 bit aligned) pixels*/
+LV_ATTRIBUTE_BLEND_RGB565 static inline uint32_t pair_load(const uint16_t * px)
+{
+    return (uint32_t)px[0] | ((uint32_t)px[1] << 16);
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+LV_ATTRIBUTE_BLEND_RGB565 void _lv_blend_rgb565_fill_opa(lv_color_t * dest, int32_t dest_stride, int32_t w, int32_t h,
+                                                         lv_color_t color, lv_opa_t opa)
+{
+    uint32_t c = PX_TO_565(color.full);
+    uint32_t opa_inv = 255 - opa;
+
+    /*Premultiply the fill color once, in the layout of a pixel pair*/
+    uint32_t fg_b = (c & 0x1F) * opa * LANE_ONE + LANE_ROUND;
+    uint32_t fg_g = ((c >> 5) & 0x3F) * opa * LANE_ONE + LANE_ROUND;
+    uint32_t fg_r = (c >> 11) * opa * LANE_ONE + LANE_ROUND;
+
+    /*Most fills are on a plain background: reuse the last result (start with a black pair)*/
+    uint32_t last_dest = 0;
+    uint32_t last_res = PAIR_FROM_565(lane_div255(fg_b) | (lane_div255(fg_g) << 5) | (lane_div255(fg_r) << 11));
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        uint16_t * d16 = (uint16_t *)dest;
+        int32_t x = 0;
+
+        if((lv_uintptr_t)d16 & 0x3) {
+            d16[0] = px_mix(color.full, d16[0], opa);
+            x++;
+        }
+
+        uint32_t * d32 = (uint32_t *)(d16 + x);
+        int32_t pairs = (w - x) >> 1;
+        int32_t i;
+        for(i = 0; i < pairs; i++) {
+            uint32_t px = d32[i];
+            if(px != last_dest) {
+                uint32_t d = PAIR_TO_565(px);
+                uint32_t b = lane_div255(fg_b + (d & LANE_MASK_5) * opa_inv);
+                uint32_t g = lane_div255(fg_g + ((d >> 5) & LANE_MASK_6) * opa_inv);
+                uint32_t r = lane_div255(fg_r + ((d >> 11) & LANE_MASK_5) * opa_inv);
+                last_dest = px;
+                last_res = PAIR_FROM_565(b | (g << 5) | (r << 11));
+            }
+            d32[i] = last_res;
+        }
+        x += pairs << 1;
+
+        if(x < w) {
+            d16[x] = px_mix(color.full, d16[x], opa);
+        }
+
+        dest += dest_stride;
+    }
+}
+
+LV_ATTRIBUTE_BLEND_RGB565 void _lv_blend_rgb565_map_copy(lv_color_t * dest, int32_t dest_stride,
+                                                         const lv_color_t * src, int32_t src_stride, int32_t w, int32_t h)
+{
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        uint16_t * d16 = (uint16_t *)dest;
+        const uint16_t * s16 = (const uint16_t *)src;
+        int32_t x = 0;
+
+        if((lv_uintptr_t)d16 & 0x3) {
+            d16[0] = s16[0];
+            x++;
+        }
+
+        uint32_t * d32 = (uint32_t *)(d16 + x);
+        int32_t pairs = (w - x) >> 1;
+
+        if(((lv_uintptr_t)(s16 + x) & 0x3) == 0) {
+            /*Both aligned: the word copy of _lv_memcpy() is already fast*/
+            _lv_memcpy(d32, s16 + x, pairs * sizeof(uint32_t));
+        }
+        else {
+            /*The source is off by one pixel: assemble the words from half words*/
+            const uint16_t * s = s16 + x;
+            int32_t i;
+            for(i = 0; i <= pairs - 2; i += 2) {
+                d32[i] = pair_load(&s[i * 2]);
+                d32[i + 1] = pair_load(&s[i * 2 + 2]);
+            }
+            for(; i < pairs; i++) {
+                d32[i] = pair_load(&s[i * 2]);
+            }
+        }
+        x += pairs << 1;
+
+        if(x < w) {
+            d16[x] = s16[x];
+        }
+
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+LV_ATTRIBUTE_BLEND_RGB565 void _lv_blend_rgb565_map_opa(lv_color_t * dest, int32_t dest_stride,
+                                                        const lv_color_t * src, int32_t src_stride, int32_t w, int32_t h,
+                                                        lv_opa_t opa)
+{
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        uint16_t * d16 = (uint16_t *)dest;
+        const uint16_t * s16 = (const uint16_t *)src;
+        int32_t x = 0;
+
+        if((lv_uintptr_t)d16 & 0x3) {
+            d16[0] = px_mix(s16[0], d16[0], opa);
+            x++;
+        }
+
+        uint32_t * d32 = (uint32_t *)(d16 + x);
+        const uint16_t * s = s16 + x;
+        int32_t pairs = (w - x) >> 1;
+        int32_t i;
+        for(i = 0; i < pairs; i++) {
+            d32[i] = pair_mix_px(pair_load(&s[i * 2]), d32[i], opa);
+        }
+        x += pairs << 1;
+
+        if(x < w) {
+            d16[x] = px_mix(s16[x], d16[x], opa);
+        }
+
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+#endif /*LV_DRAW_BLEND_RGB565*/
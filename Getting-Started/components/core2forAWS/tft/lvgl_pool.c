@@ -0,0 +1,350 @@
+/**
+ * @file lvgl_pool.c
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LV_MEM_POOL
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "lvgl_pool.h"
+
+#ifndef CONFIG_LV_MEM_POOL_INTERNAL_KB
+#define CONFIG_LV_MEM_POOL_INTERNAL_KB 32
+#endif
+
+#define ARENA_SIZE      (CONFIG_LV_MEM_POOL_INTERNAL_KB * 1024)
+#define PAGE_COUNT      (ARENA_SIZE / LVGL_POOL_PAGE_SIZE)
+#define PAGE_NONE       0xFF
+#define CLASS_NONE      0xFF
+
+_Static_assert(PAGE_COUNT < PAGE_NONE, "Too many arena pages for 8 bit page indices");
+
+/* Allocations outside of the arena remember their size in front of the data */
+#define OVERFLOW_HEADER 8
+
+typedef struct block {
+    struct block *next;
+} block_t;
+
+typedef struct {
+    block_t *free;      /* Free blocks of the page */
+    uint16_t used;      /* Blocks in use */
+    uint8_t cls;        /* Size class, CLASS_NONE while the page is free */
+    uint8_t prev;       /* Links in the list of pages with free blocks of the class, */
+    uint8_t next;       /* or in the list of free pages */
+} page_t;
+
+typedef struct {
+    uint8_t partial;    /* First page of the class with free blocks */
+    uint16_t blocks_per_page;
+    lvgl_pool_class_stats_t stats;
+} class_t;
+
+static const uint16_t class_sizes[LVGL_POOL_CLASSES] = { 16, 24, 32, 48, 64, 96, 128, 192, 256 };
+
+static uint8_t arena[ARENA_SIZE] __attribute__((aligned(8)));
+static page_t pages[PAGE_COUNT];
+static class_t classes[LVGL_POOL_CLASSES];
+static uint8_t free_pages = PAGE_NONE;
+static uint8_t size_to_class[LVGL_POOL_MAX_BLOCK / 8 + 1];
+static bool initialized;
+
+static lvgl_pool_stats_t totals;
+static int64_t rate_start_us;
+static uint32_t rate_start_allocs;
+
+/* LVGL only allocates with xGuiSemaphore taken, this guards the statistics readers */
+static portMUX_TYPE pool_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void pool_init(void) {
+    uint8_t cls = 0;
+    for (int i = 0; i <= LVGL_POOL_MAX_BLOCK / 8; i++) {
+        while (class_sizes[cls] < i * 8) {
+            cls++;
+        }
+        size_to_class[i] = cls;
+    }
+
+    for (int i = 0; i < LVGL_POOL_CLASSES; i++) {
+        classes[i].partial = PAGE_NONE;
+        classes[i].blocks_per_page = LVGL_POOL_PAGE_SIZE / class_sizes[i];
+        classes[i].stats.block_size = class_sizes[i];
+    }
+
+    for (int i = PAGE_COUNT - 1; i >= 0; i--) {
+        pages[i].cls = CLASS_NONE;
+        pages[i].next = free_pages;
+        free_pages = i;
+    }
+
+    totals.arena_size = ARENA_SIZE;
+    totals.pages_free = PAGE_COUNT;
+    initialized = true;
+}
+
+static void partial_push(class_t *c, uint8_t index) {
+    pages[index].prev = PAGE_NONE;
+    pages[index].next = c->partial;
+    if (c->partial != PAGE_NONE) {
+        pages[c->partial].prev = index;
+    }
+    c->partial = index;
+}
+
+static void partial_remove(class_t *c, uint8_t index) {
+    page_t *page = &pages[index];
+    if (page->prev != PAGE_NONE) {
+        pages[page->prev].next = page->next;
+    } else {
+        c->partial = page->next;
+    }
+    if (page->next != PAGE_NONE) {
+        pages[page->next].prev = page->prev;
+    }
+}
+
+/* Hands a free page to a class and threads its blocks into a free list */
+static bool page_assign(uint8_t cls) {
+    if (free_pages == PAGE_NONE) {
+        return false;
+    }
+
+    uint8_t index = free_pages;
+    page_t *page = &pages[index];
+    free_pages = page->next;
+
+    class_t *c = &classes[cls];
+    uint8_t *base = &arena[index * LVGL_POOL_PAGE_SIZE];
+    block_t *prev = NULL;
+    for (int i = c->blocks_per_page - 1; i >= 0; i--) {
+        block_t *block = (block_t *) (base + i * class_sizes[cls]);
+        block->next = prev;
+        prev = block;
+    }
+    page->free = prev;
+    page->used = 0;
+    page->cls = cls;
+    partial_push(c, index);
+
+    c->stats.pages++;
+    totals.pages_free--;
+    return true;
+}
+
+static void page_release(uint8_t index) {
+    page_t *page = &pages[index];
+    classes[page->cls].stats.pages--;
+    page->cls = CLASS_NONE;
+    page->next = free_pages;
+    free_pages = index;
+    totals.pages_free++;
+}
+
+static void *overflow_alloc(size_t size) {
+    uint8_t *p = heap_caps_malloc(size + OVERFLOW_HEADER, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p == NULL) {
+        p = heap_caps_malloc(size + OVERFLOW_HEADER, MALLOC_CAP_8BIT);
+    }
+    if (p == NULL) {
+        return NULL;
+    }
+    *(uint32_t *) p = size;
+
+    portENTER_CRITICAL(&pool_mux);
+    totals.overflow_used += size;
+    totals.overflow_count++;
+    if (totals.overflow_used > totals.overflow_peak) {
+        totals.overflow_peak = totals.overflow_used;
+    }
+    portEXIT_CRITICAL(&pool_mux);
+
+    return p + OVERFLOW_HEADER;
+}
+
+void *LvglPool_Alloc(size_t size) {
+    if (!initialized) {
+        pool_init();
+    }
+
+    void *ptr = NULL;
+
+    if (size <= LVGL_POOL_MAX_BLOCK) {
+        uint8_t cls = size_to_class[(size + 7) / 8];
+        class_t *c = &classes[cls];
+
+        portENTER_CRITICAL(&pool_mux);
+        if (c->partial != PAGE_NONE || page_assign(cls)) {
+            uint8_t index = c->partial;
+            page_t *page = &pages[index];
+            block_t *block = page->free;
+            page->free = block->next;
+            if (++page->used == c->blocks_per_page) {
+                partial_remove(c, index);
+            }
+
+            c->stats.allocs++;
+            if (++c->stats.used > c->stats.peak_used) {
+                c->stats.peak_used = c->stats.used;
+            }
+            totals.internal_used += class_sizes[cls];
+            if (totals.internal_used > totals.internal_peak) {
+                totals.internal_peak = totals.internal_used;
+            }
+            totals.allocs++;
+            ptr = block;
+        } else {
+            totals.arena_full++;
+        }
+        portEXIT_CRITICAL(&pool_mux);
+
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+
+    ptr = overflow_alloc(size);
+
+    portENTER_CRITICAL(&pool_mux);
+    if (ptr != NULL) {
+        totals.allocs++;
+    } else {
+        totals.failed++;
+    }
+    portEXIT_CRITICAL(&pool_mux);
+
+    return ptr;
+}
+
+void LvglPool_Free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    uint8_t *p = ptr;
+    if (p < arena || p >= arena + ARENA_SIZE) {
+        p -= OVERFLOW_HEADER;
+        uint32_t size = *(uint32_t *) p;
+        heap_caps_free(p);
+
+        portENTER_CRITICAL(&pool_mux);
+        totals.overflow_used -= size;
+        totals.overflow_count--;
+        totals.frees++;
+        portEXIT_CRITICAL(&pool_mux);
+        return;
+    }
+
+    uint8_t index = (p - arena) / LVGL_POOL_PAGE_SIZE;
+    page_t *page = &pages[index];
+    class_t *c = &classes[page->cls];
+
+    portENTER_CRITICAL(&pool_mux);
+    block_t *block = ptr;
+    block->next = page->free;
+    page->free = block;
+    if (page->used-- == c->blocks_per_page) {
+        partial_push(c, index);
+    }
+
+    c->stats.used--;
+    totals.internal_used -= class_sizes[page->cls];
+    totals.frees++;
+
+    /* Give empty pages back to the other classes, but keep one so a class
+     * that allocates and frees the same block doesn't churn pages */
+    if (page->used == 0 && (page->prev != PAGE_NONE || page->next != PAGE_NONE)) {
+        partial_remove(c, index);
+        page_release(index);
+    }
+    portEXIT_CRITICAL(&pool_mux);
+}
+
+/* Must be called within pool_mux, returns the free bytes in partially used pages */
+static uint32_t partial_free_bytes(void) {
+    uint32_t bytes = 0;
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        if (pages[i].cls != CLASS_NONE) {
+            const class_t *c = &classes[pages[i].cls];
+            bytes += (c->blocks_per_page - pages[i].used) * class_sizes[pages[i].cls];
+        }
+    }
+    return bytes;
+}
+
+static void stats_read(lvgl_pool_stats_t *stats) {
+    portENTER_CRITICAL(&pool_mux);
+    if (!initialized) {
+        pool_init();
+    }
+    *stats = totals;
+    for (int i = 0; i < LVGL_POOL_CLASSES; i++) {
+        stats->classes[i] = classes[i].stats;
+    }
+    uint32_t stuck = partial_free_bytes();
+    portEXIT_CRITICAL(&pool_mux);
+
+    uint32_t free_bytes = stuck + stats->pages_free * LVGL_POOL_PAGE_SIZE;
+    stats->frag_pct = free_bytes ? stuck * 100 / free_bytes : 0;
+}
+
+esp_err_t LvglPool_GetStats(lvgl_pool_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+    stats_read(stats);
+
+    if (now > rate_start_us) {
+        stats->allocs_per_sec = (uint64_t) (stats->allocs - rate_start_allocs) * 1000000 / (now - rate_start_us);
+    }
+    rate_start_us = now;
+    rate_start_allocs = stats->allocs;
+
+    return ESP_OK;
+}
+
+void LvglPool_Dump(void) {
+    lvgl_pool_stats_t stats;
+    LvglPool_GetStats(&stats);
+
+    printf("LVGL pool: arena %u B, %u B used (peak %u), %u/%u pages free, %u%% fragmented\n",
+           stats.arena_size, stats.internal_used, stats.internal_peak, stats.pages_free,
+           stats.arena_size / LVGL_POOL_PAGE_SIZE, stats.frag_pct);
+    printf("Overflow: %u B in %u allocations (peak %u B), %u because the arena was full, %u failed\n",
+           stats.overflow_used, stats.overflow_count, stats.overflow_peak, stats.arena_full, stats.failed);
+    printf("%u allocations, %u frees, %u allocations/s\n", stats.allocs, stats.frees, stats.allocs_per_sec);
+    printf("%6s %6s %8s %8s %10s\n", "block", "pages", "used", "peak", "allocs");
+    for (int i = 0; i < LVGL_POOL_CLASSES; i++) {
+        const lvgl_pool_class_stats_t *c = &stats.classes[i];
+        printf("%6u %6u %8u %8u %10u\n", c->block_size, c->pages, c->used, c->peak_used, c->allocs);
+    }
+}
+
+void LvglPool_Monitor(lv_mem_monitor_t *mon) {
+    lvgl_pool_stats_t stats;
+    stats_read(&stats);
+
+    mon->total_size = stats.arena_size + stats.overflow_used;
+    mon->free_size = stats.arena_size - stats.internal_used;
+    mon->free_biggest_size = stats.pages_free ? LVGL_POOL_PAGE_SIZE : 0;
+    mon->max_used = stats.internal_peak + stats.overflow_peak;
+    mon->used_cnt = stats.overflow_count;
+    for (int i = 0; i < LVGL_POOL_CLASSES; i++) {
+        mon->used_cnt += stats.classes[i].used;
+        mon->free_cnt += stats.classes[i].pages * (LVGL_POOL_PAGE_SIZE / stats.classes[i].block_size)
+                         - stats.classes[i].used;
+    }
+    mon->used_pct = 100 - (100U * mon->free_size) / mon->total_size;
+    mon->frag_pct = stats.frag_pct;
+}
+
+#endif /* CONFIG_LV_MEM_POOL */
@@ -0,0 +1,116 @@
+/**
+ * @file microphone_vad.h
+ * @brief Voice and sound activity detection on the frames of the microphone capture.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "microphone.h"
+
+/**
+ * @brief What a frame changed in the activity.
+ */
+/* @[declare_mic_vad_event_t] */
+typedef enum {
+    MIC_VAD_NONE = 0,   /**< @brief No change. */
+    MIC_VAD_START,      /**< @brief Activity started with this frame. */
+    MIC_VAD_STOP,       /**< @brief The hangover after the last active frame ran out. */
+} mic_vad_event_t;
+/* @[declare_mic_vad_event_t] */
+
+/**
+ * @brief State of a detector.
+ *
+ * Each frame gives two features computed in integer arithmetic in a single
+ * pass over the samples: the energy without the DC offset, as log2 in Q8,
+ * and the rate of zero crossings. A frame is active when its energy is
+ * threshold_q8 above the noise floor and it crosses zero less often than
+ * broadband hiss does. The noise floor follows quieter frames quickly and
+ * louder ones slowly, so steady noise such as a fan stops counting after a
+ * while.
+ *
+ * Activity starts after onset_us of active frames and stops hangover_us after
+ * the last one, which bridges the pauses between words.
+ */
+/* @[declare_mic_vad_t] */
+typedef struct {
+    uint32_t sample_rate;       /**< @brief Sample rate of the frames in Hz. */
+    int32_t threshold_q8;       /**< @brief Energy above the noise floor of an active frame, log2 in Q8, 85 per dB. */
+    uint16_t max_zcr_permille;  /**< @brief Most zero crossings per thousand samples of an active frame. */
+    uint32_t onset_us;          /**< @brief Active frames needed to start. */
+    uint32_t hangover_us;       /**< @brief Time after the last active frame to stop. */
+    int32_t noise_q8;           /**< @brief Noise floor, log2 of the mean energy in Q8. */
+    int32_t energy_q8;          /**< @brief Energy of the last frame, log2 of the mean energy in Q8. */
+    uint16_t zcr_permille;      /**< @brief Zero crossings per thousand samples of the last frame. */
+    int16_t dc;                 /**< @brief Mean of the last frame, removed from the next. */
+    bool started;               /**< @brief Whether the noise floor was set from a first frame. */
+    bool active;                /**< @brief Whether there is activity. */
+    uint32_t speech_us;         /**< @brief Length of the run of active frames. */
+    int64_t last_speech_us;     /**< @brief End of the last active frame. */
+    uint32_t frames;            /**< @brief Frames processed. */
+    uint32_t active_frames;     /**< @brief Frames processed during activity, hangovers included. */
+    uint32_t starts;            /**< @brief Times activity started. */
+    uint64_t cycles;            /**< @brief CPU cycles spent in Microphone_VadProcess(). */
+    uint32_t cycles_max;        /**< @brief Most CPU cycles of one frame. */
+} mic_vad_t;
+/* @[declare_mic_vad_t] */
+
+/**
+ * @brief Initializes a detector.
+ *
+ * The threshold, the zero crossing limit, the onset and the hangover come from
+ * CONFIG_MIC_VAD_THRESHOLD_DB, CONFIG_MIC_VAD_MAX_ZCR, CONFIG_MIC_VAD_ONSET_MS
+ * and CONFIG_MIC_VAD_HANGOVER_MS, and can be changed in the state afterwards.
+ * The noise floor is set from the first frame.
+ *
+ * @param[out] vad The detector.
+ * @param[in] sample_rate Sample rate of the frames in Hz.
+ */
+/* @[declare_microphone_vadinit] */
+void Microphone_VadInit(mic_vad_t *vad, uint32_t sample_rate);
+/* @[declare_microphone_vadinit] */
+
+/**
+ * @brief Updates a detector with a frame.
+ *
+ * Meant to be fed every frame of a subscriber of the capture, before the
+ * frame is released. Costs a few cycles per sample, so the processing it
+ * gates, an FFT or an upload, can be skipped while there is no activity.
+ * The timestamps of the frames measure the onset and the hangover.
+ *
+ * **Example:**
+ *
+ * Transform only the frames with sound in them.
+ * @code{c}
+ *  mic_vad_t vad;
+ *  mic_subscriber_t subscriber;
+ *  const mic_frame_t *frame;
+ *
+ *  Microphone_StartCapture(&(mic_capture_config_t) { .sample_rate = 16000 });
+ *  Microphone_Subscribe(2, &subscriber);
+ *  Microphone_VadInit(&vad, 16000);
+ *  for (;;) {
+ *      if (Microphone_ReceiveFrame(subscriber, &frame, portMAX_DELAY) != ESP_OK) {
+ *          continue;
+ *      }
+ *      if (Microphone_VadProcess(&vad, frame) == MIC_VAD_START) {
+ *          printf("Sound at %lld us\n", frame->time_us);
+ *      }
+ *      if (vad.active) {
+ *          // FFT of frame->samples
+ *      }
+ *      Microphone_ReleaseFrame(frame);
+ *  }
+ * @endcode
+ *
+ * @param[in,out] vad The detector.
+ * @param[in] frame The next frame.
+ *
+ * @return Whether activity started or stopped with the frame.
+ */
+/* @[declare_microphone_vadprocess] */
+mic_vad_event_t Microphone_VadProcess(mic_vad_t *vad, const mic_frame_t *frame);
+/* @[declare_microphone_vadprocess] */
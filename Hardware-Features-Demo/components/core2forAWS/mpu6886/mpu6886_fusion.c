@@ -0,0 +1,228 @@
+#include "math.h"
+#include "string.h"
+#include "nvs.h"
+#include "xtensa/hal.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "mpu6886.h"
+#include "mpu6886_fusion.h"
+
+#ifndef CONFIG_MPU6886_FUSION_KP
+#define CONFIG_MPU6886_FUSION_KP 1000
+#endif
+#ifndef CONFIG_MPU6886_FUSION_KI
+#define CONFIG_MPU6886_FUSION_KI 10
+#endif
+
+#define MPU6886_NVS_NAMESPACE       "mpu6886"
+#define MPU6886_NVS_GYRO_BIAS       "gyro_bias"
+
+#define MPU6886_DEG_TO_RAD          0.017453293f
+#define MPU6886_RAD_TO_DEG          57.29578f
+/* Longer gaps between samples restart the filter from the accelerometer */
+#define MPU6886_FUSION_MAX_DT_US    100000
+/* The accelerometer only corrects the orientation while it measures gravity within this much */
+#define MPU6886_FUSION_ACCEL_GATE   0.15f
+/* Spread of the readings of a device lying still */
+#define MPU6886_STILL_SPREAD_DPS    5.0f
+#define MPU6886_STILL_SPREAD_G      0.05f
+#define MPU6886_CALIBRATE_PERIOD_MS 2
+
+/* Sets the orientation from the direction of gravity alone, the yaw is 0 */
+static void MPU6886_FusionLevel(mpu6886_fusion_t *fusion, const float a[3]) {
+    float roll = atan2f(a[1], a[2]);
+    float pitch = atan2f(-a[0], sqrtf(a[1] * a[1] + a[2] * a[2]));
+    float cr = cosf(roll / 2), sr = sinf(roll / 2);
+    float cp = cosf(pitch / 2), sp = sinf(pitch / 2);
+
+    fusion->q[0] = cr * cp;
+    fusion->q[1] = sr * cp;
+    fusion->q[2] = cr * sp;
+    fusion->q[3] = -sr * sp;
+    memset(fusion->integral, 0, sizeof(fusion->integral));
+}
+
+void MPU6886_FusionInit(mpu6886_fusion_t *fusion) {
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->q[0] = 1.0f;
+    fusion->kp = CONFIG_MPU6886_FUSION_KP / 1000.0f;
+    fusion->ki = CONFIG_MPU6886_FUSION_KI / 1000.0f;
+    /* Without a saved bias the integral term estimates it, only more slowly */
+    if (MPU6886_LoadGyroBias(fusion->gyro_bias) != ESP_OK) {
+        memset(fusion->gyro_bias, 0, sizeof(fusion->gyro_bias));
+    }
+}
+
+void MPU6886_FusionSetGyroBias(mpu6886_fusion_t *fusion, const float bias[3]) {
+    memcpy(fusion->gyro_bias, bias, sizeof(fusion->gyro_bias));
+}
+
+void MPU6886_FusionUpdate(mpu6886_fusion_t *fusion, const mpu6886_sample_t *sample) {
+    uint32_t start = xthal_get_ccount();
+    float *q = fusion->q;
+    const float *a = sample->accel;
+
+    memcpy(fusion->accel, a, sizeof(fusion->accel));
+    int64_t dt_us = sample->time_us - fusion->time_us;
+    fusion->time_us = sample->time_us;
+    if (!fusion->started || dt_us <= 0 || dt_us > MPU6886_FUSION_MAX_DT_US) {
+        fusion->started = true;
+        MPU6886_FusionLevel(fusion, a);
+        return;
+    }
+    float dt = dt_us * 1e-6f;
+
+    float gx = (sample->gyro[0] - fusion->gyro_bias[0]) * MPU6886_DEG_TO_RAD;
+    float gy = (sample->gyro[1] - fusion->gyro_bias[1]) * MPU6886_DEG_TO_RAD;
+    float gz = (sample->gyro[2] - fusion->gyro_bias[2]) * MPU6886_DEG_TO_RAD;
+
+    float norm_sq = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+    if (norm_sq > (1.0f - MPU6886_FUSION_ACCEL_GATE) * (1.0f - MPU6886_FUSION_ACCEL_GATE) &&
+        norm_sq < (1.0f + MPU6886_FUSION_ACCEL_GATE) * (1.0f + MPU6886_FUSION_ACCEL_GATE)) {
+        float inv_norm = 1.0f / sqrtf(norm_sq);
+        float ax = a[0] * inv_norm, ay = a[1] * inv_norm, az = a[2] * inv_norm;
+
+        /* Gravity as the current orientation expects it in device coordinates */
+        float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+        float vy = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+        float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+        /* The rotation from the expected to the measured gravity */
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        if (fusion->ki > 0.0f) {
+            fusion->integral[0] += fusion->ki * ex * dt;
+            fusion->integral[1] += fusion->ki * ey * dt;
+            fusion->integral[2] += fusion->ki * ez * dt;
+        }
+        gx += fusion->kp * ex + fusion->integral[0];
+        gy += fusion->kp * ey + fusion->integral[1];
+        gz += fusion->kp * ez + fusion->integral[2];
+    } else {
+        gx += fusion->integral[0];
+        gy += fusion->integral[1];
+        gz += fusion->integral[2];
+    }
+
+    /* q' = q / 2 * (0, g) */
+    float hx = 0.5f * dt * gx, hy = 0.5f * dt * gy, hz = 0.5f * dt * gz;
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    q[0] += -q1 * hx - q2 * hy - q3 * hz;
+    q[1] += q0 * hx + q2 * hz - q3 * hy;
+    q[2] += q0 * hy - q1 * hz + q3 * hx;
+    q[3] += q0 * hz + q1 * hy - q2 * hx;
+
+    float inv_q = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) {
+        q[i] *= inv_q;
+    }
+
+    uint32_t cycles = xthal_get_ccount() - start;
+    fusion->updates++;
+    fusion->cycles += cycles;
+    if (cycles > fusion->cycles_max) {
+        fusion->cycles_max = cycles;
+    }
+}
+
+void MPU6886_FusionGetAttitude(const mpu6886_fusion_t *fusion, mpu6886_attitude_t *attitude) {
+    const float *q = fusion->q;
+    const float *a = fusion->accel;
+
+    memcpy(attitude->q, q, sizeof(attitude->q));
+    attitude->roll = atan2f(2.0f * (q[0] * q[1] + q[2] * q[3]), 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) *
+                     MPU6886_RAD_TO_DEG;
+    float sin_pitch = 2.0f * (q[0] * q[2] - q[3] * q[1]);
+    sin_pitch = sin_pitch > 1.0f ? 1.0f : sin_pitch < -1.0f ? -1.0f : sin_pitch;
+    attitude->pitch = asinf(sin_pitch) * MPU6886_RAD_TO_DEG;
+    attitude->yaw = atan2f(2.0f * (q[0] * q[3] + q[1] * q[2]), 1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) *
+                    MPU6886_RAD_TO_DEG;
+
+    float *g = attitude->gravity;
+    g[0] = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    g[1] = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+    g[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+    float *l = attitude->linear_accel;
+    for (int i = 0; i < 3; i++) {
+        l[i] = a[i] - g[i];
+    }
+
+    /* Rotated into the world, l' = q * l * q^-1 */
+    float *w = attitude->linear_accel_world;
+    w[0] = (1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) * l[0] + 2.0f * (q[1] * q[2] - q[0] * q[3]) * l[1] +
+           2.0f * (q[1] * q[3] + q[0] * q[2]) * l[2];
+    w[1] = 2.0f * (q[1] * q[2] + q[0] * q[3]) * l[0] + (1.0f - 2.0f * (q[1] * q[1] + q[3] * q[3])) * l[1] +
+           2.0f * (q[2] * q[3] - q[0] * q[1]) * l[2];
+    w[2] = 2.0f * (q[1] * q[3] - q[0] * q[2]) * l[0] + 2.0f * (q[2] * q[3] + q[0] * q[1]) * l[1] +
+           (1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) * l[2];
+}
+
+esp_err_t MPU6886_CalibrateGyroBias(uint32_t duration_ms, float bias[3]) {
+    if (duration_ms < 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float sum[3] = { 0 };
+    float min[6], max[6];
+    TickType_t period = pdMS_TO_TICKS(MPU6886_CALIBRATE_PERIOD_MS);
+    if (period == 0) {
+        period = 1;
+    }
+    uint32_t count = duration_ms / (period * portTICK_PERIOD_MS);
+    TickType_t wake = xTaskGetTickCount();
+    for (uint32_t n = 0; n < count; n++) {
+        /* The gyroscope, then the accelerometer, which shows a turn at a constant rate */
+        float r[6];
+        MPU6886_GetGyroData(&r[0], &r[1], &r[2]);
+        MPU6886_GetAccelData(&r[3], &r[4], &r[5]);
+        for (int i = 0; i < 6; i++) {
+            min[i] = n == 0 || r[i] < min[i] ? r[i] : min[i];
+            max[i] = n == 0 || r[i] > max[i] ? r[i] : max[i];
+        }
+        for (int i = 0; i < 3; i++) {
+            sum[i] += r[i];
+        }
+        vTaskDelayUntil(&wake, period);
+    }
+
+    for (int i = 0; i < 6; i++) {
+        if (max[i] - min[i] > (i < 3 ? MPU6886_STILL_SPREAD_DPS : MPU6886_STILL_SPREAD_G)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        bias[i] = sum[i] / count;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(MPU6886_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, MPU6886_NVS_GYRO_BIAS, bias, 3 * sizeof(float));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t MPU6886_LoadGyroBias(float bias[3]) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(MPU6886_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t length = 3 * sizeof(float);
+    err = nvs_get_blob(handle, MPU6886_NVS_GYRO_BIAS, bias, &length);
+    if (err == ESP_OK && length != 3 * sizeof(float)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    nvs_close(handle);
+    return err;
+}
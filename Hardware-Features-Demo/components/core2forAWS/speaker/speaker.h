@@ -5,6 +5,10 @@
 
 #pragma once
 #include "stdint.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
 
 /**
  * @brief Initializes the speaker over I2S. The I2S bus is initialized
@@ -13,10 +17,9 @@
  * ESP-IDF I2S driver directly.
  * 
  * @note You must enable the speaker after initializing it with @ref Core2ForAWS_Speaker_Enable().
- * The speaker cannot be initialized at the same time
- * as the microphone since they both share a common pin (GPIO0).
- * Attempting to enable or use both at the same time will 
- * cause the device to hard fault.
+ * The speaker uses I2S1 and shares a common pin (GPIO0) with the
+ * microphone, the I2S manager hands the pin to the speaker for its
+ * writes. See i2s_manager.h.
  * 
  * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros). 0 or `ESP_OK` if successful.
  * 
@@ -28,10 +31,9 @@ esp_err_t Speaker_Init();
 /**
  * @brief Plays buffer through the speaker.
  * 
- * @note The speaker cannot be used at the same time
- * as the microphone since they both share a common pin (GPIO0).
- * Attempting to enable or use both at the same time will 
- * cause the device to hard fault.
+ * @note While the microphone is open, it stops receiving samples
+ * during the write and until the samples in the DMA buffers have
+ * played, since they both share a common pin (GPIO0).
  * 
  * **Example:**
  * 
@@ -49,9 +51,12 @@ esp_err_t Speaker_Init();
  * 
  * @param[out] buff The sound buffer to play.
  * @param[in] len Length of the buffer.
- * @param[in] timeout UNUSED.
+ * @param[in] timeout The most ticks to wait for the speaker and for room in the DMA buffers.
  *
- * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros). 0 or `ESP_OK` if successful.
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The speaker is not initialized
+ *  - ESP_ERR_TIMEOUT       : Only part of the buffer was written before the timeout
  */
 /* @[declare_speaker_writebuff] */
 esp_err_t Speaker_WriteBuff(uint8_t* buff, uint32_t len, uint32_t timeout);
@@ -64,4 +69,170 @@ esp_err_t Speaker_WriteBuff(uint8_t* buff, uint32_t len, uint32_t timeout);
  */
 /* @[declare_speaker_deinit] */
 esp_err_t Speaker_Deinit();
-/* @[declare_speaker_deinit] */
\ No newline at end of file
+/* @[declare_speaker_deinit] */
+
+/**
+ * @brief Settings of the playback stream, fields left at 0 take the
+ * Kconfig values.
+ */
+/* @[declare_speaker_stream_config_t] */
+typedef struct {
+    uint32_t sample_rate;       /**< @brief Samples per second. */
+    uint16_t dma_buf_count;     /**< @brief I2S DMA buffers, 2 to 128. */
+    uint16_t dma_buf_len;       /**< @brief Samples per DMA buffer, 8 to 1024. */
+    uint8_t queue_len;          /**< @brief Blocks that can wait to be played. */
+} speaker_stream_config_t;
+/* @[declare_speaker_stream_config_t] */
+
+/**
+ * @brief A block of samples to play, mono 16 bit.
+ *
+ * The samples are not copied, they must stay untouched until the block is
+ * handed back to the completion callback.
+ */
+/* @[declare_speaker_block_t] */
+typedef struct {
+    const int16_t *samples;     /**< @brief The samples. */
+    size_t count;               /**< @brief Number of samples. */
+    bool last;                  /**< @brief Ends a sound, the stream running dry after it is not an underrun. */
+    void *ctx;                  /**< @brief For the completion callback. */
+} speaker_block_t;
+/* @[declare_speaker_block_t] */
+
+/**
+ * @brief Called from the stream task when a block is done with.
+ *
+ * When played is true, the samples are in the DMA buffers and the next
+ * block can be submitted to follow them without a gap. False means the block
+ * was discarded by @ref Speaker_Flush(). Must not block.
+ */
+/* @[declare_speaker_block_cb_t] */
+typedef void (*speaker_block_cb_t)(const speaker_block_t *block, bool played);
+/* @[declare_speaker_block_cb_t] */
+
+/**
+ * @brief Statistics of the playback stream since it was started.
+ */
+/* @[declare_speaker_stream_stats_t] */
+typedef struct {
+    uint32_t blocks;                /**< @brief Blocks played. */
+    uint64_t samples;               /**< @brief Samples played. */
+    uint32_t flushed;               /**< @brief Blocks discarded by @ref Speaker_Flush(). */
+    uint32_t queue_full;            /**< @brief Submits that found the queue full. */
+    uint32_t underruns;             /**< @brief Times the DMA buffers ran dry in the middle of a sound. */
+    int64_t last_underrun_us;       /**< @brief When the DMA buffers last ran dry in the middle of a sound, 0 if never. */
+    uint32_t start_latency_us_last; /**< @brief Time from the submit of the first block of the last sound to its first samples in the DMA buffers. */
+    uint32_t start_latency_us_max;  /**< @brief Longest start latency. */
+    uint8_t queued;                 /**< @brief Blocks waiting to be played now. */
+} speaker_stream_stats_t;
+/* @[declare_speaker_stream_stats_t] */
+
+/**
+ * @brief Starts the playback stream.
+ *
+ * Installs the speaker with the DMA buffers of the settings and starts a task
+ * that plays the submitted blocks one after the other. The task takes the pin
+ * shared with the microphone for each sound and gives it back once the sound
+ * has played, see i2s_manager.h. Do not use @ref Speaker_Init() with it.
+ *
+ * A sound starts playing within one DMA buffer of its first samples reaching
+ * the DMA: short buffers give short start latencies, more of them give the
+ * refills more time.
+ *
+ * **Example:**
+ *
+ * Play an alert sound without waiting for it.
+ * @code{c}
+ *  static const int16_t beep[4410] = { ... };
+ *  static const speaker_block_t beep_block = { .samples = beep, .count = 4410, .last = true };
+ *
+ *  Speaker_StartStream(NULL, NULL);
+ *  Core2ForAWS_Speaker_Enable(1);
+ *  ...
+ *  Speaker_Submit(&beep_block, 0);
+ * @endcode
+ *
+ * @param[in] config The settings, NULL for the Kconfig ones.
+ * @param[in] done Called when a block is done with, may be NULL.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : The settings are out of range
+ *  - ESP_ERR_INVALID_STATE : The stream is already running or the speaker is initialized
+ *  - ESP_ERR_NO_MEM        : Out of memory
+ */
+/* @[declare_speaker_startstream] */
+esp_err_t Speaker_StartStream(const speaker_stream_config_t *config, speaker_block_cb_t done);
+/* @[declare_speaker_startstream] */
+
+/**
+ * @brief Stops the playback stream and uninstalls the speaker.
+ *
+ * The blocks not played yet are discarded.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The stream is not running
+ */
+/* @[declare_speaker_stopstream] */
+esp_err_t Speaker_StopStream(void);
+/* @[declare_speaker_stopstream] */
+
+/**
+ * @brief Queues a block to play after the ones already submitted.
+ *
+ * The block is copied, the samples are not.
+ *
+ * @param[in] block The block.
+ * @param[in] wait The most ticks to wait for room in the queue.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : No samples
+ *  - ESP_ERR_INVALID_STATE : The stream is not running
+ *  - ESP_ERR_TIMEOUT       : The queue stayed full
+ */
+/* @[declare_speaker_submit] */
+esp_err_t Speaker_Submit(const speaker_block_t *block, TickType_t wait);
+/* @[declare_speaker_submit] */
+
+/**
+ * @brief Waits for the submitted blocks to play out.
+ *
+ * The stream running dry at the end is not an underrun. One task at a time.
+ *
+ * @param[in] wait The most ticks to wait.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The stream is not running
+ *  - ESP_ERR_TIMEOUT       : Samples were still playing
+ */
+/* @[declare_speaker_drain] */
+esp_err_t Speaker_Drain(TickType_t wait);
+/* @[declare_speaker_drain] */
+
+/**
+ * @brief Silences the stream at once.
+ *
+ * Waits for a DMA buffer being written to be accepted, then clears the DMA
+ * buffers. No sample submitted before the call is written afterwards: the
+ * block playing stops and the queued ones are handed to the completion
+ * callback as not played.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_STATE : The stream is not running
+ */
+/* @[declare_speaker_flush] */
+esp_err_t Speaker_Flush(void);
+/* @[declare_speaker_flush] */
+
+/**
+ * @brief Retrieves the statistics of the playback stream.
+ *
+ * @param[out] stats The statistics.
+ */
+/* @[declare_speaker_getstreamstats] */
+void Speaker_GetStreamStats(speaker_stream_stats_t *stats);
+/* @[declare_speaker_getstreamstats] */
@@ -0,0 +1,561 @@
+/*
+ * FreeRTOS on POSIX threads for the host builds.
+ *
+ * Every task is a thread. Queues, semaphores and notifications are a mutex and
+ * condition variables each, with timeouts on the monotonic clock. The thread
+ * that calls an ISR handler (a device model raising a pin, or the SPI thread
+ * finishing a transaction) stands in for the interrupt; the FromISR calls are
+ * the same as the task calls without waiting.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Clock */
+
+static struct timespec start_time;
+
+__attribute__((constructor)) static void sim_clock_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) (now.tv_sec - start_time.tv_sec) * 1000000 + (now.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) (esp_timer_get_time() / (1000 * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+/* Absolute monotonic time ticks from now, for pthread_cond_timedwait() */
+static void sim_deadline(TickType_t ticks, struct timespec *deadline) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    uint64_t ns = (uint64_t) ticks * portTICK_PERIOD_MS * 1000000 + deadline->tv_nsec;
+    deadline->tv_sec += ns / 1000000000;
+    deadline->tv_nsec = ns % 1000000000;
+}
+
+static void sim_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Waits on the condition until the deadline, forever with portMAX_DELAY.
+ * Returns false once the deadline passed; the caller checks its condition again either way. */
+static bool sim_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t wait, const struct timespec *deadline) {
+    if (wait == 0) {
+        return false;
+    }
+    if (wait == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Critical sections */
+
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void sim_enter_critical(void) {
+    pthread_mutex_lock(&critical_lock);
+}
+
+void sim_exit_critical(void) {
+    pthread_mutex_unlock(&critical_lock);
+}
+
+void sim_yield(void) {
+    sched_yield();
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Tasks */
+
+struct sim_task {
+    pthread_t thread;
+    char name[16];
+    TaskFunction_t function;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+static __thread struct sim_task *current_task;
+
+static struct sim_task *sim_task_new(const char *name) {
+    struct sim_task *task = calloc(1, sizeof(*task));
+    assert(task != NULL);
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    pthread_mutex_init(&task->lock, NULL);
+    sim_cond_init(&task->notified);
+    return task;
+}
+
+static void *sim_task_entry(void *arg) {
+    struct sim_task *task = arg;
+    current_task = task;
+    pthread_setname_np(pthread_self(), task->name);
+    task->function(task->arg);
+    /* A FreeRTOS task must not return */
+    assert(!"task returned");
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void) stack_depth;
+    (void) priority;
+    (void) core;
+
+    struct sim_task *task = sim_task_new(name);
+    task->function = function;
+    task->arg = arg;
+    if (handle) {
+        *handle = task;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&task->thread, &attr, sim_task_entry, task);
+    pthread_attr_destroy(&attr);
+    return err == 0 ? pdPASS : pdFAIL;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    /* Threads not made by xTaskCreate, like main(), get a handle on first use */
+    if (current_task == NULL) {
+        current_task = sim_task_new("main");
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+const char *pcTaskGetTaskName(TaskHandle_t task) {
+    return (task ? task : xTaskGetCurrentTaskHandle())->name;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == xTaskGetCurrentTaskHandle()) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {
+        .tv_sec = (uint64_t) ticks * portTICK_PERIOD_MS / 1000,
+        .tv_nsec = ((uint64_t) ticks * portTICK_PERIOD_MS % 1000) * 1000000,
+    };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    TickType_t wake = *previous_wake + increment;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t) (wake - now) > 0) {
+        vTaskDelay(wake - now);
+    }
+    *previous_wake = wake;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t ret = pdPASS;
+
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) {
+                ret = pdFAIL;
+            } else {
+                task->notify_value = value;
+            }
+            break;
+        case eNoAction:
+            break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higher_priority_task_woken) {
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+    xTaskNotifyFromISR(task, 0, eIncrement, higher_priority_task_woken);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait) {
+    struct sim_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    sim_deadline(wait == portMAX_DELAY ? 0 : wait, &deadline);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_value == 0 && sim_cond_wait(&task->notified, &task->lock, wait, &deadline)) {
+    }
+    uint32_t value = task->notify_value;
+    if (value) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait) {
+    struct sim_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    sim_deadline(wait == portMAX_DELAY ? 0 : wait, &deadline);
+
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+    }
+    while (!task->notify_pending && sim_cond_wait(&task->notified, &task->lock, wait, &deadline)) {
+    }
+    BaseType_t ret = task->notify_pending ? pdTRUE : pdFALSE;
+    if (value) {
+        *value = task->notify_value;
+    }
+    if (ret) {
+        task->notify_value &= ~clear_on_exit;
+        task->notify_pending = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Queues and semaphores */
+
+typedef enum {
+    SIM_QUEUE,
+    SIM_SEMAPHORE,
+    SIM_MUTEX,
+    SIM_RECURSIVE_MUTEX,
+} sim_queue_type_t;
+
+struct sim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    sim_queue_type_t type;
+    bool is_static;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+    /* Mutexes only */
+    TaskHandle_t holder;
+    UBaseType_t recursion;
+};
+
+_Static_assert(sizeof(struct sim_queue) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t is too small");
+
+static QueueHandle_t sim_queue_init(struct sim_queue *queue, sim_queue_type_t type, UBaseType_t length,
+                                    UBaseType_t item_size) {
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    sim_cond_init(&queue->not_empty);
+    sim_cond_init(&queue->not_full);
+    queue->type = type;
+    queue->length = length;
+    queue->item_size = item_size;
+    if (item_size) {
+        queue->items = malloc((size_t) length * item_size);
+        assert(queue->items != NULL);
+    }
+    return queue;
+}
+
+static QueueHandle_t sim_queue_new(sim_queue_type_t type, UBaseType_t length, UBaseType_t item_size) {
+    struct sim_queue *queue = malloc(sizeof(*queue));
+    assert(queue != NULL);
+    return sim_queue_init(queue, type, length, item_size);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return sim_queue_new(SIM_QUEUE, length, item_size);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    if (!queue->is_static) {
+        free(queue);
+    }
+}
+
+/* Adds an item, or a count for semaphores, with the lock taken and space available */
+static void sim_queue_put(QueueHandle_t queue, const void *item, bool front) {
+    if (queue->item_size) {
+        UBaseType_t slot;
+        if (front) {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            slot = queue->head;
+        } else {
+            slot = (queue->head + queue->count) % queue->length;
+        }
+        memcpy(queue->items + (size_t) slot * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_broadcast(&queue->not_empty);
+}
+
+/* Takes or peeks the first item, or a count for semaphores, with the lock taken and an item there */
+static void sim_queue_get(QueueHandle_t queue, void *item, bool peek) {
+    if (queue->item_size && item) {
+        memcpy(item, queue->items + (size_t) queue->head * queue->item_size, queue->item_size);
+    }
+    if (!peek) {
+        queue->head = queue->item_size ? (queue->head + 1) % queue->length : 0;
+        queue->count--;
+        pthread_cond_broadcast(&queue->not_full);
+    }
+}
+
+static BaseType_t sim_queue_send(QueueHandle_t queue, const void *item, TickType_t wait, bool front) {
+    struct timespec deadline;
+    sim_deadline(wait == portMAX_DELAY ? 0 : wait, &deadline);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && sim_cond_wait(&queue->not_full, &queue->lock, wait, &deadline)) {
+    }
+    BaseType_t ret = errQUEUE_FULL;
+    if (queue->count < queue->length) {
+        sim_queue_put(queue, item, front);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+static BaseType_t sim_queue_receive(QueueHandle_t queue, void *item, TickType_t wait, bool peek) {
+    struct timespec deadline;
+    sim_deadline(wait == portMAX_DELAY ? 0 : wait, &deadline);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && sim_cond_wait(&queue->not_empty, &queue->lock, wait, &deadline)) {
+    }
+    BaseType_t ret = errQUEUE_EMPTY;
+    if (queue->count) {
+        sim_queue_get(queue, item, peek);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait) {
+    return sim_queue_send(queue, item, wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t wait) {
+    return sim_queue_send(queue, item, wait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->length) {
+        sim_queue_get(queue, NULL, false);
+    }
+    sim_queue_put(queue, item, false);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+    return sim_queue_receive(queue, item, wait, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait) {
+    return sim_queue_receive(queue, item, wait, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;
+    queue->head = 0;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return spaces;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return sim_queue_new(SIM_SEMAPHORE, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    struct sim_queue *queue = (struct sim_queue *) buffer;
+    sim_queue_init(queue, SIM_SEMAPHORE, 1, 0);
+    queue->is_static = true;
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    SemaphoreHandle_t semaphore = sim_queue_new(SIM_SEMAPHORE, max_count, 0);
+    semaphore->count = initial_count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t mutex = sim_queue_new(SIM_MUTEX, 1, 0);
+    mutex->count = 1;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+    struct sim_queue *mutex = (struct sim_queue *) buffer;
+    sim_queue_init(mutex, SIM_MUTEX, 1, 0);
+    mutex->is_static = true;
+    mutex->count = 1;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    SemaphoreHandle_t mutex = sim_queue_new(SIM_RECURSIVE_MUTEX, 1, 0);
+    mutex->count = 1;
+    return mutex;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    vQueueDelete(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+    BaseType_t ret = sim_queue_receive(semaphore, NULL, wait, false);
+    if (ret == pdPASS && semaphore->type != SIM_SEMAPHORE) {
+        pthread_mutex_lock(&semaphore->lock);
+        semaphore->holder = xTaskGetCurrentTaskHandle();
+        pthread_mutex_unlock(&semaphore->lock);
+    }
+    return ret;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    /* Mutexes given from an ISR, like spi_mutex from the SPI post transaction callback, have no holder to check */
+    pthread_mutex_lock(&semaphore->lock);
+    BaseType_t ret = pdFAIL;
+    if (semaphore->count < semaphore->length) {
+        semaphore->holder = NULL;
+        sim_queue_put(semaphore, NULL, false);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t wait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    pthread_mutex_lock(&mutex->lock);
+    if (mutex->holder == self) {
+        mutex->recursion++;
+        pthread_mutex_unlock(&mutex->lock);
+        return pdPASS;
+    }
+    pthread_mutex_unlock(&mutex->lock);
+
+    BaseType_t ret = xSemaphoreTake(mutex, wait);
+    if (ret == pdPASS) {
+        pthread_mutex_lock(&mutex->lock);
+        mutex->recursion = 1;
+        pthread_mutex_unlock(&mutex->lock);
+    }
+    return ret;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    pthread_mutex_lock(&mutex->lock);
+    if (mutex->holder != xTaskGetCurrentTaskHandle()) {
+        pthread_mutex_unlock(&mutex->lock);
+        return pdFAIL;
+    }
+    if (--mutex->recursion) {
+        pthread_mutex_unlock(&mutex->lock);
+        return pdPASS;
+    }
+    pthread_mutex_unlock(&mutex->lock);
+    return xSemaphoreGive(mutex);
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t mutex) {
+    pthread_mutex_lock(&mutex->lock);
+    TaskHandle_t holder = mutex->holder;
+    pthread_mutex_unlock(&mutex->lock);
+    return holder;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore) {
+    return uxQueueMessagesWaiting(semaphore);
+}
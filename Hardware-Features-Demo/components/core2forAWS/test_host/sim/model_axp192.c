@@ -0,0 +1,61 @@
+/*
+ * AXP192 power management model.
+ *
+ * Registers keep what was written, from the reset values of the Core2. ADC
+ * results are set by the tests, and writes to the GPIO 3/4 level register
+ * report GPIO 4, the LCD reset line, to the board.
+ */
+
+#include "sim.h"
+#include "sim_internal.h"
+
+#define AXP192_GPIO34_STATE_REG     0x96
+#define AXP192_GPIO4_BIT            (1 << 1)
+
+sim_i2c_device_t sim_axp192 = {
+    .name = "AXP192",
+    .port = I2C_NUM_1,
+    .addr = 0x34,
+};
+
+static void (*gpio4_callback)(int level);
+
+static void sim_axp192_write(sim_i2c_device_t *dev, uint8_t reg, uint8_t value) {
+    (void) dev;
+    if (reg == AXP192_GPIO34_STATE_REG && gpio4_callback) {
+        gpio4_callback(value & AXP192_GPIO4_BIT ? 1 : 0);
+    }
+}
+
+void sim_axp192_on_gpio4(void (*callback)(int level)) {
+    sim_i2c_lock();
+    gpio4_callback = callback;
+    sim_i2c_unlock();
+}
+
+void sim_axp192_set_adc(uint8_t reg, uint16_t value, uint8_t bits) {
+    uint8_t low_bits = bits - 8;
+    sim_i2c_lock();
+    sim_axp192.regs[reg] = value >> low_bits;
+    sim_axp192.regs[(uint8_t) (reg + 1)] = value & ((1 << low_bits) - 1);
+    sim_i2c_unlock();
+}
+
+void sim_axp192_init(void) {
+    uint8_t *regs = sim_axp192.regs;
+    regs[0x00] = 0x05;          /* VBUS present and usable */
+    regs[0x01] = 0x20;          /* Battery connected */
+    regs[0x12] = 0x4d;          /* EXTEN, LDO2, LDO3, DC-DC1 and DC-DC3 on */
+    regs[0x26] = 0x6a;          /* DC-DC1 3.35 V */
+    regs[0x27] = 0x54;          /* DC-DC3 2.8 V */
+    regs[0x28] = 0xcc;          /* LDO2 and LDO3 3.0 V */
+    regs[0x33] = 0xc0;
+    regs[0x82] = 0x83;
+    regs[AXP192_GPIO34_STATE_REG] = AXP192_GPIO4_BIT;
+    sim_axp192.on_write = sim_axp192_write;
+    sim_i2c_attach(&sim_axp192);
+
+    /* 4.1 V battery at 1.1 mV and 5.0 V VBUS at 1.7 mV per step */
+    sim_axp192_set_adc(0x78, 3727, 12);
+    sim_axp192_set_adc(0x5a, 2941, 12);
+}
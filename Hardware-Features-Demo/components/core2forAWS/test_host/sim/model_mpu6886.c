@@ -0,0 +1,351 @@
+/*
+ * MPU6886 IMU model.
+ *
+ * The sensor registers are synthesized from sim_imu_motion_t when a burst read
+ * starts at them: the device turns at a constant rate from level, so its
+ * orientation is a rotation about a fixed axis and the accelerometer sees
+ * gravity rotated into the device frame.
+ *
+ * With the FIFO enabled, samples are pushed at the rate set by SMPLRT_DIV,
+ * synthesized for the time they were due, whenever the FIFO registers are
+ * accessed. FIFO_R_W reads pop it without moving the register pointer.
+ *
+ * With wake-on-motion enabled, the accelerometer is sampled at the rate set by
+ * SMPLRT_DIV whenever INT_STATUS is read, and a change from the previous sample
+ * above the threshold of an axis latches its WOM bit. INT_STATUS clears when
+ * read. The INT line is not modelled, it is not routed on the Core2 for AWS.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define MPU6886_ACCEL_XOUT_H    0x3b
+#define MPU6886_TEMP_OUT_H      0x41
+#define MPU6886_GYRO_XOUT_H     0x43
+#define MPU6886_GYRO_CONFIG     0x1b
+#define MPU6886_ACCEL_CONFIG    0x1c
+#define MPU6886_PWR_MGMT_1      0x6b
+#define MPU6886_WHOAMI          0x75
+#define MPU6886_SMPLRT_DIV      0x19
+#define MPU6886_CONFIG          0x1a
+#define MPU6886_FIFO_EN         0x23
+#define MPU6886_ACCEL_WOM_X_THR 0x20
+#define MPU6886_INT_ENABLE      0x38
+#define MPU6886_ACCEL_INTEL_CTRL 0x69
+#define MPU6886_INT_STATUS      0x3a
+#define MPU6886_USER_CTRL       0x6a
+#define MPU6886_FIFO_COUNTH     0x72
+#define MPU6886_FIFO_COUNTL     0x73
+#define MPU6886_FIFO_R_W        0x74
+
+#define SIM_MPU6886_FIFO_SIZE   1024
+
+#define SIM_MPU6886_TEMP_C      30.0f
+
+sim_i2c_device_t sim_mpu6886 = {
+    .name = "MPU6886",
+    .port = I2C_NUM_1,
+    .addr = 0x68,
+};
+
+static sim_imu_motion_t motion;
+static int64_t motion_start_us;
+static uint32_t noise_seed = 1;
+
+/* FIFO, filled up to the time of the last access with the configuration cached at that time */
+static uint8_t fifo[SIM_MPU6886_FIFO_SIZE];
+static uint32_t fifo_head;
+static uint32_t fifo_count;
+static bool fifo_running;
+static uint8_t fifo_en;
+static uint8_t fifo_div;
+static bool fifo_stop_when_full;
+static int64_t fifo_next_us;
+
+/* Interrupt status bits latched until INT_STATUS is read */
+static uint8_t int_status;
+
+/* Wake-on-motion, evaluated up to the time of the last access like the FIFO */
+static bool wom_running;
+static uint8_t wom_div;
+static int64_t wom_next_us;
+static float wom_last_mg[3];
+
+static void sim_mpu6886_reset(void) {
+    fifo_head = 0;
+    fifo_count = 0;
+    fifo_running = false;
+    int_status = 0;
+    wom_running = false;
+    memset(sim_mpu6886.regs, 0, sizeof(sim_mpu6886.regs));
+    sim_mpu6886.regs[MPU6886_WHOAMI] = 0x19;
+    sim_mpu6886.regs[MPU6886_PWR_MGMT_1] = 0x40;
+}
+
+/* Uniform in [-1, 1] */
+static float sim_mpu6886_noise(void) {
+    noise_seed = noise_seed * 1103515245 + 12345;
+    return (float) (noise_seed >> 8) / (float) (1 << 23) - 1.0f;
+}
+
+static int16_t sim_mpu6886_raw(float value) {
+    float raw = roundf(value);
+    return raw > INT16_MAX ? INT16_MAX : raw < INT16_MIN ? INT16_MIN : (int16_t) raw;
+}
+
+static void sim_mpu6886_put(uint8_t reg, float value) {
+    int16_t raw = sim_mpu6886_raw(value);
+    sim_mpu6886.regs[reg] = (uint16_t) raw >> 8;
+    sim_mpu6886.regs[reg + 1] = raw & 0xff;
+}
+
+/* Rotation axis and angle at a time, with the lock taken */
+static void sim_mpu6886_rotation(int64_t time_us, float axis[3], float *angle) {
+    float rate = sqrtf(motion.rate_dps[0] * motion.rate_dps[0] + motion.rate_dps[1] * motion.rate_dps[1] +
+                       motion.rate_dps[2] * motion.rate_dps[2]);
+    if (rate == 0.0f) {
+        axis[0] = 0.0f;
+        axis[1] = 0.0f;
+        axis[2] = 1.0f;
+        *angle = 0.0f;
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        axis[i] = motion.rate_dps[i] / rate;
+    }
+    *angle = rate * (float) M_PI / 180.0f * (float) (time_us - motion_start_us) / 1e6f;
+}
+
+/* The accelerometer, temperature and gyroscope registers at a time, in register order */
+static void sim_mpu6886_measure(int64_t time_us, float out[7]) {
+    float axis[3], angle;
+    sim_mpu6886_rotation(time_us, axis, &angle);
+
+    /* Gravity and the shake along world Z, turned into the device frame by the inverse rotation (Rodrigues) */
+    float t = (float) (time_us - motion_start_us) / 1e6f;
+    float g = 1.0f + motion.shake_g * sinf(2.0f * (float) M_PI * motion.shake_hz * t);
+    float c = cosf(angle), s = sinf(angle);
+    float accel[3];
+    /* v = (0, 0, g): v cos - (k x v) sin + k (k . v) (1 - cos) */
+    accel[0] = -(axis[1] * g) * s + axis[0] * axis[2] * g * (1.0f - c);
+    accel[1] = (axis[0] * g) * s + axis[1] * axis[2] * g * (1.0f - c);
+    accel[2] = g * c + axis[2] * axis[2] * g * (1.0f - c);
+
+    uint8_t accel_fs = (sim_mpu6886.regs[MPU6886_ACCEL_CONFIG] >> 3) & 0x03;
+    uint8_t gyro_fs = (sim_mpu6886.regs[MPU6886_GYRO_CONFIG] >> 3) & 0x03;
+    float accel_lsb = 16384.0f / (1 << accel_fs);
+    float gyro_lsb = 131.0f / (1 << gyro_fs);
+
+    for (int i = 0; i < 3; i++) {
+        float a = accel[i] + motion.noise * sim_mpu6886_noise();
+        float w = motion.rate_dps[i] + motion.gyro_bias_dps[i] + motion.noise * sim_mpu6886_noise();
+        out[i] = a * accel_lsb;
+        out[4 + i] = w * gyro_lsb;
+    }
+    out[3] = (SIM_MPU6886_TEMP_C - 25.0f) * 326.8f;
+}
+
+static void sim_mpu6886_sample(void) {
+    float values[7];
+    sim_mpu6886_measure(esp_timer_get_time(), values);
+    for (int i = 0; i < 7; i++) {
+        sim_mpu6886_put(MPU6886_ACCEL_XOUT_H + 2 * i, values[i]);
+    }
+}
+
+/* Returns false if the sample was dropped because the FIFO was full */
+static bool sim_mpu6886_fifo_push(int64_t time_us) {
+    float values[7];
+    uint8_t packet[14];
+    size_t length = 0;
+
+    sim_mpu6886_measure(time_us, values);
+    for (int i = 0; i < 7; i++) {
+        /* Temperature is always included */
+        bool wanted = i < 3 ? (fifo_en & 0x08) : i == 3 ? true : (fifo_en & 0x10);
+        if (wanted) {
+            int16_t raw = sim_mpu6886_raw(values[i]);
+            packet[length++] = (uint16_t) raw >> 8;
+            packet[length++] = raw & 0xff;
+        }
+    }
+
+    if (fifo_count + length > SIM_MPU6886_FIFO_SIZE) {
+        int_status |= 0x10;
+        if (fifo_stop_when_full) {
+            return false;
+        }
+        /* The oldest bytes are overwritten */
+        uint32_t drop = fifo_count + length - SIM_MPU6886_FIFO_SIZE;
+        fifo_head = (fifo_head + drop) % SIM_MPU6886_FIFO_SIZE;
+        fifo_count -= drop;
+    }
+    for (size_t i = 0; i < length; i++) {
+        fifo[(fifo_head + fifo_count + i) % SIM_MPU6886_FIFO_SIZE] = packet[i];
+    }
+    fifo_count += length;
+    return true;
+}
+
+/* Pushes the samples due until now with the cached configuration */
+static void sim_mpu6886_fifo_fill(void) {
+    if (!fifo_running) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t period_us = 1000 * (1 + fifo_div);
+    /* More than a FIFO full of samples would only be overwritten, skip to the last ones */
+    int64_t backlog_us = period_us * (SIM_MPU6886_FIFO_SIZE / 6 + 1);
+    if (!fifo_stop_when_full && now - fifo_next_us > backlog_us) {
+        fifo_next_us += (now - fifo_next_us - backlog_us) / period_us * period_us;
+    }
+    while (fifo_next_us <= now) {
+        if (!sim_mpu6886_fifo_push(fifo_next_us)) {
+            /* Full, the samples until now are lost */
+            fifo_next_us += ((now - fifo_next_us) / period_us + 1) * period_us;
+            break;
+        }
+        fifo_next_us += period_us;
+    }
+}
+
+/* Takes the FIFO configuration from the registers, after filling up to now with the old one */
+static void sim_mpu6886_fifo_config(void) {
+    sim_mpu6886_fifo_fill();
+
+    uint8_t user_ctrl = sim_mpu6886.regs[MPU6886_USER_CTRL];
+    if (user_ctrl & 0x04) {
+        fifo_head = 0;
+        fifo_count = 0;
+        sim_mpu6886.regs[MPU6886_USER_CTRL] = user_ctrl & ~0x04;
+    }
+    bool running = (user_ctrl & 0x40) && (sim_mpu6886.regs[MPU6886_FIFO_EN] & 0x18);
+    if (running && !fifo_running) {
+        fifo_next_us = esp_timer_get_time() + 1000 * (1 + sim_mpu6886.regs[MPU6886_SMPLRT_DIV]);
+    }
+    fifo_running = running;
+    fifo_en = sim_mpu6886.regs[MPU6886_FIFO_EN];
+    fifo_div = sim_mpu6886.regs[MPU6886_SMPLRT_DIV];
+    fifo_stop_when_full = sim_mpu6886.regs[MPU6886_CONFIG] & 0x40;
+}
+
+/* The acceleration in mG the comparator sees at a time */
+static void sim_mpu6886_wom_sample(int64_t time_us, float mg[3]) {
+    float values[7];
+    sim_mpu6886_measure(time_us, values);
+    uint8_t accel_fs = (sim_mpu6886.regs[MPU6886_ACCEL_CONFIG] >> 3) & 0x03;
+    for (int i = 0; i < 3; i++) {
+        mg[i] = values[i] * 1000.0f / (16384.0f / (1 << accel_fs));
+    }
+}
+
+/* Compares the samples due until now with the previous ones */
+static void sim_mpu6886_wom_check(void) {
+    if (!wom_running) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t period_us = 1000 * (1 + wom_div);
+    uint8_t enabled = sim_mpu6886.regs[MPU6886_INT_ENABLE] & 0xe0;
+    while (wom_next_us <= now) {
+        float mg[3];
+        sim_mpu6886_wom_sample(wom_next_us, mg);
+        for (int i = 0; i < 3; i++) {
+            /* 4 mG per LSB of the thresholds */
+            float threshold = 4.0f * sim_mpu6886.regs[MPU6886_ACCEL_WOM_X_THR + i];
+            if (fabsf(mg[i] - wom_last_mg[i]) > threshold) {
+                int_status |= (0x80 >> i) & enabled;
+            }
+            wom_last_mg[i] = mg[i];
+        }
+        wom_next_us += period_us;
+    }
+}
+
+/* Takes the wake-on-motion configuration from the registers, after checking up to now with the old one */
+static void sim_mpu6886_wom_config(void) {
+    sim_mpu6886_wom_check();
+
+    /* ACCEL_INTEL_EN and ACCEL_INTEL_MODE, in the low power cycle */
+    bool running = (sim_mpu6886.regs[MPU6886_ACCEL_INTEL_CTRL] & 0xc0) == 0xc0 &&
+                   (sim_mpu6886.regs[MPU6886_PWR_MGMT_1] & 0x20);
+    if (running && !wom_running) {
+        int64_t now = esp_timer_get_time();
+        /* The first sample has nothing to be compared with */
+        sim_mpu6886_wom_sample(now, wom_last_mg);
+        wom_next_us = now + 1000 * (1 + sim_mpu6886.regs[MPU6886_SMPLRT_DIV]);
+    }
+    wom_running = running;
+    wom_div = sim_mpu6886.regs[MPU6886_SMPLRT_DIV];
+}
+
+static void sim_mpu6886_read(sim_i2c_device_t *dev, uint8_t reg) {
+    /* Bursts start at one of the three blocks, refreshing all of them keeps a burst consistent */
+    if (reg == MPU6886_ACCEL_XOUT_H || reg == MPU6886_TEMP_OUT_H || reg == MPU6886_GYRO_XOUT_H) {
+        sim_mpu6886_sample();
+    } else if (reg == MPU6886_FIFO_COUNTH) {
+        /* Latches the count for the low byte read next */
+        sim_mpu6886_fifo_fill();
+        dev->regs[MPU6886_FIFO_COUNTH] = fifo_count >> 8;
+        dev->regs[MPU6886_FIFO_COUNTL] = fifo_count & 0xff;
+    } else if (reg == MPU6886_FIFO_R_W) {
+        sim_mpu6886_fifo_fill();
+        if (fifo_count) {
+            dev->regs[MPU6886_FIFO_R_W] = fifo[fifo_head];
+            fifo_head = (fifo_head + 1) % SIM_MPU6886_FIFO_SIZE;
+            fifo_count--;
+        } else {
+            dev->regs[MPU6886_FIFO_R_W] = 0xff;
+        }
+        dev->pointer = MPU6886_FIFO_R_W;
+    } else if (reg == MPU6886_INT_STATUS) {
+        sim_mpu6886_fifo_fill();
+        sim_mpu6886_wom_check();
+        dev->regs[MPU6886_INT_STATUS] = int_status;
+        int_status = 0;
+    }
+}
+
+static void sim_mpu6886_write(sim_i2c_device_t *dev, uint8_t reg, uint8_t value) {
+    (void) dev;
+    if (reg == MPU6886_PWR_MGMT_1 && (value & 0x80)) {
+        sim_mpu6886_reset();
+    } else if (reg == MPU6886_USER_CTRL || reg == MPU6886_FIFO_EN || reg == MPU6886_SMPLRT_DIV ||
+               reg == MPU6886_CONFIG) {
+        sim_mpu6886_fifo_config();
+    }
+    if (reg == MPU6886_ACCEL_INTEL_CTRL || reg == MPU6886_PWR_MGMT_1 || reg == MPU6886_SMPLRT_DIV) {
+        sim_mpu6886_wom_config();
+    }
+}
+
+void sim_mpu6886_set_motion(const sim_imu_motion_t *new_motion) {
+    sim_i2c_lock();
+    motion = *new_motion;
+    motion_start_us = esp_timer_get_time();
+    sim_i2c_unlock();
+}
+
+void sim_mpu6886_get_orientation(int64_t time_us, float q[4]) {
+    float axis[3], angle;
+    sim_i2c_lock();
+    sim_mpu6886_rotation(time_us, axis, &angle);
+    sim_i2c_unlock();
+
+    q[0] = cosf(angle / 2);
+    for (int i = 0; i < 3; i++) {
+        q[i + 1] = axis[i] * sinf(angle / 2);
+    }
+}
+
+void sim_mpu6886_init(void) {
+    sim_mpu6886_reset();
+    sim_mpu6886.on_read = sim_mpu6886_read;
+    sim_mpu6886.on_write = sim_mpu6886_write;
+    motion_start_us = esp_timer_get_time();
+    sim_i2c_attach(&sim_mpu6886);
+}
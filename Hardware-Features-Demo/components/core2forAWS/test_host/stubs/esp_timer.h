@@ -0,0 +1,7 @@
+/* Host stand-in for the ESP-IDF high resolution timer, counting from the start of the program */
+
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,163 @@
+/**
+ * @file disp_profiler.h
+ * @brief Frame time, flush and GUI lock statistics of the display pipeline.
+ *
+ * Enabled with CONFIG_LV_DISP_PROFILER. LVGL's refresh (lv_refr.c), the
+ * ILI9342C flush and the SPI driver report into this module, which keeps:
+ *  - a record of the last CONFIG_LV_DISP_PROFILER_HISTORY frames,
+ *  - histograms over a rolling window of CONFIG_LV_DISP_PROFILER_WINDOW
+ *    frames, so old screens don't hide what the current one costs.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "latency_histogram.h"
+
+/**
+ * @brief Measured durations.
+ */
+/* @[declare_disp_profiler_metric_t] */
+typedef enum {
+    DISP_PROFILER_FRAME,        /**< Whole refresh of the invalidated areas, until the last flush is queued. */
+    DISP_PROFILER_AREA_RENDER,  /**< Rendering of one invalidated area, without the flush waits. */
+    DISP_PROFILER_FLUSH_WAIT,   /**< Time LVGL waited for a previous flush to finish before rendering on. */
+    DISP_PROFILER_FLUSH,        /**< From ili9341_flush() to the end of the last SPI transaction. */
+    DISP_PROFILER_GUI_LOCK_WAIT,/**< Time the gui task waited for xGuiSemaphore. */
+    DISP_PROFILER_GUI_LOCK_HOLD,/**< Time the gui task held xGuiSemaphore per lv_task_handler() call. */
+    DISP_PROFILER_METRIC_MAX
+} disp_profiler_metric_t;
+/* @[declare_disp_profiler_metric_t] */
+
+/**
+ * @brief Number of histogram buckets, see latency_histogram.h.
+ */
+#define DISP_PROFILER_BUCKETS           LATENCY_HISTOGRAM_BUCKETS
+#define DISP_PROFILER_BUCKET_BASE_US    LATENCY_HISTOGRAM_BASE_US
+
+/**
+ * @brief Histogram of one metric.
+ */
+/* @[declare_disp_profiler_histogram_t] */
+typedef latency_histogram_t disp_profiler_histogram_t;
+/* @[declare_disp_profiler_histogram_t] */
+
+/**
+ * @brief One refreshed frame.
+ */
+/* @[declare_disp_profiler_frame_t] */
+typedef struct {
+    uint32_t start_us;          /**< esp_timer_get_time() at the start of the refresh, lower 32 bits. */
+    uint32_t frame_us;          /**< Duration of the whole refresh. */
+    uint32_t render_us;         /**< Rendering time, i.e. frame_us without flush_wait_us. */
+    uint32_t flush_wait_us;     /**< Time spent waiting for flushes to finish. */
+    uint32_t max_area_us;       /**< Rendering time of the slowest area. */
+    uint32_t spi_bytes;         /**< Bytes queued to the display controller. */
+    uint32_t pixels;            /**< Refreshed pixels. */
+    uint32_t lock_hold_us;      /**< xGuiSemaphore hold time of the lv_task_handler() call that refreshed. */
+    uint16_t areas;             /**< Refreshed (joined) areas. */
+} disp_profiler_frame_t;
+/* @[declare_disp_profiler_frame_t] */
+
+/**
+ * @brief Statistics over the last complete window of frames.
+ */
+/* @[declare_disp_profiler_stats_t] */
+typedef struct {
+    uint32_t frames;            /**< Frames in the window. */
+    uint32_t areas;             /**< Refreshed areas in the window. */
+    uint64_t pixels;            /**< Refreshed pixels in the window. */
+    uint64_t spi_bytes;         /**< Bytes queued to the display in the window. */
+    uint32_t over_budget;       /**< Frames longer than CONFIG_LV_DISP_PROFILER_FRAME_BUDGET_MS. */
+    uint32_t window_us;         /**< Wall time covered by the window. */
+    disp_profiler_histogram_t metrics[DISP_PROFILER_METRIC_MAX]; /**< Indexed by disp_profiler_metric_t. */
+} disp_profiler_stats_t;
+/* @[declare_disp_profiler_stats_t] */
+
+/**
+ * @brief Copies the statistics of the last complete window.
+ *
+ * Until the first window completes, the statistics of the frames so far
+ * are returned.
+ *
+ * **Example:**
+ *
+ * Log the average and worst frame time.
+ * @code{c}
+ *  disp_profiler_stats_t stats;
+ *  DispProfiler_GetStats(&stats);
+ *  disp_profiler_histogram_t *frame = &stats.metrics[DISP_PROFILER_FRAME];
+ *  if (frame->count) {
+ *      ESP_LOGI(TAG, "frame avg %u us, max %u us", (uint32_t)(frame->total_us / frame->count), frame->max_us);
+ *  }
+ * @endcode
+ *
+ * @param[out] stats The statistics.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : stats is NULL
+ */
+/* @[declare_dispprofiler_getstats] */
+esp_err_t DispProfiler_GetStats(disp_profiler_stats_t *stats);
+/* @[declare_dispprofiler_getstats] */
+
+/**
+ * @brief Copies the records of the most recent frames, newest first.
+ *
+ * @param[out] frames Array of at least max_frames records.
+ * @param[in] max_frames Size of the array.
+ *
+ * @return The number of records copied.
+ */
+/* @[declare_dispprofiler_getrecentframes] */
+size_t DispProfiler_GetRecentFrames(disp_profiler_frame_t *frames, size_t max_frames);
+/* @[declare_dispprofiler_getrecentframes] */
+
+/**
+ * @brief Clears all statistics and frame records.
+ */
+/* @[declare_dispprofiler_reset] */
+void DispProfiler_Reset(void);
+/* @[declare_dispprofiler_reset] */
+
+/**
+ * @brief Prints the statistics and the recent frames to the console.
+ */
+/* @[declare_dispprofiler_dump] */
+void DispProfiler_Dump(void);
+/* @[declare_dispprofiler_dump] */
+
+/**
+ * @brief Registers the `disp_prof` console command.
+ *
+ * `disp_prof` prints the same report as DispProfiler_Dump(),
+ * `disp_prof reset` clears the statistics. Call it after
+ * esp_console_init() or esp_console_new_repl_uart().
+ *
+ * @note Requires CONFIG_LV_DISP_PROFILER_CONSOLE.
+ *
+ * @return The result of esp_console_cmd_register().
+ */
+/* @[declare_dispprofiler_registerconsolecommand] */
+esp_err_t DispProfiler_RegisterConsoleCommand(void);
+/* @[declare_dispprofiler_registerconsolecommand] */
+
+/* Reporting functions, called by the display pipeline */
+
+//! @cond Doxygen_Suppress
+void DispProfiler_FrameBegin(void);
+void DispProfiler_FrameEnd(uint32_t pixels);
+void DispProfiler_AreaBegin(void);
+void DispProfiler_AreaEnd(void);
+void DispProfiler_FlushWaitBegin(void);
+void DispProfiler_FlushWaitEnd(void);
+void DispProfiler_FlushStart(void);
+void IRAM_ATTR DispProfiler_FlushDoneFromISR(void);
+void DispProfiler_AddSpiBytes(size_t bytes);
+void DispProfiler_GuiLock(uint32_t wait_us, uint32_t hold_us);
+//! @endcond
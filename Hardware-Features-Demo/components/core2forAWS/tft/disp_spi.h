@@ -29,6 +29,7 @@ typedef enum _disp_spi_send_flag_t {
     DISP_SPI_MODE_DIO           = 0x00000400, /* Reserved */
     DISP_SPI_MODE_QIO           = 0x00000800, /* Reserved */
     DISP_SPI_MODE_DIOQIO_ADDR   = 0x00001000, /* Reserved */
+    DISP_SPI_SEND_CMD           = 0x00002000, /* D/C line low for this transaction */
 } disp_spi_send_flag_t;
 
 typedef struct _disp_spi_read_data {
@@ -52,14 +53,30 @@ extern SemaphoreHandle_t spi_mutex;
 
 void disp_spi_add_device(spi_host_device_t host);
 void disp_spi_add_device_config(spi_host_device_t host, spi_device_interface_config_t *devcfg);
+/* Queued transactions (no POLLING/SYNCHRONOUS flag) return immediately. Up to 4 bytes
+ * of data are copied into the transaction; longer data must stay valid until the
+ * transaction completes. The first queued transaction takes the bus and the one
+ * flagged DISP_SPI_SIGNAL_FLUSH releases it once sent. */
 void disp_spi_transaction(const uint8_t *data, size_t length,
     disp_spi_send_flag_t flags, disp_spi_read_data *out, uint64_t addr);
+/* Queues rows of row_length bytes that lie stride bytes apart, as a continuous
+ * write. The flags apply to the end of the last row. */
+void disp_spi_queue_rows(const uint8_t *data, size_t row_length, size_t stride,
+    uint16_t rows, disp_spi_send_flag_t flags);
 void disp_wait_for_pending_transactions(void);
 
 static inline void disp_spi_send_data(uint8_t *data, size_t length) {
     disp_spi_transaction(data, length, DISP_SPI_SEND_POLLING, NULL, 0);
 }
 
+static inline void disp_spi_queue_cmd(uint8_t cmd) {
+    disp_spi_transaction(&cmd, 1, DISP_SPI_SEND_QUEUED | DISP_SPI_SEND_CMD, NULL, 0);
+}
+
+static inline void disp_spi_queue_data(uint8_t *data, size_t length) {
+    disp_spi_transaction(data, length, DISP_SPI_SEND_QUEUED, NULL, 0);
+}
+
 static inline void disp_spi_send_colors(uint8_t *data, size_t length) {
     disp_spi_transaction(data, length,
         DISP_SPI_SEND_QUEUED | DISP_SPI_SIGNAL_FLUSH,
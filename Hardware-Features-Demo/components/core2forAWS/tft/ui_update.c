@@ -0,0 +1,144 @@
+/**
+ * @file ui_update.c
+ *
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "core2forAWS.h"
+#include "ui_update.h"
+
+#ifndef CONFIG_LV_UI_UPDATE_QUEUE_LEN
+#define CONFIG_LV_UI_UPDATE_QUEUE_LEN 32
+#endif
+
+#ifndef CONFIG_LV_UI_UPDATE_TEXT_LEN
+#define CONFIG_LV_UI_UPDATE_TEXT_LEN 32
+#endif
+
+typedef enum {
+    UI_UPDATE_LABEL_TEXT,
+    UI_UPDATE_BAR_VALUE,
+    UI_UPDATE_ARC_VALUE,
+    UI_UPDATE_STYLE_COLOR,
+    UI_UPDATE_HIDDEN,
+} ui_update_type_t;
+
+typedef struct {
+    lv_obj_t *obj;
+    uint8_t type;
+    uint8_t part;
+    lv_style_property_t prop;
+    union {
+        char text[CONFIG_LV_UI_UPDATE_TEXT_LEN];
+        int16_t value;
+        lv_color_t color;
+        bool hidden;
+    };
+} ui_update_t;
+
+static QueueHandle_t update_queue;
+static volatile uint32_t dropped;
+
+/* Only touched by the gui task while it holds xGuiSemaphore */
+static ui_update_t pending[CONFIG_LV_UI_UPDATE_QUEUE_LEN];
+
+void UIUpdate_Init(void) {
+    update_queue = xQueueCreate(CONFIG_LV_UI_UPDATE_QUEUE_LEN, sizeof(ui_update_t));
+}
+
+static esp_err_t ui_update_send(const ui_update_t *update) {
+    if (update_queue == NULL || xQueueSend(update_queue, update, 0) != pdTRUE) {
+        dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    Core2ForAWS_Display_Notify();
+    return ESP_OK;
+}
+
+esp_err_t UIUpdate_SetLabelText(lv_obj_t *label, const char *text) {
+    ui_update_t update = { .obj = label, .type = UI_UPDATE_LABEL_TEXT };
+    strlcpy(update.text, text, sizeof(update.text));
+    return ui_update_send(&update);
+}
+
+esp_err_t UIUpdate_SetBarValue(lv_obj_t *bar, int16_t value) {
+    ui_update_t update = { .obj = bar, .type = UI_UPDATE_BAR_VALUE, .value = value };
+    return ui_update_send(&update);
+}
+
+esp_err_t UIUpdate_SetArcValue(lv_obj_t *arc, int16_t value) {
+    ui_update_t update = { .obj = arc, .type = UI_UPDATE_ARC_VALUE, .value = value };
+    return ui_update_send(&update);
+}
+
+esp_err_t UIUpdate_SetStyleColor(lv_obj_t *obj, uint8_t part, lv_style_property_t prop, lv_color_t color) {
+    ui_update_t update = { .obj = obj, .type = UI_UPDATE_STYLE_COLOR, .part = part, .prop = prop, .color = color };
+    return ui_update_send(&update);
+}
+
+esp_err_t UIUpdate_SetHidden(lv_obj_t *obj, bool hidden) {
+    ui_update_t update = { .obj = obj, .type = UI_UPDATE_HIDDEN, .hidden = hidden };
+    return ui_update_send(&update);
+}
+
+/* True if a later update writes the same widget property, so this one can be skipped */
+static bool ui_update_superseded(uint16_t index, uint16_t count) {
+    const ui_update_t *update = &pending[index];
+
+    for (uint16_t i = index + 1; i < count; i++) {
+        if (pending[i].obj == update->obj && pending[i].type == update->type &&
+            pending[i].part == update->part && pending[i].prop == update->prop) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ui_update_apply(const ui_update_t *update) {
+    switch (update->type) {
+        case UI_UPDATE_LABEL_TEXT:
+            lv_label_set_text(update->obj, update->text);
+            break;
+        case UI_UPDATE_BAR_VALUE:
+            lv_bar_set_value(update->obj, update->value, LV_ANIM_OFF);
+            break;
+        case UI_UPDATE_ARC_VALUE:
+            lv_arc_set_value(update->obj, update->value);
+            break;
+        case UI_UPDATE_STYLE_COLOR:
+            _lv_obj_set_style_local_color(update->obj, update->part, update->prop, update->color);
+            break;
+        case UI_UPDATE_HIDDEN:
+            lv_obj_set_hidden(update->obj, update->hidden);
+            break;
+        default:
+            break;
+    }
+}
+
+void UIUpdate_Process(void) {
+    uint16_t count = 0;
+
+    if (update_queue == NULL) {
+        return;
+    }
+
+    /* Only drain what is queued now, so a busy producer can't keep the frame from starting */
+    while (count < CONFIG_LV_UI_UPDATE_QUEUE_LEN && xQueueReceive(update_queue, &pending[count], 0) == pdTRUE) {
+        count++;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (!ui_update_superseded(i, count)) {
+            ui_update_apply(&pending[i]);
+        }
+    }
+}
+
+uint32_t UIUpdate_GetDropped(void) {
+    return dropped;
+}
@@ -0,0 +1,392 @@
+/*
+
+  ESP32 FFT, fixed-point
+  ======================
+
+  Q15 real FFT with block floating point scaling, see fft_q15.h.
+
+  The real samples are transformed as size / 2 complex ones, even samples
+  real and odd ones imaginary, like rfft() of fft.c does: a bit reversal,
+  radix-4 decimation in time stages (with one radix-2 stage first when the
+  number of points is not a power of 4), then the post processing that
+  separates the positive frequencies of the real signal.
+
+  All the products are 16 x 16 bits into 32 bits, with rounding.
+
+*/
+#include <stdlib.h>
+#include <math.h>
+
+#include "fft_q15.h"
+
+#define TWO_PI 6.28318530717958647692
+
+// Largest bit length of the stage inputs that keeps every output within 16 bits.
+// A radix-4 output adds an input and three rotated ones: (1 + 3 sqrt(2)) 2^12 < 2^15
+#define RADIX4_INPUT_BITS 12
+// A radix-2 output without twiddle factor adds two inputs: 2 * 2^13 < 2^15
+#define RADIX2_INPUT_BITS 13
+// A post processing output is an average plus a rotated one: (1 + sqrt(2)) 2^13 < 2^15
+#define POST_INPUT_BITS 13
+
+// Branch free for shift = 0, the stages mostly run with the same shift for the whole block
+static inline int fft_q15_round_shift(int v, int shift)
+{
+  return (v + ((1 << shift) >> 1)) >> shift;
+}
+
+// Bit length bound of values folded in with ones' complement absolute values, |v| <= 2^bits
+static inline int fft_q15_bits(unsigned int mask)
+{
+  return mask ? 32 - __builtin_clz(mask) : 0;
+}
+
+static inline unsigned int fft_q15_abs(int v)
+{
+  return (unsigned int)(v ^ (v >> 31));
+}
+
+fft_q15_config_t *fft_q15_init(int size)
+{
+  /*
+   * Prepare a Q15 real FFT of the size, a power of two from 4 to 65536.
+   *
+   * Returns NULL on a bad size or if memory runs out.
+   */
+  int k, m;
+
+  if (size < 4 || size > 65536 || (size & (size - 1)) != 0)
+    return NULL;
+
+  fft_q15_config_t *config = (fft_q15_config_t *)calloc(1, sizeof(fft_q15_config_t));
+  if (config == NULL)
+    return NULL;
+
+  config->size = size;
+
+  // The radix-4 stages use W_size^k up to k = 3 size / 4, the post processing up to size / 4
+  int twiddles = 3 * size / 4;
+  config->twiddle_factors = (int16_t *)malloc(2 * twiddles * sizeof(int16_t));
+
+  int n = size / 2;
+  config->bit_reversal = (unsigned short *)malloc(n * sizeof(unsigned short));
+
+  if (config->twiddle_factors == NULL || config->bit_reversal == NULL)
+  {
+    fft_q15_destroy(config);
+    return NULL;
+  }
+
+  for (k = 0 ; k < twiddles ; k++)
+  {
+    config->twiddle_factors[2 * k] = (int16_t)lrint(32767.0 * cos(TWO_PI * k / size));
+    config->twiddle_factors[2 * k + 1] = (int16_t)lrint(32767.0 * sin(TWO_PI * k / size));
+  }
+
+  int bits = 0;
+  while ((1 << bits) < n)
+    bits++;
+
+  for (k = 0 ; k < n ; k++)
+  {
+    int r = 0;
+    for (m = 0 ; m < bits ; m++)
+      r |= ((k >> m) & 1) << (bits - 1 - m);
+
+    if (k < r)
+    {
+      config->bit_reversal[2 * config->bit_reversal_pairs] = k;
+      config->bit_reversal[2 * config->bit_reversal_pairs + 1] = r;
+      config->bit_reversal_pairs++;
+    }
+  }
+
+  return config;
+}
+
+void fft_q15_destroy(fft_q15_config_t *config)
+{
+  free(config->twiddle_factors);
+  free(config->bit_reversal);
+  free(config);
+}
+
+static unsigned int fft_q15_radix2(int16_t *x, int n, int shift)
+{
+  /*
+   * First stage, pairs of points, W = 1
+   */
+  unsigned int mask = 0;
+  int i;
+
+  for (i = 0 ; i < 2 * n ; i += 4)
+  {
+    int ar = fft_q15_round_shift(x[i], shift);
+    int ai = fft_q15_round_shift(x[i + 1], shift);
+    int br = fft_q15_round_shift(x[i + 2], shift);
+    int bi = fft_q15_round_shift(x[i + 3], shift);
+
+    x[i] = ar + br;
+    x[i + 1] = ai + bi;
+    x[i + 2] = ar - br;
+    x[i + 3] = ai - bi;
+
+    mask |= fft_q15_abs(x[i]) | fft_q15_abs(x[i + 1]) | fft_q15_abs(x[i + 2]) | fft_q15_abs(x[i + 3]);
+  }
+
+  return mask;
+}
+
+static inline unsigned int fft_q15_butterfly4(int16_t *p0, int16_t *p1, int16_t *p2, int16_t *p3,
+                                              int ar, int ai, int br, int bi, int cr, int ci, int dr, int di)
+{
+  /*
+   * Radix-4 butterfly on the rotated transforms a, b, c, d of the samples 4p,
+   * 4p + 1, 4p + 2 and 4p + 3, returns the mask of the outputs
+   */
+  int acr = ar + cr, aci = ai + ci;
+  int amcr = ar - cr, amci = ai - ci;
+  int bdr = br + dr, bdi = bi + di;
+  int bmdr = br - dr, bmdi = bi - di;
+
+  // X[k] = (a + c) + (b + d), X[k + 2len] = (a + c) - (b + d)
+  // X[k + len] = (a - c) - j (b - d), X[k + 3len] = (a - c) + j (b - d)
+  p0[0] = acr + bdr;
+  p0[1] = aci + bdi;
+  p2[0] = acr - bdr;
+  p2[1] = aci - bdi;
+  p1[0] = amcr + bmdi;
+  p1[1] = amci - bmdr;
+  p3[0] = amcr - bmdi;
+  p3[1] = amci + bmdr;
+
+  return fft_q15_abs(p0[0]) | fft_q15_abs(p0[1]) | fft_q15_abs(p1[0]) | fft_q15_abs(p1[1]) |
+         fft_q15_abs(p2[0]) | fft_q15_abs(p2[1]) | fft_q15_abs(p3[0]) | fft_q15_abs(p3[1]);
+}
+
+static unsigned int fft_q15_radix4(int16_t *x, int n, int len, int shift, const int16_t *twiddle_factors,
+                                   int tw_stride)
+{
+  /*
+   * Combines groups of four transforms of len points into transforms of 4 len points
+   *
+   * In bit reversed order, the four blocks of a group hold the transforms of
+   * the samples 4p, 4p + 2, 4p + 1 and 4p + 3 of the group, in that order.
+   * W_4len^j is at [j * tw_stride] complex entries of twiddle_factors.
+   */
+  unsigned int mask = 0;
+  int i, j;
+
+  // W = 1 for the first point of every transform, which is the whole first stage
+  for (i = 0 ; i < n ; i += 4 * len)
+  {
+    int16_t *p0 = &x[2 * i];
+    int16_t *p1 = &x[2 * (i + len)];
+    int16_t *p2 = &x[2 * (i + 2 * len)];
+    int16_t *p3 = &x[2 * (i + 3 * len)];
+
+    mask |= fft_q15_butterfly4(p0, p1, p2, p3,
+                               fft_q15_round_shift(p0[0], shift), fft_q15_round_shift(p0[1], shift),
+                               fft_q15_round_shift(p2[0], shift), fft_q15_round_shift(p2[1], shift),
+                               fft_q15_round_shift(p1[0], shift), fft_q15_round_shift(p1[1], shift),
+                               fft_q15_round_shift(p3[0], shift), fft_q15_round_shift(p3[1], shift));
+  }
+
+  for (j = 1 ; j < len ; j++)
+  {
+    int c1 = twiddle_factors[2 * j * tw_stride], s1 = twiddle_factors[2 * j * tw_stride + 1];
+    int c2 = twiddle_factors[4 * j * tw_stride], s2 = twiddle_factors[4 * j * tw_stride + 1];
+    int c3 = twiddle_factors[6 * j * tw_stride], s3 = twiddle_factors[6 * j * tw_stride + 1];
+
+    for (i = j ; i < n ; i += 4 * len)
+    {
+      int16_t *p0 = &x[2 * i];
+      int16_t *p1 = &x[2 * (i + len)];
+      int16_t *p2 = &x[2 * (i + 2 * len)];
+      int16_t *p3 = &x[2 * (i + 3 * len)];
+      int t0, t1;
+
+      // Multiplication by W = c - js
+      t0 = fft_q15_round_shift(p2[0], shift);
+      t1 = fft_q15_round_shift(p2[1], shift);
+      int br = (c1 * t0 + s1 * t1 + (1 << 14)) >> 15;
+      int bi = (c1 * t1 - s1 * t0 + (1 << 14)) >> 15;
+
+      t0 = fft_q15_round_shift(p1[0], shift);
+      t1 = fft_q15_round_shift(p1[1], shift);
+      int cr = (c2 * t0 + s2 * t1 + (1 << 14)) >> 15;
+      int ci = (c2 * t1 - s2 * t0 + (1 << 14)) >> 15;
+
+      t0 = fft_q15_round_shift(p3[0], shift);
+      t1 = fft_q15_round_shift(p3[1], shift);
+      int dr = (c3 * t0 + s3 * t1 + (1 << 14)) >> 15;
+      int di = (c3 * t1 - s3 * t0 + (1 << 14)) >> 15;
+
+      mask |= fft_q15_butterfly4(p0, p1, p2, p3, fft_q15_round_shift(p0[0], shift),
+                                 fft_q15_round_shift(p0[1], shift), br, bi, cr, ci, dr, di);
+    }
+  }
+
+  return mask;
+}
+
+static void fft_q15_post_processing(int16_t *y, int n, int shift, const int16_t *twiddle_factors)
+{
+  /*
+   * Fixed-point version of the post processing of rfft(), n real points
+   */
+  int k;
+
+  int t = fft_q15_round_shift(y[0], shift);
+  int u = fft_q15_round_shift(y[1], shift);
+  y[0] = t + u;  // DC coefficient
+  y[1] = t - u;  // Center coefficient
+
+  // Quarter element, complex conjugate
+  y[n / 2] = fft_q15_round_shift(y[n / 2], shift);
+  y[n / 2 + 1] = -fft_q15_round_shift(y[n / 2 + 1], shift);
+
+  for (k = 2 ; k < n / 2 ; k += 2)
+  {
+    int c = twiddle_factors[k];
+    int s = twiddle_factors[k + 1];
+
+    int ykr = fft_q15_round_shift(y[k], shift);
+    int yki = fft_q15_round_shift(y[k + 1], shift);
+    int ynr = fft_q15_round_shift(y[n - k], shift);
+    int yni = fft_q15_round_shift(y[n - k + 1], shift);
+
+    // Twice the even and odd half coefficients, the halves are taken in the rounding below
+    int xer = ykr + ynr;
+    int xei = yki - yni;
+    int xor_t = yki + yni;
+    int xoi = ynr - ykr;
+
+    int tr =  c * xor_t + s * xoi;
+    int ti = -s * xor_t + c * xoi;
+
+    y[k]         =  (xer * (1 << 14) + (tr >> 1) + (1 << 14)) >> 15;
+    y[k + 1]     =  (xei * (1 << 14) + (ti >> 1) + (1 << 14)) >> 15;
+    y[n - k]     =  (xer * (1 << 14) - (tr >> 1) + (1 << 14)) >> 15;
+    y[n - k + 1] = -((xei * (1 << 14) - (ti >> 1) + (1 << 14)) >> 15);
+  }
+}
+
+int rfft_q15(fft_q15_config_t *config, int16_t *data)
+{
+  /*
+   * Forward real FFT of size 16-bit samples, in place
+   *
+   * Parameters
+   * ----------
+   *  config (fft_q15_config_t *)
+   *    The plan from fft_q15_init()
+   *  data (int16_t *)
+   *    The samples, replaced by the spectrum in the packed layout of rfft():
+   *    [ X[0], X[size/2], Re(X[1]), Im(X[1]), ..., Re(X[size/2-1]), Im(X[size/2-1]) ]
+   *
+   * Returns
+   * -------
+   *  The block exponent, the spectrum is data * 2^exponent
+   */
+  int size = config->size;
+  int n = size / 2;
+  int k, len, shift;
+  unsigned int mask = 0;
+
+  int stages = 0;
+  while ((1 << stages) < n)
+    stages++;
+
+  // Normalize the input to the headroom of the first stage, up for quiet signals
+  for (k = 0 ; k < size ; k++)
+    mask |= fft_q15_abs(data[k]);
+
+  int exponent = fft_q15_bits(mask) - ((stages & 1) ? RADIX2_INPUT_BITS : RADIX4_INPUT_BITS);
+  if (mask == 0)
+    exponent = 0;
+
+  if (exponent < 0)
+  {
+    for (k = 0 ; k < size ; k++)
+      data[k] = data[k] * (1 << -exponent);
+  }
+  else if (exponent > 0)
+  {
+    for (k = 0 ; k < size ; k++)
+      data[k] = fft_q15_round_shift(data[k], exponent);
+  }
+
+  for (k = 0 ; k < config->bit_reversal_pairs ; k++)
+  {
+    int a = 2 * config->bit_reversal[2 * k];
+    int b = 2 * config->bit_reversal[2 * k + 1];
+    int16_t t;
+
+    t = data[a];
+    data[a] = data[b];
+    data[b] = t;
+
+    t = data[a + 1];
+    data[a + 1] = data[b + 1];
+    data[b + 1] = t;
+  }
+
+  shift = 0;
+  len = 1;
+  if (stages & 1)
+  {
+    mask = fft_q15_radix2(data, n, 0);
+    len = 2;
+  }
+
+  for ( ; len < n ; len *= 4)
+  {
+    if (len > 1 || (stages & 1))
+    {
+      shift = fft_q15_bits(mask) - RADIX4_INPUT_BITS;
+      shift = shift > 0 ? shift : 0;
+      exponent += shift;
+    }
+    // W_4len^j is W_size^(j * size / 4len)
+    mask = fft_q15_radix4(data, n, len, shift, config->twiddle_factors, size / (4 * len));
+    shift = 0;
+  }
+
+  shift = fft_q15_bits(mask) - POST_INPUT_BITS;
+  shift = shift > 0 ? shift : 0;
+  exponent += shift;
+  fft_q15_post_processing(data, size, shift, config->twiddle_factors);
+
+  return exponent;
+}
+
+int rfft_q15_power(fft_q15_config_t *config, int16_t *data, uint32_t *power)
+{
+  /*
+   * Forward real FFT of size 16-bit samples, reduced to the squared
+   * magnitudes of the frequencies 0 to size / 2, without square roots
+   *
+   * Parameters
+   * ----------
+   *  data (int16_t *)
+   *    The samples, destroyed
+   *  power (uint32_t *)
+   *    size / 2 + 1 squared magnitudes
+   *
+   * Returns
+   * -------
+   *  The block exponent, the power of the spectrum is power * 4^exponent
+   */
+  int n = config->size;
+  int k;
+
+  int exponent = rfft_q15(config, data);
+
+  power[0] = (uint32_t)(data[0] * data[0]);
+  power[n / 2] = (uint32_t)(data[1] * data[1]);
+  for (k = 1 ; k < n / 2 ; k++)
+    power[k] = (uint32_t)(data[2 * k] * data[2 * k]) + (uint32_t)(data[2 * k + 1] * data[2 * k + 1]);
+
+  return exponent;
+}
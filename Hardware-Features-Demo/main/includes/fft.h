@@ -51,6 +51,10 @@ typedef enum
 
 #define FFT_OWN_INPUT_MEM 1
 #define FFT_OWN_OUTPUT_MEM 2
+#define FFT_CACHED_PLAN 4
+
+// Number of plans fft_plan_get() keeps for the life of the program
+#define FFT_PLAN_CACHE_SIZE 4
 
 typedef struct
 {
@@ -61,11 +65,16 @@ typedef struct
   fft_type_t type;   // real or complex
   fft_direction_t direction; // forward or backward
   unsigned int flags; // FFT flags
+  unsigned short *bit_reversal; // pairs of indices swapped by the in-place transform
+  int bit_reversal_pairs; // number of pairs in bit_reversal
 } fft_config_t;
 
 fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, float *input, float *output);
 void fft_destroy(fft_config_t *config);
 void fft_execute(fft_config_t *config);
+fft_config_t *fft_plan_get(int size, fft_type_t type, fft_direction_t direction);
+void rfft_inplace(fft_config_t *config, float *data);
+void rfft_magnitude(fft_config_t *config, float *data);
 void fft(float *input, float *output, float *twiddle_factors, int n);
 void ifft(float *input, float *output, float *twiddle_factors, int n);
 void rfft(float *x, float *y, float *twiddle_factors, int n);
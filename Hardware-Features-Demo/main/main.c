@@ -21,11 +21,11 @@ static void brightness_slider_event_cb(lv_obj_t * slider, lv_event_t event);
 static void strength_slider_event_cb(lv_obj_t * slider, lv_event_t event);
 static void led_event_handler(lv_obj_t * obj, lv_event_t event);
 
-static void speakerTask(void *arg);
+static void speakerStart(void);
 static void ateccTask(void *arg);
 static void sdcardTest();
 
-TaskHandle_t mic_handle, speaker_handle, atecc_handle;
+TaskHandle_t mic_handle, atecc_handle;
 
 static const char *TAG = "MAIN";
 
@@ -39,7 +39,7 @@ void app_main(void)
     sdcardTest();
     sk6812Test();
 
-    xTaskCreatePinnedToCore(speakerTask, "speak", 4096 * 2, NULL, 4, &speaker_handle, 1);
+    speakerStart();
     xTaskCreatePinnedToCore(microphoneTask, "microphoneTask", 4096 * 2, NULL, 1, &mic_handle, 1);
     rtc_date_t date;
     date.year = 2020;
@@ -108,7 +108,14 @@ void app_main(void)
     xTaskCreatePinnedToCore(ateccTask, "ateccTask", 4096 * 2, NULL, 1, &atecc_handle, 1);
 
     char label_stash[200];
+    bool speaker_on = true;
     for (;;) {
+        /* The amplifier stays on until the DMA buffers played the end of the clip */
+        if (speaker_on && Speaker_Drain(0) == ESP_OK) {
+            Core2ForAWS_Speaker_Enable(0);
+            speaker_on = false;
+        }
+
         BM8563_GetTime(&date);
         sprintf(label_stash, "Time: %d-%02d-%02d %02d:%02d:%02d\r\n",
                 date.year, date.month, date.day, date.hour, date.minute, date.second);
@@ -173,21 +180,17 @@ static void led_event_handler(lv_obj_t * obj, lv_event_t event) {
     }
 }
 
-static void speakerTask(void *arg) {
-    Speaker_Init();
-    Core2ForAWS_Speaker_Enable(1);
+static void speakerStart(void) {
     extern const unsigned char music[120264];
-    Speaker_WriteBuff((uint8_t *)music, 120264, portMAX_DELAY);
-    Core2ForAWS_Speaker_Enable(0);
-    esp_err_t err = Speaker_Deinit();
+    static speaker_block_t block = { .samples = (const int16_t *)music, .count = 120264 / 2, .last = true };
 
-    if(err == ESP_OK){
-        vTaskResume(mic_handle);
-    }
-    else {
-        ESP_LOGE(TAG, "Error uninstalling speaker");
+    /* Played by the stream task while the microphone keeps capturing */
+    if (Speaker_StartStream(NULL, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Error starting the speaker stream");
+        return;
     }
-    vTaskDelete(NULL);
+    Core2ForAWS_Speaker_Enable(1);
+    Speaker_Submit(&block, 0);
 }
 
 static void ateccTask(void *arg) {
@@ -4,11 +4,15 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "esp_log.h"
+#include "xtensa/hal.h"
 
 #include "math.h"
-#include "fft.h"
+#include "fft_q15.h"
 #include "core2forAWS.h"
 
+static const char *TAG = "MIC_FFT";
+
 const unsigned char ImageData[768] = { 
  0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x01 , 0x00 , 0x00 , 0x04 , 0x00 , 
  0x01 , 0x07 , 0x00 , 0x01 , 0x09 , 0x00 , 0x01 , 0x0D , 0x00 , 0x02 , 0x10 , 0x00 , 0x02 , 0x14 , 0x00 , 0x01 , 
@@ -75,10 +79,22 @@ QueueHandle_t queue = NULL;
 #define CANVAS_WIDTH 240
 #define CANVAS_HEIGHT 60
 
+/* Two columns can wait in the queue and one be drawn, so a fourth is always free to fill */
+#define FFT_COLUMNS 4
+
+#define FFT_SIZE 512
+/* The CPU cycles of the transform are logged every this many frames, about 12 s at 44.1 kHz */
+#define FFT_CYCLES_FRAMES 1000
+
 void fftShowtask(void *arg) {
-    uint16_t colorPos;
     uint8_t *fft_dis_buff;
 
+    /* Convert the RGB color map once, columns are then drawn straight from the magnitudes */
+    static lv_color_t palette[256];
+    for (uint16_t i = 0; i < 256; i++) {
+        palette[i] = LV_COLOR_MAKE(ImageData[i * 3 + 0], ImageData[i * 3 + 1], ImageData[i * 3 + 2]);
+    }
+
     xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
     lv_obj_t *canvas = lv_canvas_create(lv_scr_act(), NULL);
     lv_obj_set_pos(canvas, 40, 170);
@@ -89,11 +105,9 @@ void fftShowtask(void *arg) {
     
     for (;;) {
         xQueueReceive(queue, &fft_dis_buff, portMAX_DELAY);
-        for (uint16_t count_y = 0; count_y < CANVAS_HEIGHT; count_y++) {
-            colorPos = fft_dis_buff[count_y];
-            lv_canvas_set_px(canvas, posData, count_y, LV_COLOR_MAKE(ImageData[colorPos * 3 + 0], ImageData[colorPos * 3 + 1], ImageData[colorPos * 3 + 2]));
-        }
-        free(fft_dis_buff);
+        xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+        lv_canvas_set_col_palette(canvas, posData, fft_dis_buff, palette);
+        xSemaphoreGive(xGuiSemaphore);
         posData += 1;
         if (posData == CANVAS_WIDTH) {
             posData = 0;
@@ -102,35 +116,62 @@ void fftShowtask(void *arg) {
 }
 
 void microphoneTask(void *arg) {
-    static int8_t i2s_readraw_buff[1024];
-    size_t bytesread;
-    int16_t *buffptr;
+    const mic_frame_t *frame;
+    mic_subscriber_t subscriber;
     double data = 0;
+    static uint8_t fft_columns[FFT_COLUMNS][CANVAS_HEIGHT];
+    uint8_t column = 0;
     uint8_t *fft_dis_buff = NULL;
-    vTaskSuspend(NULL);
-    Microphone_Init();
+    /* The frame is shared with the other subscribers, the transform runs in place on a copy */
+    static int16_t samples[FFT_SIZE];
+    static uint32_t power[FFT_SIZE / 2 + 1];
+    uint32_t fft_cycles = 0, fft_cycles_max = 0, fft_frames = 0;
+    mic_capture_config_t mic_config = { .sample_rate = 44100, .frame_samples = FFT_SIZE };
+    if (Microphone_StartCapture(&mic_config) != ESP_OK || Microphone_Subscribe(1, &subscriber) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the microphone capture");
+        vTaskDelete(NULL);
+    }
     queue = xQueueCreate(2, sizeof(uint8_t *));
 
     xTaskCreatePinnedToCore(fftShowtask, "fftShowtask", 4096*2, NULL, 1, NULL, 1);
 
+    /* Prepared once, the loop below transforms the raw samples without allocating */
+    fft_q15_config_t *real_fft_plan = fft_q15_init(FFT_SIZE);
+    if (real_fft_plan == NULL) {
+        ESP_LOGE(TAG, "Failed to prepare the FFT plan");
+        vTaskDelete(NULL);
+    }
+
     for (;;) {
-        fft_dis_buff = (uint8_t *)heap_caps_malloc(CANVAS_HEIGHT * sizeof(uint8_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM);
+        fft_dis_buff = fft_columns[column];
         memset(fft_dis_buff, 0, CANVAS_HEIGHT);
-        fft_config_t *real_fft_plan = fft_init(512, FFT_REAL, FFT_FORWARD, NULL, NULL);
-        i2s_read(I2S_NUM_0, (char *)i2s_readraw_buff, 1024, &bytesread, pdMS_TO_TICKS(100));
-        buffptr = (int16_t *)i2s_readraw_buff;
-        for (uint16_t count_n = 0; count_n < real_fft_plan->size; count_n++) {
-            real_fft_plan->input[count_n] = (float)map(buffptr[count_n], INT16_MIN, INT16_MAX, -1000, 1000);
+        if (Microphone_ReceiveFrame(subscriber, &frame, pdMS_TO_TICKS(100)) != ESP_OK) {
+            continue;
+        }
+        memcpy(samples, frame->samples, sizeof(samples));
+        Microphone_ReleaseFrame(frame);
+
+        uint32_t start = xthal_get_ccount();
+        int exponent = rfft_q15_power(real_fft_plan, samples, power);
+        uint32_t cycles = xthal_get_ccount() - start;
+        fft_cycles += cycles;
+        if (cycles > fft_cycles_max) {
+            fft_cycles_max = cycles;
+        }
+        if (++fft_frames == FFT_CYCLES_FRAMES) {
+            ESP_LOGI(TAG, "Q15 FFT of %d samples: %u cycles average, %u max", FFT_SIZE,
+                     fft_cycles / fft_frames, fft_cycles_max);
+            fft_cycles = fft_cycles_max = fft_frames = 0;
         }
-        fft_execute(real_fft_plan);
 
+        /* Only the displayed frequencies need a square root, in the scale of the samples mapped to -1000..1000 */
         for (uint16_t count_n = 1; count_n < CANVAS_HEIGHT; count_n++) {
-            data = sqrt(real_fft_plan->output[2 * count_n] * real_fft_plan->output[2 * count_n] + real_fft_plan->output[2 * count_n + 1] * real_fft_plan->output[2 * count_n + 1]);
+            data = ldexp(sqrt(power[count_n]), exponent) * 2000 / 65535;
             fft_dis_buff[CANVAS_HEIGHT - count_n]  = map(data, 0, 2000, 0, 256);
         }
-        fft_destroy(real_fft_plan);
-        if(xQueueSend(queue, &fft_dis_buff, 0) == pdFAIL) {
-            free(fft_dis_buff);
+        /* A column the queue had no room for is filled again */
+        if(xQueueSend(queue, &fft_dis_buff, 0) == pdPASS) {
+            column = (column + 1) % FFT_COLUMNS;
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,35 @@
+#include "latency_histogram.h"
+
+void LatencyHistogram_Add(latency_histogram_t *hist, uint32_t us) {
+    uint32_t bucket = 0;
+
+    if (us >= LATENCY_HISTOGRAM_BASE_US) {
+        bucket = 32 - __builtin_clz(us / LATENCY_HISTOGRAM_BASE_US);
+        if (bucket >= LATENCY_HISTOGRAM_BUCKETS) {
+            bucket = LATENCY_HISTOGRAM_BUCKETS - 1;
+        }
+    }
+
+    if (hist->count == 0 || us < hist->min_us) {
+        hist->min_us = us;
+    }
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+    hist->count++;
+    hist->total_us += us;
+    hist->buckets[bucket]++;
+}
+
+uint32_t LatencyHistogram_Percentile(const latency_histogram_t *hist, uint32_t percent) {
+    uint32_t target = (hist->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            return i < LATENCY_HISTOGRAM_BUCKETS - 1 ? LATENCY_HISTOGRAM_BASE_US << i : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
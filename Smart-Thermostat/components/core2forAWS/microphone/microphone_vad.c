@@ -0,0 +1,126 @@
+#include "string.h"
+#include "xtensa/hal.h"
+
+#include "microphone_vad.h"
+
+#ifndef CONFIG_MIC_VAD_THRESHOLD_DB
+#define CONFIG_MIC_VAD_THRESHOLD_DB 9
+#endif
+#ifndef CONFIG_MIC_VAD_MAX_ZCR
+#define CONFIG_MIC_VAD_MAX_ZCR 350
+#endif
+#ifndef CONFIG_MIC_VAD_ONSET_MS
+#define CONFIG_MIC_VAD_ONSET_MS 40
+#endif
+#ifndef CONFIG_MIC_VAD_HANGOVER_MS
+#define CONFIG_MIC_VAD_HANGOVER_MS 500
+#endif
+
+/* log2 in Q8 per dB, 256 / 3.0103 */
+#define MIC_VAD_Q8_PER_DB           85
+/* The noise floor stays above an RMS of 4, so near digital silence a few LSB are not activity */
+#define MIC_VAD_NOISE_MIN_Q8        (4 << 8)
+/* The noise floor falls by 1/4 of the way to a quieter frame, and rises by 1/32 of the way to
+ * a louder one, 1/256 during activity */
+#define MIC_VAD_NOISE_FALL_SHIFT    2
+#define MIC_VAD_NOISE_RISE_SHIFT    5
+#define MIC_VAD_NOISE_ACTIVE_SHIFT  8
+
+/* log2 in Q8, linear between the powers of two, which is within 0.09 of the logarithm */
+static int32_t Microphone_VadLog2(uint32_t x) {
+    if (x == 0) {
+        return 0;
+    }
+    int msb = 31 - __builtin_clz(x);
+    uint32_t frac = msb >= 8 ? x >> (msb - 8) : x << (8 - msb);
+    return (msb << 8) + (frac & 0xff);
+}
+
+void Microphone_VadInit(mic_vad_t *vad, uint32_t sample_rate) {
+    memset(vad, 0, sizeof(*vad));
+    vad->sample_rate = sample_rate;
+    vad->threshold_q8 = CONFIG_MIC_VAD_THRESHOLD_DB * MIC_VAD_Q8_PER_DB;
+    vad->max_zcr_permille = CONFIG_MIC_VAD_MAX_ZCR;
+    vad->onset_us = CONFIG_MIC_VAD_ONSET_MS * 1000;
+    vad->hangover_us = CONFIG_MIC_VAD_HANGOVER_MS * 1000;
+}
+
+mic_vad_event_t Microphone_VadProcess(mic_vad_t *vad, const mic_frame_t *frame) {
+    uint32_t start = xthal_get_ccount();
+    const int16_t *x = frame->samples;
+    int n = frame->count;
+    mic_vad_event_t event = MIC_VAD_NONE;
+
+    if (n == 0 || vad->sample_rate == 0) {
+        return MIC_VAD_NONE;
+    }
+
+    /* One pass around the mean of the last frame, the DC moves too slowly for that to matter */
+    int32_t dc = vad->dc;
+    int32_t sum = 0;
+    uint64_t sum_sq = 0;
+    uint32_t crossings = 0;
+    bool negative = x[0] < dc;
+    for (int i = 0; i < n; i++) {
+        int32_t d = x[i] - dc;
+        sum += d;
+        sum_sq += (uint32_t) d * (uint32_t) d;
+        crossings += (d < 0) != negative;
+        negative = d < 0;
+    }
+    int32_t mean = sum / n;
+    uint64_t mean_sq = sum_sq / n;
+    uint32_t energy = mean_sq > (uint64_t) mean * mean ? mean_sq - (uint64_t) mean * mean : 0;
+    vad->dc = dc + mean;
+    vad->energy_q8 = Microphone_VadLog2(energy);
+    vad->zcr_permille = crossings * 1000 / n;
+
+    if (!vad->started || frame->discontinuity) {
+        vad->speech_us = 0;
+    }
+    if (!vad->started) {
+        vad->noise_q8 = vad->energy_q8;
+        vad->started = true;
+    }
+    if (vad->noise_q8 < MIC_VAD_NOISE_MIN_Q8) {
+        vad->noise_q8 = MIC_VAD_NOISE_MIN_Q8;
+    }
+
+    bool speech = vad->energy_q8 >= vad->noise_q8 + vad->threshold_q8 &&
+                  vad->zcr_permille <= vad->max_zcr_permille;
+
+    int32_t diff = vad->energy_q8 - vad->noise_q8;
+    if (diff < 0) {
+        vad->noise_q8 += diff >> MIC_VAD_NOISE_FALL_SHIFT;
+    } else {
+        vad->noise_q8 += diff >> (vad->active ? MIC_VAD_NOISE_ACTIVE_SHIFT : MIC_VAD_NOISE_RISE_SHIFT);
+    }
+
+    uint32_t frame_us = (uint64_t) n * 1000000 / vad->sample_rate;
+    int64_t end_us = frame->time_us + frame_us;
+    if (speech) {
+        vad->speech_us += frame_us;
+        vad->last_speech_us = end_us;
+    } else if (!vad->active) {
+        vad->speech_us = 0;
+    }
+
+    if (!vad->active && speech && vad->speech_us >= vad->onset_us) {
+        vad->active = true;
+        vad->starts++;
+        event = MIC_VAD_START;
+    } else if (vad->active && !speech && end_us - vad->last_speech_us >= vad->hangover_us) {
+        vad->active = false;
+        vad->speech_us = 0;
+        event = MIC_VAD_STOP;
+    }
+
+    uint32_t cycles = xthal_get_ccount() - start;
+    vad->frames++;
+    vad->active_frames += vad->active || event == MIC_VAD_STOP;
+    vad->cycles += cycles;
+    if (cycles > vad->cycles_max) {
+        vad->cycles_max = cycles;
+    }
+    return event;
+}
@@ -1,14 +1,73 @@
+#include "string.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
 #include "i2c_device.h"
 #include "mpu6886.h"
 
+#ifndef CONFIG_MPU6886_SAMPLE_RING_LEN
+#define CONFIG_MPU6886_SAMPLE_RING_LEN 128
+#endif
+#ifndef CONFIG_MPU6886_FIFO_BATCH_MS
+#define CONFIG_MPU6886_FIFO_BATCH_MS 20
+#endif
+#ifndef CONFIG_MPU6886_INT_PIN
+#define CONFIG_MPU6886_INT_PIN -1
+#endif
+#ifndef CONFIG_MPU6886_WOM_POLL_MS
+#define CONFIG_MPU6886_WOM_POLL_MS 20
+#endif
+
+/* The FIFO holds the accelerometer, temperature and gyroscope registers of each sample, in register order */
+#define MPU6886_FIFO_SIZE       1024
+#define MPU6886_FIFO_PACKET     14
+/* Packets taken per burst read, the FIFO is drained in as many bursts as needed */
+#define MPU6886_FIFO_BURST      32
+/* Internal sample rate the output data rate is divided from */
+#define MPU6886_BASE_RATE_HZ    1000
+/* Bus and scheduling delay of a FIFO read still taken as timing jitter rather than clock drift */
+#define MPU6886_READ_LATENCY_US 10000
+/* The SMPLRT_DIV of MPU6886_Init(), 166 Hz */
+#define MPU6886_SMPLRT_DIV_INIT 0x05
+/* Wake-on-motion threshold resolution */
+#define MPU6886_WOM_MG_PER_LSB  4
+/* WOM_X_INT, WOM_Y_INT and WOM_Z_INT, in INT_ENABLE and INT_STATUS */
+#define MPU6886_WOM_INT_MASK    0xE0
+
 static I2CDevice_t mpu6886_device;
 static gyro_scale_t gyro_scale = MPU6886_GFS_2000DPS;
 static acc_scale_t acc_scale = MPU6886_AFS_8G;
 static float acc_res, gyro_res;
+static bool mpu6886_ready;
+
+/* Stream and motion detect state, changed under mode_mutex, which the task holds while it empties the FIFO */
+static SemaphoreHandle_t mode_mutex;
+static xTaskHandle stream_task_handle;
+static volatile bool streaming;
+static volatile bool motion_armed;
+#if CONFIG_MPU6886_INT_PIN >= 0
+static bool intr_ready;
+static SemaphoreHandle_t motion_sem;
+#endif
+static int64_t sample_period_us;
+static int64_t last_sample_us;
+static mpu6886_stream_stats_t stream_stats;
+static MPU6886_SampleCallback_t sample_callbacks[MPU6886_MAX_SAMPLE_CALLBACKS];
+static volatile uint8_t sample_callback_count;
+
+/* Samples are only written by the MPU6886 task, readers copy them out under the mux */
+static mpu6886_sample_t sample_ring[CONFIG_MPU6886_SAMPLE_RING_LEN];
+static uint32_t sample_head;
+static portMUX_TYPE sample_mux = portMUX_INITIALIZER_UNLOCKED;
 
 static void MPU6886_I2CInit() {
     mpu6886_device = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, MPU6886_ADDRESS);
+    i2c_device_set_priority(mpu6886_device, I2C_PRIORITY_HIGH);
 }
 
 static void MPU6886_I2CReadBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *read_Buffer) {
@@ -28,6 +87,12 @@ int MPU6886_Init(void) {
     if (tempdata[0] != 0x19) {
         return -1;
     }
+    if (mode_mutex == NULL) {
+        mode_mutex = xSemaphoreCreateMutex();
+        if (mode_mutex == NULL) {
+            return -1;
+        }
+    }
     vTaskDelay(1);
 
     regdata = 0x00;
@@ -84,6 +149,7 @@ int MPU6886_Init(void) {
 
     gyro_res = MPU6886_GetGyroRes(gyro_scale);
     acc_res = MPU6886_GetAccRes(acc_scale);
+    mpu6886_ready = true;
     return 0;
 }
 
@@ -187,3 +253,446 @@ void MPU6886_GetTempData(float *t) {
     MPU6886_GetTempAdc(&temp);
     *t = (float)temp / 326.8 + 25.0;
 }
+
+static void MPU6886_WriteReg(uint8_t reg, uint8_t value, esp_err_t *err) {
+    if (*err == ESP_OK) {
+        *err = i2c_write_byte(mpu6886_device, reg, value);
+    }
+}
+
+/* Back to the power, filter and interrupt configuration of MPU6886_Init() after wake-on-motion */
+static esp_err_t MPU6886_RestoreInit(void) {
+    esp_err_t err = ESP_OK;
+    MPU6886_WriteReg(MPU6886_PWR_MGMT_1, 0x01, &err);
+    MPU6886_WriteReg(MPU6886_ACCEL_INTEL_CTRL, 0x00, &err);
+    MPU6886_WriteReg(MPU6886_PWR_MGMT_2, 0x00, &err);
+    MPU6886_WriteReg(MPU6886_ACCEL_CONFIG2, 0x00, &err);
+    MPU6886_WriteReg(MPU6886_SMPLRT_DIV, MPU6886_SMPLRT_DIV_INIT, &err);
+    MPU6886_WriteReg(MPU6886_INT_ENABLE, 0x01, &err);
+    return err;
+}
+
+/* Empties and restarts the FIFO. The next sample is one period away. */
+static esp_err_t MPU6886_ResetFifo(void) {
+    esp_err_t err = ESP_OK;
+    /* FIFO_EN and FIFO_RST */
+    MPU6886_WriteReg(MPU6886_USER_CTRL, 0x44, &err);
+    last_sample_us = esp_timer_get_time();
+    return err;
+}
+
+static void MPU6886_StoreSample(const uint8_t *packet, int64_t time_us) {
+    mpu6886_sample_t sample = { .time_us = time_us };
+    for (int i = 0; i < 3; i++) {
+        sample.accel[i] = (int16_t) ((packet[2 * i] << 8) | packet[2 * i + 1]) * acc_res;
+        sample.gyro[i] = (int16_t) ((packet[8 + 2 * i] << 8) | packet[9 + 2 * i]) * gyro_res;
+    }
+    sample.temp = (int16_t) ((packet[6] << 8) | packet[7]) / 326.8 + 25.0;
+
+    portENTER_CRITICAL(&sample_mux);
+    sample_ring[sample_head % CONFIG_MPU6886_SAMPLE_RING_LEN] = sample;
+    sample_head++;
+    portEXIT_CRITICAL(&sample_mux);
+}
+
+/* Reads everything the FIFO holds, must be called with mode_mutex taken */
+static bool MPU6886_DrainFifo(void) {
+    static uint8_t buff[MPU6886_FIFO_BURST * MPU6886_FIFO_PACKET];
+    uint8_t count_buff[2];
+
+    if (i2c_read_bytes(mpu6886_device, MPU6886_FIFO_COUNTH, count_buff, 2) != ESP_OK) {
+        stream_stats.errors++;
+        return false;
+    }
+    int64_t read_us = esp_timer_get_time();
+    uint16_t count = ((count_buff[0] & 0x1f) << 8) | count_buff[1];
+
+    /* The FIFO stops taking samples when full, and a count off the packet size means the stream lost
+     * its alignment, both lose the samples and their timing */
+    if (count + MPU6886_FIFO_PACKET > MPU6886_FIFO_SIZE || count % MPU6886_FIFO_PACKET) {
+        stream_stats.overflows++;
+        if (MPU6886_ResetFifo() != ESP_OK) {
+            stream_stats.errors++;
+        }
+        return false;
+    }
+
+    uint16_t packets = count / MPU6886_FIFO_PACKET;
+    if (packets == 0) {
+        return false;
+    }
+
+    /* The samples continue one period after the last one. The newest was taken shortly before the count
+     * was read, if it would not be the clocks drifted apart, so the timeline restarts from the read. */
+    int64_t span_us = (int64_t) (packets - 1) * sample_period_us;
+    int64_t time_us = last_sample_us + sample_period_us;
+    if (time_us + span_us > read_us || time_us + span_us < read_us - sample_period_us - MPU6886_READ_LATENCY_US) {
+        time_us = read_us - span_us;
+        if (time_us <= last_sample_us) {
+            time_us = last_sample_us + 1;
+        }
+    }
+
+    bool stored = false;
+    while (packets) {
+        uint16_t burst = packets < MPU6886_FIFO_BURST ? packets : MPU6886_FIFO_BURST;
+        /* FIFO_R_W does not advance the register address, every byte read pops the FIFO */
+        if (i2c_read_bytes(mpu6886_device, MPU6886_FIFO_R_W, buff, burst * MPU6886_FIFO_PACKET) != ESP_OK) {
+            stream_stats.errors++;
+            /* Part of the burst may have been popped */
+            MPU6886_ResetFifo();
+            return stored;
+        }
+        stream_stats.bursts++;
+        for (uint16_t i = 0; i < burst; i++) {
+            MPU6886_StoreSample(&buff[i * MPU6886_FIFO_PACKET], time_us);
+            last_sample_us = time_us;
+            time_us += sample_period_us;
+            stream_stats.samples++;
+        }
+        stored = true;
+        packets -= burst;
+    }
+    return stored;
+}
+
+#if CONFIG_MPU6886_INT_PIN >= 0
+static void IRAM_ATTR MPU6886_ISRHandler(void *arg) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    if (motion_armed) {
+        /* The line is level triggered and stays high until INT_STATUS is read by the waiting task */
+        gpio_intr_disable(CONFIG_MPU6886_INT_PIN);
+        xSemaphoreGiveFromISR(motion_sem, &higher_priority_task_woken);
+    } else if (stream_task_handle != NULL) {
+        vTaskNotifyGiveFromISR(stream_task_handle, &higher_priority_task_woken);
+    }
+    if (higher_priority_task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/* Routes the INT line to the ISR, shared by the FIFO watermark and wake-on-motion */
+static esp_err_t MPU6886_IntrInit(void) {
+    if (intr_ready) {
+        return ESP_OK;
+    }
+    motion_sem = xSemaphoreCreateBinary();
+    if (motion_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_POSEDGE,
+        .pin_bit_mask = (1ULL << CONFIG_MPU6886_INT_PIN),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = 0,
+        .pull_down_en = 1,
+    };
+    gpio_config(&io_conf);
+    gpio_install_isr_service(0);
+    gpio_isr_handler_add(CONFIG_MPU6886_INT_PIN, MPU6886_ISRHandler, NULL);
+    intr_ready = true;
+    return ESP_OK;
+}
+#endif
+
+static void MPU6886_StreamTask(void *arg) {
+    TickType_t batch_ticks = pdMS_TO_TICKS(CONFIG_MPU6886_FIFO_BATCH_MS);
+    if (batch_ticks == 0) {
+        batch_ticks = 1;
+    }
+
+    for (;;) {
+        if (!streaming) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+#if CONFIG_MPU6886_INT_PIN >= 0
+        /* Woken by the watermark interrupt, the timeout only catches a missed edge */
+        ulTaskNotifyTake(pdTRUE, 2 * batch_ticks);
+#else
+        ulTaskNotifyTake(pdTRUE, batch_ticks);
+#endif
+
+        xSemaphoreTake(mode_mutex, portMAX_DELAY);
+        bool stored = streaming && MPU6886_DrainFifo();
+        xSemaphoreGive(mode_mutex);
+
+        if (stored) {
+            for (uint8_t i = 0; i < sample_callback_count; i++) {
+                sample_callbacks[i]();
+            }
+        }
+    }
+}
+
+esp_err_t MPU6886_StartStream(uint16_t rate_hz) {
+    if (rate_hz < 4 || rate_hz > MPU6886_BASE_RATE_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!mpu6886_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mode_mutex, portMAX_DELAY);
+    if (streaming || motion_armed) {
+        xSemaphoreGive(mode_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stream_task_handle == NULL) {
+        if (xTaskCreatePinnedToCore(MPU6886_StreamTask, "MPU6886Task", 3 * 1024, NULL, 3, &stream_task_handle, 0) != pdPASS) {
+            stream_task_handle = NULL;
+            xSemaphoreGive(mode_mutex);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+#if CONFIG_MPU6886_INT_PIN >= 0
+    if (MPU6886_IntrInit() != ESP_OK) {
+        xSemaphoreGive(mode_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    uint8_t div = MPU6886_BASE_RATE_HZ / rate_hz - 1;
+    uint16_t rate = MPU6886_BASE_RATE_HZ / (div + 1);
+    /* Wake the task once per batch, but well before the FIFO could fill up */
+    uint32_t batch = rate * CONFIG_MPU6886_FIFO_BATCH_MS / 1000;
+    if (batch == 0) {
+        batch = 1;
+    } else if (batch > MPU6886_FIFO_SIZE / MPU6886_FIFO_PACKET / 2) {
+        batch = MPU6886_FIFO_SIZE / MPU6886_FIFO_PACKET / 2;
+    }
+    uint16_t watermark = batch * MPU6886_FIFO_PACKET;
+
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    stream_stats.rate_hz = rate;
+    sample_period_us = 1000000 / rate;
+
+    esp_err_t err = ESP_OK;
+    MPU6886_WriteReg(MPU6886_USER_CTRL, 0x00, &err);
+    MPU6886_WriteReg(MPU6886_SMPLRT_DIV, div, &err);
+    /* FIFO_MODE, a full FIFO keeps the oldest samples so the packets stay aligned. DLPF_CFG as set by the init. */
+    MPU6886_WriteReg(MPU6886_CONFIG, 0x41, &err);
+    MPU6886_WriteReg(MPU6886_FIFO_WM_TH1, watermark >> 8, &err);
+    MPU6886_WriteReg(MPU6886_FIFO_WM_TH2, watermark & 0xff, &err);
+#if CONFIG_MPU6886_INT_PIN >= 0
+    /* Active high push-pull, latched until any register is read, i.e. the FIFO count */
+    MPU6886_WriteReg(MPU6886_INT_PIN_CFG, 0x32, &err);
+    /* The watermark raises the interrupt by itself, the overflow one catches a late read */
+    MPU6886_WriteReg(MPU6886_INT_ENABLE, 0x10, &err);
+#endif
+    /* GYRO_FIFO_EN and ACCEL_FIFO_EN, the temperature is always included */
+    MPU6886_WriteReg(MPU6886_FIFO_EN, 0x18, &err);
+    if (err == ESP_OK) {
+        err = MPU6886_ResetFifo();
+    }
+    streaming = err == ESP_OK;
+    xSemaphoreGive(mode_mutex);
+
+    if (!streaming) {
+        return ESP_FAIL;
+    }
+    xTaskNotifyGive(stream_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t MPU6886_StopStream(void) {
+    if (mode_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mode_mutex, portMAX_DELAY);
+    if (!streaming) {
+        xSemaphoreGive(mode_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    streaming = false;
+
+    /* Back to the configuration of MPU6886_Init() */
+    esp_err_t err = ESP_OK;
+    MPU6886_WriteReg(MPU6886_FIFO_EN, 0x00, &err);
+    MPU6886_WriteReg(MPU6886_USER_CTRL, 0x04, &err);
+    MPU6886_WriteReg(MPU6886_CONFIG, 0x01, &err);
+    MPU6886_WriteReg(MPU6886_SMPLRT_DIV, MPU6886_SMPLRT_DIV_INIT, &err);
+#if CONFIG_MPU6886_INT_PIN >= 0
+    MPU6886_WriteReg(MPU6886_INT_ENABLE, 0x01, &err);
+    MPU6886_WriteReg(MPU6886_INT_PIN_CFG, 0x22, &err);
+#endif
+    if (err != ESP_OK) {
+        stream_stats.errors++;
+    }
+    xSemaphoreGive(mode_mutex);
+    return ESP_OK;
+}
+
+uint32_t MPU6886_ReadSample(uint32_t *cursor, mpu6886_sample_t *sample) {
+    uint32_t waiting;
+
+    portENTER_CRITICAL(&sample_mux);
+    if (sample_head - *cursor > CONFIG_MPU6886_SAMPLE_RING_LEN) {
+        *cursor = sample_head - CONFIG_MPU6886_SAMPLE_RING_LEN;
+    }
+    waiting = sample_head - *cursor;
+    if (waiting) {
+        *sample = sample_ring[*cursor % CONFIG_MPU6886_SAMPLE_RING_LEN];
+        (*cursor)++;
+    }
+    portEXIT_CRITICAL(&sample_mux);
+
+    return waiting;
+}
+
+esp_err_t MPU6886_AddSampleCallback(MPU6886_SampleCallback_t callback) {
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sample_callback_count == MPU6886_MAX_SAMPLE_CALLBACKS) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* The task only calls the slots below the count, so the slot is set first */
+    sample_callbacks[sample_callback_count] = callback;
+    sample_callback_count++;
+    return ESP_OK;
+}
+
+void MPU6886_GetStreamStats(mpu6886_stream_stats_t *stats) {
+    if (mode_mutex == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(mode_mutex, portMAX_DELAY);
+    *stats = stream_stats;
+    xSemaphoreGive(mode_mutex);
+}
+
+esp_err_t MPU6886_EnableMotionDetect(uint16_t threshold_mg, uint16_t rate_hz) {
+    if (threshold_mg < MPU6886_WOM_MG_PER_LSB || threshold_mg > 255 * MPU6886_WOM_MG_PER_LSB ||
+        rate_hz < 4 || rate_hz > MPU6886_BASE_RATE_HZ / 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!mpu6886_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mode_mutex, portMAX_DELAY);
+    if (streaming || motion_armed) {
+        xSemaphoreGive(mode_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+#if CONFIG_MPU6886_INT_PIN >= 0
+    if (MPU6886_IntrInit() != ESP_OK) {
+        xSemaphoreGive(mode_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    uint8_t threshold = (threshold_mg + MPU6886_WOM_MG_PER_LSB / 2) / MPU6886_WOM_MG_PER_LSB;
+    uint8_t div = MPU6886_BASE_RATE_HZ / rate_hz - 1;
+    uint8_t status;
+
+    esp_err_t err = ESP_OK;
+    /* Accelerometer running, gyroscope in standby */
+    MPU6886_WriteReg(MPU6886_PWR_MGMT_1, 0x01, &err);
+    MPU6886_WriteReg(MPU6886_PWR_MGMT_2, 0x07, &err);
+    /* ACCEL_FCHOICE_B cleared and A_DLPF_CFG 1, averaging 4 samples, as the low power mode needs */
+    MPU6886_WriteReg(MPU6886_ACCEL_CONFIG2, 0x01, &err);
+    MPU6886_WriteReg(MPU6886_INT_ENABLE, MPU6886_WOM_INT_MASK, &err);
+    MPU6886_WriteReg(MPU6886_ACCEL_WOM_X_THR, threshold, &err);
+    MPU6886_WriteReg(MPU6886_ACCEL_WOM_Y_THR, threshold, &err);
+    MPU6886_WriteReg(MPU6886_ACCEL_WOM_Z_THR, threshold, &err);
+    /* ACCEL_INTEL_EN and ACCEL_INTEL_MODE, each sample is compared with the previous one */
+    MPU6886_WriteReg(MPU6886_ACCEL_INTEL_CTRL, 0xC0, &err);
+    MPU6886_WriteReg(MPU6886_SMPLRT_DIV, div, &err);
+    /* CYCLE, the accelerometer only wakes up to take each sample */
+    MPU6886_WriteReg(MPU6886_PWR_MGMT_1, 0x21, &err);
+    /* Drops what was latched before */
+    if (err == ESP_OK) {
+        err = i2c_read_byte(mpu6886_device, MPU6886_INT_STATUS, &status);
+    }
+    if (err != ESP_OK) {
+        MPU6886_RestoreInit();
+        xSemaphoreGive(mode_mutex);
+        return ESP_FAIL;
+    }
+    motion_armed = true;
+
+#if CONFIG_MPU6886_INT_PIN >= 0
+    xSemaphoreTake(motion_sem, 0);
+    /* A level interrupt, which can also end a light sleep */
+    gpio_set_intr_type(CONFIG_MPU6886_INT_PIN, GPIO_INTR_HIGH_LEVEL);
+    gpio_wakeup_enable(CONFIG_MPU6886_INT_PIN, GPIO_INTR_HIGH_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    gpio_intr_enable(CONFIG_MPU6886_INT_PIN);
+#endif
+    xSemaphoreGive(mode_mutex);
+    return ESP_OK;
+}
+
+esp_err_t MPU6886_DisableMotionDetect(void) {
+    if (mode_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mode_mutex, portMAX_DELAY);
+    if (!motion_armed) {
+        xSemaphoreGive(mode_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    motion_armed = false;
+
+#if CONFIG_MPU6886_INT_PIN >= 0
+    gpio_wakeup_disable(CONFIG_MPU6886_INT_PIN);
+    gpio_set_intr_type(CONFIG_MPU6886_INT_PIN, GPIO_INTR_POSEDGE);
+    gpio_intr_enable(CONFIG_MPU6886_INT_PIN);
+    /* Lets a waiting task see that the detection is off */
+    xSemaphoreGive(motion_sem);
+#endif
+    esp_err_t err = MPU6886_RestoreInit();
+    xSemaphoreGive(mode_mutex);
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t MPU6886_WaitForMotion(TickType_t wait) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t poll_ticks = pdMS_TO_TICKS(CONFIG_MPU6886_WOM_POLL_MS);
+    if (poll_ticks == 0) {
+        poll_ticks = 1;
+    }
+
+    if (mode_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (;;) {
+        uint8_t status = 0;
+
+        xSemaphoreTake(mode_mutex, portMAX_DELAY);
+        if (!motion_armed) {
+            xSemaphoreGive(mode_mutex);
+            return ESP_ERR_INVALID_STATE;
+        }
+        /* Reading INT_STATUS clears the latched interrupt and releases the INT line */
+        esp_err_t err = i2c_read_byte(mpu6886_device, MPU6886_INT_STATUS, &status);
+        bool moved = err == ESP_OK && (status & MPU6886_WOM_INT_MASK);
+#if CONFIG_MPU6886_INT_PIN >= 0
+        if (!moved) {
+            gpio_intr_enable(CONFIG_MPU6886_INT_PIN);
+        }
+#endif
+        xSemaphoreGive(mode_mutex);
+
+        if (moved) {
+            return ESP_OK;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= wait) {
+            return ESP_ERR_TIMEOUT;
+        }
+#if CONFIG_MPU6886_INT_PIN >= 0
+        (void) poll_ticks;
+        xSemaphoreTake(motion_sem, wait - elapsed);
+#else
+        /* The task stays blocked between polls, so with CONFIG_PM_ENABLE the idle task can light-sleep */
+        vTaskDelay(poll_ticks < wait - elapsed ? poll_ticks : wait - elapsed);
+#endif
+    }
+}
@@ -0,0 +1,206 @@
+/*
+ * Host benchmark of the sensor paths of the core2forAWS drivers.
+ *
+ * IMU: the accelerometer and gyroscope reads of MPU6886_GetAccelData() and
+ * MPU6886_GetGyroData(), timed with the I2C transfers taking their time on the
+ * wire at 400 kHz and without, which leaves the cost of the driver stack.
+ *
+ * IMU stream: the same samples taken from the FIFO by MPU6886_StartStream()
+ * at 500 Hz, per sample on the bus.
+ *
+ * Touch: the time from the FT6336U pulsing its interrupt line to the touch
+ * callbacks of the driver, through the ISR, the FT6336U task and the read.
+ *
+ * Load: the IMU polled at 1 kHz, the battery at 100 Hz, the RTC at 10 Hz and
+ * touch reports at 100 Hz, all at once, with the I2C trace of every device.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "i2c_device.h"
+#include "i2c_trace.h"
+#include "axp192.h"
+#include "mpu6886.h"
+#include "bm8563.h"
+#include "ft6336u.h"
+
+#define IMU_READS       2000
+#define TOUCH_REPORTS   200
+#define LOAD_MS         2000
+
+static void bench_imu(bool wire_time)
+{
+    float ax, ay, az, gx, gy, gz;
+    sim_i2c_stats_t stats;
+
+    sim_set_wire_time(wire_time);
+    sim_i2c_reset_stats();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < IMU_READS; i++) {
+        MPU6886_GetAccelData(&ax, &ay, &az);
+        MPU6886_GetGyroData(&gx, &gy, &gz);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    sim_i2c_get_stats(I2C_NUM_1, &stats);
+    sim_set_wire_time(true);
+
+    printf("imu %-9s %8.1f us per sample, %6.1f us on the wire, %5.1f transactions\n",
+           wire_time ? "wire" : "cpu", (double) elapsed / IMU_READS, stats.wire_ns / 1000.0 / IMU_READS,
+           (double) stats.links / IMU_READS);
+}
+
+static void bench_imu_stream(void)
+{
+    sim_i2c_stats_t stats;
+    mpu6886_stream_stats_t stream;
+    mpu6886_sample_t sample;
+    uint32_t cursor = 0, samples = 0;
+
+    MPU6886_StartStream(500);
+    sim_i2c_reset_stats();
+    /* The ring only holds CONFIG_MPU6886_SAMPLE_RING_LEN samples, read them as they come */
+    for (int i = 0; i < 20; i++) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        while (MPU6886_ReadSample(&cursor, &sample)) {
+            samples++;
+        }
+    }
+    sim_i2c_get_stats(I2C_NUM_1, &stats);
+    MPU6886_GetStreamStats(&stream);
+    MPU6886_StopStream();
+
+    printf("imu fifo  %4u Hz   %6u samples,   %6.1f us on the wire, %5.2f transactions, %u overflows\n",
+           stream.rate_hz, samples, samples ? stats.wire_ns / 1000.0 / samples : 0.0,
+           samples ? (double) stats.links / samples : 0.0, stream.overflows);
+}
+
+static volatile int64_t touch_seen_us;
+
+static void touch_callback(void)
+{
+    touch_seen_us = esp_timer_get_time();
+}
+
+static void bench_touch(void)
+{
+    int64_t min = INT64_MAX, max = 0, total = 0;
+    uint32_t missed = 0;
+
+    for (int i = 0; i < TOUCH_REPORTS; i++) {
+        /* Alternate between two points so every report is a change */
+        sim_touch_point_t point = { .x = 100 + (i & 1) * 50, .y = 120, .id = 0 };
+        touch_seen_us = 0;
+        int64_t start = esp_timer_get_time();
+        sim_ft6336u_report(1, &point);
+        while (touch_seen_us == 0 && esp_timer_get_time() - start < 100000) {
+            vTaskDelay(0);
+        }
+        if (touch_seen_us == 0) {
+            missed++;
+            continue;
+        }
+        int64_t latency = touch_seen_us - start;
+        min = latency < min ? latency : min;
+        max = latency > max ? latency : max;
+        total += latency;
+        vTaskDelay(pdMS_TO_TICKS(2));
+    }
+    sim_ft6336u_report(0, NULL);
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    uint32_t seen = TOUCH_REPORTS - missed;
+    printf("touch to callback   %8.1f us avg, %lld us min, %lld us max, %u missed\n",
+           seen ? (double) total / seen : 0.0, (long long) (seen ? min : 0), (long long) max, missed);
+}
+
+static volatile bool load_running;
+static volatile uint32_t imu_samples;
+
+static void imu_task(void *arg)
+{
+    float ax, ay, az, gx, gy, gz;
+    TickType_t wake = xTaskGetTickCount();
+    while (load_running) {
+        MPU6886_GetAccelData(&ax, &ay, &az);
+        MPU6886_GetGyroData(&gx, &gy, &gz);
+        imu_samples++;
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(1));
+    }
+    vTaskDelete(NULL);
+}
+
+static void power_task(void *arg)
+{
+    while (load_running) {
+        Axp192_GetBatVolt();
+        Axp192_GetBatCurrent();
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    vTaskDelete(NULL);
+}
+
+static void rtc_task(void *arg)
+{
+    rtc_date_t date;
+    while (load_running) {
+        BM8563_GetTime(&date);
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    vTaskDelete(NULL);
+}
+
+static void bench_load(void)
+{
+    static i2c_trace_stats_t stats[I2C_TRACE_MAX_DEVICES];
+
+    i2c_trace_reset();
+    imu_samples = 0;
+    load_running = true;
+    xTaskCreatePinnedToCore(imu_task, "imu", 4096, NULL, 5, NULL, 1);
+    xTaskCreatePinnedToCore(power_task, "power", 4096, NULL, 3, NULL, 1);
+    xTaskCreatePinnedToCore(rtc_task, "rtc", 4096, NULL, 2, NULL, 1);
+
+    for (int i = 0; i < LOAD_MS / 10; i++) {
+        sim_touch_point_t point = { .x = 40 + i % 240, .y = 100, .id = 0 };
+        sim_ft6336u_report(1, &point);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    sim_ft6336u_report(0, NULL);
+    load_running = false;
+    vTaskDelay(pdMS_TO_TICKS(200));
+
+    printf("load for %d ms, %u IMU samples\n", LOAD_MS, imu_samples);
+    printf("%-12s %6s %6s %9s %9s %9s %9s\n", "device", "reads", "writes", "wait avg", "wait max", "xfer avg",
+           "xfer max");
+    size_t count = i2c_trace_get_stats(stats, I2C_TRACE_MAX_DEVICES);
+    for (size_t i = 0; i < count; i++) {
+        const i2c_trace_stats_t *s = &stats[i];
+        printf("I2C%d 0x%02x    %6u %6u %9llu %9u %9llu %9u\n", s->port, s->addr, s->reads, s->writes,
+               (unsigned long long) (s->wait.count ? s->wait.total_us / s->wait.count : 0), s->wait.max_us,
+               (unsigned long long) (s->transfer.count ? s->transfer.total_us / s->transfer.count : 0),
+               s->transfer.max_us);
+    }
+}
+
+int main(void)
+{
+    sim_board_init();
+    Axp192_Init();
+    MPU6886_Init();
+    BM8563_Init();
+    FT6336U_Init();
+    FT6336U_AddTouchCallback(touch_callback);
+
+    bench_imu(true);
+    bench_imu(false);
+    bench_imu_stream();
+    bench_touch();
+    bench_load();
+    return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * The Core2 for AWS board: device models on their buses and pins.
+ */
+
+#include <time.h>
+
+#include "driver/gpio.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define SIM_LCD_CS_PIN          5
+#define SIM_TOUCH_INTR_PIN      GPIO_NUM_39
+
+static bool wire_time = true;
+
+void sim_set_wire_time(bool enable) {
+    __atomic_store_n(&wire_time, enable, __ATOMIC_RELAXED);
+}
+
+bool sim_wire_time(void) {
+    return __atomic_load_n(&wire_time, __ATOMIC_RELAXED);
+}
+
+void sim_wire_wait(uint64_t ns) {
+    if (ns == 0 || !sim_wire_time()) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL };
+    nanosleep(&ts, NULL);
+}
+
+void sim_board_init(void) {
+    sim_axp192_init();
+    sim_mpu6886_init();
+    sim_bm8563_init();
+    sim_ft6336u_init();
+
+    /* The touch interrupt line idles high with its pull-up */
+    sim_gpio_drive(SIM_TOUCH_INTR_PIN, 1);
+
+    sim_spi_attach(SIM_LCD_CS_PIN, sim_ili9342c_receive, NULL);
+    sim_axp192_on_gpio4(sim_ili9342c_reset);
+}
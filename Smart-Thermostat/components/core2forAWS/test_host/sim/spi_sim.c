@@ -0,0 +1,298 @@
+/*
+ * SPI master driver of the simulated board.
+ *
+ * Every device has a thread standing in for the DMA and its interrupt: queued
+ * transactions are sent in order, each between the pre and post transaction
+ * callbacks, and then wait in the result queue. Polling and blocking transfers
+ * run on the calling thread once the queued ones are done. The bytes of every
+ * transaction go to the sink attached to the chip select pin of the device.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/spi_master.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define SIM_SPI_MAX_SINKS   4
+
+typedef struct {
+    int cs_pin;
+    sim_spi_sink_t sink;
+    void *ctx;
+} sim_spi_sink_slot_t;
+
+struct spi_device_t {
+    spi_host_device_t host;
+    spi_device_interface_config_t config;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    spi_transaction_t **ring;
+    uint32_t head;          /* Oldest transaction waiting for its result to be collected */
+    uint32_t done;          /* Sent, not collected */
+    uint32_t pending;       /* Queued, not sent */
+    bool sending;
+};
+
+static pthread_mutex_t spi_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool bus_initialized[SPI3_HOST + 1];
+static sim_spi_sink_slot_t sinks[SIM_SPI_MAX_SINKS];
+static sim_spi_stats_t stats;
+
+void sim_spi_attach(int cs_pin, sim_spi_sink_t sink, void *ctx) {
+    pthread_mutex_lock(&spi_lock);
+    for (int i = 0; i < SIM_SPI_MAX_SINKS; i++) {
+        if (sinks[i].sink == NULL || sinks[i].cs_pin == cs_pin) {
+            sinks[i].cs_pin = cs_pin;
+            sinks[i].sink = sink;
+            sinks[i].ctx = ctx;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&spi_lock);
+}
+
+void sim_spi_get_stats(sim_spi_stats_t *out) {
+    pthread_mutex_lock(&spi_lock);
+    *out = stats;
+    pthread_mutex_unlock(&spi_lock);
+}
+
+void sim_spi_reset_stats(void) {
+    pthread_mutex_lock(&spi_lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&spi_lock);
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config, int dma_chan) {
+    (void) bus_config;
+    (void) dma_chan;
+    if (host < SPI1_HOST || host > SPI3_HOST) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&spi_lock);
+    esp_err_t err = bus_initialized[host] ? ESP_ERR_INVALID_STATE : ESP_OK;
+    bus_initialized[host] = true;
+    pthread_mutex_unlock(&spi_lock);
+    return err;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host) {
+    pthread_mutex_lock(&spi_lock);
+    bus_initialized[host] = false;
+    pthread_mutex_unlock(&spi_lock);
+    return ESP_OK;
+}
+
+/* Sends one transaction to the sink of the device, on the thread of the DMA or of the caller */
+static void sim_spi_send(spi_device_handle_t dev, spi_transaction_t *trans) {
+    if (dev->config.pre_cb) {
+        dev->config.pre_cb(trans);
+    }
+
+    size_t length = (trans->length + 7) / 8;
+    const uint8_t *data = (trans->flags & SPI_TRANS_USE_TXDATA) ? trans->tx_data : trans->tx_buffer;
+    if (trans->flags & SPI_TRANS_USE_RXDATA) {
+        memset(trans->rx_data, 0, sizeof(trans->rx_data));
+    } else if (trans->rx_buffer) {
+        memset(trans->rx_buffer, 0, trans->rxlength ? (trans->rxlength + 7) / 8 : length);
+    }
+
+    pthread_mutex_lock(&spi_lock);
+    sim_spi_sink_t sink = NULL;
+    void *ctx = NULL;
+    for (int i = 0; i < SIM_SPI_MAX_SINKS; i++) {
+        if (sinks[i].sink && sinks[i].cs_pin == dev->config.spics_io_num) {
+            sink = sinks[i].sink;
+            ctx = sinks[i].ctx;
+        }
+    }
+    uint64_t bits = (uint64_t) trans->length;
+    if (trans->flags & SPI_TRANS_VARIABLE_ADDR) {
+        bits += ((spi_transaction_ext_t *) trans)->address_bits;
+    }
+    uint64_t wire_ns = dev->config.clock_speed_hz ? bits * 1000000000ULL / dev->config.clock_speed_hz : 0;
+    stats.transactions++;
+    stats.bytes += length;
+    stats.wire_ns += wire_ns;
+    pthread_mutex_unlock(&spi_lock);
+
+    if (sink && data && length) {
+        sink(data, length, ctx);
+    }
+    sim_wire_wait(wire_ns);
+
+    if (dev->config.post_cb) {
+        dev->config.post_cb(trans);
+    }
+}
+
+static void *sim_spi_dma(void *arg) {
+    spi_device_handle_t dev = arg;
+
+    pthread_mutex_lock(&dev->lock);
+    for (;;) {
+        while (dev->pending == 0) {
+            pthread_cond_wait(&dev->changed, &dev->lock);
+        }
+        spi_transaction_t *trans = dev->ring[(dev->head + dev->done) % dev->config.queue_size];
+        dev->sending = true;
+        pthread_mutex_unlock(&dev->lock);
+
+        sim_spi_send(dev, trans);
+
+        pthread_mutex_lock(&dev->lock);
+        dev->sending = false;
+        dev->pending--;
+        dev->done++;
+        pthread_cond_broadcast(&dev->changed);
+    }
+    return NULL;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle) {
+    if (host < SPI1_HOST || host > SPI3_HOST || dev_config == NULL || handle == NULL || dev_config->queue_size < 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&spi_lock);
+    bool initialized = bus_initialized[host];
+    pthread_mutex_unlock(&spi_lock);
+    if (!initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    spi_device_handle_t dev = calloc(1, sizeof(*dev));
+    if (dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->host = host;
+    dev->config = *dev_config;
+    dev->ring = calloc(dev_config->queue_size, sizeof(*dev->ring));
+    pthread_mutex_init(&dev->lock, NULL);
+    pthread_cond_init(&dev->changed, NULL);
+    pthread_create(&dev->thread, NULL, sim_spi_dma, dev);
+    pthread_detach(dev->thread);
+
+    *handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) {
+    pthread_mutex_lock(&handle->lock);
+    bool busy = handle->pending || handle->done;
+    pthread_mutex_unlock(&handle->lock);
+    if (busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_cancel(handle->thread);
+    return ESP_OK;
+}
+
+/* Waits on the device until the condition holds or the wait runs out */
+#define SIM_SPI_WAIT(dev, cond, ticks, ok)                                                  \
+    do {                                                                                    \
+        TickType_t start_ = xTaskGetTickCount();                                            \
+        ok = true;                                                                          \
+        while (!(cond)) {                                                                   \
+            if ((ticks) != portMAX_DELAY && xTaskGetTickCount() - start_ >= (ticks)) {      \
+                ok = false;                                                                 \
+                break;                                                                      \
+            }                                                                               \
+            if ((ticks) == portMAX_DELAY) {                                                 \
+                pthread_cond_wait(&(dev)->changed, &(dev)->lock);                           \
+            } else {                                                                        \
+                pthread_mutex_unlock(&(dev)->lock);                                         \
+                sim_yield();                                                                \
+                pthread_mutex_lock(&(dev)->lock);                                           \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait) {
+    if (handle == NULL || trans_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool ok;
+
+    pthread_mutex_lock(&handle->lock);
+    SIM_SPI_WAIT(handle, handle->pending + handle->done < (uint32_t) handle->config.queue_size, ticks_to_wait, ok);
+    if (ok) {
+        handle->ring[(handle->head + handle->done + handle->pending) % handle->config.queue_size] = trans_desc;
+        handle->pending++;
+        pthread_cond_broadcast(&handle->changed);
+    }
+    pthread_mutex_unlock(&handle->lock);
+
+    if (ok) {
+        pthread_mutex_lock(&spi_lock);
+        stats.queued++;
+        pthread_mutex_unlock(&spi_lock);
+    }
+    return ok ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                      TickType_t ticks_to_wait) {
+    if (handle == NULL || trans_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool ok;
+
+    pthread_mutex_lock(&handle->lock);
+    SIM_SPI_WAIT(handle, handle->done > 0, ticks_to_wait, ok);
+    if (ok) {
+        *trans_desc = handle->ring[handle->head];
+        handle->head = (handle->head + 1) % handle->config.queue_size;
+        handle->done--;
+        pthread_cond_broadcast(&handle->changed);
+    }
+    pthread_mutex_unlock(&handle->lock);
+    return ok ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spi_device_polling_start(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait) {
+    if (handle == NULL || trans_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool ok;
+
+    /* Like the driver, a polling transfer may not start while queued ones are still being sent */
+    pthread_mutex_lock(&handle->lock);
+    SIM_SPI_WAIT(handle, handle->pending == 0 && !handle->sending, ticks_to_wait, ok);
+    pthread_mutex_unlock(&handle->lock);
+    if (!ok) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    sim_spi_send(handle, trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_end(spi_device_handle_t handle, TickType_t ticks_to_wait) {
+    (void) handle;
+    (void) ticks_to_wait;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc) {
+    return spi_device_polling_start(handle, trans_desc, portMAX_DELAY);
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc) {
+    return spi_device_polling_start(handle, trans_desc, portMAX_DELAY);
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait) {
+    (void) device;
+    (void) wait;
+    return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t dev) {
+    (void) dev;
+}
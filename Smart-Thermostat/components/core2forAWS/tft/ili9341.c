@@ -11,6 +11,7 @@
 #include "freertos/semphr.h"
 #include "ili9341.h"
 #include "disp_spi.h"
+#include "disp_profiler.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "axp192.h"
@@ -35,10 +36,11 @@ typedef struct {
  *  STATIC PROTOTYPES
  **********************/
 static void ili9341_set_orientation(uint8_t orientation);
+static void ili9341_queue_window(const lv_area_t * area);
 
 static void ili9341_send_cmd(uint8_t cmd);
-static void ili9341_send_data(void * data, uint16_t length);
-static void ili9341_send_color(void * data, uint16_t length);
+static void ili9341_send_data(void * data, size_t length);
+static void ili9341_send_color(void * data, size_t length);
 
 /**********************
  *  STATIC VARIABLES
@@ -110,33 +112,31 @@ void ili9341_init(void)
 
 void ili9341_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map)
 {
-	uint8_t data[4];
-
-	/*Column addresses*/
-	ili9341_send_cmd(0x2A);
-	data[0] = (area->x1 >> 8) & 0xFF;
-	data[1] = area->x1 & 0xFF;
-	data[2] = (area->x2 >> 8) & 0xFF;
-	data[3] = area->x2 & 0xFF;
-	ili9341_send_data(data, 4);
-
-	/*Page addresses*/
-	ili9341_send_cmd(0x2B);
-	data[0] = (area->y1 >> 8) & 0xFF;
-	data[1] = area->y1 & 0xFF;
-	data[2] = (area->y2 >> 8) & 0xFF;
-	data[3] = area->y2 & 0xFF;
-	ili9341_send_data(data, 4);
-
-	/*Memory write*/
-	ili9341_send_cmd(0x2C);
+#if CONFIG_LV_DISP_PROFILER
+	DispProfiler_FlushStart();
+#endif
 
+	/* The whole window update is queued at once; parameters of up to 4 bytes are
+	 * copied into the transactions and the pixels stay owned by LVGL until the
+	 * last transaction signals lv_disp_flush_ready() */
+	ili9341_queue_window(area);
 
 	uint32_t size = lv_area_get_width(area) * lv_area_get_height(area);
 
 	ili9341_send_color((void*)color_map, size * 2);
 }
 
+void ili9341_write_window(const lv_area_t * area, const lv_color_t * pixels, uint16_t stride, bool signal_flush)
+{
+	ili9341_queue_window(area);
+
+	/* Memory writes continue on the next row of the window, so the rows are
+	 * sent back to back without new commands */
+	disp_spi_queue_rows((const uint8_t *) pixels, lv_area_get_width(area) * sizeof(lv_color_t),
+		stride * sizeof(lv_color_t), lv_area_get_height(area),
+		signal_flush ? DISP_SPI_SEND_QUEUED | DISP_SPI_SIGNAL_FLUSH : DISP_SPI_SEND_QUEUED);
+}
+
 void ili9341_sleep_in()
 {
 	uint8_t data[] = {0x08};
@@ -156,24 +156,44 @@ void ili9341_sleep_out()
  **********************/
 
 
+/* Queues the column and page addresses of the window followed by a memory write */
+static void ili9341_queue_window(const lv_area_t * area)
+{
+	uint8_t data[4];
+
+	/*Column addresses*/
+	disp_spi_queue_cmd(0x2A);
+	data[0] = (area->x1 >> 8) & 0xFF;
+	data[1] = area->x1 & 0xFF;
+	data[2] = (area->x2 >> 8) & 0xFF;
+	data[3] = area->x2 & 0xFF;
+	disp_spi_queue_data(data, 4);
+
+	/*Page addresses*/
+	disp_spi_queue_cmd(0x2B);
+	data[0] = (area->y1 >> 8) & 0xFF;
+	data[1] = area->y1 & 0xFF;
+	data[2] = (area->y2 >> 8) & 0xFF;
+	data[3] = area->y2 & 0xFF;
+	disp_spi_queue_data(data, 4);
+
+	/*Memory write*/
+	disp_spi_queue_cmd(0x2C);
+}
+
 static void ili9341_send_cmd(uint8_t cmd)
 {
-    disp_wait_for_pending_transactions();
-    gpio_set_level(ILI9341_DC, 0);	 /*Command mode*/
-    disp_spi_send_data(&cmd, 1);
+    /* D/C is driven from the transaction flags in the SPI pre-transfer callback */
+    disp_spi_transaction(&cmd, 1, DISP_SPI_SEND_POLLING | DISP_SPI_SEND_CMD, NULL, 0);
 }
 
-static void ili9341_send_data(void * data, uint16_t length)
+static void ili9341_send_data(void * data, size_t length)
 {
-    disp_wait_for_pending_transactions();
-    gpio_set_level(ILI9341_DC, 1);	 /*Data mode*/
     disp_spi_send_data(data, length);
 }
 
-static void ili9341_send_color(void * data, uint16_t length)
+static void ili9341_send_color(void * data, size_t length)
 {
-    disp_wait_for_pending_transactions();
-    gpio_set_level(ILI9341_DC, 1);   /*Data mode*/
     disp_spi_send_colors(data, length);
 }
 
@@ -0,0 +1,257 @@
+/**
+ * @file img_rle.c
+ *
+ */
+
+#include <string.h>
+
+#include "esp_heap_caps.h"
+
+#include "img_rle.h"
+
+#ifndef CONFIG_LV_IMG_RLE_DECODE_WHOLE_KB
+#define CONFIG_LV_IMG_RLE_DECODE_WHOLE_KB 160
+#endif
+#ifndef CONFIG_LV_IMG_RLE_CACHE_KB
+#define CONFIG_LV_IMG_RLE_CACHE_KB 256
+#endif
+
+#define IMG_RLE_CACHE_ENTRIES   8
+
+/* Decoded images kept after their last close, so opening them again is a lookup */
+typedef struct {
+    const void *src;
+    uint8_t *pixels;
+    size_t size;
+    uint16_t refs;
+    uint32_t last_use;
+} rle_cached_t;
+
+static rle_cached_t rle_cache[IMG_RLE_CACHE_ENTRIES];
+static size_t rle_cache_size;
+static uint32_t rle_cache_clock;
+
+/* Images img_rle.py left unencoded keep their own color format and are refused here, so
+ * LVGL's built-in decoder draws them and encoded and plain images can be mixed */
+static const uint8_t *rle_data(const void *src) {
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_VARIABLE) {
+        return NULL;
+    }
+
+    const lv_img_dsc_t *img = src;
+    if (img->header.cf != LV_IMG_CF_USER_ENCODED_0 || img->data_size < IMG_RLE_HEADER_SIZE
+        || img->data[0] != IMG_RLE_VERSION) {
+        return NULL;
+    }
+    /* The line offsets must be there before rle_decode_line() follows them */
+    if (lv_img_cf_get_px_size(img->data[1]) < 8
+        || img->data_size < IMG_RLE_HEADER_SIZE + (uint32_t) img->header.h * 4) {
+        return NULL;
+    }
+    return img->data;
+}
+
+static inline uint32_t rle_line_offset(const uint8_t *data, lv_coord_t y) {
+    const uint8_t *p = data + IMG_RLE_HEADER_SIZE + y * 4;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Decodes len pixels of line y starting at x */
+static void rle_decode_line(const uint8_t *data, uint8_t px_size, lv_coord_t x, lv_coord_t y, lv_coord_t len,
+                            uint8_t *buf) {
+    const uint8_t *p = data + rle_line_offset(data, y);
+    uint32_t skip = x;
+
+    while (len > 0) {
+        uint8_t ctrl = *p++;
+        uint32_t count;
+        bool run = ctrl >= 0x80;
+
+        if (run) {
+            count = ctrl - 0x7F;
+        } else {
+            count = ctrl + 1;
+        }
+
+        /* Skip the packets left of x */
+        if (skip >= count) {
+            skip -= count;
+            p += run ? px_size : count * px_size;
+            continue;
+        }
+
+        count -= skip;
+        if (count > (uint32_t) len) {
+            count = len;
+        }
+        len -= count;
+
+        if (run) {
+            if (px_size == 2) {
+                uint8_t b0 = p[0], b1 = p[1];
+                for (uint32_t i = 0; i < count; i++) {
+                    buf[0] = b0;
+                    buf[1] = b1;
+                    buf += 2;
+                }
+            } else {
+                for (uint32_t i = 0; i < count; i++) {
+                    memcpy(buf, p, px_size);
+                    buf += px_size;
+                }
+            }
+            p += px_size;
+        } else {
+            memcpy(buf, p + skip * px_size, count * px_size);
+            buf += count * px_size;
+            p += (skip + count) * px_size;
+        }
+        skip = 0;
+    }
+}
+
+static void rle_cache_evict(rle_cached_t *entry) {
+    heap_caps_free(entry->pixels);
+    rle_cache_size -= entry->size;
+    memset(entry, 0, sizeof(*entry));
+}
+
+/* Returns the entry holding src, or a free entry with room for size bytes after evicting the least
+ * recently used images nobody has open, or NULL when the image cannot be cached */
+static rle_cached_t *rle_cache_get(const void *src, size_t size) {
+    rle_cached_t *free_entry = NULL;
+
+    for (int i = 0; i < IMG_RLE_CACHE_ENTRIES; i++) {
+        if (rle_cache[i].src == src && rle_cache[i].pixels != NULL) {
+            return &rle_cache[i];
+        }
+        if (free_entry == NULL && rle_cache[i].pixels == NULL) {
+            free_entry = &rle_cache[i];
+        }
+    }
+    if (size > CONFIG_LV_IMG_RLE_CACHE_KB * 1024) {
+        return NULL;
+    }
+
+    while (free_entry == NULL || rle_cache_size + size > CONFIG_LV_IMG_RLE_CACHE_KB * 1024) {
+        rle_cached_t *oldest = NULL;
+        for (int i = 0; i < IMG_RLE_CACHE_ENTRIES; i++) {
+            if (rle_cache[i].pixels != NULL && rle_cache[i].refs == 0
+                && (oldest == NULL || rle_cache[i].last_use < oldest->last_use)) {
+                oldest = &rle_cache[i];
+            }
+        }
+        if (oldest == NULL) {
+            return NULL;
+        }
+        rle_cache_evict(oldest);
+        if (free_entry == NULL) {
+            free_entry = oldest;
+        }
+    }
+    return free_entry;
+}
+
+static lv_res_t rle_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header) {
+    (void) decoder;
+
+    const uint8_t *data = rle_data(src);
+    if (data == NULL) {
+        return LV_RES_INV;
+    }
+
+    /* Report the decoded format, it tells the drawing code how to interpret the pixels */
+    *header = ((const lv_img_dsc_t *) src)->header;
+    header->cf = data[1];
+    return LV_RES_OK;
+}
+
+static lv_res_t rle_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc) {
+    (void) decoder;
+
+    const uint8_t *data = rle_data(dsc->src);
+    if (data == NULL) {
+        return LV_RES_INV;
+    }
+
+    if (data[2] != LV_COLOR_DEPTH || data[3] != LV_COLOR_16_SWAP) {
+        dsc->error_msg = "RLE color depth";
+        return LV_RES_OK;
+    }
+
+    uint8_t px_size = lv_img_cf_get_px_size(dsc->header.cf) >> 3;
+    size_t size = (size_t) dsc->header.w * dsc->header.h * px_size;
+    if (size > CONFIG_LV_IMG_RLE_DECODE_WHOLE_KB * 1024) {
+        /* Decoded line by line by rle_read_line() */
+        return LV_RES_OK;
+    }
+
+    rle_cached_t *entry = rle_cache_get(dsc->src, size);
+    if (entry != NULL && entry->pixels != NULL) {
+        entry->refs++;
+        entry->last_use = ++rle_cache_clock;
+        dsc->img_data = entry->pixels;
+        return LV_RES_OK;
+    }
+
+    /* Decoded images are large and read sequentially, PSRAM suits them */
+    uint8_t *pixels = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (pixels == NULL) {
+        pixels = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    if (pixels == NULL) {
+        LV_LOG_WARN("Not enough memory to decode the whole image, decoding by line");
+        return LV_RES_OK;
+    }
+
+    for (lv_coord_t y = 0; y < dsc->header.h; y++) {
+        rle_decode_line(data, px_size, 0, y, dsc->header.w, pixels + (size_t) y * dsc->header.w * px_size);
+    }
+    if (entry != NULL) {
+        entry->src = dsc->src;
+        entry->pixels = pixels;
+        entry->size = size;
+        entry->refs = 1;
+        entry->last_use = ++rle_cache_clock;
+        rle_cache_size += size;
+    }
+    dsc->img_data = pixels;
+    return LV_RES_OK;
+}
+
+static lv_res_t rle_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc, lv_coord_t x, lv_coord_t y,
+                              lv_coord_t len, uint8_t *buf) {
+    (void) decoder;
+
+    const uint8_t *data = ((const lv_img_dsc_t *) dsc->src)->data;
+    rle_decode_line(data, lv_img_cf_get_px_size(dsc->header.cf) >> 3, x, y, len, buf);
+    return LV_RES_OK;
+}
+
+static void rle_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc) {
+    (void) decoder;
+
+    if (dsc->img_data == NULL) {
+        return;
+    }
+    for (int i = 0; i < IMG_RLE_CACHE_ENTRIES; i++) {
+        if (rle_cache[i].pixels == dsc->img_data) {
+            /* Stays decoded until rle_cache_get() needs the room */
+            rle_cache[i].refs--;
+            dsc->img_data = NULL;
+            return;
+        }
+    }
+    heap_caps_free((void *) dsc->img_data);
+    dsc->img_data = NULL;
+}
+
+void ImgRle_Init(void) {
+    lv_img_decoder_t *decoder = lv_img_decoder_create();
+    LV_ASSERT_MEM(decoder);
+
+    lv_img_decoder_set_info_cb(decoder, rle_info);
+    lv_img_decoder_set_open_cb(decoder, rle_open);
+    lv_img_decoder_set_read_line_cb(decoder, rle_read_line);
+    lv_img_decoder_set_close_cb(decoder, rle_close);
+}
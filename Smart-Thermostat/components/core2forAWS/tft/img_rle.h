@@ -0,0 +1,61 @@
+/**
+ * @file img_rle.h
+ * @brief LVGL image decoder for run-length encoded images.
+ *
+ * tft/tools/img_rle.py converts the C arrays of the LVGL image converter
+ * into run-length encoded images with the LV_IMG_CF_USER_ENCODED_0 color
+ * format. They are used like any other image:
+ * @code{c}
+ *  LV_IMG_DECLARE(house_on);
+ *  lv_img_set_src(img, &house_on);
+ * @endcode
+ * Images the encoding would not make smaller are written unencoded in
+ * their own color format and drawn by LVGL's built-in decoder.
+ *
+ * Encoded data layout (little endian):
+ *  - 4 byte header: format version, decoded color format, LV_COLOR_DEPTH
+ *    and LV_COLOR_16_SWAP the pixels were encoded for,
+ *  - a 32 bit offset of every line, counted from the start of the data,
+ *  - the lines as packets. A control byte below 0x80 is followed by
+ *    control + 1 literal pixels, a control byte of 0x80 or above by one
+ *    pixel repeated control - 0x7F times. Packets never cross lines.
+ *
+ * Pixels are stored in the decoded color format, i.e. LV_COLOR_SIZE / 8
+ * bytes, followed by an alpha byte for LV_IMG_CF_TRUE_COLOR_ALPHA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+
+/**
+ * @brief Version of the encoded data layout.
+ */
+#define IMG_RLE_VERSION         1
+
+/**
+ * @brief Size of the encoded data header.
+ */
+#define IMG_RLE_HEADER_SIZE     4
+
+/**
+ * @brief Registers the decoder with LVGL.
+ *
+ * Images up to CONFIG_LV_IMG_RLE_DECODE_WHOLE_KB are decoded entirely
+ * when opened, so an image kept open by lv_img_cache is drawn straight
+ * from RAM afterwards. Larger images are decoded line by line while
+ * they are drawn. Size LV_IMG_CACHE_DEF_SIZE to the number of images
+ * shown at once to keep them decoded.
+ *
+ * Decoded images also stay decoded after they are closed, up to
+ * CONFIG_LV_IMG_RLE_CACHE_KB in total, so an image lv_img_cache dropped
+ * is not decoded again when it is opened next.
+ *
+ * @note Core2ForAWS_Display_Init() calls this function when
+ * CONFIG_LV_IMG_RLE_DECODER is enabled.
+ */
+/* @[declare_imgrle_init] */
+void ImgRle_Init(void);
+/* @[declare_imgrle_init] */
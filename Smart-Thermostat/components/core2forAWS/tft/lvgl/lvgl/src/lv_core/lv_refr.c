@@ -29,6 +29,16 @@
 /* Draw translucent random colored areas on the invalidated (redrawn) areas*/
 #define MASK_AREA_DEBUG 0
 
+/*Profiling hooks, see `lv_conf_kconfig.h`*/
+#ifndef LV_REFR_PROFILE_FRAME_BEGIN
+#define LV_REFR_PROFILE_FRAME_BEGIN()
+#define LV_REFR_PROFILE_FRAME_END(px)
+#define LV_REFR_PROFILE_AREA_BEGIN()
+#define LV_REFR_PROFILE_AREA_END()
+#define LV_REFR_PROFILE_FLUSH_WAIT_BEGIN()
+#define LV_REFR_PROFILE_FLUSH_WAIT_END()
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -194,6 +204,8 @@ void _lv_disp_refr_task(lv_task_t * task)
         return;
     }
 
+    LV_REFR_PROFILE_FRAME_BEGIN();
+
     lv_refr_join_area();
 
     lv_refr_areas();
@@ -264,6 +276,7 @@ void _lv_disp_refr_task(lv_task_t * task)
         disp_refr->inv_p = 0;
 
         elaps = lv_tick_elaps(start);
+        LV_REFR_PROFILE_FRAME_END(px_num);
         /*Call monitor cb if present*/
         if(disp_refr->driver.monitor_cb) {
             disp_refr->driver.monitor_cb(&disp_refr->driver, elaps, px_num);
@@ -397,7 +410,9 @@ static void lv_refr_areas(void)
 
             if(i == last_i) disp_refr->driver.buffer->last_area = 1;
             disp_refr->driver.buffer->last_part = 0;
+            LV_REFR_PROFILE_AREA_BEGIN();
             lv_refr_area(&disp_refr->inv_areas[i]);
+            LV_REFR_PROFILE_AREA_END();
 
             px_num += lv_area_get_size(&disp_refr->inv_areas[i]);
         }
@@ -503,9 +518,11 @@ static void lv_refr_area_part(const lv_area_t * area_p)
     /*In non double buffered mode, before rendering the next part wait until the previous image is
      * flushed*/
     if(lv_disp_is_double_buf(disp_refr) == false) {
+        LV_REFR_PROFILE_FLUSH_WAIT_BEGIN();
         while(vdb->flushing) {
             if(disp_refr->driver.wait_cb) disp_refr->driver.wait_cb(&disp_refr->driver);
         }
+        LV_REFR_PROFILE_FLUSH_WAIT_END();
     }
 
     lv_obj_t * top_act_scr = NULL;
@@ -898,9 +915,11 @@ static void lv_refr_vdb_rotate(lv_area_t * area, lv_color_t * color_p)
             /*Flush the completed area to the display*/
             drv->flush_cb(drv, area, rot_buf == NULL ? color_p : rot_buf);
             /*FIXME: Rotation forces legacy behavior where rendering and flushing are done serially*/
+            LV_REFR_PROFILE_FLUSH_WAIT_BEGIN();
             while(vdb->flushing) {
                 if(drv->wait_cb) drv->wait_cb(drv);
             }
+            LV_REFR_PROFILE_FLUSH_WAIT_END();
             color_p += area_w * height;
             row += height;
         }
@@ -921,9 +940,11 @@ static void lv_refr_vdb_flush(void)
     /*In double buffered mode wait until the other buffer is flushed before flushing the current
      * one*/
     if(lv_disp_is_double_buf(disp_refr)) {
+        LV_REFR_PROFILE_FLUSH_WAIT_BEGIN();
         while(vdb->flushing) {
             if(disp_refr->driver.wait_cb) disp_refr->driver.wait_cb(&disp_refr->driver);
         }
+        LV_REFR_PROFILE_FLUSH_WAIT_END();
     }
 
     vdb->flushing = 1;
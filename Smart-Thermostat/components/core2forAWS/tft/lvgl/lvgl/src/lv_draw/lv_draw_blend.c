@@ -7,6 +7,7 @@
  *      INCLUDES
  *********************/
 #include "lv_draw_blend.h"
+#include "lv_draw_blend_rgb565.h"
 #include "lv_img_decoder.h"
 #include "../lv_misc/lv_math.h"
 #include "../lv_hal/lv_hal_disp.h"
@@ -404,6 +405,10 @@ LV_ATTRIBUTE_FAST_MEM static void fill_normal(const lv_area_t * disp_area, lv_co
 
                 return;
             }
+#endif
+#if LV_DRAW_BLEND_RGB565
+            _lv_blend_rgb565_fill_opa(disp_buf_first, disp_w, draw_area_w, draw_area_h, color, opa);
+            return;
 #endif
             lv_color_t last_dest_color = LV_COLOR_BLACK;
             lv_color_t last_res_color = lv_color_mix(color, last_dest_color, opa);
@@ -791,6 +796,10 @@ LV_ATTRIBUTE_FAST_MEM static void map_normal(const lv_area_t * disp_area, lv_col
 #endif
 
             /*Software rendering*/
+#if LV_DRAW_BLEND_RGB565
+            _lv_blend_rgb565_map_copy(disp_buf_first, disp_w, map_buf_first, map_w, draw_area_w, draw_area_h);
+            return;
+#endif
             for(y = 0; y < draw_area_h; y++) {
                 _lv_memcpy(disp_buf_first, map_buf_first, draw_area_w * sizeof(lv_color_t));
                 disp_buf_first += disp_w;
@@ -841,6 +850,10 @@ LV_ATTRIBUTE_FAST_MEM static void map_normal(const lv_area_t * disp_area, lv_col
 #endif
 
             /*Software rendering*/
+#if LV_DRAW_BLEND_RGB565
+            _lv_blend_rgb565_map_opa(disp_buf_first, disp_w, map_buf_first, map_w, draw_area_w, draw_area_h, opa);
+            return;
+#endif
 
             for(y = 0; y < draw_area_h; y++) {
                 for(x = 0; x < draw_area_w; x++) {
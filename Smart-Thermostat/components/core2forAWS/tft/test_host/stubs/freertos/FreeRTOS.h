@@ -0,0 +1,12 @@
+/* Host stand-in for the FreeRTOS critical sections, the host tests are single threaded */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void) (mux))
+#define portEXIT_CRITICAL(mux)          ((void) (mux))
@@ -0,0 +1,34 @@
+/*
+
+  ESP32 FFT, fixed-point
+  ======================
+
+  A Q15 real FFT for 16-bit samples, such as the ones the I2S microphone
+  delivers, next to the float implementation of fft.h. The transform runs in
+  place with mixed radix-4/radix-2 stages and block floating point scaling:
+  every stage checks the headroom of the whole block and scales it down only
+  when its outputs could overflow, so quiet signals keep their resolution.
+
+  Results come with a block exponent. The spectrum of the samples is
+  data * 2^exponent, and its power is power * 4^exponent.
+
+*/
+#ifndef __FFT_Q15_H__
+#define __FFT_Q15_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+  int size;  // FFT size, number of real samples
+  int16_t *twiddle_factors;  // Q15 cos/sin pairs of W_size^k
+  unsigned short *bit_reversal; // pairs of indices swapped before the first stage
+  int bit_reversal_pairs; // number of pairs in bit_reversal
+} fft_q15_config_t;
+
+fft_q15_config_t *fft_q15_init(int size);
+void fft_q15_destroy(fft_q15_config_t *config);
+int rfft_q15(fft_q15_config_t *config, int16_t *data);
+int rfft_q15_power(fft_q15_config_t *config, int16_t *data, uint32_t *power);
+
+#endif // __FFT_Q15_H__
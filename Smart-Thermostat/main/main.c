@@ -49,7 +49,7 @@
 #include "core2forAWS.h"
 
 #include "wifi.h"
-#include "fft.h"
+#include "fft_q15.h"
 #include "ui.h"
 
 static const char *TAG = "MAIN";
@@ -68,6 +68,13 @@ static const char *TAG = "MAIN";
 
 #define MAX_LENGTH_OF_UPDATE_JSON_BUFFER 200
 
+// Without changes the shadow is only updated this often
+#define SHADOW_HEARTBEAT_MS 60000
+// Sound level changes smaller than this are not worth an update
+#define SOUND_REPORT_DELTA 8
+// Temperature changes in degrees F smaller than this are not worth an update
+#define TEMPERATURE_REPORT_DELTA 0.5f
+
 /* CA Root certificate */
 extern const uint8_t aws_root_ca_pem_start[] asm("_binary_aws_root_ca_pem_start");
 extern const uint8_t aws_root_ca_pem_end[] asm("_binary_aws_root_ca_pem_end");
@@ -113,6 +120,8 @@ void disconnect_callback_handler(AWS_IoT_Client *pClient, void *data) {
 }
 
 static bool shadowUpdateInProgress;
+// A delta changed a reported value
+static bool shadowReportPending;
 
 void ShadowUpdateStatusCallback(const char *pThingName, ShadowActions_t action, Shadow_Ack_Status_t status,
                                 const char *pReceivedJsonDocument, void *pContextData) {
@@ -141,6 +150,7 @@ void hvac_Callback(const char *pJsonString, uint32_t JsonStringDataLen, jsonStru
     if(pContext != NULL) {
         ESP_LOGI(TAG, "Delta - hvacStatus state changed to %s", status);
     }
+    shadowReportPending = true;
 
     if(strcmp(status, HEATING) == 0) {
         ESP_LOGI(TAG, "setting side LEDs to red");
@@ -166,10 +176,12 @@ void occupancy_Callback(const char *pJsonString, uint32_t JsonStringDataLen, jso
     if(pContext != NULL) {
         ESP_LOGI(TAG, "Delta - roomOccupancy state changed to %d", *(bool *) (pContext->pData));
     }
+    shadowReportPending = true;
 }
 
 float temperature = STARTING_ROOMTEMPERATURE;
 uint8_t soundBuffer = STARTING_SOUNDLEVEL;
+bool soundActive = false;
 uint8_t reportedSound = STARTING_SOUNDLEVEL;
 char hvacStatus[7] = STARTING_HVACSTATUS;
 bool roomOccupancy = STARTING_ROOMOCCUPANCY;
@@ -184,37 +196,67 @@ long map(long x, long in_min, long in_max, long out_min, long out_max) {
 }
 
 void microphone_task(void *arg) {
-    static int8_t i2s_readraw_buff[1024];
-    size_t bytesread;
-    int16_t *buffptr;
+    static int16_t samples[512];
+    const mic_frame_t *frame;
+    mic_subscriber_t subscriber;
+    mic_vad_t vad;
     double data = 0;
 
-    Microphone_Init();
+    mic_capture_config_t mic_config = { .sample_rate = 44100, .frame_samples = 512 };
+    if (Microphone_StartCapture(&mic_config) != ESP_OK || Microphone_Subscribe(2, &subscriber) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the microphone capture.");
+        vTaskDelete(NULL);
+    }
+    Microphone_VadInit(&vad, mic_config.sample_rate);
     uint8_t maxSound = 0x00;
-    uint8_t currentSound = 0x00;
+
+    // Prepared once, the loop below transforms the raw samples in place without allocating.
+    static uint32_t power[512 / 2 + 1];
+    fft_q15_config_t *real_fft_plan = fft_q15_init(512);
+    if (real_fft_plan == NULL) {
+        ESP_LOGE(TAG, "Failed to prepare the FFT plan.");
+        vTaskDelete(NULL);
+    }
 
     for (;;) {
-        maxSound = 0x00;
-        fft_config_t *real_fft_plan = fft_init(512, FFT_REAL, FFT_FORWARD, NULL, NULL);
-        i2s_read(I2S_NUM_0, (char *)i2s_readraw_buff, 1024, &bytesread, pdMS_TO_TICKS(100));
-        buffptr = (int16_t *)i2s_readraw_buff;
-        for (uint16_t count_n = 0; count_n < real_fft_plan->size; count_n++) {
-            real_fft_plan->input[count_n] = (float)map(buffptr[count_n], INT16_MIN, INT16_MAX, -1000, 1000);
+        if (Microphone_ReceiveFrame(subscriber, &frame, pdMS_TO_TICKS(100)) != ESP_OK) {
+            continue;
+        }
+        // Only frames with sound in them are worth a transform, silence reports 0
+        mic_vad_event_t event = Microphone_VadProcess(&vad, frame);
+        if (event != MIC_VAD_NONE) {
+            ESP_LOGI(TAG, "Sound %s", event == MIC_VAD_START ? "started" : "stopped");
         }
-        fft_execute(real_fft_plan);
+        if (!vad.active) {
+            Microphone_ReleaseFrame(frame);
+            if (event == MIC_VAD_STOP) {
+                xSemaphoreTake(xMaxNoiseSemaphore, portMAX_DELAY);
+                soundBuffer = 0;
+                soundActive = false;
+                xSemaphoreGive(xMaxNoiseSemaphore);
+            }
+            continue;
+        }
+        // The transform works in place and frames are shared, so it gets a copy
+        memcpy(samples, frame->samples, sizeof(samples));
+        Microphone_ReleaseFrame(frame);
+        int exponent = rfft_q15_power(real_fft_plan, samples, power);
 
+        // The loudest frequency decides, a single square root for the frame
+        uint32_t maxPower = 0;
         for (uint16_t count_n = 1; count_n < AUDIO_TIME_SLICES; count_n++) {
-            data = sqrt(real_fft_plan->output[2 * count_n] * real_fft_plan->output[2 * count_n] + real_fft_plan->output[2 * count_n + 1] * real_fft_plan->output[2 * count_n + 1]);
-            currentSound = map(data, 0, 2000, 0, 256);
-            if(currentSound > maxSound) {
-                maxSound = currentSound;
+            if(power[count_n] > maxPower) {
+                maxPower = power[count_n];
             }
         }
-        fft_destroy(real_fft_plan);
+        // Magnitude in the scale of the samples mapped to -1000..1000
+        data = ldexp(sqrt(maxPower), exponent) * 2000 / 65535;
+        maxSound = map(data, 0, 2000, 0, 256);
 
         // store max of sample in semaphore
         xSemaphoreTake(xMaxNoiseSemaphore, portMAX_DELAY);
         soundBuffer = maxSound;
+        soundActive = true;
         xSemaphoreGive(xMaxNoiseSemaphore);
     }
 }
@@ -328,6 +370,12 @@ void aws_iot_task(void *param) {
         ESP_LOGE(TAG, "Shadow Register Delta Error");
     }
 
+    float publishedTemperature = STARTING_ROOMTEMPERATURE;
+    uint8_t publishedSound = STARTING_SOUNDLEVEL;
+    bool publishedActive = false;
+    TickType_t publishedTicks = 0;
+    bool published = false;
+
     // loop and publish changes
     while(NETWORK_ATTEMPTING_RECONNECT == rc || NETWORK_RECONNECTED == rc || SUCCESS == rc) {
         rc = aws_iot_shadow_yield(&iotCoreClient, 200);
@@ -346,10 +394,20 @@ void aws_iot_task(void *param) {
         // sample from soundBuffer (latest reading from microphone)
         xSemaphoreTake(xMaxNoiseSemaphore, portMAX_DELAY);
         reportedSound = soundBuffer;
+        bool active = soundActive;
         xSemaphoreGive(xMaxNoiseSemaphore);
 
         // END get sensor readings
 
+        // Skip the update when nothing changed, a silent room only sends the heartbeat
+        bool changed = !published || shadowReportPending || active != publishedActive ||
+                       abs(reportedSound - publishedSound) >= SOUND_REPORT_DELTA ||
+                       fabsf(temperature - publishedTemperature) >= TEMPERATURE_REPORT_DELTA;
+        if(!changed && xTaskGetTickCount() - publishedTicks < pdMS_TO_TICKS(SHADOW_HEARTBEAT_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+
         ESP_LOGI(TAG, "*****************************************************************************************");
         ESP_LOGI(TAG, "On Device: roomOccupancy %s", roomOccupancy ? "true" : "false");
         ESP_LOGI(TAG, "On Device: hvacStatus %s", hvacStatus);
@@ -367,6 +425,12 @@ void aws_iot_task(void *param) {
                     rc = aws_iot_shadow_update(&iotCoreClient, client_id, JsonDocumentBuffer,
                                                ShadowUpdateStatusCallback, NULL, 4, true);
                     shadowUpdateInProgress = true;
+                    shadowReportPending = false;
+                    published = true;
+                    publishedTicks = xTaskGetTickCount();
+                    publishedTemperature = temperature;
+                    publishedSound = reportedSound;
+                    publishedActive = active;
                 }
             }
         }
@@ -78,16 +78,14 @@ void ui_textarea_add(char *baseTxt, char *param, size_t paramLen) {
 }
 
 void ui_wifi_label_update(bool state){
-    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
     if (state == false) {
-        lv_label_set_text(wifi_label, LV_SYMBOL_WIFI);
+        UIUpdate_SetLabelText(wifi_label, LV_SYMBOL_WIFI);
     } 
     else{
         char buffer[25];
         sprintf (buffer, "#0000ff %s #", LV_SYMBOL_WIFI);
-        lv_label_set_text(wifi_label, buffer);
+        UIUpdate_SetLabelText(wifi_label, buffer);
     }
-    xSemaphoreGive(xGuiSemaphore);
 }
 
 void ui_init() {